@@ -0,0 +1,74 @@
+#include "arena.h"
+
+#include <cstdlib>
+
+Arena::Arena(int blockSize)
+    : mBlockSize(qMax(4096, blockSize))
+    , mPos(nullptr)
+    , mEnd(nullptr)
+    , mReserved(0)
+    , mUsed(0)
+    , mStrings(this)
+{
+}
+
+Arena::~Arena()
+{
+    foreach(char *block, mBlocks)
+    {
+        std::free(block);
+    }
+}
+
+void *Arena::allocate(int size, int alignment)
+{
+    QMutexLocker locker(&mMutex);
+
+    quintptr pos = (quintptr(mPos) + quintptr(alignment - 1)) & ~quintptr(alignment - 1);
+    if( !mPos || pos + quintptr(size) > quintptr(mEnd) )
+    {
+        /// крупный запрос получает свой блок, текущий блок продолжает раздаваться
+        int blockSize = size + alignment > mBlockSize ? size + alignment : mBlockSize;
+        char *block = static_cast<char *>(std::malloc(size_t(blockSize)));
+        Q_CHECK_PTR(block);
+        mBlocks.append(block);
+        mReserved += blockSize;
+
+        pos = (quintptr(block) + quintptr(alignment - 1)) & ~quintptr(alignment - 1);
+        if( blockSize == mBlockSize )
+        {
+            mEnd = block + blockSize;
+        }
+        else
+        {
+            mUsed += size;
+            return reinterpret_cast<void *>(pos);
+        }
+    }
+
+    mPos = reinterpret_cast<char *>(pos + quintptr(size));
+    mUsed += size;
+    return reinterpret_cast<void *>(pos);
+}
+
+StringPool &Arena::strings()
+{
+    return mStrings;
+}
+
+const StringPool &Arena::strings() const
+{
+    return mStrings;
+}
+
+qint64 Arena::reservedBytes() const
+{
+    QMutexLocker locker(&mMutex);
+    return mReserved;
+}
+
+qint64 Arena::usedBytes() const
+{
+    QMutexLocker locker(&mMutex);
+    return mUsed;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QMutex>
+#include <QVector>
+
+#include "stringpool.h"
+
+/// Память одного анализа: блоки по blockSize выделяются по мере надобности
+/// и раздаются сдвигом указателя, а освобождаются все разом вместе с ареной.
+/// Отдельных free нет. allocate() можно вызывать из рабочих потоков: он
+/// берёт мьютекс, поэтому потребители запрашивают память крупно (блок
+/// столбцов, страница URI), а не на каждый сегмент. Строки, общие для
+/// всего анализа (кодеки, языки, группы, URI init-сегментов), интернируются
+/// в strings() и живут там же.
+class Arena
+{
+public:
+    explicit Arena(int blockSize = 64 * 1024);
+    ~Arena();
+
+    /// память не обнулена; alignment - степень двойки
+    void *allocate(int size, int alignment = 8);
+
+    StringPool &strings();
+    const StringPool &strings() const;
+
+    /// выделено у системы, байт
+    qint64 reservedBytes() const;
+    /// роздано через allocate(), байт
+    qint64 usedBytes() const;
+
+private:
+    Q_DISABLE_COPY(Arena)
+
+    int mBlockSize;
+    mutable QMutex mMutex;
+    QVector<char *> mBlocks;
+    char *mPos;
+    char *mEnd;
+    qint64 mReserved;
+    qint64 mUsed;
+
+    StringPool mStrings;
+};
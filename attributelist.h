@@ -0,0 +1,123 @@
+#pragma once
+
+#include <QLatin1String>
+#include <QVarLengthArray>
+
+#include <cstring>
+
+/// Список атрибутов тега M3U8 (RFC 8216, 4.2), разобранный за один проход.
+/// Имена и значения - представления над исходным буфером строки, поэтому
+/// буфер должен жить дольше объекта. Копирование происходит только тогда,
+/// когда значение сохраняется вызывающей стороной.
+class AttributeList
+{
+public:
+    struct Attribute
+    {
+        QLatin1String name;
+        QLatin1String value;
+        bool quoted;
+    };
+
+    AttributeList()
+    {
+    }
+
+    explicit AttributeList(QLatin1String list)
+    {
+        parse(list);
+    }
+
+    void parse(QLatin1String list)
+    {
+        mAttributes.clear();
+
+        const char *p = list.data();
+        const char *end = p + list.size();
+        while( p < end )
+        {
+            while( p < end && (*p == ' ' || *p == '\t') )
+                ++p;
+
+            const char *nameStart = p;
+            while( p < end && *p != '=' && *p != ',' )
+                ++p;
+            if( p == end || *p == ',' )
+            {
+                /// атрибут без значения - пропускаем
+                if( p < end )
+                    ++p;
+                continue;
+            }
+
+            Attribute attribute;
+            attribute.name = QLatin1String(nameStart, int(p - nameStart));
+            ++p;
+
+            if( p < end && *p == '"' )
+            {
+                ++p;
+                const char *valueStart = p;
+                const char *quote = static_cast<const char *>(std::memchr(p, '"', size_t(end - p)));
+                p = quote ? quote : end;
+                attribute.value = QLatin1String(valueStart, int(p - valueStart));
+                attribute.quoted = true;
+                if( p < end )
+                    ++p;
+            }
+            else
+            {
+                attribute.quoted = false;
+            }
+
+            const char *comma = static_cast<const char *>(std::memchr(p, ',', size_t(end - p)));
+            const char *valueEnd = comma ? comma : end;
+            if( !attribute.quoted )
+            {
+                attribute.value = QLatin1String(p, int(valueEnd - p));
+            }
+            p = comma ? comma + 1 : end;
+
+            mAttributes.append(attribute);
+        }
+    }
+
+    QLatin1String value(QLatin1String name) const
+    {
+        const Attribute *attribute = find(name);
+        return attribute ? attribute->value : QLatin1String();
+    }
+
+    bool contains(QLatin1String name) const
+    {
+        return find(name) != nullptr;
+    }
+
+    int size() const
+    {
+        return mAttributes.size();
+    }
+
+    const Attribute &at(int i) const
+    {
+        return mAttributes.at(i);
+    }
+
+private:
+    const Attribute *find(QLatin1String name) const
+    {
+        for( int i = 0; i < mAttributes.size(); ++i )
+        {
+            const Attribute &attribute = mAttributes.at(i);
+            if( attribute.name.size() == name.size() &&
+                    !std::memcmp(attribute.name.data(), name.data(), size_t(name.size())) )
+            {
+                return &attribute;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    QVarLengthArray<Attribute, 16> mAttributes;
+};
@@ -1,42 +1,42 @@
 #include "backend.h"
 
-#include <QFuture>
-#include <QNetworkReply>
-#include <QtConcurrent>
-
-#include "utils.h"
-
-const int AUDIO_ROWS = 0;
-const int AUDIO_COLUMNS = 5;
-const int VIDEO_ROWS = 0;
-const int VIDEO_COLUMNS = 5;
-const int LOG_ROWS = 0;
-const int LOG_COLUMNS = 1;
+#include "localfiles.h"
+#include "playlistcache.h"
 
 Backend::Backend(QObject *parent)
     : QObject(parent)
-    , mAccessManager(new QNetworkAccessManager(parent))
+    , mAnalyzer(new HlsAnalyzer(this))
+    , mWatcher(new QFutureWatcher<AnalysisResult>(this))
     , mDeviation(10)
-    , mGlobalCounter(0)
-    , mVideoWatcher(nullptr)
-    , mAudioWatcher(nullptr)
+    , mSampleInterval(0)
+    , mGeneration(0)
 {
-    connect(this, &Backend::allRepliesFinished, this, &Backend::onAllRepliesFinished);
+    mAnalyzer->enableCache(PlaylistCache::defaultDirectory());
+    connect(mWatcher, &QFutureWatcher<AnalysisResult>::finished, this, &Backend::onAnalysisFinished);
+    connect(mWatcher, &QFutureWatcher<AnalysisResult>::progressRangeChanged, this, [this](int minimum, int maximum)
+    {
+        Q_UNUSED(minimum)
+        emit progressChanged(mWatcher->progressValue(), maximum);
+    });
+    connect(mWatcher, &QFutureWatcher<AnalysisResult>::progressValueChanged, this, [this](int value)
+    {
+        emit progressChanged(value, mWatcher->progressMaximum());
+    });
 
     createModels();
 }
 
-QStandardItemModel *Backend::audioModel()
+AudioTableModel *Backend::audioModel()
 {
     return mAudioModel;
 }
 
-QStandardItemModel *Backend::videoModel()
+VideoTableModel *Backend::videoModel()
 {
     return mVideoModel;
 }
 
-QStandardItemModel *Backend::logModel()
+LogTableModel *Backend::logModel()
 {
     return mLogModel;
 }
@@ -46,392 +46,232 @@ void Backend::setDeviation(qreal deviation)
     mDeviation = deviation;
 }
 
-void Backend::reset()
+void Backend::setDeepProbe(int sampleInterval)
 {
-    mAudioModel->removeRows(0, mAudioModel->rowCount());
-    mVideoModel->removeRows(0, mVideoModel->rowCount());
-    mLogModel->removeRows(0, mLogModel->rowCount());
-
-    mUrlsForAudio.clear();
-    mUrlsForVideo.clear();
-    mVariantStreams.clear();
+    mSampleInterval = sampleInterval;
+}
 
-    mGlobalCounter = 0;
+void Backend::reset()
+{
+    mAudioModel->clear();
+    mVideoModel->clear();
+    mLogModel->clear();
+
+    mVideoRows.clear();
+    mAudioRows.clear();
+    mCheckedVariants.clear();
+    /// ответы прошлого анализа, уже стоящие в очереди событий, отбрасываются
+    mGeneration++;
+
+    /// прошлый анализ больше не нужен - пусть не занимает сеть
+    mWatcher->future().cancel();
+    mAnalyzer->clearTimings();
+}
 
-    delete mVideoWatcher;
-    delete mAudioWatcher;
-    mVideoWatcher = new QFutureWatcher<void>(this);
-    mAudioWatcher = new QFutureWatcher<void>(this);
+NetworkTimings Backend::timings() const
+{
+    return mAnalyzer->timings();
 }
 
 void Backend::parseUrl(const QString &url)
 {
-    QNetworkRequest request(url);
-    QNetworkReply *reply = mAccessManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]()
+    /// каталог с результатом упаковки может содержать несколько мастер-плейлистов
+    QStringList masters = LocalFiles::expand(url);
+    if( masters.isEmpty() )
     {
-        onReplyFinished(reply);
-    });
-    if( reply->isFinished() )
+        emit error("Мастер-плейлисты не найдены!");
+        return;
+    }
+    if( masters.size() > 1 )
     {
-        onReplyFinished(reply);
+        mLogModel->append(QVector<LogTableModel::Entry>() << LogTableModel::message(
+                              QString("Найдено мастер-плейлистов: %1, анализируется %2").arg(masters.size()).arg(masters.first())));
     }
+
+    AnalysisOptions options;
+    options.sampleInterval = mSampleInterval;
+    quint64 generation = mGeneration;
+    mWatcher->setFuture(mAnalyzer->analyze(masters.first(), options, this, [this, generation](const RenditionResult &rendition)
+    {
+        if( generation == mGeneration )
+            onRenditionReady(rendition);
+    }));
 }
 
-void Backend::onReplyFinished(QNetworkReply *reply)
+void Backend::onAnalysisFinished()
 {
-    if( reply->error() != QNetworkReply::NoError )
+    /// отменённый reset() анализ
+    if( mWatcher->isCanceled() )
+        return;
+
+    AnalysisResult result = mWatcher->result();
+    if( !result.errorString.isEmpty() )
     {
-        qDebug() << "Error: " << reply->errorString();
-        emit error(reply->errorString());
+        emit error(result.errorString);
         return;
     }
-    else
-    {
-        QUrl base = reply->url().adjusted(QUrl::RemoveFilename);
-        QByteArray data = reply->readAll();
-        QTextStream stream(&data);
 
-        QString line = stream.readLine();
-        if( !Utils::isHLS(line) )
-        {
-            emit error("Неверный формат!");
-            return;
-        }
+    qDebug().noquote() << "Запросы:" << mAnalyzer->statisticsString();
+    if( result.partial )
+    {
+        mLogModel->append(QVector<LogTableModel::Entry>() << LogTableModel::message(
+                              "Часть медиа-плейлистов не получена, результаты неполные"));
+    }
 
-        bool isMaster = false;
-        while( !stream.atEnd() )
-        {
-            line = stream.readLine();
-            if( line.contains("EXT-X-STREAM-INF") )
-            {
-                isMaster = true;
-                QString average = Utils::parseLine(line, QString("AVERAGE-BANDWIDTH"));
-                QString codec = Utils::parseLine(line, QString("CODECS"));
-                QString aud = Utils::parseLine(line, QString("AUDIO"));
-                QString resolution = Utils::parseLine(line, QString("RESOLUTION"));
-                QString bandwidth = Utils::parseLine(line, QString("BANDWIDTH"));
-                QString framerate = Utils::parseLine(line, QString("FRAME-RATE"));
-
-                line = stream.readLine();
-                if( line.contains(".m3u8") )
-                {
-                    QUrl final = base.resolved(QUrl(line));
-                    VariantStream variantStream;
-                    variantStream.averageBandwidth = average.toUInt();
-                    variantStream.peakBandwidth = bandwidth.toUInt();
-                    variantStream.audio = aud;
-                    variantStream.videoStream.url = final.toString();
-                    if( codec.contains(",") )
-                    {
-                        variantStream.videoStream.codec = Utils::getReadableCodec(codec.split(",").value(0));
-                        variantStream.audioStream.codec = Utils::getReadableCodec(codec.split(",").value(1));
-                    }
-                    else
-                    {
-                        variantStream.videoStream.codec = Utils::getReadableCodec(codec);
-                    }
-                    variantStream.videoStream.resolution = resolution;
-                    variantStream.videoStream.framerate = framerate;
-                    mVariantStreams.append(variantStream);
-
-                    if( !mUrlsForVideo.contains(variantStream.videoStream.url) )
-                    {
-                        mUrlsForVideo.append(variantStream.videoStream.url);
-                    }
-                }
-            }
-            if( line.contains("EXT-X-MEDIA:TYPE=AUDIO") )
-            {
-                QString groupId = Utils::parseLine(line, QString("GROUP-ID"));
-                QString numOfChannels = Utils::parseLine(line, QString("CHANNELS"));
-                QString language = Utils::parseLine(line, QString("LANGUAGE"));
-                QUrl final = base.resolved(QUrl(Utils::parseLine(line, QString("URI"))));
-                mUrlsForAudio.append(final.toString());
-                for( int i = 0; i < mVariantStreams.size(); ++i )
-                {
-                    if( mVariantStreams.at(i).audio == groupId )
-                    {
-                        mVariantStreams[i].audioStream.url = final.toString();
-                        mVariantStreams[i].audioStream.language = language;
-                        mVariantStreams[i].audioStream.numOfChannels = numOfChannels.toUInt();
-                    }
-                }
-            }
-        }
+    setModelData(result.variantStreams);
+}
 
-        if( isMaster )
-        {
-            foreach(auto &url, mUrlsForVideo)
-            {
-                QNetworkRequest request(url);
-                QNetworkReply *newReply = mAccessManager->get(request);
-                connect(newReply, &QNetworkReply::finished, this, [this, newReply]()
-                {
-                    mVideoReplies.append(qMakePair(newReply, 0));
-                    mGlobalCounter++;
-                    if( mGlobalCounter == mUrlsForAudio.size() + mUrlsForVideo.size() )
-                    {
-                        emit allRepliesFinished();
-                    }
-                });
-            }
-
-            foreach(auto &audioUrl, mUrlsForAudio)
-            {
-                QNetworkRequest request(audioUrl);
-                QNetworkReply *newReply = mAccessManager->get(request);
-                connect(newReply, &QNetworkReply::finished, this, [this, newReply]()
-                {
-                    mAudioReplies.append(qMakePair(newReply, 0));
-                    mGlobalCounter++;
-                    if( mGlobalCounter == mUrlsForAudio.size() + mUrlsForVideo.size() )
-                    {
-                        emit allRepliesFinished();
-                    }
-                });
-            }
-        }
-    }
-    reply->deleteLater();
+void Backend::createModels()
+{
+    mAudioModel = new AudioTableModel(this);
+    mVideoModel = new VideoTableModel(this);
+    mLogModel = new LogTableModel(this);
 }
 
-void Backend::onAllRepliesFinished()
+/// Расхождения заявленного в мастер-плейлисте с содержимым сегментов видео
+static QVector<LogTableModel::Entry> videoProbeEntries(const VideoStream &videoStream, int video)
 {
-    mGlobalCounter = 0;
-    auto getVideoBitrate = [](QPair<QNetworkReply *, quint32> &pair)
+    QVector<LogTableModel::Entry> entries;
+    if( !videoStream.probedCodec.isEmpty() && !videoStream.codec.isEmpty() && videoStream.probedCodec != videoStream.codec )
     {
-        if( pair.first->error() != QNetworkReply::NoError )
-        {
-            qDebug() << "Error: " << pair.first->errorString();
-            return;
-        }
-        else
-        {
-            //QUrl base = pair.first->url().adjusted(QUrl::RemoveFilename);
-            QByteArray data = pair.first->readAll();
-            QTextStream textStream(&data);
-
-            QString line = textStream.readLine();
-            if( !Utils::isHLS(line) )
-            {
-                qDebug() << "Неверный формат!";
-                return;
-            }
-
-            quint32 br = 0;
-            quint32 count = 0;
-            while( !textStream.atEnd() )
-            {
-                line = textStream.readLine();
-                if( line.contains("EXT-X-BITRATE") )
-                {
-                    QString bitrate = Utils::parseLine(line, QString("EXT-X-BITRATE"));
-                    br += bitrate.toUInt();
-                    count++;
-                }
-            }
-
-            if (count > 0)
-                pair.second = (br * 1000) / count;
-        }
-    };
-    QFuture<void> videoFuture = QtConcurrent::map(mVideoReplies, getVideoBitrate);
+        entries.append(LogTableModel::message(QString("Кодек видео в сегментах: %1, заявлен: %2")
+                                              .arg(videoStream.probedCodec, videoStream.codec), video));
+    }
 
-    auto getAudioBitrate = [](QPair<QNetworkReply *, quint32> &pair)
+    bool ok = false;
+    qreal framerate = videoStream.framerate.toDouble(&ok);
+    if( ok && framerate > 0 && videoStream.probedFramerate > 0 &&
+            qAbs(videoStream.probedFramerate - framerate) > framerate / 100 )
     {
-        if( pair.first->error() != QNetworkReply::NoError )
-        {
-            qDebug() << "Error: " << pair.first->errorString();
-            return;
-        }
-        else
-        {
-            //QUrl base = pair.first->url().adjusted(QUrl::RemoveFilename);
-            QByteArray data = pair.first->readAll();
-            QTextStream textStream(&data);
-
-            QString line = textStream.readLine();
-            if( !Utils::isHLS(line) )
-            {
-                qDebug() << "Неверный формат!";
-                return;
-            }
-
-            quint32 br = 0;
-            quint32 count = 0;
-            while( !textStream.atEnd() )
-            {
-                line = textStream.readLine();
-                if( line.contains("EXT-X-BITRATE") )
-                {
-                    QString bitrate = Utils::parseLine(line, QString("EXT-X-BITRATE"));
-                    br += bitrate.toUInt();
-                    count++;
-                }
-            }
-
-            if (count > 0)
-                pair.second = (br * 1000) / count;
-        }
-    };
-    QFuture<void> audioFuture = QtConcurrent::map(mAudioReplies, getAudioBitrate);
+        entries.append(LogTableModel::message(QString("Частота кадров в сегментах: %1, заявлена: %2")
+                                              .arg(videoStream.probedFramerate, 0, 'f', 3).arg(videoStream.framerate), video));
+    }
 
-    connect(mVideoWatcher, &QFutureWatcher<void>::finished, this, &Backend::onVideoBitratesComputed);
-    mVideoWatcher->setFuture(videoFuture);
-    connect(mAudioWatcher, &QFutureWatcher<void>::finished, this, &Backend::onAudioBitratesComputed);
-    mAudioWatcher->setFuture(audioFuture);
+    if( !videoStream.probedResolution.isEmpty() && !videoStream.resolution.isEmpty() &&
+            videoStream.probedResolution != videoStream.resolution )
+    {
+        entries.append(LogTableModel::message(QString("Разрешение в сегментах: %1, заявлено: %2")
+                                              .arg(videoStream.probedResolution, videoStream.resolution), video));
+    }
+    return entries;
 }
 
-void Backend::onVideoBitratesComputed()
+/// То же для аудио; аудио без отдельной группы идёт в сегментах видео
+static QVector<LogTableModel::Entry> audioProbeEntries(const AudioStream &audioStream, int video, int audio)
 {
-    for( int i = 0; i < mVideoReplies.size(); ++i )
+    QVector<LogTableModel::Entry> entries;
+    if( !audioStream.probedCodec.isEmpty() && !audioStream.codec.isEmpty() && audioStream.probedCodec != audioStream.codec )
     {
-        setVideoBitrateByUrl(mVideoReplies.at(i).first->url().toString(), mVideoReplies.at(i).second);
-        mVideoReplies.at(i).first->deleteLater();
-
-        mGlobalCounter++;
-        if( mGlobalCounter == mUrlsForAudio.size() + mUrlsForVideo.size() )
-        {
-            mVideoReplies.clear();
-            mAudioReplies.clear();
-            setModelData();
-            break;
-
-        }
+        entries.append(LogTableModel::message(QString("Кодек аудио в сегментах: %1, заявлен: %2")
+                                              .arg(audioStream.probedCodec, audioStream.codec), video, audio));
+    }
+    if( audioStream.probedChannels > 0 && audioStream.numOfChannels > 0 && audioStream.probedChannels != audioStream.numOfChannels )
+    {
+        entries.append(LogTableModel::message(QString("Каналов аудио в сегментах: %1, заявлено: %2")
+                                              .arg(audioStream.probedChannels).arg(audioStream.numOfChannels), video, audio));
     }
+    return entries;
 }
 
-void Backend::onAudioBitratesComputed()
+void Backend::addVideoStream(const VariantStream &variantStream, QVector<LogTableModel::Entry> *entries)
 {
-    for( int i = 0; i < mAudioReplies.size(); ++i )
-    {
-        setAudioBitrateByAudio(mAudioReplies.at(i).first->url().toString(), mAudioReplies.at(i).second);
-        mAudioReplies.at(i).first->deleteLater();
+    if( variantStream.videoId == -1 || mVideoRows.contains(variantStream.videoId) )
+        return;
 
-        mGlobalCounter++;
-        if( mGlobalCounter == mUrlsForAudio.size() + mUrlsForVideo.size() )
-        {
-            mVideoReplies.clear();
-            mAudioReplies.clear();
-            setModelData();
-            break;
-        }
+    mVideoModel->append(QVector<VideoStream>() << variantStream.videoStream);
+    int video = mVideoModel->rowCount();
+    mVideoRows.insert(variantStream.videoId, video);
+
+    if( variantStream.videoStream.realVideoBitrate == 0 )
+    {
+        entries->append(LogTableModel::entry(LogTableModel::ZeroVideoBitrate, video));
+    }
+    *entries += videoProbeEntries(variantStream.videoStream, video);
+    if( variantStream.audioId == -1 )
+    {
+        *entries += audioProbeEntries(variantStream.audioStream, video, 0);
     }
 }
 
-void Backend::createModels()
+void Backend::addAudioStream(const VariantStream &variantStream, QVector<LogTableModel::Entry> *entries)
 {
-    mAudioModel = new QStandardItemModel(AUDIO_ROWS, AUDIO_COLUMNS, this);
-    mAudioModel->setHeaderData(0, Qt::Horizontal, tr("Поток"));
-    mAudioModel->setHeaderData(1, Qt::Horizontal, tr("Кодек"));
-    mAudioModel->setHeaderData(2, Qt::Horizontal, tr("Количество каналов"));
-    mAudioModel->setHeaderData(3, Qt::Horizontal, tr("Язык"));
-    mAudioModel->setHeaderData(4, Qt::Horizontal, tr("Битрейт"));
-
-    mVideoModel = new QStandardItemModel(VIDEO_ROWS, VIDEO_COLUMNS, this);
-    mVideoModel->setHeaderData(0, Qt::Horizontal, tr("Поток"));
-    mVideoModel->setHeaderData(1, Qt::Horizontal, tr("Кодек"));
-    mVideoModel->setHeaderData(2, Qt::Horizontal, tr("Разрешение"));
-    mVideoModel->setHeaderData(3, Qt::Horizontal, tr("Битрейт"));
-    mVideoModel->setHeaderData(4, Qt::Horizontal, tr("Фреймрейт"));
-
-    mLogModel = new QStandardItemModel(LOG_ROWS, LOG_COLUMNS, this);
-    mLogModel->setHeaderData(0, Qt::Horizontal, tr("Сообщение"));
-}
+    if( variantStream.audioId == -1 || mAudioRows.contains(variantStream.audioId) )
+        return;
 
-void Backend::setModelData()
-{
-    for(int i = 0; i < mVariantStreams.size(); ++i )
+    mAudioModel->append(QVector<AudioStream>() << variantStream.audioStream);
+    int audio = mAudioModel->rowCount();
+    mAudioRows.insert(variantStream.audioId, audio);
+
+    if( variantStream.audioStream.realAudioBitrate == 0 )
     {
-        if( !mVariantStreams.at(i).videoStream.url.isEmpty() &&
-                mVideoModel->findItems(mVariantStreams.at(i).videoStream.url).isEmpty() )
-        {
-            int rowCount = mVideoModel->rowCount();
-            mVideoModel->insertRows(rowCount, 1, QModelIndex());
-
-            mVideoModel->setData(mVideoModel->index(rowCount, 0, QModelIndex()), mVariantStreams.at(i).videoStream.url);
-            mVideoModel->setData(mVideoModel->index(rowCount, 1, QModelIndex()), mVariantStreams.at(i).videoStream.codec);
-            mVideoModel->setData(mVideoModel->index(rowCount, 2, QModelIndex()), mVariantStreams.at(i).videoStream.resolution);
-            mVideoModel->setData(mVideoModel->index(rowCount, 3, QModelIndex()), mVariantStreams.at(i).videoStream.realVideoBitrate);
-            mVideoModel->setData(mVideoModel->index(rowCount, 4, QModelIndex()), mVariantStreams.at(i).videoStream.framerate);
-
-            if( mVariantStreams.at(i).videoStream.realVideoBitrate == 0 )
-            {
-                QString error = QString("Реальный битрейт равен нулю для видео-потока #%1").arg(rowCount + 1);
-
-                rowCount = mLogModel->rowCount();
-                mLogModel->insertRows(rowCount, 1, QModelIndex());
-                mLogModel->setData(mLogModel->index(rowCount, 0, QModelIndex()), error);
-            }
-        }
-        if( !mVariantStreams.at(i).audioStream.url.isEmpty() &&
-                mAudioModel->findItems(mVariantStreams.at(i).audioStream.url).isEmpty() )
-        {
-            int rowCount = mAudioModel->rowCount();
-            mAudioModel->insertRows(rowCount, 1, QModelIndex());
-
-            mAudioModel->setData(mAudioModel->index(rowCount, 0, QModelIndex()), mVariantStreams.at(i).audioStream.url);
-            mAudioModel->setData(mAudioModel->index(rowCount, 1, QModelIndex()), mVariantStreams.at(i).audioStream.codec);
-            mAudioModel->setData(mAudioModel->index(rowCount, 2, QModelIndex()), mVariantStreams.at(i).audioStream.numOfChannels);
-            mAudioModel->setData(mAudioModel->index(rowCount, 3, QModelIndex()), mVariantStreams.at(i).audioStream.language);
-            mAudioModel->setData(mAudioModel->index(rowCount, 4, QModelIndex()), mVariantStreams.at(i).audioStream.realAudioBitrate);
-
-            if( mVariantStreams.at(i).audioStream.realAudioBitrate == 0 )
-            {
-                QString error = QString("Реальный битрейт равен нулю для аудио-потока #%1").arg(rowCount + 1);
-
-                rowCount = mLogModel->rowCount();
-                mLogModel->insertRows(rowCount, 1, QModelIndex());
-                mLogModel->setData(mLogModel->index(rowCount, 0, QModelIndex()), error);
-            }
-        }
+        entries->append(LogTableModel::entry(LogTableModel::ZeroAudioBitrate, 0, audio));
     }
+    *entries += audioProbeEntries(variantStream.audioStream, 0, audio);
+}
 
-    for( int i = 0; i < mVariantStreams.size(); ++i )
+/// Вариант проверяется один раз - когда в моделях есть обе его части
+void Backend::checkRanges(const QVector<int> &indexes, const QList<VariantStream> &variantStreams,
+                          QVector<LogTableModel::Entry> *entries)
+{
+    for( int i = 0; i < indexes.size(); ++i )
     {
-        if( !mVariantStreams[i].isInRange(mDeviation) )
+        const VariantStream &variantStream = variantStreams.at(i);
+        int video = variantStream.videoId != -1 ? mVideoRows.value(variantStream.videoId) : 0;
+        int audio = variantStream.audioId != -1 ? mAudioRows.value(variantStream.audioId) : 0;
+        if( (variantStream.videoId != -1 && video == 0) || (variantStream.audioId != -1 && audio == 0) )
+            continue;
+        if( mCheckedVariants.contains(indexes.at(i)) )
+            continue;
+        mCheckedVariants.insert(indexes.at(i));
+
+        if( (video != 0 || audio != 0) && !variantStream.isInRange(mDeviation) )
         {
-            int video = !mVideoModel->findItems(mVariantStreams.at(i).videoStream.url).isEmpty()
-                    ? mVideoModel->findItems(mVariantStreams.at(i).videoStream.url).first()->index().row() + 1
-                    : 0;
-            int audio = !mAudioModel->findItems(mVariantStreams.at(i).audioStream.url).isEmpty()
-                    ? mAudioModel->findItems(mVariantStreams.at(i).audioStream.url).first()->index().row() + 1
-                    : 0;
-            QString error;
-            if( video == 0 && audio == 0 )
-                continue;
-            if( video == 0 && audio != 0 )
-                error = QString("Реальный битрейт вне допустимого диапазона для Variant Stream'а с аудио-потоком #%1").arg(audio);
-            if( video != 0 && audio == 0 )
-                error = QString("Реальный битрейт вне допустимого диапазона для Variant Stream'а с видео-потоком #%1").arg(video);
-            if( video != 0 && audio != 0 )
-                error = QString("Реальный битрейт вне допустимого диапазона для Variant Stream'а с видео-потоком #%1 и аудио-потоком #%2")
-                        .arg(video).arg(audio);
-
-            int rowCount = mLogModel->rowCount();
-            mLogModel->insertRows(rowCount, 1, QModelIndex());
-            mLogModel->setData(mLogModel->index(rowCount, 0, QModelIndex()), error);
+            entries->append(LogTableModel::entry(LogTableModel::OutOfRange, video, audio));
         }
     }
-
-    emit analysisFinished();
 }
 
-void Backend::setVideoBitrateByUrl(const QString &videoUrl, quint32 videoBitrate)
+void Backend::onRenditionReady(const RenditionResult &rendition)
 {
-    for(int i = 0; i < mVariantStreams.size(); ++i )
+    QVector<LogTableModel::Entry> entries;
+    foreach(const VariantStream &variantStream, rendition.variantStreams)
     {
-        if( mVariantStreams.at(i).videoStream.url == videoUrl )
-            mVariantStreams[i].videoStream.realVideoBitrate = videoBitrate;
+        if( rendition.isAudio )
+            addAudioStream(variantStream, &entries);
+        else
+            addVideoStream(variantStream, &entries);
     }
+    checkRanges(rendition.variantIndexes, rendition.variantStreams, &entries);
+    mLogModel->append(entries);
 }
 
-void Backend::setAudioBitrateByAudio(const QString &audioUrl, quint32 audioBitrate)
+void Backend::setModelData(const QList<VariantStream> &variantStreams)
 {
-    for(int i = 0; i < mVariantStreams.size(); ++i )
+    QVector<LogTableModel::Entry> entries;
+
+    /// медиа-плейлисты, которые так и не пришли, показываются с нулевым битрейтом
+    QVector<int> indexes;
+    for( int i = 0; i < variantStreams.size(); ++i )
+    {
+        addVideoStream(variantStreams.at(i), &entries);
+        addAudioStream(variantStreams.at(i), &entries);
+        indexes.append(i);
+    }
+    checkRanges(indexes, variantStreams, &entries);
+
+    /// пиковые эпизоды считаются по всем плейлистам сразу - только в конце
+    for( int i = 0; i < variantStreams.size(); ++i )
     {
-        if( mVariantStreams.at(i).audioStream.url == audioUrl )
-            mVariantStreams[i].audioStream.realAudioBitrate = audioBitrate;
+        const VariantStream &variantStream = variantStreams.at(i);
+        int video = variantStream.videoId != -1 ? mVideoRows.value(variantStream.videoId) : 0;
+        int audio = variantStream.audioId != -1 ? mAudioRows.value(variantStream.audioId) : 0;
+        foreach(const PeakRange &range, variantStream.peakRanges)
+        {
+            entries.append(LogTableModel::peakEntry(range, variantStream.peakBandwidth, video, audio));
+        }
     }
+
+    mLogModel->append(entries);
+
+    emit analysisFinished();
 }
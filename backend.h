@@ -3,99 +3,70 @@
 #include <QObject>
 
 #include <QFutureWatcher>
-#include <QNetworkAccessManager>
-#include <QStandardItemModel>
-
-struct VideoStream
-{
-    QString url;
-    QString codec;
-    QString resolution;
-    quint32 realVideoBitrate; //in bits per second
-    QString framerate;
-};
-
-struct AudioStream
-{
-    QString url;
-    QString codec;
-    quint32 numOfChannels;
-    QString language;
-    quint32 realAudioBitrate; //in bits per second
-};
-
-struct VariantStream
-{
-    quint32 averageBandwidth; //in bits per second
-    quint32 peakBandwidth; //in bits per second
-    QString audio;
-
-    VideoStream videoStream;
-    AudioStream audioStream;
-
-    bool isInRange(qreal deviation)
-    {
-        quint32 x;
-        if( videoStream.realVideoBitrate + audioStream.realAudioBitrate > averageBandwidth )
-            x = videoStream.realVideoBitrate + audioStream.realAudioBitrate - averageBandwidth;
-        else
-            x = averageBandwidth - videoStream.realVideoBitrate - audioStream.realAudioBitrate;
-        qreal y = x / static_cast<qreal>(averageBandwidth);
-        qreal z = deviation / static_cast<qreal>(100);
-
-        return z > y;
-    }
-};
-
+#include <QHash>
+#include <QSet>
+
+#include "hlsanalyzer.h"
+#include "networktimings.h"
+#include "streams.h"
+#include "tablemodels.h"
+
+/// Модели окна поверх библиотеки анализа: сеть и анализ живут в потоке
+/// HlsAnalyzer. Каждый готовый медиа-плейлист сразу добавляется в модели,
+/// вариант проверяется, как только готовы обе его части; в конце
+/// добавляются неполученные плейлисты и пиковые эпизоды.
 class Backend : public QObject
 {
     Q_OBJECT
 public:
     explicit Backend(QObject *parent = nullptr);
 
-    QStandardItemModel *audioModel();
-    QStandardItemModel *videoModel();
-    QStandardItemModel *logModel();
+    AudioTableModel *audioModel();
+    VideoTableModel *videoModel();
+    LogTableModel *logModel();
 
     void setDeviation(qreal deviation);
+    /// см. StreamAnalysis::setDeepProbe
+    void setDeepProbe(int sampleInterval);
     void reset();
     void parseUrl(const QString &url);
 
+    /// копия замеров запросов последнего анализа
+    NetworkTimings timings() const;
+
 signals:
+    /// готово done медиа-плейлистов и проверок сегментов из total
+    void progressChanged(int done, int total);
     void analysisFinished();
     void error(const QString &errorString);
-    void allRepliesFinished();
 
 private slots:
-    void onReplyFinished(QNetworkReply *reply);
-    void onAllRepliesFinished();
-    void onVideoBitratesComputed();
-    void onAudioBitratesComputed();
+    void onAnalysisFinished();
 
 private:
     void createModels();
-    void setModelData();
-    void setVideoBitrateByUrl(const QString &videoUrl, quint32 videoBitrate);
-    void setAudioBitrateByAudio(const QString &audioUrl, quint32 audioBitrate);
+    void onRenditionReady(const RenditionResult &rendition);
+    void addVideoStream(const VariantStream &variantStream, QVector<LogTableModel::Entry> *entries);
+    void addAudioStream(const VariantStream &variantStream, QVector<LogTableModel::Entry> *entries);
+    void checkRanges(const QVector<int> &indexes, const QList<VariantStream> &variantStreams,
+                     QVector<LogTableModel::Entry> *entries);
+    void setModelData(const QList<VariantStream> &variantStreams);
 
 private:
-    QStandardItemModel *mAudioModel;
-    QStandardItemModel *mVideoModel;
-    QStandardItemModel *mLogModel;
+    AudioTableModel *mAudioModel;
+    VideoTableModel *mVideoModel;
+    LogTableModel *mLogModel;
 
-    QNetworkAccessManager *mAccessManager;
+    HlsAnalyzer *mAnalyzer;
+    QFutureWatcher<AnalysisResult> *mWatcher;
 
     // in percent
     qreal mDeviation;
+    int mSampleInterval;
 
-    QList<QString> mUrlsForVideo;
-    QList<QString> mUrlsForAudio;
-    QList<VariantStream> mVariantStreams;
-
-    int mGlobalCounter;
-
-    QList<QPair<QNetworkReply*, quint32> > mVideoReplies;
-    QList<QPair<QNetworkReply*, quint32> > mAudioReplies;
-    QFutureWatcher<void> *mVideoWatcher;
-    QFutureWatcher<void> *mAudioWatcher;
+    /// строка (с единицы) в модели видео/аудио для каждого id из реестра
+    QHash<int, int> mVideoRows;
+    QHash<int, int> mAudioRows;
+    QSet<int> mCheckedVariants;
+    quint64 mGeneration;
 };
@@ -0,0 +1,416 @@
+#include "batchrunner.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include "localfiles.h"
+#include "snapshot.h"
+
+static QByteArray csvField(const QString &value)
+{
+    QByteArray field = value.toUtf8();
+    if( field.contains(',') || field.contains('"') || field.contains('\n') )
+    {
+        field.replace("\"", "\"\"");
+        field.prepend('"');
+        field.append('"');
+    }
+    return field;
+}
+
+BatchRunner::BatchRunner(QObject *parent)
+    : QObject(parent)
+    , mAnalyzer(new HlsAnalyzer(this))
+    , mConcurrency(16)
+    , mRunning(0)
+    , mFormat(Json)
+    , mDeviation(10)
+    , mLive(false)
+    , mLiveDurationMs(0)
+    , mSucceeded(0)
+    , mFailed(0)
+{
+    mOut.open(stdout, QIODevice::WriteOnly);
+}
+
+void BatchRunner::setConcurrency(int concurrency)
+{
+    mConcurrency = qMax(1, concurrency);
+}
+
+void BatchRunner::setMaxPerHost(int maxPerHost)
+{
+    mAnalyzer->setMaxPerHost(maxPerHost);
+}
+
+void BatchRunner::setRetries(int retries)
+{
+    mAnalyzer->setMaxAttempts(retries + 1);
+}
+
+void BatchRunner::setRequestTimeout(int ms)
+{
+    mAnalyzer->setRequestTimeout(ms);
+}
+
+void BatchRunner::enableCache(const QString &directory, qint64 maximumSize)
+{
+    mAnalyzer->enableCache(directory, maximumSize);
+}
+
+void BatchRunner::setFormat(Format format)
+{
+    mFormat = format;
+}
+
+void BatchRunner::setDeviation(qreal deviation)
+{
+    mDeviation = deviation;
+}
+
+void BatchRunner::setPeakWindow(quint32 windowMs)
+{
+    mOptions.peakWindowMs = windowMs;
+}
+
+void BatchRunner::setProbeRate(int requestsPerSecond)
+{
+    mOptions.probeRate = requestsPerSecond;
+    mLiveOptions.probeRate = requestsPerSecond;
+}
+
+void BatchRunner::setDeepProbe(int sampleInterval)
+{
+    mOptions.sampleInterval = sampleInterval;
+}
+
+void BatchRunner::setDeadline(int ms)
+{
+    mOptions.deadlineMs = ms;
+}
+
+void BatchRunner::setLive(int durationMs)
+{
+    mLive = true;
+    mLiveDurationMs = durationMs;
+}
+
+void BatchRunner::setSnapshotDirectory(const QString &directory)
+{
+    mSnapshotDirectory = directory;
+    QDir().mkpath(directory);
+}
+
+void BatchRunner::addUrls(const QStringList &urls)
+{
+    foreach(auto &url, urls)
+    {
+        foreach(auto &master, LocalFiles::expand(url))
+        {
+            mQueue.enqueue(master);
+        }
+    }
+}
+
+void BatchRunner::start()
+{
+    if( mLive )
+    {
+        startLive();
+        return;
+    }
+
+    if( mFormat == Csv )
+    {
+        mOut.write("master,error,video,audio,average_bandwidth,peak_bandwidth,video_bitrate,audio_bitrate,in_range,real_peak_bandwidth,peak_ranges\n");
+        mOut.flush();
+    }
+
+    if( mQueue.isEmpty() )
+    {
+        emit finished();
+        return;
+    }
+    startNext();
+}
+
+int BatchRunner::succeeded() const
+{
+    return mSucceeded;
+}
+
+int BatchRunner::failed() const
+{
+    return mFailed;
+}
+
+QString BatchRunner::statisticsString() const
+{
+    return mAnalyzer->statisticsString();
+}
+
+QByteArray BatchRunner::metrics(bool prometheus) const
+{
+    NetworkTimings timings = mAnalyzer->timings();
+    return prometheus ? timings.toPrometheus() : timings.toJson();
+}
+
+void BatchRunner::startNext()
+{
+    while( mRunning < mConcurrency && !mQueue.isEmpty() )
+    {
+        QFutureWatcher<AnalysisResult> *watcher = new QFutureWatcher<AnalysisResult>(this);
+        connect(watcher, &QFutureWatcher<AnalysisResult>::finished, this, [this, watcher]()
+        {
+            watcher->deleteLater();
+            onAnalysisFinished(watcher->result());
+        });
+        mRunning++;
+        watcher->setFuture(mAnalyzer->analyze(mQueue.dequeue(), mOptions));
+    }
+}
+
+void BatchRunner::startLive()
+{
+    if( mFormat == Csv )
+    {
+        mOut.write("master,playlist,audio,error,sequence,new_segments,segments,rolling_bitrate,target_duration_ms,stale_ms,stale,ended,reloads,delta_reloads,bytes\n");
+        mOut.flush();
+    }
+
+    while( !mQueue.isEmpty() )
+    {
+        mChannels.append(mAnalyzer->monitor(mQueue.dequeue(), mLiveOptions, this, [this](const LiveStatus &status)
+        {
+            onLiveStatus(status);
+        }));
+    }
+    if( mChannels.isEmpty() )
+    {
+        emit finished();
+        return;
+    }
+
+    if( mLiveDurationMs > 0 )
+    {
+        QTimer::singleShot(mLiveDurationMs, this, [this]()
+        {
+            foreach(int channel, mChannels)
+            {
+                mAnalyzer->stopMonitoring(channel);
+            }
+            mChannels.clear();
+            emit finished();
+        });
+    }
+}
+
+void BatchRunner::onAnalysisFinished(const AnalysisResult &result)
+{
+    if( result.errorString.isEmpty() )
+        mSucceeded++;
+    else
+        mFailed++;
+
+    if( mFormat == Json )
+        writeJson(result);
+    else
+        writeCsv(result);
+    mOut.flush();
+
+    if( !mSnapshotDirectory.isEmpty() )
+    {
+        qint64 time = QDateTime::currentMSecsSinceEpoch();
+        Snapshot::save(QDir(mSnapshotDirectory).filePath(Snapshot::fileName(result.url, time)), result, time);
+    }
+
+    mRunning--;
+
+    if( mRunning == 0 && mQueue.isEmpty() )
+    {
+        emit finished();
+        return;
+    }
+    startNext();
+}
+
+void BatchRunner::onLiveStatus(const LiveStatus &status)
+{
+    /// обновления, отправленные до остановки
+    if( mChannels.isEmpty() )
+        return;
+
+    if( status.errorString.isEmpty() )
+        mSucceeded++;
+    else
+        mFailed++;
+
+    if( mFormat == Json )
+        writeLiveJson(status);
+    else
+        writeLiveCsv(status);
+    mOut.flush();
+}
+
+void BatchRunner::writeJson(const AnalysisResult &result)
+{
+    QJsonObject object;
+    object.insert("master", result.url);
+    if( !result.errorString.isEmpty() )
+    {
+        object.insert("error", result.errorString);
+    }
+    if( result.partial )
+    {
+        object.insert("partial", true);
+    }
+
+    QJsonArray variants;
+    foreach(auto &variantStream, result.variantStreams)
+    {
+        QJsonObject video;
+        video.insert("url", variantStream.videoStream.url);
+        video.insert("codec", variantStream.videoStream.codec);
+        video.insert("resolution", variantStream.videoStream.resolution);
+        video.insert("framerate", variantStream.videoStream.framerate);
+        video.insert("bitrate", qint64(variantStream.videoStream.realVideoBitrate));
+        if( !variantStream.videoStream.probedCodec.isEmpty() )
+        {
+            QJsonObject probe;
+            probe.insert("codec", variantStream.videoStream.probedCodec);
+            probe.insert("frameRate", variantStream.videoStream.probedFramerate);
+            if( !variantStream.videoStream.probedResolution.isEmpty() )
+                probe.insert("resolution", variantStream.videoStream.probedResolution);
+            probe.insert("bitrate", qint64(variantStream.videoStream.probedBitrate));
+            video.insert("probe", probe);
+        }
+
+        QJsonObject variant;
+        variant.insert("averageBandwidth", qint64(variantStream.averageBandwidth));
+        variant.insert("peakBandwidth", qint64(variantStream.peakBandwidth));
+        variant.insert("inRange", variantStream.isInRange(mDeviation));
+        variant.insert("realPeakBandwidth", qint64(variantStream.realPeakBandwidth));
+        if( !variantStream.peakRanges.isEmpty() )
+        {
+            QJsonArray ranges;
+            foreach(auto &range, variantStream.peakRanges)
+            {
+                QJsonObject peakRange;
+                peakRange.insert("startMs", qint64(range.startMs));
+                peakRange.insert("endMs", qint64(range.endMs));
+                peakRange.insert("peakBitrate", qint64(range.peakBitrate));
+                ranges.append(peakRange);
+            }
+            variant.insert("peakRanges", ranges);
+        }
+        variant.insert("video", video);
+
+        if( !variantStream.audioStream.url.isEmpty() )
+        {
+            QJsonObject audio;
+            audio.insert("url", variantStream.audioStream.url);
+            audio.insert("codec", variantStream.audioStream.codec);
+            audio.insert("channels", qint64(variantStream.audioStream.numOfChannels));
+            audio.insert("language", variantStream.audioStream.language);
+            audio.insert("bitrate", qint64(variantStream.audioStream.realAudioBitrate));
+            if( !variantStream.audioStream.probedCodec.isEmpty() )
+            {
+                QJsonObject probe;
+                probe.insert("codec", variantStream.audioStream.probedCodec);
+                if( variantStream.audioStream.probedChannels > 0 )
+                    probe.insert("channels", qint64(variantStream.audioStream.probedChannels));
+                probe.insert("bitrate", qint64(variantStream.audioStream.probedBitrate));
+                audio.insert("probe", probe);
+            }
+            variant.insert("audio", audio);
+        }
+        variants.append(variant);
+    }
+    object.insert("variants", variants);
+
+    mOut.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    mOut.write("\n");
+}
+
+void BatchRunner::writeCsv(const AnalysisResult &result)
+{
+    QByteArray master = csvField(result.url);
+    if( !result.errorString.isEmpty() || result.variantStreams.isEmpty() )
+    {
+        mOut.write(master + "," + csvField(result.errorString) + ",,,,,,,,,\n");
+        return;
+    }
+
+    foreach(auto &variantStream, result.variantStreams)
+    {
+        QByteArray row = master;
+        row += result.partial ? ",partial," : ",,";
+        row += csvField(variantStream.videoStream.url) + ",";
+        row += csvField(variantStream.audioStream.url) + ",";
+        row += QByteArray::number(variantStream.averageBandwidth) + ",";
+        row += QByteArray::number(variantStream.peakBandwidth) + ",";
+        row += QByteArray::number(variantStream.videoStream.realVideoBitrate) + ",";
+        row += QByteArray::number(variantStream.audioStream.realAudioBitrate) + ",";
+        row += variantStream.isInRange(mDeviation) ? "1" : "0";
+        row += "," + QByteArray::number(variantStream.realPeakBandwidth);
+        row += "," + QByteArray::number(variantStream.peakRanges.size());
+        row += "\n";
+        mOut.write(row);
+    }
+}
+
+void BatchRunner::writeLiveJson(const LiveStatus &status)
+{
+    QJsonObject object;
+    object.insert("master", status.master);
+    if( !status.url.isEmpty() )
+    {
+        object.insert("playlist", status.url);
+        object.insert("audio", status.isAudio);
+    }
+    if( !status.errorString.isEmpty() )
+    {
+        object.insert("error", status.errorString);
+    }
+    object.insert("sequence", qint64(status.lastSequence));
+    object.insert("newSegments", qint64(status.newSegments));
+    object.insert("segments", qint64(status.segmentCount));
+    object.insert("rollingBitrate", qint64(status.rollingBitrate));
+    object.insert("targetDurationMs", qint64(status.targetDurationMs));
+    object.insert("staleMs", status.staleMs);
+    object.insert("stale", status.stale);
+    object.insert("ended", status.ended);
+    object.insert("reloads", qint64(status.reloads));
+    object.insert("deltaReloads", qint64(status.deltaReloads));
+    object.insert("bytes", qint64(status.bytes));
+
+    mOut.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    mOut.write("\n");
+}
+
+void BatchRunner::writeLiveCsv(const LiveStatus &status)
+{
+    QByteArray row = csvField(status.master) + ",";
+    row += csvField(status.url) + ",";
+    row += status.isAudio ? "1," : "0,";
+    row += csvField(status.errorString) + ",";
+    row += QByteArray::number(status.lastSequence) + ",";
+    row += QByteArray::number(status.newSegments) + ",";
+    row += QByteArray::number(status.segmentCount) + ",";
+    row += QByteArray::number(status.rollingBitrate) + ",";
+    row += QByteArray::number(status.targetDurationMs) + ",";
+    row += QByteArray::number(status.staleMs) + ",";
+    row += status.stale ? "1," : "0,";
+    row += status.ended ? "1," : "0,";
+    row += QByteArray::number(status.reloads) + ",";
+    row += QByteArray::number(status.deltaReloads) + ",";
+    row += QByteArray::number(status.bytes);
+    row += "\n";
+    mOut.write(row);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QObject>
+
+#include <QFile>
+#include <QQueue>
+
+#include "hlsanalyzer.h"
+
+/// Пакетный анализ без графического интерфейса: очередь мастер-URL,
+/// не более concurrency одновременных анализов на общем HlsAnalyzer,
+/// результат каждого потока пишется в stdout сразу по готовности.
+class BatchRunner : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format
+    {
+        Json,
+        Csv
+    };
+
+    explicit BatchRunner(QObject *parent = nullptr);
+
+    void setConcurrency(int concurrency);
+    void setMaxPerHost(int maxPerHost);
+    /// повторов после неудачной попытки, 0 - без повторов
+    void setRetries(int retries);
+    void setRequestTimeout(int ms);
+    void enableCache(const QString &directory, qint64 maximumSize);
+    void setFormat(Format format);
+    void setDeviation(qreal deviation);
+    void setPeakWindow(quint32 windowMs);
+    void setProbeRate(int requestsPerSecond);
+    void setDeepProbe(int sampleInterval);
+    /// срок анализа одного потока, 0 - без ограничения
+    void setDeadline(int ms);
+    /// вместо разового анализа наблюдать за живыми потоками durationMs
+    /// (0 - пока процесс не остановят), выводя каждую перезагрузку
+    void setLive(int durationMs);
+    /// каталог, куда пишется снимок каждого анализа, см. Snapshot
+    void setSnapshotDirectory(const QString &directory);
+    void addUrls(const QStringList &urls);
+
+    void start();
+
+    int succeeded() const;
+    int failed() const;
+    QString statisticsString() const;
+    QByteArray metrics(bool prometheus) const;
+
+signals:
+    void finished();
+
+private:
+    void startNext();
+    void startLive();
+    void onAnalysisFinished(const AnalysisResult &result);
+    void onLiveStatus(const LiveStatus &status);
+    void writeJson(const AnalysisResult &result);
+    void writeCsv(const AnalysisResult &result);
+    void writeLiveJson(const LiveStatus &status);
+    void writeLiveCsv(const LiveStatus &status);
+
+private:
+    HlsAnalyzer *mAnalyzer;
+    QFile mOut;
+
+    QQueue<QString> mQueue;
+    int mConcurrency;
+    int mRunning;
+    Format mFormat;
+
+    // in percent
+    qreal mDeviation;
+    AnalysisOptions mOptions;
+    QString mSnapshotDirectory;
+
+    bool mLive;
+    int mLiveDurationMs;
+    LiveOptions mLiveOptions;
+    QVector<int> mChannels;
+
+    int mSucceeded;
+    int mFailed;
+};
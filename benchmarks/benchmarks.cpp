@@ -0,0 +1,921 @@
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryFile>
+#include <QtTest>
+
+
+#include "arena.h"
+#include "attributelist.h"
+#include "fmp4probe.h"
+#include "hlsanalyzer.h"
+#include "loadtest.h"
+#include "masterplaylistparser.h"
+#include "mediaplaylistparser.h"
+#include "mp4boxreader.h"
+#include "originserver.h"
+#include "peakbitrate.h"
+#include "playlistgenerator.h"
+#include "probesummary.h"
+#include "snapshotdiff.h"
+#include "tablemodels.h"
+#include "tsprobe.h"
+#include "tsscanner.h"
+#include "utils.h"
+
+const int CHUNK_SIZE = 16 * 1024;
+
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+private slots:
+    void tokenize_data()
+    {
+        masterData();
+    }
+
+    void tokenize()
+    {
+        QFETCH(QByteArray, playlist);
+
+        AttributeList attributes;
+        int count = 0;
+        QBENCHMARK
+        {
+            int pos = 0;
+            while( pos < playlist.size() )
+            {
+                QLatin1String line = Utils::nextLine(playlist, pos);
+                if( Utils::stripTag(line, QLatin1String("#EXT-X-STREAM-INF:"))
+                        || Utils::stripTag(line, QLatin1String("#EXT-X-MEDIA:")) )
+                {
+                    attributes.parse(line);
+                    count += attributes.size();
+                }
+            }
+        }
+        QVERIFY(count > 0);
+    }
+
+    void parseMaster_data()
+    {
+        masterData();
+    }
+
+    void parseMaster()
+    {
+        QFETCH(QByteArray, playlist);
+        QFETCH(int, variants);
+
+        MasterPlaylistParser parser;
+        QUrl base("http://example.com/stream/");
+        QBENCHMARK
+        {
+            parser.parse(playlist, base);
+        }
+        QCOMPARE(parser.variantStreams().size(), variants);
+    }
+
+    void parseMedia_data()
+    {
+        QTest::addColumn<QByteArray>("playlist");
+        QTest::addColumn<int>("segments");
+        QTest::addColumn<bool>("withBitrate");
+
+        const int counts[] = { 100, 10000, 200000 };
+        for( int count : counts )
+        {
+            QTest::newRow(qPrintable(QString("segments_%1_bitrate").arg(count)))
+                    << PlaylistGenerator::media(count, true) << count << true;
+            QTest::newRow(qPrintable(QString("segments_%1_plain").arg(count)))
+                    << PlaylistGenerator::media(count, false) << count << false;
+        }
+    }
+
+    void parseMedia()
+    {
+        QFETCH(QByteArray, playlist);
+        QFETCH(int, segments);
+        QFETCH(bool, withBitrate);
+
+        quint32 bitrate = 0;
+        quint32 parsed = 0;
+        QBENCHMARK
+        {
+            /// порциями, как при чтении из сети
+            MediaPlaylistParser parser;
+            for( int pos = 0; pos < playlist.size(); pos += CHUNK_SIZE )
+            {
+                parser.feed(QByteArray::fromRawData(playlist.constData() + pos, qMin(CHUNK_SIZE, playlist.size() - pos)));
+            }
+            parser.finish();
+            bitrate = parser.averageBitrate();
+            parsed = parser.segmentCount();
+        }
+        QCOMPARE(int(parsed), segments);
+        QCOMPARE(bitrate != 0, withBitrate);
+    }
+
+    void playlistMetrics_data()
+    {
+        parseMedia_data();
+    }
+
+    void playlistMetrics()
+    {
+        QFETCH(QByteArray, playlist);
+        QFETCH(int, segments);
+        QFETCH(bool, withBitrate);
+
+        MediaPlaylistParser parser;
+        parser.setArena(QSharedPointer<Arena>(new Arena));
+        for( int pos = 0; pos < playlist.size(); pos += CHUNK_SIZE )
+        {
+            parser.feed(QByteArray::fromRawData(playlist.constData() + pos, qMin(CHUNK_SIZE, playlist.size() - pos)));
+        }
+        parser.finish();
+        QCOMPARE(int(parser.segmentCount()), segments);
+
+        /// метрики вне MediaPlaylistParser - проходы по сохранённым сегментам
+        BitrateMean mean;
+        SegmentDurations durations;
+        QBENCHMARK
+        {
+            mean = BitrateMean();
+            durations = SegmentDurations();
+            scanSegments(parser.segmentStore(), parser.info(), mean, durations);
+        }
+        QCOMPARE(mean.bitrateCount() != 0, withBitrate);
+        QCOMPARE(durations.averageDuration(), quint64(6006000));
+        QCOMPARE(durations.maximumDuration(), quint64(6006000));
+        QCOMPARE(durations.durationDeviation(), qreal(0));
+        QCOMPARE(durations.overTargetCount(), quint32(0));
+        QCOMPARE(durations.targetDuration(), quint64(6000000));
+    }
+
+    void storeSegments_data()
+    {
+        parseMedia_data();
+    }
+
+    void storeSegments()
+    {
+        QFETCH(QByteArray, playlist);
+        QFETCH(int, segments);
+
+        SegmentStore store;
+        quint64 totalUs = 0;
+        QBENCHMARK
+        {
+            MediaPlaylistParser parser;
+            parser.setArena(QSharedPointer<Arena>(new Arena));
+            for( int pos = 0; pos < playlist.size(); pos += CHUNK_SIZE )
+            {
+                parser.feed(QByteArray::fromRawData(playlist.constData() + pos, qMin(CHUNK_SIZE, playlist.size() - pos)));
+            }
+            parser.finish();
+            store = parser.segmentStore();
+
+            /// проход метрики по столбцам
+            totalUs = 0;
+            for( int chunk = 0; chunk < store.chunkCount(); ++chunk )
+            {
+                SegmentStore::Columns columns = store.columns(chunk);
+                for( int i = 0; i < columns.count; ++i )
+                {
+                    totalUs += columns.durationsUs[i];
+                }
+            }
+        }
+        QCOMPARE(store.count(), segments);
+        QCOMPARE(totalUs, quint64(segments) * 6006000);
+        QCOMPARE(store.uri(segments - 1), QByteArray("segment") + QByteArray::number(segments - 1) + ".ts");
+        /// между якорями блока
+        QCOMPARE(store.uri(segments / 2 + 1), QByteArray("segment") + QByteArray::number(segments / 2 + 1) + ".ts");
+        if( segments >= 10000 )
+        {
+            /// на коротких плейлистах преобладают постоянные расходы
+            QVERIFY2(store.memoryUsage() < qint64(segments) * 16,
+                     qPrintable(QString("%1 bytes per segment").arg(qreal(store.memoryUsage()) / segments)));
+        }
+    }
+
+    void mapChanges_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+
+        /// 0 - одной порцией: все EXT-X-MAP в одной порции
+        const int sizes[] = { 0, 7 };
+        for( int size : sizes )
+        {
+            QTest::newRow(qPrintable(QString("chunk_%1").arg(size))) << size;
+        }
+    }
+
+    /// URI из EXT-X-MAP остаётся действительным, пока записи порции не
+    /// отданы метрикам, даже если за ним в той же порции идёт следующий
+    void mapChanges()
+    {
+        QFETCH(int, chunkSize);
+
+        QByteArray playlist = "#EXTM3U\n#EXT-X-TARGETDURATION:6\n"
+                              "#EXT-X-MAP:URI=\"init1.mp4\"\n#EXTINF:6.0,\na0.m4s\n#EXTINF:6.0,\na1.m4s\n"
+                              "#EXT-X-MAP:URI=\"init2.mp4\"\n#EXTINF:6.0,\nb0.m4s\n"
+                              "#EXT-X-MAP:URI=\"init3.mp4\"\n#EXTINF:6.0,\nc0.m4s\n#EXT-X-ENDLIST\n";
+        MediaPlaylistParser parser;
+        parser.setArena(QSharedPointer<Arena>(new Arena));
+        parser.setSampleInterval(1);
+        int step = chunkSize > 0 ? chunkSize : playlist.size();
+        for( int pos = 0; pos < playlist.size(); pos += step )
+        {
+            parser.feed(playlist.mid(pos, step));
+        }
+        parser.finish();
+
+        const char *expected[] = { "init1.mp4", "init1.mp4", "init2.mp4", "init3.mp4" };
+        SegmentStore store = parser.segmentStore();
+        QCOMPARE(store.count(), 4);
+        QCOMPARE(parser.sampledSegments().size(), 4);
+        for( int i = 0; i < 4; ++i )
+        {
+            QCOMPARE(QString(store.mapUri(i)), QString(expected[i]));
+            QCOMPARE(parser.sampledSegments().at(i).mapUri, QByteArray(expected[i]));
+        }
+    }
+
+    void diffSnapshots()
+    {
+        /// история одного потока: каждый сотый прогон сдвигает битрейт
+        const int count = 2000;
+        AnalysisResult result;
+        result.url = "http://example.com/master.m3u8";
+        for( int i = 0; i < 10; ++i )
+        {
+            VariantStream variant;
+            variant.averageBandwidth = quint32(1000000 * (i + 1));
+            variant.videoStream.url = QString("http://example.com/video/%1/prog_index.m3u8?token=abc").arg(i);
+            variant.videoStream.codec = "AVC";
+            variant.videoStream.resolution = "1920x1080";
+            variant.videoStream.realVideoBitrate = variant.averageBandwidth;
+            variant.videoStream.segmentCount = 600;
+            variant.audioStream.url = "http://example.com/audio/en.m3u8";
+            variant.audioStream.codec = "AAC";
+            variant.audioStream.language = "en";
+            variant.audioStream.realAudioBitrate = 128000;
+            variant.audioStream.segmentCount = 600;
+            result.variantStreams.append(variant);
+        }
+
+        QVector<QByteArray> snapshots;
+        for( int i = 0; i < count; ++i )
+        {
+            if( i % 100 == 99 )
+                result.variantStreams[0].videoStream.realVideoBitrate += 100000;
+            snapshots.append(Snapshot::serialize(result, qint64(i) * 3600 * 1000));
+        }
+
+        SnapshotDiff diff;
+        diff.setThreshold(1);
+        int changes = 0;
+        QBENCHMARK
+        {
+            changes = 0;
+            Snapshot previous(snapshots.first());
+            for( int i = 1; i < count; ++i )
+            {
+                Snapshot current(snapshots.at(i));
+                changes += diff.compare(previous, current).size();
+                previous = current;
+            }
+        }
+        QCOMPARE(changes, count / 100);
+    }
+
+    void analyzeOrigin_data()
+    {
+        QTest::addColumn<int>("latencyMs");
+        QTest::addColumn<int>("kilobytesPerSecond");
+        QTest::addColumn<qreal>("errorRate");
+        QTest::addColumn<qreal>("stallRate");
+
+        QTest::newRow("clean") << 0 << 0 << qreal(0) << qreal(0);
+        QTest::newRow("latency_50ms") << 50 << 0 << qreal(0) << qreal(0);
+        QTest::newRow("throttle_256k") << 0 << 256 << qreal(0) << qreal(0);
+        QTest::newRow("errors_10") << 0 << 0 << qreal(0.1) << qreal(0);
+        QTest::newRow("stalls_10") << 0 << 0 << qreal(0) << qreal(0.1);
+    }
+
+    void analyzeOrigin()
+    {
+        QFETCH(int, latencyMs);
+        QFETCH(int, kilobytesPerSecond);
+        QFETCH(qreal, errorRate);
+        QFETCH(qreal, stallRate);
+
+        /// полный анализ по локальной сети: планировщик, повторы и таймауты
+        OriginServer::Options options;
+        options.variants = 8;
+        options.segments = 200;
+        OriginServer::Faults faults;
+        faults.latencyMs = latencyMs;
+        faults.bytesPerSecond = qint64(kilobytesPerSecond) * 1024;
+        faults.errorRate = errorRate;
+        faults.stallRate = stallRate;
+
+        OriginServer origin;
+        origin.setOptions(options);
+        origin.setFaults(faults);
+        QVERIFY2(origin.listen(), qPrintable(origin.errorString()));
+
+        HlsAnalyzer analyzer;
+        analyzer.setRequestTimeout(1000);
+        analyzer.setMaxAttempts(4);
+        AnalysisOptions analysisOptions;
+        analysisOptions.deadlineMs = 30000;
+
+        AnalysisResult result;
+        QBENCHMARK
+        {
+            QEventLoop loop;
+            QFutureWatcher<AnalysisResult> watcher;
+            connect(&watcher, &QFutureWatcher<AnalysisResult>::finished, &loop, &QEventLoop::quit);
+            watcher.setFuture(analyzer.analyze(origin.masterUrl(), analysisOptions));
+            loop.exec();
+            QVERIFY(watcher.isFinished());
+            result = watcher.result();
+        }
+        if( errorRate > 0 || stallRate > 0 )
+        {
+            /// сбой мастера отдаётся без повтора, поэтому исход случаен:
+            /// проверяется только, что сбои дошли до счётчиков планировщика
+            RequestScheduler::Statistics statistics = analyzer.statistics();
+            QVERIFY(origin.faultCount() > 0);
+            QVERIFY2(statistics.retries + statistics.timeouts + statistics.hedges > 0,
+                     qPrintable(analyzer.statisticsString()));
+            return;
+        }
+        QVERIFY2(result.errorString.isEmpty(), qPrintable(result.errorString));
+        QCOMPARE(result.variantStreams.size(), options.variants);
+        QVERIFY(!result.partial);
+        QCOMPARE(result.variantStreams.first().videoStream.segmentCount, quint32(options.segments));
+    }
+
+    void loadTestOrigin_data()
+    {
+        QTest::addColumn<int>("clients");
+        QTest::addColumn<int>("threads");
+
+        QTest::newRow("clients_50_threads_1") << 50 << 1;
+        QTest::newRow("clients_200_threads_4") << 200 << 4;
+    }
+
+    void loadTestOrigin()
+    {
+        QFETCH(int, clients);
+        QFETCH(int, threads);
+
+        OriginServer origin;
+        OriginServer::Options originOptions;
+        originOptions.segments = 50;
+        origin.setOptions(originOptions);
+        QVERIFY2(origin.listen(), qPrintable(origin.errorString()));
+
+        HlsAnalyzer analyzer;
+        AnalysisOptions analysisOptions;
+        analysisOptions.keepSegments = true;
+        QEventLoop analysisLoop;
+        QFutureWatcher<AnalysisResult> watcher;
+        connect(&watcher, &QFutureWatcher<AnalysisResult>::finished, &analysisLoop, &QEventLoop::quit);
+        watcher.setFuture(analyzer.analyze(origin.masterUrl(), analysisOptions));
+        analysisLoop.exec();
+        AnalysisResult result = watcher.result();
+        QVERIFY2(result.errorString.isEmpty(), qPrintable(result.errorString));
+
+        /// origin отвечает в этом же потоке, плееры - в своих
+        LoadOptions options;
+        options.clients = clients;
+        options.threads = threads;
+        options.durationMs = 3000;
+        options.rampUpMs = 500;
+        options.bufferMs = 12000;
+
+        LoadReport total;
+        QBENCHMARK
+        {
+            QEventLoop loop;
+            LoadTest test(result, options);
+            connect(&test, &LoadTest::finished, &loop, &QEventLoop::quit);
+            QVERIFY2(test.start([](const LoadReport &) {}), qPrintable(test.errorString()));
+            loop.exec();
+            total = test.total();
+        }
+        QCOMPARE(total.errors, quint64(0));
+        QVERIFY(total.requests >= quint64(clients) * 3);
+    }
+
+    void checkPeaks()
+    {
+        /// двое суток видео по 6 с и аудио по 3 с: 200k + 400k сегментов
+        const int videoCount = 200000;
+        QVector<quint32> videoBitrates(videoCount);
+        for( int i = 0; i < videoCount; ++i )
+        {
+            videoBitrates[i] = quint32(2000 + (qint64(i) * 7919) % 1500);
+        }
+        QSharedPointer<Arena> arena(new Arena);
+        SegmentStore video = bitrateStore(arena, videoBitrates, 6000000);
+        SegmentStore audio = bitrateStore(arena, QVector<quint32>(videoCount * 2, 128), 3000000);
+
+        PeakBitrateCheck check(10000);
+        quint32 peak = 0;
+        QVector<PeakRange> ranges;
+        QBENCHMARK
+        {
+            peak = check.run(video, audio, 3000000, &ranges);
+        }
+        QCOMPARE(peak, quint32((3499 + 128) * 1000));
+        QCOMPARE(ranges.size(), 5);
+    }
+
+    void peakRanges()
+    {
+        /// видео 20 с по 2 с, аудио 15 с по 1 с (100 кбит/с); превышения
+        /// 2 Мбит/с - на 6-8 и 10-12 с (ближе окна - один эпизод) и на
+        /// 18-20 с, где аудио уже кончилось
+        QVector<quint32> videoBitrates(10, 1000);
+        videoBitrates[3] = 5000;
+        videoBitrates[5] = 4000;
+        videoBitrates[9] = 3000;
+        QSharedPointer<Arena> arena(new Arena);
+        SegmentStore video = bitrateStore(arena, videoBitrates, 2000000);
+        SegmentStore audio = bitrateStore(arena, QVector<quint32>(15, 100), 1000000);
+
+        QVector<PeakRange> ranges;
+        QCOMPARE(PeakBitrateCheck(4000).run(video, audio, 2000000, &ranges), quint32(5100000));
+        QCOMPARE(ranges.size(), 2);
+        QCOMPARE(ranges.at(0).startMs, quint32(6000));
+        QCOMPARE(ranges.at(0).endMs, quint32(12000));
+        QCOMPARE(ranges.at(0).peakBitrate, quint32(5100000));
+        QCOMPARE(ranges.at(1).startMs, quint32(18000));
+        QCOMPARE(ranges.at(1).endMs, quint32(20000));
+        QCOMPARE(ranges.at(1).peakBitrate, quint32(3000000));
+
+        /// остаётся только худший диапазон
+        QCOMPARE(PeakBitrateCheck(4000, 1).run(video, audio, 2000000, &ranges), quint32(5100000));
+        QCOMPARE(ranges.size(), 1);
+        QCOMPARE(ranges.at(0).startMs, quint32(6000));
+
+        /// без аудио и без превышений
+        QCOMPARE(PeakBitrateCheck(4000).run(video, SegmentStore(), 6000000, &ranges), quint32(5000000));
+        QVERIFY(ranges.isEmpty());
+    }
+
+    void probeSegment_data()
+    {
+        QTest::addColumn<int>("frames");
+
+        const int counts[] = { 150, 1500 };
+        for( int count : counts )
+        {
+            QTest::newRow(qPrintable(QString("frames_%1").arg(count))) << count;
+        }
+    }
+
+    void probeSegment()
+    {
+        QFETCH(int, frames);
+
+        QByteArray segment = PlaylistGenerator::transportStream(frames);
+        qreal frameRate = 0;
+        QBENCHMARK
+        {
+            TsProbe probe;
+            for( int pos = 0; pos < segment.size(); pos += CHUNK_SIZE )
+            {
+                probe.feed(QByteArray::fromRawData(segment.constData() + pos, qMin(CHUNK_SIZE, segment.size() - pos)));
+            }
+            probe.finish();
+
+            ProbeSummary summary;
+            summary.add(probe, quint32(frames * 40));
+            frameRate = summary.frameRate();
+        }
+        QCOMPARE(qRound(frameRate), 25);
+    }
+
+    void probeFragment_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+
+        /// 0 - одной порцией; мелкие порции рвут заголовки и moov/moof
+        const int sizes[] = { 0, 1, 7, 4096 };
+        for( int size : sizes )
+        {
+            QTest::newRow(qPrintable(QString("chunk_%1").arg(size))) << size;
+        }
+    }
+
+    void probeFragment()
+    {
+        QFETCH(int, chunkSize);
+
+        QByteArray data = fmp4Init() + fmp4Fragment(fmp4Trun(0x000301, 3, 3)) + mp4Box("mdat", QByteArray(6800, 'm'));
+        Fmp4Probe probe;
+        QBENCHMARK
+        {
+            probe = feedFmp4(data, chunkSize);
+        }
+        QVERIFY(probe.isValid());
+        QVERIFY(probe.hasFragments());
+        QCOMPARE(probe.tracks().size(), 2);
+
+        const Fmp4Probe::Track *video = probe.videoTrack();
+        QVERIFY(video);
+        QCOMPARE(video->codec, QString("AVC"));
+        QCOMPARE(int(video->width), 1280);
+        QCOMPARE(int(video->height), 720);
+        QCOMPARE(video->timescale, quint32(90000));
+        QCOMPARE(video->sampleCount, quint64(3));
+        QCOMPARE(video->duration, quint64(3 * 3003));
+        QCOMPARE(video->bytes, quint64(1000 + 2000 + 3000));
+
+        /// trun без длительностей и размеров - значения из trex
+        const Fmp4Probe::Track *audio = probe.audioTrack();
+        QVERIFY(audio);
+        QCOMPARE(audio->codec, QString("AAC"));
+        QCOMPARE(int(audio->channels), 2);
+        QCOMPARE(audio->sampleCount, quint64(4));
+        QCOMPARE(audio->duration, quint64(4 * 1024));
+        QCOMPARE(audio->bytes, quint64(4 * 200));
+    }
+
+    void fmp4BoxSizes()
+    {
+        /// size 0 - бокс до конца буфера
+        QByteArray boxes = mp4Box("free", QByteArray(4, 'f')) + be32(0) + QByteArray("mdat") + QByteArray(10, 'm');
+        Mp4BoxReader reader(reinterpret_cast<const uchar *>(boxes.constData()), quint64(boxes.size()));
+        Mp4BoxReader::Box box;
+        QVERIFY(reader.next(&box));
+        QCOMPARE(box.size, quint64(4));
+        QVERIFY(reader.next(&box));
+        QCOMPARE(box.type, Mp4BoxReader::fourcc("mdat"));
+        QCOMPARE(box.size, quint64(10));
+        QVERIFY(!reader.next(&box));
+        QVERIFY(!reader.isMalformed());
+
+        /// size 1 - 64-битный largesize после типа
+        QByteArray large = mp4LargeBox("moof", QByteArray(5, 'x'));
+        quint32 type = 0;
+        quint64 size = 0;
+        QCOMPARE(Mp4BoxReader::header(reinterpret_cast<const uchar *>(large.constData()), quint64(large.size()), &type, &size), 16);
+        QCOMPARE(type, Mp4BoxReader::fourcc("moof"));
+        QCOMPARE(size, quint64(21));
+
+        /// размер меньше заголовка
+        QByteArray broken = be32(4) + QByteArray("free");
+        Mp4BoxReader brokenReader(reinterpret_cast<const uchar *>(broken.constData()), quint64(broken.size()));
+        QVERIFY(!brokenReader.next(&box));
+        QVERIFY(brokenReader.isMalformed());
+
+        /// moof с largesize разбирается, всё после mdat размера 0 - нет
+        QByteArray moof = fmp4Fragment(fmp4Trun(0x000301, 3, 3));
+        QByteArray data = fmp4Init() + mp4LargeBox("moof", moof.mid(8)) + be32(0) + QByteArray("mdat")
+                + QByteArray(100, 'm') + moof;
+        for( int chunkSize : { 0, 3 } )
+        {
+            Fmp4Probe probe = feedFmp4(data, chunkSize);
+            QVERIFY(probe.videoTrack());
+            QCOMPARE(probe.videoTrack()->sampleCount, quint64(3));
+            QCOMPARE(probe.videoTrack()->bytes, quint64(6000));
+        }
+    }
+
+    void fmp4Truncated()
+    {
+        /// tkhd без track_ID: дорожка пропускается
+        Fmp4Probe probe = feedFmp4(fmp4Init(true), 0);
+        QCOMPARE(probe.tracks().size(), 1);
+        QVERIFY(!probe.videoTrack());
+        QVERIFY(probe.audioTrack());
+
+        /// trun короче заголовка, trun с двумя записями из трёх и trun, число
+        /// сэмплов которого не помещается в бокс, - пропускаются целиком
+        QByteArray shortTrun = mp4Box("trun", QByteArray(6, '\0'));
+        QByteArray truncatedTrun = fmp4Trun(0x000301, 3, 2);
+        QByteArray overflowTrun = fmp4Trun(0x000301, 0xffffffffu, 3);
+        foreach(const QByteArray &trun, QList<QByteArray>() << shortTrun << truncatedTrun << overflowTrun)
+        {
+            probe = feedFmp4(fmp4Init() + fmp4Fragment(trun), 0);
+            QVERIFY(probe.hasFragments());
+            QCOMPARE(probe.videoTrack()->sampleCount, quint64(0));
+            QCOMPARE(probe.videoTrack()->bytes, quint64(0));
+            QCOMPARE(probe.audioTrack()->sampleCount, quint64(4));
+        }
+    }
+
+    void readableCodecs()
+    {
+        /// как в CODECS и как их называет Fmp4Probe
+        QCOMPARE(Utils::getReadableCodec("av01.0.08M.08"), QString("AV1"));
+        QCOMPARE(Utils::getReadableCodec("vp09.00.40.08"), QString("VP9"));
+        QCOMPARE(Utils::getReadableCodec("fLaC"), QString("FLAC"));
+        QCOMPARE(Utils::getReadableCodec("flac"), QString("FLAC"));
+        QCOMPARE(Utils::getReadableCodec("Opus"), QString("Opus"));
+        QCOMPARE(Utils::getReadableCodec("opus"), QString("Opus"));
+    }
+
+    void findSync()
+    {
+        /// худший случай - синхронизации нет, просматривается весь буфер
+        QByteArray garbage(16 * 1024 * 1024, 'q');
+        const uchar *data = reinterpret_cast<const uchar *>(garbage.constData());
+        int found = 0;
+        QBENCHMARK
+        {
+            found = TsScanner::findSync(data, garbage.size());
+        }
+        QCOMPARE(found, -1);
+    }
+
+    void fillModels_data()
+    {
+        QTest::addColumn<int>("rows");
+
+        const int counts[] = { 100, 10000, 100000 };
+        for( int count : counts )
+        {
+            QTest::newRow(qPrintable(QString("rows_%1").arg(count))) << count;
+        }
+    }
+
+    void fillModels()
+    {
+        QFETCH(int, rows);
+
+        QVector<VideoStream> videoStreams(rows);
+        QVector<AudioStream> audioStreams(rows);
+        QVector<LogTableModel::Entry> entries(rows);
+        for( int i = 0; i < rows; ++i )
+        {
+            videoStreams[i].url = QString("http://example.com/video/%1/prog_index.m3u8").arg(i);
+            videoStreams[i].codec = "AVC";
+            videoStreams[i].resolution = "1920x1080";
+            videoStreams[i].realVideoBitrate = quint32(1000000 + i);
+            videoStreams[i].framerate = "29.970";
+            audioStreams[i].url = QString("http://example.com/audio/%1.m3u8").arg(i);
+            audioStreams[i].codec = "AAC";
+            audioStreams[i].numOfChannels = 2;
+            audioStreams[i].language = "en";
+            entries[i] = LogTableModel::entry(LogTableModel::OutOfRange, i + 1, i + 1);
+        }
+
+        QBENCHMARK
+        {
+            VideoTableModel videoModel;
+            AudioTableModel audioModel;
+            LogTableModel logModel;
+            videoModel.append(videoStreams);
+            audioModel.append(audioStreams);
+            logModel.append(entries);
+        }
+    }
+
+    void filterLog_data()
+    {
+        fillModels_data();
+    }
+
+    /// фильтр журнала при наборе шаблона по букве
+    void filterLog()
+    {
+        QFETCH(int, rows);
+
+        QVector<LogTableModel::Entry> entries(rows);
+        for( int i = 0; i < rows; ++i )
+        {
+            entries[i] = LogTableModel::entry(LogTableModel::OutOfRange, i + 1, i + 1);
+        }
+        LogTableModel logModel;
+        logModel.append(entries);
+        ColumnarProxyModel proxyModel(&logModel);
+
+        const QString pattern = "аудио-потоком #1";
+        QBENCHMARK
+        {
+            for( int length = 1; length <= pattern.size(); ++length )
+            {
+                proxyModel.setPattern(pattern.left(length));
+            }
+        }
+        /// #1, #10..#19, #100..#199 и т. д.
+        int expected = 0;
+        for( int i = 1; i <= rows; ++i )
+        {
+            if( QString::number(i).startsWith('1') )
+                expected++;
+        }
+        QCOMPARE(proxyModel.rowCount(), expected);
+    }
+
+private:
+    static QByteArray be32(quint32 value)
+    {
+        QByteArray data(4, '\0');
+        qToBigEndian(value, reinterpret_cast<uchar *>(data.data()));
+        return data;
+    }
+
+    static QByteArray mp4Box(const char *type, const QByteArray &payload)
+    {
+        return be32(quint32(payload.size() + 8)) + QByteArray(type, 4) + payload;
+    }
+
+    /// бокс с size = 1 и 64-битным размером
+    static QByteArray mp4LargeBox(const char *type, const QByteArray &payload)
+    {
+        QByteArray size(8, '\0');
+        qToBigEndian(quint64(payload.size() + 16), reinterpret_cast<uchar *>(size.data()));
+        return be32(1) + QByteArray(type, 4) + size + payload;
+    }
+
+    /// дорожка: tkhd (truncated - без track_ID), mdhd, hdlr и stsd с одним описанием
+    static QByteArray mp4Track(quint32 trackId, quint32 timescale, const char *handler, const QByteArray &sampleEntry,
+                               bool truncated = false)
+    {
+        QByteArray tkhd = QByteArray(12, '\0') + be32(trackId) + QByteArray(64, '\0');
+        QByteArray mdhd = QByteArray(12, '\0') + be32(timescale) + QByteArray(8, '\0');
+        QByteArray hdlr = QByteArray(8, '\0') + QByteArray(handler, 4) + QByteArray(13, '\0');
+        QByteArray stsd = be32(0) + be32(1) + sampleEntry;
+        QByteArray minf = mp4Box("minf", mp4Box("stbl", mp4Box("stsd", stsd)));
+        return mp4Box("trak", mp4Box("tkhd", truncated ? tkhd.left(10) : tkhd) +
+                      mp4Box("mdia", mp4Box("mdhd", mdhd) + mp4Box("hdlr", hdlr) + minf));
+    }
+
+    /// init-сегмент: видео AVC 1280x720 (track 1, 90 кГц, 3003 на кадр по
+    /// умолчанию) и аудио AAC стерео (track 2, по 1024 и 200 байт на сэмпл)
+    static QByteArray fmp4Init(bool truncatedVideo = false)
+    {
+        QByteArray avc1(78, '\0');
+        avc1[24] = char(0x05);  // 1280
+        avc1[25] = char(0x00);
+        avc1[26] = char(0x02);  // 720
+        avc1[27] = char(0xd0);
+        QByteArray mp4a(28, '\0');
+        mp4a[17] = char(2);
+
+        QByteArray trex1 = be32(0) + be32(1) + be32(1) + be32(3003) + be32(0) + be32(0);
+        QByteArray trex2 = be32(0) + be32(2) + be32(1) + be32(1024) + be32(200) + be32(0);
+        QByteArray moov = mp4Box("mvhd", QByteArray(100, '\0')) +
+                mp4Track(1, 90000, "vide", mp4Box("avc1", avc1), truncatedVideo) +
+                mp4Track(2, 48000, "soun", mp4Box("mp4a", mp4a)) +
+                mp4Box("mvex", mp4Box("trex", trex1) + mp4Box("trex", trex2));
+        return mp4Box("ftyp", QByteArray("iso6\0\0\0\0iso6cmfc", 16)) + mp4Box("moov", moov);
+    }
+
+    /// trun видео: flags, count и entries записей (длительность 3003, размер 1000 * n)
+    static QByteArray fmp4Trun(quint32 flags, quint32 count, int entries)
+    {
+        QByteArray trun = be32(flags) + be32(count) + be32(0);
+        for( int i = 1; i <= entries; ++i )
+        {
+            trun += be32(3003) + be32(quint32(1000 * i));
+        }
+        return mp4Box("trun", trun);
+    }
+
+    /// moof: videoTrun для дорожки 1 и четыре сэмпла аудио по умолчанию
+    static QByteArray fmp4Fragment(const QByteArray &videoTrun)
+    {
+        QByteArray videoTraf = mp4Box("tfhd", be32(0) + be32(1)) + videoTrun;
+        QByteArray audioTraf = mp4Box("tfhd", be32(0) + be32(2)) + mp4Box("trun", be32(0x000001) + be32(4) + be32(0));
+        return mp4Box("moof", mp4Box("mfhd", be32(0) + be32(1)) + mp4Box("traf", videoTraf) + mp4Box("traf", audioTraf));
+    }
+
+    /// порциями по chunkSize байт; 0 - одной порцией
+    static Fmp4Probe feedFmp4(const QByteArray &data, int chunkSize)
+    {
+        Fmp4Probe probe;
+        int step = chunkSize > 0 ? chunkSize : data.size();
+        for( int pos = 0; pos < data.size(); pos += step )
+        {
+            probe.feed(data.mid(pos, step));
+        }
+        probe.finish();
+        return probe;
+    }
+
+    /// сегменты одной длительности с заданным EXT-X-BITRATE, kbps
+    static SegmentStore bitrateStore(const QSharedPointer<Arena> &arena, const QVector<quint32> &bitrates, quint64 durationUs)
+    {
+        SegmentStore store(arena);
+        for( int i = 0; i < bitrates.size(); ++i )
+        {
+            SegmentRecord record;
+            record.uri = QLatin1String("segment.ts");
+            record.durationUs = durationUs;
+            record.bitrate = bitrates.at(i);
+            store.append(record);
+        }
+        store.squeeze();
+        return store;
+    }
+
+    void masterData()
+    {
+        QTest::addColumn<QByteArray>("playlist");
+        QTest::addColumn<int>("variants");
+
+        const int counts[] = { 10, 100, 1000 };
+        for( int count : counts )
+        {
+            QTest::newRow(qPrintable(QString("variants_%1").arg(count))) << PlaylistGenerator::master(count) << count;
+        }
+    }
+};
+
+/// Переводит CSV-вывод QTest ("function","tag","metric",value,total,iterations) в JSON
+static bool writeJson(const QString &csvFileName, const QString &jsonFileName)
+{
+    QFile csv(csvFileName);
+    if( !csv.open(QIODevice::ReadOnly) )
+        return false;
+
+    QJsonArray results;
+    while( !csv.atEnd() )
+    {
+        QList<QByteArray> fields = csv.readLine().trimmed().split(',');
+        if( fields.size() < 6 )
+            continue;
+        for( int i = 0; i < 3; ++i )
+        {
+            if( fields[i].startsWith('"') && fields[i].endsWith('"') )
+                fields[i] = fields[i].mid(1, fields[i].size() - 2);
+        }
+
+        bool ok;
+        double value = fields.at(3).toDouble(&ok);
+        if( !ok )
+            continue;
+
+        QJsonObject result;
+        result.insert("benchmark", QString::fromUtf8(fields.at(0)));
+        result.insert("tag", QString::fromUtf8(fields.at(1)));
+        result.insert("metric", QString::fromUtf8(fields.at(2)));
+        result.insert("value", value);
+        result.insert("total", fields.at(4).toDouble());
+        result.insert("iterations", fields.at(5).toLongLong());
+        results.append(result);
+    }
+
+    QJsonObject root;
+    root.insert("qt", QString(qVersion()));
+    root.insert("results", results);
+
+    QFile json(jsonFileName);
+    bool opened = jsonFileName == "-" ? json.open(stdout, QIODevice::WriteOnly) : json.open(QIODevice::WriteOnly);
+    if( !opened )
+        return false;
+    json.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    /// --json <file> забираем себе, остальное отдаём QTest
+    QStringList arguments = app.arguments();
+    QString jsonFileName;
+    int json = arguments.indexOf("--json");
+    if( json != -1 )
+    {
+        jsonFileName = arguments.value(json + 1, "-");
+        arguments.erase(arguments.begin() + json, arguments.begin() + qMin(json + 2, arguments.size()));
+    }
+
+    QTemporaryFile csv;
+    if( !jsonFileName.isEmpty() )
+    {
+        csv.open();
+        csv.close();
+        arguments << "-o" << csv.fileName() + ",csv";
+        if( jsonFileName != "-" )
+            arguments << "-o" << "-,txt";
+    }
+
+    Benchmarks benchmarks;
+    int code = QTest::qExec(&benchmarks, arguments);
+
+    if( !jsonFileName.isEmpty() && !writeJson(csv.fileName(), jsonFileName) )
+    {
+        qCritical() << "Не удалось записать" << jsonFileName;
+        return 1;
+    }
+    return code;
+}
+
+#include "benchmarks.moc"
@@ -0,0 +1,23 @@
+QT -= gui
+QT += testlib
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = hls-benchmarks
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../hlsanalysis/hlsanalysis.pri)
+
+INCLUDEPATH += ../origin
+
+SOURCES += \
+        benchmarks.cpp \
+        ../origin/originserver.cpp \
+        ../tablemodels.cpp
+
+HEADERS += \
+    ../origin/originserver.h \
+    ../origin/playlistgenerator.h \
+    ../tablemodels.h
@@ -0,0 +1,211 @@
+#include "deepprobe.h"
+
+#include <QNetworkReply>
+#include <QSharedPointer>
+#include <QTimer>
+
+#include "requestscheduler.h"
+#include "tsprobe.h"
+
+DeepProbe::DeepProbe(RequestScheduler *scheduler, QObject *parent)
+    : QObject(parent)
+    , mScheduler(scheduler)
+    , mMaxInFlight(2)
+    , mNext(0)
+    , mInFlight(0)
+{
+}
+
+void DeepProbe::setMaxInFlight(int maxInFlight)
+{
+    mMaxInFlight = qMax(1, maxInFlight);
+}
+
+void DeepProbe::probe(const QUrl &base, const QVector<SampledSegment> &segments)
+{
+    mBase = base;
+    mSegments = segments;
+    mNext = 0;
+    mInFlight = 0;
+    mInits.clear();
+    mInitWaiters.clear();
+    mSummary = ProbeSummary();
+    if( mSegments.isEmpty() )
+    {
+        QTimer::singleShot(0, this, &DeepProbe::finished);
+        return;
+    }
+    startNext();
+}
+
+const ProbeSummary &DeepProbe::summary() const
+{
+    return mSummary;
+}
+
+QNetworkRequest DeepProbe::request(const QUrl &url, quint64 offset, quint64 length)
+{
+    QNetworkRequest request(url);
+    if( length > 0 )
+    {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-" + QByteArray::number(offset + length - 1));
+    }
+    return request;
+}
+
+QByteArray DeepProbe::initKey(const SampledSegment &segment)
+{
+    return segment.mapUri + '@' + QByteArray::number(segment.mapByteRangeOffset) + ':' +
+            QByteArray::number(segment.mapByteRangeLength);
+}
+
+void DeepProbe::startNext()
+{
+    while( mInFlight < mMaxInFlight && mNext < mSegments.size() )
+    {
+        int index = mNext++;
+        mInFlight++;
+
+        const SampledSegment &segment = mSegments.at(index);
+        if( segment.mapUri.isEmpty() )
+        {
+            startSegment(index);
+            continue;
+        }
+
+        QByteArray key = initKey(segment);
+        if( mInits.contains(key) )
+        {
+            /// init-сегмент не разобрался - и фрагменты разбирать не с чем
+            if( mInits.value(key).isValid() )
+                startSegment(index);
+            else
+                mInFlight--;
+        }
+        else if( mInitWaiters.contains(key) )
+        {
+            mInitWaiters[key].append(index);
+        }
+        else
+        {
+            mInitWaiters[key].append(index);
+            requestInit(key, index);
+        }
+    }
+
+    if( mInFlight == 0 && mNext == mSegments.size() )
+    {
+        emit finished();
+    }
+}
+
+void DeepProbe::startSegment(int index)
+{
+    const SampledSegment &segment = mSegments.at(index);
+    QUrl url = mBase.resolved(QUrl(QString::fromUtf8(segment.uri)));
+    QByteArray key = segment.mapUri.isEmpty() ? QByteArray() : initKey(segment);
+    quint32 durationMs = segment.durationMs;
+
+    mScheduler->get(request(url, segment.byteRangeOffset, segment.byteRangeLength), RequestScheduler::SegmentPriority, this,
+                    [this, key, durationMs](QNetworkReply *reply)
+    {
+        /// разбор идёт порциями - в памяти не бывает больше буфера чтения
+        if( key.isEmpty() )
+        {
+            QSharedPointer<TsProbe> probe(new TsProbe);
+            connect(reply, &QNetworkReply::readyRead, this, [reply, probe]()
+            {
+                probe->feed(reply->readAll());
+            });
+            connect(reply, &QNetworkReply::finished, this, [this, reply, probe, durationMs]()
+            {
+                reply->deleteLater();
+                if( reply->error() != QNetworkReply::NoError )
+                {
+                    qDebug() << "Error: " << reply->errorString();
+                }
+                else
+                {
+                    probe->feed(reply->readAll());
+                    probe->finish();
+                    mSummary.add(*probe, durationMs);
+                }
+                segmentDone();
+            });
+            return;
+        }
+
+        /// разобранный init-сегмент копируется, фрагменты дописываются в копию
+        QSharedPointer<Fmp4Probe> probe(new Fmp4Probe(mInits.value(key)));
+        connect(reply, &QNetworkReply::readyRead, this, [reply, probe]()
+        {
+            probe->feed(reply->readAll());
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, reply, probe]()
+        {
+            reply->deleteLater();
+            if( reply->error() != QNetworkReply::NoError )
+            {
+                qDebug() << "Error: " << reply->errorString();
+            }
+            else
+            {
+                probe->feed(reply->readAll());
+                probe->finish();
+                mSummary.add(*probe);
+            }
+            segmentDone();
+        });
+    });
+}
+
+void DeepProbe::requestInit(const QByteArray &key, int index)
+{
+    const SampledSegment &segment = mSegments.at(index);
+    QUrl url = mBase.resolved(QUrl(QString::fromUtf8(segment.mapUri)));
+    mScheduler->get(request(url, segment.mapByteRangeOffset, segment.mapByteRangeLength), RequestScheduler::SegmentPriority, this,
+                    [this, key](QNetworkReply *reply)
+    {
+        connect(reply, &QNetworkReply::finished, this, [this, key, reply]()
+        {
+            onInitFinished(key, reply);
+        });
+    });
+}
+
+void DeepProbe::onInitFinished(const QByteArray &key, QNetworkReply *reply)
+{
+    reply->deleteLater();
+
+    /// init-сегмент - несколько килобайт, разбираем целиком
+    Fmp4Probe init;
+    if( reply->error() != QNetworkReply::NoError )
+    {
+        qDebug() << "Error: " << reply->errorString();
+    }
+    else
+    {
+        init.feed(reply->readAll());
+        init.finish();
+    }
+
+    mInits.insert(key, init);
+    QVector<int> waiters = mInitWaiters.take(key);
+    if( !init.isValid() )
+    {
+        mInFlight -= waiters.size();
+        startNext();
+        return;
+    }
+
+    foreach(int index, waiters)
+    {
+        startSegment(index);
+    }
+}
+
+void DeepProbe::segmentDone()
+{
+    mInFlight--;
+    startNext();
+}
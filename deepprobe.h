@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+
+#include <QHash>
+#include <QUrl>
+#include <QVector>
+
+#include "fmp4probe.h"
+#include "probesummary.h"
+#include "segmentrecord.h"
+
+class QNetworkReply;
+class RequestScheduler;
+
+/// Глубокая проверка медиа-плейлиста: скачивает выбранные сегменты и
+/// разбирает их по мере поступления, не сохраняя тела целиком: MPEG-TS -
+/// через TsProbe, fMP4 - через Fmp4Probe. Init-сегмент fMP4 качается и
+/// разбирается один раз на EXT-X-MAP. Одновременно качается не больше
+/// maxInFlight сегментов с приоритетом сегментов, чтобы не мешать плейлистам.
+class DeepProbe : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DeepProbe(RequestScheduler *scheduler, QObject *parent = nullptr);
+
+    void setMaxInFlight(int maxInFlight);
+
+    /// URI сегментов разрешаются относительно base - URL медиа-плейлиста
+    void probe(const QUrl &base, const QVector<SampledSegment> &segments);
+
+    const ProbeSummary &summary() const;
+
+    /// запрос сегмента или init-сегмента с учётом EXT-X-BYTERANGE
+    static QNetworkRequest request(const QUrl &url, quint64 offset, quint64 length);
+    /// init-сегмент, общий для сегментов с одинаковым EXT-X-MAP
+    static QByteArray initKey(const SampledSegment &segment);
+
+signals:
+    void finished();
+
+private:
+    void startNext();
+    void startSegment(int index);
+    void requestInit(const QByteArray &key, int index);
+    void onInitFinished(const QByteArray &key, QNetworkReply *reply);
+    void segmentDone();
+
+private:
+    RequestScheduler *mScheduler;
+    int mMaxInFlight;
+
+    QUrl mBase;
+    QVector<SampledSegment> mSegments;
+    int mNext;
+    int mInFlight;
+
+    /// разобранные init-сегменты по URI и диапазону
+    QHash<QByteArray, Fmp4Probe> mInits;
+    /// сегменты, ждущие свой init-сегмент
+    QHash<QByteArray, QVector<int>> mInitWaiters;
+
+    ProbeSummary mSummary;
+};
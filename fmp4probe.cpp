@@ -0,0 +1,433 @@
+#include "fmp4probe.h"
+
+#include "mp4boxreader.h"
+
+/// moov и moof больше этого не копим - это уже не сегмент HLS
+const quint64 MAXIMUM_BOX_SIZE = 16 * 1024 * 1024;
+
+const quint32 TFHD_BASE_DATA_OFFSET = 0x000001;
+const quint32 TFHD_SAMPLE_DESCRIPTION_INDEX = 0x000002;
+const quint32 TFHD_DEFAULT_SAMPLE_DURATION = 0x000008;
+const quint32 TFHD_DEFAULT_SAMPLE_SIZE = 0x000010;
+const quint32 TRUN_DATA_OFFSET = 0x000001;
+const quint32 TRUN_FIRST_SAMPLE_FLAGS = 0x000004;
+const quint32 TRUN_SAMPLE_DURATION = 0x000100;
+const quint32 TRUN_SAMPLE_SIZE = 0x000200;
+const quint32 TRUN_SAMPLE_FLAGS = 0x000400;
+const quint32 TRUN_SAMPLE_COMPOSITION_TIME_OFFSET = 0x000800;
+
+typedef Mp4BoxReader::Box Box;
+
+static quint32 read32(const uchar *p)
+{
+    return qFromBigEndian<quint32>(p);
+}
+
+static quint16 read16(const uchar *p)
+{
+    return qFromBigEndian<quint16>(p);
+}
+
+/// версия FullBox и смещение полей после заголовка версии 0 и 1
+static int fullBoxField(const Box &box, int offset0, int offset1)
+{
+    return box.size >= 4 && box.data[0] == 1 ? offset1 : offset0;
+}
+
+static QString codecFor(quint32 type)
+{
+    switch( type )
+    {
+    case Mp4BoxReader::fourcc("avc1"):
+    case Mp4BoxReader::fourcc("avc3"):
+        return "AVC";
+    case Mp4BoxReader::fourcc("hvc1"):
+    case Mp4BoxReader::fourcc("hev1"):
+        return "HEVC";
+    case Mp4BoxReader::fourcc("av01"):
+        return "AV1";
+    case Mp4BoxReader::fourcc("vp09"):
+        return "VP9";
+    case Mp4BoxReader::fourcc("mp4a"):
+        return "AAC";
+    case Mp4BoxReader::fourcc("ac-3"):
+        return "AC-3";
+    case Mp4BoxReader::fourcc("ec-3"):
+        return "EC-3";
+    case Mp4BoxReader::fourcc("Opus"):
+        return "Opus";
+    case Mp4BoxReader::fourcc("fLaC"):
+        return "FLAC";
+    }
+    return QString();
+}
+
+Fmp4Probe::Fmp4Probe()
+    : mSkip(0)
+    , mFailed(false)
+    , mFragments(false)
+{
+}
+
+void Fmp4Probe::feed(const QByteArray &chunk)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(chunk.constData());
+    const quint64 size = quint64(chunk.size());
+    quint64 pos = 0;
+    while( pos < size && !mFailed )
+    {
+        if( mSkip > 0 )
+        {
+            quint64 skip = qMin(mSkip, size - pos);
+            mSkip -= skip;
+            pos += skip;
+            continue;
+        }
+
+        quint32 type = 0;
+        quint64 boxSize = 0;
+        if( mPending.isEmpty() )
+        {
+            /// бокс целиком в порции - разбираем на месте, без копирования
+            int header = Mp4BoxReader::header(data + pos, size - pos, &type, &boxSize);
+            if( header < 0 )
+            {
+                mFailed = true;
+                return;
+            }
+            if( header > 0 && (boxSize == 0 || !wanted(type) || boxSize > MAXIMUM_BOX_SIZE) )
+            {
+                /// mdat и прочее не читаем; размер 0 - бокс до конца файла
+                mSkip = boxSize == 0 ? ~quint64(0) : boxSize;
+                continue;
+            }
+            if( header > 0 && boxSize <= size - pos )
+            {
+                parseBox(type, data + pos + header, boxSize - quint64(header));
+                pos += boxSize;
+                continue;
+            }
+        }
+
+        /// заголовок или нужный бокс разорваны между порциями - копим
+        const uchar *pending = reinterpret_cast<const uchar *>(mPending.constData());
+        int header = Mp4BoxReader::header(pending, quint64(mPending.size()), &type, &boxSize);
+        if( header < 0 )
+        {
+            mFailed = true;
+            return;
+        }
+        if( header > 0 && (boxSize == 0 || !wanted(type) || boxSize > MAXIMUM_BOX_SIZE) )
+        {
+            mSkip = boxSize == 0 ? ~quint64(0) : boxSize - quint64(mPending.size());
+            mPending.clear();
+            continue;
+        }
+
+        /// заголовок растёт по 8 байт: 64-битный размер и uuid длиннее обычного
+        quint64 need = header > 0 ? boxSize : quint64(mPending.size()) + 8;
+        quint64 take = qMin(need - quint64(mPending.size()), size - pos);
+        mPending.append(reinterpret_cast<const char *>(data + pos), int(take));
+        pos += take;
+
+        if( header > 0 && quint64(mPending.size()) == boxSize )
+        {
+            pending = reinterpret_cast<const uchar *>(mPending.constData());
+            parseBox(type, pending + header, boxSize - quint64(header));
+            mPending.clear();
+        }
+    }
+}
+
+void Fmp4Probe::finish()
+{
+    mPending.clear();
+    mSkip = 0;
+}
+
+bool Fmp4Probe::isValid() const
+{
+    return !mTracks.isEmpty();
+}
+
+bool Fmp4Probe::hasFragments() const
+{
+    return mFragments;
+}
+
+const QVector<Fmp4Probe::Track> &Fmp4Probe::tracks() const
+{
+    return mTracks;
+}
+
+const Fmp4Probe::Track *Fmp4Probe::videoTrack() const
+{
+    for( int i = 0; i < mTracks.size(); ++i )
+    {
+        if( mTracks.at(i).video )
+            return &mTracks.at(i);
+    }
+    return nullptr;
+}
+
+const Fmp4Probe::Track *Fmp4Probe::audioTrack() const
+{
+    for( int i = 0; i < mTracks.size(); ++i )
+    {
+        if( mTracks.at(i).audio )
+            return &mTracks.at(i);
+    }
+    return nullptr;
+}
+
+bool Fmp4Probe::wanted(quint32 type) const
+{
+    return type == Mp4BoxReader::fourcc("moov") || type == Mp4BoxReader::fourcc("moof");
+}
+
+void Fmp4Probe::parseBox(quint32 type, const uchar *data, quint64 size)
+{
+    if( type == Mp4BoxReader::fourcc("moov") )
+    {
+        parseMoov(data, size);
+        return;
+    }
+
+    /// moof: mfhd и traf на каждую дорожку
+    mFragments = true;
+    Mp4BoxReader moof(data, size);
+    Box traf;
+    while( moof.find(Mp4BoxReader::fourcc("traf"), &traf) )
+    {
+        parseTraf(traf.data, traf.size);
+    }
+}
+
+void Fmp4Probe::parseMoov(const uchar *data, quint64 size)
+{
+    mTracks.clear();
+
+    Mp4BoxReader moov(data, size);
+    Box trak;
+    while( moov.find(Mp4BoxReader::fourcc("trak"), &trak) )
+    {
+        parseTrak(trak.data, trak.size);
+    }
+
+    /// значения по умолчанию для фрагментов - когда дорожки уже известны
+    Box mvex;
+    if( Mp4BoxReader(data, size).find(Mp4BoxReader::fourcc("mvex"), &mvex) )
+    {
+        Mp4BoxReader reader(mvex.data, mvex.size);
+        Box trex;
+        while( reader.find(Mp4BoxReader::fourcc("trex"), &trex) )
+        {
+            parseTrex(trex.data, trex.size);
+        }
+    }
+}
+
+void Fmp4Probe::parseTrak(const uchar *data, quint64 size)
+{
+    Track track;
+
+    Box tkhd;
+    Mp4BoxReader trak(data, size);
+    if( !trak.find(Mp4BoxReader::fourcc("tkhd"), &tkhd) )
+        return;
+    int trackIdOffset = fullBoxField(tkhd, 12, 20);
+    if( tkhd.size < quint64(trackIdOffset + 4) )
+        return;
+    track.trackId = read32(tkhd.data + trackIdOffset);
+
+    Box mdia;
+    if( !Mp4BoxReader(data, size).find(Mp4BoxReader::fourcc("mdia"), &mdia) )
+        return;
+
+    Box box;
+    Box minf;
+    bool hasMinf = false;
+    Mp4BoxReader reader(mdia.data, mdia.size);
+    while( reader.next(&box) )
+    {
+        if( box.type == Mp4BoxReader::fourcc("mdhd") )
+        {
+            int timescaleOffset = fullBoxField(box, 12, 20);
+            if( box.size >= quint64(timescaleOffset + 4) )
+                track.timescale = read32(box.data + timescaleOffset);
+        }
+        else if( box.type == Mp4BoxReader::fourcc("hdlr") && box.size >= 12 )
+        {
+            quint32 handler = read32(box.data + 8);
+            track.video = handler == Mp4BoxReader::fourcc("vide");
+            track.audio = handler == Mp4BoxReader::fourcc("soun");
+        }
+        else if( box.type == Mp4BoxReader::fourcc("minf") )
+        {
+            minf = box;
+            hasMinf = true;
+        }
+    }
+
+    Box stbl;
+    Box stsd;
+    if( hasMinf && Mp4BoxReader(minf.data, minf.size).find(Mp4BoxReader::fourcc("stbl"), &stbl) &&
+            Mp4BoxReader(stbl.data, stbl.size).find(Mp4BoxReader::fourcc("stsd"), &stsd) && stsd.size > 8 )
+    {
+        /// описание первого сэмпла: сегменты HLS не меняют кодек внутри дорожки
+        Box entry;
+        if( Mp4BoxReader(stsd.data + 8, stsd.size - 8).next(&entry) )
+        {
+            parseSampleEntry(track, entry.type, entry.data, entry.size);
+        }
+    }
+
+    if( track.video || track.audio )
+    {
+        mTracks.append(track);
+    }
+}
+
+void Fmp4Probe::parseSampleEntry(Track &track, quint32 type, const uchar *data, quint64 size)
+{
+    /// VisualSampleEntry - 78 байт полей до вложенных боксов, AudioSampleEntry - 28
+    quint64 fieldsSize = track.video ? 78 : 28;
+    if( size < fieldsSize )
+        return;
+
+    if( track.video )
+    {
+        track.width = read16(data + 24);
+        track.height = read16(data + 26);
+    }
+    else
+    {
+        track.channels = read16(data + 16);
+    }
+
+    if( type == Mp4BoxReader::fourcc("encv") || type == Mp4BoxReader::fourcc("enca") )
+    {
+        /// зашифрованная дорожка: исходный формат в sinf/frma
+        Box sinf;
+        Box frma;
+        if( Mp4BoxReader(data + fieldsSize, size - fieldsSize).find(Mp4BoxReader::fourcc("sinf"), &sinf) &&
+                Mp4BoxReader(sinf.data, sinf.size).find(Mp4BoxReader::fourcc("frma"), &frma) && frma.size >= 4 )
+        {
+            type = read32(frma.data);
+        }
+    }
+    track.codec = codecFor(type);
+
+    /// в ac-3/ec-3 channelcount не используется, каналы - в dac3/dec3
+    if( track.codec == "AC-3" || track.codec == "EC-3" )
+    {
+        track.channels = 0;
+    }
+}
+
+void Fmp4Probe::parseTrex(const uchar *data, quint64 size)
+{
+    /// версия/флаги, track_ID, description_index, duration, size, flags
+    if( size < 24 )
+        return;
+    if( Track *found = track(read32(data + 4)) )
+    {
+        found->defaultSampleDuration = read32(data + 12);
+        found->defaultSampleSize = read32(data + 16);
+    }
+}
+
+void Fmp4Probe::parseTraf(const uchar *data, quint64 size)
+{
+    Track *current = nullptr;
+    quint32 defaultDuration = 0;
+    quint32 defaultSize = 0;
+
+    Mp4BoxReader traf(data, size);
+    Box box;
+    while( traf.next(&box) )
+    {
+        if( box.type == Mp4BoxReader::fourcc("tfhd") && box.size >= 8 )
+        {
+            quint32 flags = read32(box.data) & 0x00ffffff;
+            current = track(read32(box.data + 4));
+            if( !current )
+                return;
+            defaultDuration = current->defaultSampleDuration;
+            defaultSize = current->defaultSampleSize;
+
+            quint64 offset = 8;
+            if( flags & TFHD_BASE_DATA_OFFSET )
+                offset += 8;
+            if( flags & TFHD_SAMPLE_DESCRIPTION_INDEX )
+                offset += 4;
+            if( flags & TFHD_DEFAULT_SAMPLE_DURATION )
+            {
+                if( box.size < offset + 4 )
+                    return;
+                defaultDuration = read32(box.data + offset);
+                offset += 4;
+            }
+            if( flags & TFHD_DEFAULT_SAMPLE_SIZE && box.size >= offset + 4 )
+            {
+                defaultSize = read32(box.data + offset);
+            }
+        }
+        else if( box.type == Mp4BoxReader::fourcc("trun") && current && box.size >= 8 )
+        {
+            quint32 flags = read32(box.data) & 0x00ffffff;
+            quint64 count = read32(box.data + 4);
+            quint64 offset = 8;
+            if( flags & TRUN_DATA_OFFSET )
+                offset += 4;
+            if( flags & TRUN_FIRST_SAMPLE_FLAGS )
+                offset += 4;
+
+            quint64 entrySize = 0;
+            const quint32 entryFlags[] = { TRUN_SAMPLE_DURATION, TRUN_SAMPLE_SIZE, TRUN_SAMPLE_FLAGS,
+                                           TRUN_SAMPLE_COMPOSITION_TIME_OFFSET };
+            for( quint32 flag : entryFlags )
+            {
+                if( flags & flag )
+                    entrySize += 4;
+            }
+            if( offset > box.size || count * entrySize > box.size - offset )
+                return;
+
+            if( !(flags & TRUN_SAMPLE_DURATION) && !(flags & TRUN_SAMPLE_SIZE) )
+            {
+                current->duration += count * defaultDuration;
+                current->bytes += count * defaultSize;
+            }
+            else
+            {
+                const uchar *entry = box.data + offset;
+                for( quint64 i = 0; i < count; ++i, entry += entrySize )
+                {
+                    const uchar *field = entry;
+                    if( flags & TRUN_SAMPLE_DURATION )
+                    {
+                        current->duration += read32(field);
+                        field += 4;
+                    }
+                    else
+                    {
+                        current->duration += defaultDuration;
+                    }
+                    current->bytes += flags & TRUN_SAMPLE_SIZE ? read32(field) : defaultSize;
+                }
+            }
+            current->sampleCount += count;
+        }
+    }
+}
+
+Fmp4Probe::Track *Fmp4Probe::track(quint32 trackId)
+{
+    for( int i = 0; i < mTracks.size(); ++i )
+    {
+        if( mTracks.at(i).trackId == trackId )
+            return &mTracks[i];
+    }
+    return nullptr;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/// Разбор fMP4/CMAF: init-сегмент (moov) даёт дорожки с кодеком, разрешением
+/// и числом каналов, фрагменты (moof/traf/trun) - длительности и размеры
+/// сэмплов, по которым точно считаются битрейт и частота кадров каждой дорожки.
+/// Данные подаются порциями; копятся только разорванные между порциями
+/// moov и moof, содержимое mdat пропускается не читая.
+/// Init-сегмент разбирается один раз, для каждого сегмента копируется
+/// уже разобранный Fmp4Probe.
+class Fmp4Probe
+{
+public:
+    struct Track
+    {
+        quint32 trackId = 0;
+        quint32 timescale = 0;
+        QString codec;
+        bool video = false;
+        bool audio = false;
+        quint16 width = 0;
+        quint16 height = 0;
+        quint16 channels = 0;
+        quint32 defaultSampleDuration = 0;  // trex
+        quint32 defaultSampleSize = 0;
+        quint64 sampleCount = 0;
+        quint64 duration = 0;               // в единицах timescale
+        quint64 bytes = 0;
+    };
+
+    Fmp4Probe();
+
+    void feed(const QByteArray &chunk);
+    void finish();
+
+    /// init-сегмент разобран и в нём есть дорожки
+    bool isValid() const;
+    /// разобран хотя бы один moof
+    bool hasFragments() const;
+
+    const QVector<Track> &tracks() const;
+    /// первая видео/аудио-дорожка или nullptr
+    const Track *videoTrack() const;
+    const Track *audioTrack() const;
+
+private:
+    bool wanted(quint32 type) const;
+    void parseBox(quint32 type, const uchar *data, quint64 size);
+    void parseMoov(const uchar *data, quint64 size);
+    void parseTrak(const uchar *data, quint64 size);
+    void parseSampleEntry(Track &track, quint32 type, const uchar *data, quint64 size);
+    void parseTrex(const uchar *data, quint64 size);
+    void parseTraf(const uchar *data, quint64 size);
+    Track *track(quint32 trackId);
+
+private:
+    QByteArray mPending;
+    quint64 mSkip;
+    bool mFailed;
+    bool mFragments;
+    QVector<Track> mTracks;
+};
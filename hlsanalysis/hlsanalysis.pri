@@ -0,0 +1,10 @@
+# подключение движка анализа: include(<путь>/hlsanalysis/hlsanalysis.pri)
+INCLUDEPATH += $$PWD/..
+
+QT += network
+QT += concurrent
+
+LIBS += -L$$shadowed($$PWD) -lhlsanalysis
+
+win32-msvc*: PRE_TARGETDEPS += $$shadowed($$PWD)/hlsanalysis.lib
+else: PRE_TARGETDEPS += $$shadowed($$PWD)/libhlsanalysis.a
@@ -0,0 +1,83 @@
+# движок анализа: без графического интерфейса, подключается к приложению,
+# бенчмаркам и сторонним сервисам через hlsanalysis.pri
+TEMPLATE = lib
+TARGET = hlsanalysis
+
+QT -= gui
+QT += network
+QT += concurrent
+
+CONFIG += staticlib c++11
+DESTDIR = $$OUT_PWD
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        ../arena.cpp \
+        ../deepprobe.cpp \
+        ../fmp4probe.cpp \
+        ../hlsanalyzer.cpp \
+        ../latencyhistogram.cpp \
+        ../livemonitor.cpp \
+        ../loadtest.cpp \
+        ../localfiles.cpp \
+        ../masterplaylistparser.cpp \
+        ../mediaplaylistparser.cpp \
+        ../networktimings.cpp \
+        ../parsepipeline.cpp \
+        ../peakbitrate.cpp \
+        ../playlistcache.cpp \
+        ../playlistmetrics.cpp \
+        ../probesummary.cpp \
+        ../requestscheduler.cpp \
+        ../segmentsizeprober.cpp \
+        ../segmentstore.cpp \
+        ../snapshot.cpp \
+        ../snapshotdiff.cpp \
+        ../streamanalysis.cpp \
+        ../streamregistry.cpp \
+        ../stringpool.cpp \
+        ../timerwheel.cpp \
+        ../tsprobe.cpp \
+        ../tsscanner.cpp
+
+# сканер синхронизации MPEG-TS с AVX2 собирается отдельно с -mavx2,
+# выбор реализации - во время выполнения
+CONFIG += simd
+AVX2_SOURCES += ../tsscanner_avx2.cpp
+
+HEADERS += \
+    ../arena.h \
+    ../attributelist.h \
+    ../deepprobe.h \
+    ../fmp4probe.h \
+    ../hlsanalyzer.h \
+    ../latencyhistogram.h \
+    ../livemonitor.h \
+    ../loadtest.h \
+    ../localfiles.h \
+    ../masterplaylistparser.h \
+    ../mediaplaylistparser.h \
+    ../mp4boxreader.h \
+    ../networktimings.h \
+    ../parsepipeline.h \
+    ../peakbitrate.h \
+    ../playlistcache.h \
+    ../playlistmetrics.h \
+    ../probesummary.h \
+    ../requestscheduler.h \
+    ../segmentrecord.h \
+    ../segmentsizeprober.h \
+    ../segmentstore.h \
+    ../snapshot.h \
+    ../snapshotdiff.h \
+    ../streamanalysis.h \
+    ../streamregistry.h \
+    ../streams.h \
+    ../stringpool.h \
+    ../timerwheel.h \
+    ../tsprobe.h \
+    ../tsscanner.h \
+    ../utils.h
@@ -0,0 +1,241 @@
+#include "hlsanalyzer.h"
+
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QThread>
+
+#include "playlistcache.h"
+#include "requestscheduler.h"
+#include "streamanalysis.h"
+
+HlsAnalyzer::HlsAnalyzer(QObject *parent)
+    : QObject(parent)
+    , mNetworkThread(new QThread(this))
+    , mScheduler(new RequestScheduler)
+    , mMonitor(new LiveMonitor(mScheduler, mScheduler))
+    , mNextChannel(0)
+{
+    /// планировщик переезжает вместе с QNetworkAccessManager; анализы и монитор - его дети
+    mScheduler->moveToThread(mNetworkThread);
+    connect(mNetworkThread, &QThread::finished, mScheduler, &QObject::deleteLater);
+    mNetworkThread->setObjectName("network");
+    mNetworkThread->start();
+}
+
+HlsAnalyzer::~HlsAnalyzer()
+{
+    mNetworkThread->quit();
+    mNetworkThread->wait();
+}
+
+void HlsAnalyzer::setMaxPerHost(int maxPerHost)
+{
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, maxPerHost]()
+    {
+        scheduler->setMaxPerHost(maxPerHost);
+    }, Qt::BlockingQueuedConnection);
+}
+
+void HlsAnalyzer::setMaxAttempts(int attempts)
+{
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, attempts]()
+    {
+        scheduler->setMaxAttempts(attempts);
+    }, Qt::BlockingQueuedConnection);
+}
+
+void HlsAnalyzer::setRequestTimeout(int ms)
+{
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, ms]()
+    {
+        scheduler->setTimeout(ms);
+    }, Qt::BlockingQueuedConnection);
+}
+
+void HlsAnalyzer::enableCache(const QString &directory, qint64 maximumSize)
+{
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, directory, maximumSize]()
+    {
+        PlaylistCache *cache = new PlaylistCache(directory, scheduler);
+        if( maximumSize > 0 )
+            cache->setMaximumSize(maximumSize);
+        scheduler->setCache(cache);
+    }, Qt::BlockingQueuedConnection);
+}
+
+/// Рендиция и варианты, где она стоит именно в этой роли
+static RenditionResult renditionResult(const StreamAnalysis *analysis, int id, bool isAudio)
+{
+    RenditionResult rendition;
+    rendition.id = id;
+    rendition.isAudio = isAudio;
+    foreach(int variant, analysis->registry().variants(id))
+    {
+        const VariantStream &variantStream = analysis->variantStreams().at(variant);
+        if( (isAudio ? variantStream.audioId : variantStream.videoId) != id )
+            continue;
+        rendition.variantIndexes.append(variant);
+        rendition.variantStreams.append(variantStream);
+    }
+    return rendition;
+}
+
+QFuture<AnalysisResult> HlsAnalyzer::analyze(const QString &url, const AnalysisOptions &options)
+{
+    return analyze(url, options, nullptr, RenditionCallback());
+}
+
+QFuture<AnalysisResult> HlsAnalyzer::analyze(const QString &url, const AnalysisOptions &options,
+                                             QObject *context, const RenditionCallback &onRendition)
+{
+    QFutureInterface<AnalysisResult> promise;
+    promise.reportStarted();
+
+    RequestScheduler *scheduler = mScheduler;
+    QPointer<QObject> receiver(context);
+    QMetaObject::invokeMethod(mScheduler, [scheduler, url, options, promise, receiver, onRendition]() mutable
+    {
+        if( promise.isCanceled() )
+        {
+            promise.reportFinished();
+            return;
+        }
+
+        StreamAnalysis *analysis = new StreamAnalysis(scheduler, url, scheduler);
+        analysis->setPeakWindow(options.peakWindowMs);
+        analysis->setProbeRate(options.probeRate);
+        analysis->setDeepProbe(options.sampleInterval);
+        analysis->setDeadline(options.deadlineMs);
+        analysis->setKeepSegments(options.keepSegments);
+
+        /// анализ удалён раньше, чем закончился (отмена, остановка потока) - future всё равно завершается
+        QObject::connect(analysis, &QObject::destroyed, [promise]() mutable
+        {
+            if( !promise.isFinished() )
+            {
+                promise.reportCanceled();
+                promise.reportFinished();
+            }
+        });
+        if( onRendition )
+        {
+            QObject::connect(analysis, &StreamAnalysis::renditionReady, analysis, [analysis, receiver, onRendition](int id, bool isAudio)
+            {
+                RenditionResult rendition = renditionResult(analysis, id, isAudio);
+                if( !receiver.isNull() )
+                {
+                    QMetaObject::invokeMethod(receiver.data(), [onRendition, rendition]()
+                    {
+                        onRendition(rendition);
+                    }, Qt::QueuedConnection);
+                }
+            });
+        }
+        QObject::connect(analysis, &StreamAnalysis::progressChanged, analysis, [promise](int done, int total) mutable
+        {
+            promise.setProgressRange(0, total);
+            promise.setProgressValue(done);
+        });
+        QObject::connect(analysis, &StreamAnalysis::finished, analysis, [analysis, promise]() mutable
+        {
+            AnalysisResult result;
+            result.url = analysis->url();
+            result.errorString = analysis->errorString();
+            result.partial = analysis->isPartial();
+            result.variantStreams = analysis->variantStreams();
+            result.segments = analysis->segments();
+            result.registry = analysis->registry();
+            promise.reportResult(result);
+            promise.reportFinished();
+            analysis->deleteLater();
+        });
+
+        QFutureWatcher<AnalysisResult> *watcher = new QFutureWatcher<AnalysisResult>(analysis);
+        QObject::connect(watcher, &QFutureWatcherBase::canceled, analysis, &QObject::deleteLater);
+        watcher->setFuture(promise.future());
+
+        analysis->start();
+    }, Qt::QueuedConnection);
+
+    return promise.future();
+}
+
+int HlsAnalyzer::monitor(const QString &url, const LiveOptions &options, QObject *context, const LiveCallback &onUpdate)
+{
+    int channel = mNextChannel.fetchAndAddRelaxed(1);
+    QPointer<QObject> receiver(context);
+    LiveMonitor *monitor = mMonitor;
+    QMetaObject::invokeMethod(mMonitor, [monitor, channel, url, options, receiver, onUpdate]()
+    {
+        monitor->add(channel, url, options, [receiver, onUpdate](const LiveStatus &status)
+        {
+            if( receiver.isNull() )
+                return;
+            QMetaObject::invokeMethod(receiver.data(), [onUpdate, status]()
+            {
+                onUpdate(status);
+            }, Qt::QueuedConnection);
+        });
+    }, Qt::QueuedConnection);
+    return channel;
+}
+
+void HlsAnalyzer::stopMonitoring(int channel)
+{
+    LiveMonitor *monitor = mMonitor;
+    QMetaObject::invokeMethod(mMonitor, [monitor, channel]()
+    {
+        monitor->remove(channel);
+    }, Qt::QueuedConnection);
+}
+
+QString HlsAnalyzer::statisticsString() const
+{
+    QString statistics;
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, &statistics]()
+    {
+        statistics = scheduler->statisticsString();
+        if( scheduler->cache() )
+        {
+            statistics += "; кэш: " + scheduler->cache()->statisticsString();
+        }
+    }, Qt::BlockingQueuedConnection);
+    return statistics;
+}
+
+RequestScheduler::Statistics HlsAnalyzer::statistics() const
+{
+    RequestScheduler::Statistics statistics;
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, &statistics]()
+    {
+        statistics = scheduler->statistics();
+    }, Qt::BlockingQueuedConnection);
+    return statistics;
+}
+
+NetworkTimings HlsAnalyzer::timings() const
+{
+    NetworkTimings timings;
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler, &timings]()
+    {
+        timings = scheduler->timings();
+    }, Qt::BlockingQueuedConnection);
+    return timings;
+}
+
+void HlsAnalyzer::clearTimings()
+{
+    RequestScheduler *scheduler = mScheduler;
+    QMetaObject::invokeMethod(mScheduler, [scheduler]()
+    {
+        scheduler->timings().clear();
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QObject>
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+#include <functional>
+
+#include "livemonitor.h"
+#include "networktimings.h"
+#include "requestscheduler.h"
+#include "segmentstore.h"
+#include "streamregistry.h"
+#include "streams.h"
+
+class QThread;
+
+/// Настройки одного анализа, см. StreamAnalysis
+struct AnalysisOptions
+{
+    quint32 peakWindowMs = 10000;
+    /// HEAD-запросов в секунду к одному хосту на размеры сегментов без
+    /// EXT-X-BITRATE, см. SegmentSizeProber; 0 - не узнавать
+    int probeRate = 0;
+    int sampleInterval = 0;
+    /// срок всего анализа, 0 - без ограничения
+    int deadlineMs = 0;
+    /// сохранить все сегменты в AnalysisResult::segments
+    bool keepSegments = false;
+};
+
+/// Результат анализа одного мастер-плейлиста
+struct AnalysisResult
+{
+    QString url;
+    /// пусто - анализ прошёл успешно
+    QString errorString;
+    /// часть медиа-плейлистов не получена, см. StreamAnalysis::isPartial
+    bool partial = false;
+    QList<VariantStream> variantStreams;
+    StreamRegistry registry;
+    /// по id в registry; память освобождается с последней копией
+    QHash<int, SegmentStore> segments;
+};
+
+/// Готовый медиа-плейлист и варианты, в которые он входит, в их текущем
+/// состоянии: вторая часть варианта может быть ещё не готова
+struct RenditionResult
+{
+    int id = -1;
+    bool isAudio = false;
+    /// номера вариантов в мастер-плейлисте
+    QVector<int> variantIndexes;
+    QList<VariantStream> variantStreams;
+};
+
+/// Точка входа библиотеки анализа. Сеть, кэш плейлистов и анализы живут в
+/// отдельном потоке и общие для всех анализов одного объекта, разбор идёт
+/// в пуле потоков. Каждый вызов analyze() независим и сразу возвращает
+/// QFuture: по нему ждут результат, следят за прогрессом (QFutureWatcher)
+/// и отменяют анализ. Одновременных анализов может быть сколько угодно,
+/// запросы к хостам ограничивает общий RequestScheduler. Отмена future
+/// обрывает запросы анализа, уже идущие по сети.
+class HlsAnalyzer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(const RenditionResult &)> RenditionCallback;
+    typedef std::function<void(const LiveStatus &)> LiveCallback;
+
+    explicit HlsAnalyzer(QObject *parent = nullptr);
+    /// незавершённые анализы отменяются
+    ~HlsAnalyzer();
+
+    void setMaxPerHost(int maxPerHost);
+    /// см. RequestScheduler::setMaxAttempts и setTimeout
+    void setMaxAttempts(int attempts);
+    void setRequestTimeout(int ms);
+    /// maximumSize <= 0 - размер кэша по умолчанию
+    void enableCache(const QString &directory, qint64 maximumSize = 0);
+
+    /// Прогресс - число готовых медиа-плейлистов (и проверенных сегментов)
+    /// из известного на данный момент. Можно вызывать из любого потока,
+    /// кроме сетевого потока самого анализатора.
+    QFuture<AnalysisResult> analyze(const QString &url, const AnalysisOptions &options = AnalysisOptions());
+    /// То же, но каждый медиа-плейлист, как только готов, отдаётся в
+    /// onRendition в потоке context - до завершения future. context
+    /// должен жить дольше анализатора или отменить анализ раньше.
+    QFuture<AnalysisResult> analyze(const QString &url, const AnalysisOptions &options,
+                                    QObject *context, const RenditionCallback &onRendition);
+
+    /// Наблюдение за живым потоком до stopMonitoring(), см. LiveMonitor:
+    /// onUpdate вызывается в потоке context после каждой перезагрузки
+    /// каждого медиа-плейлиста. Возвращает номер канала. Обновления,
+    /// отправленные до stopMonitoring(), ещё могут прийти.
+    int monitor(const QString &url, const LiveOptions &options, QObject *context, const LiveCallback &onUpdate);
+    void stopMonitoring(int channel);
+
+    QString statisticsString() const;
+    /// копия счётчиков планировщика
+    RequestScheduler::Statistics statistics() const;
+    /// копия замеров всех запросов
+    NetworkTimings timings() const;
+    void clearTimings();
+
+private:
+    QThread *mNetworkThread;
+    RequestScheduler *mScheduler;
+    LiveMonitor *mMonitor;
+    QAtomicInt mNextChannel;
+};
@@ -0,0 +1,58 @@
+#include "latencyhistogram.h"
+
+#include <cmath>
+#include <cstring>
+
+const double LATENCY_GAMMA = 1.02;
+
+LatencyHistogram::LatencyHistogram()
+    : mCount(0)
+{
+    std::memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void LatencyHistogram::add(qint64 us)
+{
+    int bucket = us > 1 ? int(std::log(double(us)) / std::log(LATENCY_GAMMA)) : 0;
+    mBuckets[qBound(0, bucket, BUCKET_COUNT - 1)]++;
+    mCount++;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for( int i = 0; i < BUCKET_COUNT; ++i )
+    {
+        mBuckets[i] += other.mBuckets[i];
+    }
+    mCount += other.mCount;
+}
+
+void LatencyHistogram::clear()
+{
+    std::memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return mCount;
+}
+
+qreal LatencyHistogram::percentile(qreal percentile) const
+{
+    if( mCount == 0 )
+        return 0;
+
+    quint64 rank = quint64(std::ceil(qBound(0.0, percentile, 100.0) / 100.0 * mCount));
+    quint64 seen = 0;
+    for( int i = 0; i < BUCKET_COUNT; ++i )
+    {
+        seen += mBuckets[i];
+        if( seen >= rank && mBuckets[i] )
+        {
+            /// середина корзины в логарифмической шкале
+            return std::pow(LATENCY_GAMMA, i + 0.5) / 1000;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QtGlobal>
+
+/// Гистограмма задержек в логарифмических корзинах с шагом 2%: память
+/// постоянная и не зависит от числа замеров, гистограммы потоков складываются
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(qint64 us);
+    void merge(const LatencyHistogram &other);
+    void clear();
+    quint64 count() const;
+    /// percentile от 0 до 100
+    qreal percentile(qreal percentile) const; //in milliseconds
+
+private:
+    static const int BUCKET_COUNT = 920;    // до ~80 секунд в микросекундах
+
+    quint32 mBuckets[BUCKET_COUNT];
+    quint64 mCount;
+};
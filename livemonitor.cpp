@@ -0,0 +1,364 @@
+#include "livemonitor.h"
+
+#include <QNetworkReply>
+#include <QUrlQuery>
+
+#include "masterplaylistparser.h"
+#include "mediaplaylistparser.h"
+#include "requestscheduler.h"
+#include "segmentsizeprober.h"
+#include "timerwheel.h"
+
+/// пока TARGETDURATION неизвестна
+const quint64 DEFAULT_TARGET_DURATION_US = 6000000;
+
+RollingBitrate::RollingBitrate(quint32 windowMs)
+    : mWindowMs(windowMs)
+    , mDurationMs(0)
+{
+}
+
+void RollingBitrate::setWindow(quint32 windowMs)
+{
+    mWindowMs = windowMs;
+}
+
+void RollingBitrate::clear()
+{
+    mEntries.clear();
+    mDurationMs = 0;
+}
+
+void RollingBitrate::add(quint64 sequence, quint32 durationMs, quint64 bytes)
+{
+    Entry entry;
+    entry.sequence = sequence;
+    entry.durationMs = durationMs;
+    entry.bytes = bytes;
+    mEntries.enqueue(entry);
+    mDurationMs += durationMs;
+
+    /// самый старый сегмент уходит, если окно заполнено и без него
+    while( mEntries.size() > 1 && mDurationMs - mEntries.head().durationMs >= mWindowMs )
+    {
+        mDurationMs -= mEntries.dequeue().durationMs;
+    }
+}
+
+void RollingBitrate::setBytes(quint64 sequence, quint64 bytes)
+{
+    if( mEntries.isEmpty() || sequence < mEntries.head().sequence )
+        return;
+    /// номера в окне идут подряд
+    quint64 index = sequence - mEntries.head().sequence;
+    if( index < quint64(mEntries.size()) && mEntries.at(int(index)).sequence == sequence )
+    {
+        mEntries[int(index)].bytes = bytes;
+    }
+}
+
+quint32 RollingBitrate::bitrate() const
+{
+    quint64 bytes = 0;
+    quint64 durationMs = 0;
+    foreach(const Entry &entry, mEntries)
+    {
+        if( entry.bytes == 0 )
+            continue;
+        bytes += entry.bytes;
+        durationMs += entry.durationMs;
+    }
+    if( durationMs == 0 )
+        return 0;
+    return quint32(qMin<quint64>(bytes * 8000 / durationMs, 0xffffffffu));
+}
+
+LiveMonitor::LiveMonitor(RequestScheduler *scheduler, QObject *parent)
+    : QObject(parent)
+    , mScheduler(scheduler)
+    , mWheel(new TimerWheel(50, 512, this))
+    , mNextKey(1)
+{
+    mClock.start();
+}
+
+void LiveMonitor::add(int channel, const QString &url, const LiveOptions &options, const Callback &onUpdate)
+{
+    Channel &state = mChannels[channel];
+    state.url = url;
+    state.options = options;
+    state.onUpdate = onUpdate;
+    state.requests = new QObject(this);
+
+    QNetworkRequest request(url);
+    mScheduler->get(request, RequestScheduler::MasterPriority, state.requests, [this, channel](QNetworkReply *reply)
+    {
+        connect(reply, &QNetworkReply::finished, this, [this, channel, reply]()
+        {
+            onMasterReplyFinished(channel, reply);
+        });
+    });
+}
+
+void LiveMonitor::remove(int channel)
+{
+    if( !mChannels.contains(channel) )
+        return;
+
+    Channel state = mChannels.take(channel);
+    foreach(quint64 key, state.playlists)
+    {
+        mWheel->stop(mPlaylists.value(key).timer);
+        mPlaylists.remove(key);
+    }
+    mScheduler->cancel(state.requests);
+    state.requests->deleteLater();
+}
+
+int LiveMonitor::channelCount() const
+{
+    return mChannels.size();
+}
+
+int LiveMonitor::playlistCount() const
+{
+    return mPlaylists.size();
+}
+
+void LiveMonitor::onMasterReplyFinished(int channel, QNetworkReply *reply)
+{
+    reply->deleteLater();
+    if( !mChannels.contains(channel) )
+        return;
+
+    LiveStatus status;
+    status.master = mChannels.value(channel).url;
+    if( reply->error() != QNetworkReply::NoError )
+    {
+        qDebug() << "Error: " << reply->errorString();
+        status.errorString = reply->errorString();
+        mChannels.value(channel).onUpdate(status);
+        return;
+    }
+
+    QByteArray data = reply->readAll();
+    MasterPlaylistParser master;
+    if( !master.parse(data, reply->url().adjusted(QUrl::RemoveFilename)) )
+    {
+        status.errorString = "Неверный формат!";
+        mChannels.value(channel).onUpdate(status);
+        return;
+    }
+
+    if( !master.isMaster() )
+    {
+        /// вместо мастера дан медиа-плейлист - наблюдаем за ним самим
+        addPlaylist(channel, 0, false, reply->url().toString());
+        return;
+    }
+    foreach(int videoId, master.videoIds())
+    {
+        addPlaylist(channel, videoId, false, master.registry().url(videoId));
+    }
+    foreach(int audioId, master.audioIds())
+    {
+        addPlaylist(channel, audioId, true, master.registry().url(audioId));
+    }
+}
+
+void LiveMonitor::addPlaylist(int channel, int id, bool isAudio, const QString &url)
+{
+    Channel &state = mChannels[channel];
+    quint64 key = mNextKey++;
+    state.playlists.append(key);
+
+    Playlist &playlist = mPlaylists[key];
+    playlist.channel = channel;
+    playlist.url = QUrl(url);
+    playlist.rolling.setWindow(state.options.windowMs);
+    playlist.status.master = state.url;
+    playlist.status.url = url;
+    playlist.status.id = id;
+    playlist.status.isAudio = isAudio;
+    reload(key);
+}
+
+void LiveMonitor::reload(quint64 key)
+{
+    Playlist &playlist = mPlaylists[key];
+    const Channel &channel = mChannels[playlist.channel];
+    playlist.timer = 0;
+    const qint64 now = mClock.elapsed();
+    playlist.reloadStartedAt = now;
+
+    /// разностное обновление можно просить, пока наша версия моложе половины CAN-SKIP-UNTIL
+    QUrl url = playlist.url;
+    const bool delta = channel.options.deltaUpdates && playlist.loaded && playlist.canSkipUntilUs > 0
+            && quint64(now - playlist.loadedAt) * 1000 < playlist.canSkipUntilUs / 2;
+    if( delta )
+    {
+        QUrlQuery query(url);
+        query.addQueryItem("_HLS_skip", "YES");
+        url.setQuery(query);
+    }
+
+    QNetworkRequest request(url);
+    /// живой плейлист из кэша - всегда устаревший
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    mScheduler->get(request, RequestScheduler::MediaPlaylistPriority, channel.requests, [this, key](QNetworkReply *reply)
+    {
+        connect(reply, &QNetworkReply::finished, this, [this, key, reply]()
+        {
+            onReloadFinished(key, reply);
+        });
+    });
+}
+
+void LiveMonitor::onReloadFinished(quint64 key, QNetworkReply *reply)
+{
+    reply->deleteLater();
+    if( !mPlaylists.contains(key) )
+        return;
+
+    Playlist &playlist = mPlaylists[key];
+    LiveStatus &status = playlist.status;
+    status.reloads++;
+    status.newSegments = 0;
+    if( reply->error() != QNetworkReply::NoError )
+    {
+        qDebug() << "Error: " << reply->errorString();
+        status.errorString = reply->errorString();
+        scheduleReload(key, false);
+        report(key);
+        return;
+    }
+
+    QByteArray data = reply->readAll();
+    status.bytes += quint64(data.size());
+
+    QVector<SegmentRecord> records;
+    MediaPlaylistReader reader;
+    reader.feed(data, records);
+    reader.finish(records);
+    if( !reader.isValid() )
+    {
+        status.errorString = "Неверный формат!";
+        scheduleReload(key, false);
+        report(key);
+        return;
+    }
+    status.errorString.clear();
+
+    const PlaylistInfo &info = reader.info();
+    /// на просьбу о разностном обновлении сервер вправе ответить полной версией
+    if( info.skippedSegments > 0 )
+    {
+        status.deltaReloads++;
+    }
+
+    /// номер последнего сегмента меньше прежнего - поток перезапущен
+    if( playlist.loaded && !records.isEmpty() && records.last().sequence < playlist.lastSequence )
+    {
+        qDebug() << "Поток перезапущен:" << status.url;
+        playlist.loaded = false;
+        playlist.rolling.clear();
+    }
+
+    QVector<QUrl> unsizedUrls;
+    QVector<quint64> unsizedSequences;
+    const bool probe = mChannels.value(playlist.channel).options.probeRate > 0;
+    foreach(const SegmentRecord &record, records)
+    {
+        if( playlist.loaded && record.sequence <= playlist.lastSequence )
+            continue;
+
+        quint64 bytes = 0;
+        if( record.hasByteRange )
+            bytes = record.byteRangeLength;
+        else if( record.bitrate )
+            bytes = quint64(record.bitrate) * record.durationUs / 8000;
+        else if( probe )
+        {
+            unsizedUrls.append(reply->url().resolved(QUrl(QString::fromUtf8(record.uri.data(), record.uri.size()))));
+            unsizedSequences.append(record.sequence);
+        }
+        playlist.rolling.add(record.sequence, quint32(record.durationUs / 1000), bytes);
+        playlist.lastSequence = record.sequence;
+        status.newSegments++;
+    }
+
+    const qint64 now = mClock.elapsed();
+    if( !playlist.loaded || status.newSegments > 0 )
+    {
+        playlist.changedAt = now;
+    }
+    playlist.loaded = true;
+    playlist.loadedAt = playlist.reloadStartedAt;
+    if( info.targetDurationUs )
+        playlist.targetDurationUs = info.targetDurationUs;
+    playlist.canSkipUntilUs = info.canSkipUntilUs;
+
+    status.lastSequence = playlist.lastSequence;
+    status.segmentCount = quint32(info.skippedSegments + reader.segmentCount());
+    status.targetDurationMs = quint32(playlist.targetDurationUs / 1000);
+    status.ended = info.endList;
+    if( !status.ended )
+    {
+        scheduleReload(key, status.newSegments > 0);
+    }
+
+    if( !unsizedUrls.isEmpty() )
+    {
+        probeSizes(key, unsizedUrls, unsizedSequences);
+        return;
+    }
+    report(key);
+}
+
+void LiveMonitor::probeSizes(quint64 key, const QVector<QUrl> &urls, const QVector<quint64> &sequences)
+{
+    const Channel &channel = mChannels[mPlaylists.value(key).channel];
+    /// владелец - объект запросов канала: удаление канала удалит и проверку
+    SegmentSizeProber *prober = new SegmentSizeProber(mScheduler, channel.requests);
+    prober->setRate(channel.options.probeRate);
+    connect(prober, &SegmentSizeProber::finished, this, [this, prober, key, sequences]()
+    {
+        prober->deleteLater();
+        if( !mPlaylists.contains(key) )
+            return;
+        Playlist &playlist = mPlaylists[key];
+        for( int i = 0; i < sequences.size(); ++i )
+        {
+            if( prober->sizes().at(i) > 0 )
+                playlist.rolling.setBytes(sequences.at(i), quint64(prober->sizes().at(i)));
+        }
+        report(key);
+    });
+    prober->probe(urls);
+}
+
+void LiveMonitor::scheduleReload(quint64 key, bool changed)
+{
+    Playlist &playlist = mPlaylists[key];
+    qint64 targetMs = qint64(playlist.targetDurationUs ? playlist.targetDurationUs : DEFAULT_TARGET_DURATION_US) / 1000;
+    /// от начала прошлой загрузки: TARGETDURATION, а без изменений - половина
+    qint64 interval = changed ? targetMs : targetMs / 2;
+    qint64 delay = interval - (mClock.elapsed() - playlist.reloadStartedAt);
+    playlist.timer = mWheel->start(int(qMax<qint64>(0, delay)), [this, key]()
+    {
+        reload(key);
+    });
+}
+
+void LiveMonitor::report(quint64 key)
+{
+    Playlist &playlist = mPlaylists[key];
+    LiveStatus &status = playlist.status;
+    status.rollingBitrate = playlist.rolling.bitrate();
+    status.staleMs = mClock.elapsed() - playlist.changedAt;
+    /// сервер обязан выкладывать новую версию не реже, чем раз в 1.5 TARGETDURATION
+    qint64 targetMs = qint64(playlist.targetDurationUs ? playlist.targetDurationUs : DEFAULT_TARGET_DURATION_US) / 1000;
+    status.stale = playlist.loaded && !status.ended && status.staleMs * 2 > targetMs * 3;
+    mChannels.value(playlist.channel).onUpdate(status);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <QObject>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QUrl>
+#include <QVector>
+
+#include <functional>
+
+class QNetworkReply;
+class RequestScheduler;
+class TimerWheel;
+
+/// Настройки наблюдения за живым потоком, см. LiveMonitor
+struct LiveOptions
+{
+    /// окно скользящего битрейта
+    quint32 windowMs = 60000;
+    /// запрашивать разностные обновления (_HLS_skip), если сервер их объявил
+    bool deltaUpdates = true;
+    /// HEAD-запросов в секунду к одному хосту на размеры новых сегментов без EXT-X-BITRATE; 0 - не узнавать
+    int probeRate = 0;
+};
+
+/// Состояние медиа-плейлиста живого потока после очередной перезагрузки
+struct LiveStatus
+{
+    QString master;
+    QString url;
+    int id = -1;    //id in StreamRegistry
+    bool isAudio = false;
+    /// пусто - перезагрузка прошла успешно
+    QString errorString;
+
+    quint64 lastSequence = 0;       // номер последнего сегмента
+    quint32 segmentCount = 0;       // сегментов в плейлисте, включая пропущенные в разностном обновлении
+    quint32 newSegments = 0;        // добавилось с прошлой перезагрузки
+    quint32 rollingBitrate = 0;     //in bits per second
+    quint32 targetDurationMs = 0;
+    qint64 staleMs = 0;             // с появления последнего нового сегмента
+    /// новых сегментов нет дольше 1.5 TARGETDURATION
+    bool stale = false;
+    /// появился EXT-X-ENDLIST - перезагрузки прекращены
+    bool ended = false;
+
+    quint64 reloads = 0;
+    quint64 deltaReloads = 0;
+    quint64 bytes = 0;              // загружено плейлистов, байт
+};
+
+/// Битрейт последних сегментов в окне заданной длительности. Сегменты
+/// добавляются по возрастанию номера; размер можно узнать позже.
+class RollingBitrate
+{
+public:
+    explicit RollingBitrate(quint32 windowMs = 60000);
+
+    void setWindow(quint32 windowMs);
+    void clear();
+    /// bytes = 0 - размер пока неизвестен
+    void add(quint64 sequence, quint32 durationMs, quint64 bytes);
+    void setBytes(quint64 sequence, quint64 bytes);
+
+    quint32 bitrate() const; //in bits per second
+
+private:
+    struct Entry
+    {
+        quint64 sequence;
+        quint32 durationMs;
+        quint64 bytes;
+    };
+
+    quint32 mWindowMs;
+    QQueue<Entry> mEntries;
+    quint64 mDurationMs;
+};
+
+/// Наблюдение за живыми (и EVENT) потоками. Каждый медиа-плейлист
+/// перезагружается с периодом TARGETDURATION, а если не изменился -
+/// через половину (RFC 8216, 6.3.4); все сроки всех каналов ведёт одно
+/// колесо таймеров. Метрики считаются только по сегментам, которых не было
+/// в прошлой версии: они отбираются по EXT-X-MEDIA-SEQUENCE. Если сервер
+/// объявил CAN-SKIP-UNTIL, запрашивается разностное обновление с
+/// _HLS_skip=YES, в котором старые сегменты заменены на EXT-X-SKIP.
+/// Живые плейлисты короткие, поэтому разбираются прямо в потоке
+/// планировщика, без ParsePipeline. Живёт в потоке RequestScheduler.
+class LiveMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(const LiveStatus &)> Callback;
+
+    explicit LiveMonitor(RequestScheduler *scheduler, QObject *parent = nullptr);
+
+    /// номер канала выбирает вызывающая сторона; onUpdate вызывается в потоке
+    /// монитора после каждой перезагрузки каждого медиа-плейлиста канала
+    void add(int channel, const QString &url, const LiveOptions &options, const Callback &onUpdate);
+    /// запросы канала обрываются, обновлений больше не будет
+    void remove(int channel);
+
+    int channelCount() const;
+    int playlistCount() const;
+
+private:
+    struct Channel
+    {
+        QString url;
+        LiveOptions options;
+        Callback onUpdate;
+        /// владелец запросов канала: его удаление обрывает их
+        QObject *requests = nullptr;
+        QVector<quint64> playlists;
+    };
+
+    struct Playlist
+    {
+        int channel = -1;
+        QUrl url;
+        bool loaded = false;
+        quint64 lastSequence = 0;
+        quint64 targetDurationUs = 0;
+        quint64 canSkipUntilUs = 0;
+        qint64 reloadStartedAt = 0;
+        qint64 loadedAt = 0;
+        qint64 changedAt = 0;
+        quint64 timer = 0;
+        RollingBitrate rolling;
+        LiveStatus status;
+    };
+
+    void onMasterReplyFinished(int channel, QNetworkReply *reply);
+    void addPlaylist(int channel, int id, bool isAudio, const QString &url);
+    void reload(quint64 key);
+    void onReloadFinished(quint64 key, QNetworkReply *reply);
+    void probeSizes(quint64 key, const QVector<QUrl> &urls, const QVector<quint64> &sequences);
+    void scheduleReload(quint64 key, bool changed);
+    void report(quint64 key);
+
+private:
+    RequestScheduler *mScheduler;
+    TimerWheel *mWheel;
+    QElapsedTimer mClock;
+
+    QHash<int, Channel> mChannels;
+    QHash<quint64, Playlist> mPlaylists;
+    quint64 mNextKey;
+};
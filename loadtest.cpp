@@ -0,0 +1,840 @@
+#include "loadtest.h"
+
+#include <QSharedPointer>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+
+#ifndef QT_NO_SSL
+#include <QSslSocket>
+#else
+#include <QTcpSocket>
+#endif
+
+#include <algorithm>
+
+#include "segmentstore.h"
+#include "timerwheel.h"
+
+const int RETRY_DELAY = 1000; //in milliseconds
+/// переходов по Location подряд, дальше ответ 3xx - ошибка
+const int MAX_REDIRECTS = 5;
+/// вес нового замера в оценке пропускной способности
+const qreal ESTIMATE_WEIGHT = 0.3;
+
+namespace
+{
+
+struct Rendition
+{
+    QUrl url;
+    SegmentStore segments;
+};
+
+struct LadderVariant
+{
+    quint32 bandwidth = 0; //in bits per second
+    Rendition main;
+    /// отдельное аудио; segments.isNull() - нет
+    Rendition audio;
+};
+
+/// общая для всех потоков лесенка, только для чтения
+struct Ladder
+{
+    QUrl master;
+    QVector<LadderVariant> variants;
+};
+
+struct LoadStats
+{
+    int activeClients = 0;
+    quint64 requests = 0;
+    quint64 errors = 0;
+    quint64 bytes = 0;
+    quint64 switches = 0;
+    quint64 rebuffers = 0;
+    LatencyHistogram latency;
+    QVector<int> clientsPerVariant;
+};
+
+/// Имитированный плеер: одно соединение, один запрос за раз
+struct Player
+{
+    enum Kind
+    {
+        Master,
+        Playlist,
+        AudioPlaylist,
+        Init,
+        Segment,
+        AudioSegment
+    };
+
+    enum ParseState
+    {
+        StatusLine,
+        Headers,
+        Body,
+        ChunkSize,
+        ChunkEnd,       // CRLF после данных блока
+        ChunkTrailer
+    };
+
+    QTcpSocket *socket = nullptr;
+    QString host;
+    quint16 port = 0;
+    bool https = false;
+
+    /// текущий запрос
+    Kind kind = Master;
+    QUrl url;
+    qint64 offset = -1;
+    qint64 length = 0;
+    int redirects = 0;
+    QByteArray request;
+    bool inFlight = false;
+    bool sent = false;
+    qint64 startedUs = 0;
+    qint64 firstByteUs = -1;
+    quint64 timeout = 0;
+
+    /// разбор ответа
+    ParseState state = StatusLine;
+    QByteArray line;
+    int status = 0;
+    qint64 remaining = -1;  // -1 - до закрытия соединения
+    bool chunked = false;
+    bool closeAfter = false;
+    QByteArray location;
+    qint64 bodyBytes = 0;
+
+    /// воспроизведение
+    bool started = false;
+    int variant = 0;
+    int segment = 0;
+    qint64 mediaMs = 0;     // скачано
+    qint64 playheadMs = 0;  // воспроизведено
+    qint64 lastUpdateMs = 0;
+    bool playing = false;
+    bool stalled = false;
+    qreal estimate = 0;     //in bits per second
+};
+
+}
+
+/// Плееры одного потока. Живёт в своём потоке, снаружи вызывается через
+/// QMetaObject::invokeMethod
+class LoadWorker : public QObject
+{
+public:
+    LoadWorker(const QSharedPointer<const Ladder> &ladder, const LoadOptions &options)
+        : mLadder(ladder)
+        , mOptions(options)
+        , mWheel(new TimerWheel(10, 1024, this))
+    {
+        mClock.start();
+    }
+
+    ~LoadWorker()
+    {
+        /// закрытие сокета не должно дойти до уже удалённого плеера
+        foreach(Player *player, mPlayers)
+        {
+            player->socket->disconnect(this);
+            delete player->socket;
+            delete player;
+        }
+    }
+
+    void addClients(const QVector<int> &startDelays)
+    {
+        foreach(int delay, startDelays)
+        {
+            Player *player = createPlayer();
+            mWheel->start(delay, [this, player]()
+            {
+                player->started = true;
+                startSession(player);
+            });
+        }
+    }
+
+    LoadStats takeStats()
+    {
+        LoadStats stats = mStats;
+        stats.clientsPerVariant.fill(0, mLadder->variants.size());
+        foreach(Player *player, mPlayers)
+        {
+            if( !player->started )
+                continue;
+            stats.activeClients++;
+            stats.clientsPerVariant[player->variant]++;
+        }
+        mStats = LoadStats();
+        return stats;
+    }
+
+private:
+    Player *createPlayer()
+    {
+        Player *player = new Player;
+#ifndef QT_NO_SSL
+        player->socket = new QSslSocket(this);
+        connect(static_cast<QSslSocket *>(player->socket), &QSslSocket::encrypted, this, [this, player]()
+        {
+            sendRequest(player);
+        });
+#else
+        player->socket = new QTcpSocket(this);
+#endif
+        connect(player->socket, &QTcpSocket::connected, this, [this, player]()
+        {
+            if( !player->https )
+                sendRequest(player);
+        });
+        connect(player->socket, &QTcpSocket::readyRead, this, [this, player]()
+        {
+            onReadyRead(player);
+        });
+        connect(player->socket, &QTcpSocket::stateChanged, this, [this, player](QAbstractSocket::SocketState state)
+        {
+            if( state != QAbstractSocket::UnconnectedState || !player->inFlight )
+                return;
+            /// без Content-Length тело идёт до закрытия соединения
+            bool complete = player->state == Player::Body && player->remaining < 0 && !player->chunked;
+            finishRequest(player, complete);
+        });
+        mPlayers.append(player);
+        return player;
+    }
+
+    qint64 nowUs() const
+    {
+        return mClock.nsecsElapsed() / 1000;
+    }
+
+    qint64 nowMs() const
+    {
+        return mClock.elapsed();
+    }
+
+    void startSession(Player *player)
+    {
+        player->segment = 0;
+        player->mediaMs = 0;
+        player->playheadMs = 0;
+        player->playing = false;
+        player->stalled = false;
+        fetch(player, Player::Master, mLadder->master);
+    }
+
+    void fetch(Player *player, Player::Kind kind, const QUrl &url, qint64 offset = -1, qint64 length = 0)
+    {
+        const bool https = url.scheme() == "https";
+        const quint16 port = quint16(url.port(https ? 443 : 80));
+
+        QByteArray path = url.toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment);
+        if( !path.startsWith('/') )
+            path.prepend('/');
+        QByteArray request = "GET " + path + " HTTP/1.1\r\nHost: " + url.host().toUtf8();
+        if( url.port() != -1 )
+            request += ":" + QByteArray::number(port);
+        request += "\r\nUser-Agent: HLS-UI load test\r\nAccept: */*\r\n";
+        if( offset >= 0 )
+        {
+            request += "Range: bytes=" + QByteArray::number(offset) + "-" + QByteArray::number(offset + length - 1) + "\r\n";
+        }
+        request += "Connection: keep-alive\r\n\r\n";
+
+        const bool reconnect = player->socket->state() != QAbstractSocket::ConnectedState
+                || player->host != url.host() || player->port != port || player->https != https;
+        if( reconnect )
+        {
+            /// inFlight ещё false - закрытие старого соединения не считается ошибкой
+            player->socket->abort();
+        }
+
+        player->kind = kind;
+        player->url = url;
+        player->offset = offset;
+        player->length = length;
+        player->request = request;
+        player->inFlight = true;
+        player->sent = false;
+        player->startedUs = nowUs();
+        player->firstByteUs = -1;
+        player->state = Player::StatusLine;
+        player->line.clear();
+        player->bodyBytes = 0;
+        player->timeout = mWheel->start(mOptions.requestTimeoutMs, [this, player]()
+        {
+            player->timeout = 0;
+            finishRequest(player, false);
+            player->socket->abort();
+        });
+
+        if( !reconnect )
+        {
+            sendRequest(player);
+            return;
+        }
+        player->host = url.host();
+        player->port = port;
+        player->https = https;
+#ifndef QT_NO_SSL
+        if( https )
+        {
+            static_cast<QSslSocket *>(player->socket)->connectToHostEncrypted(player->host, port);
+            return;
+        }
+#endif
+        player->socket->connectToHost(player->host, port);
+    }
+
+    void sendRequest(Player *player)
+    {
+        if( !player->inFlight || player->sent )
+            return;
+        player->sent = true;
+        player->socket->write(player->request);
+    }
+
+    void onReadyRead(Player *player)
+    {
+        QByteArray data = player->socket->readAll();
+        if( !player->inFlight )
+            return;
+        if( player->firstByteUs < 0 )
+            player->firstByteUs = nowUs();
+
+        int pos = 0;
+        while( pos < data.size() && player->inFlight )
+        {
+            if( player->state == Player::Body )
+            {
+                qint64 available = data.size() - pos;
+                qint64 count = player->remaining < 0 ? available : qMin(player->remaining, available);
+                player->bodyBytes += count;
+                pos += int(count);
+                if( player->remaining < 0 )
+                    continue;
+                player->remaining -= count;
+                if( player->remaining == 0 )
+                {
+                    if( player->chunked )
+                        player->state = Player::ChunkEnd;
+                    else
+                        finishRequest(player, true);
+                }
+                continue;
+            }
+
+            int end = data.indexOf('\n', pos);
+            if( end == -1 )
+            {
+                player->line.append(data.constData() + pos, data.size() - pos);
+                break;
+            }
+            player->line.append(data.constData() + pos, end - pos);
+            pos = end + 1;
+            QByteArray line = player->line.trimmed();
+            player->line.clear();
+            onLine(player, line);
+        }
+    }
+
+    void onLine(Player *player, const QByteArray &line)
+    {
+        switch( player->state )
+        {
+        case Player::StatusLine:
+            player->status = line.split(' ').value(1).toInt();
+            player->remaining = -1;
+            player->chunked = false;
+            player->closeAfter = false;
+            player->location.clear();
+            player->state = Player::Headers;
+            break;
+        case Player::Headers:
+            if( line.isEmpty() )
+            {
+                if( player->status >= 100 && player->status < 200 )
+                    player->state = Player::StatusLine;
+                else if( player->chunked )
+                    player->state = Player::ChunkSize;
+                else if( player->remaining == 0 )
+                    finishRequest(player, true);
+                else
+                    player->state = Player::Body;
+            }
+            else
+            {
+                QByteArray lower = line.toLower();
+                if( lower.startsWith("content-length:") )
+                    player->remaining = line.mid(15).trimmed().toLongLong();
+                else if( lower.startsWith("transfer-encoding:") && lower.contains("chunked") )
+                    player->chunked = true;
+                else if( lower.startsWith("connection:") && lower.contains("close") )
+                    player->closeAfter = true;
+                else if( lower.startsWith("location:") )
+                    player->location = line.mid(9).trimmed();
+            }
+            break;
+        case Player::ChunkSize:
+        {
+            bool ok = false;
+            qint64 size = line.split(';').first().trimmed().toLongLong(&ok, 16);
+            if( !ok )
+            {
+                finishRequest(player, false);
+                player->socket->abort();
+            }
+            else if( size == 0 )
+            {
+                player->state = Player::ChunkTrailer;
+            }
+            else
+            {
+                player->remaining = size;
+                player->state = Player::Body;
+            }
+            break;
+        }
+        case Player::ChunkEnd:
+            player->state = Player::ChunkSize;
+            break;
+        case Player::ChunkTrailer:
+            if( line.isEmpty() )
+                finishRequest(player, true);
+            break;
+        case Player::Body:
+            break;
+        }
+    }
+
+    void finishRequest(Player *player, bool complete)
+    {
+        if( !player->inFlight )
+            return;
+        player->inFlight = false;
+        if( player->timeout )
+        {
+            mWheel->stop(player->timeout);
+            player->timeout = 0;
+        }
+
+        const bool ok = complete && player->status >= 200 && player->status < 300;
+        const bool redirect = complete && player->status >= 300 && player->status < 400 && !player->location.isEmpty()
+                && player->redirects < MAX_REDIRECTS;
+        mStats.requests++;
+        mStats.bytes += quint64(player->bodyBytes);
+        if( player->firstByteUs >= 0 )
+            mStats.latency.add(player->firstByteUs - player->startedUs);
+        if( player->closeAfter && complete )
+            player->socket->disconnectFromHost();
+
+        if( redirect )
+        {
+            /// новый адрес - новое соединение, если сменился хост; оценка
+            /// пропускной способности считается только по последнему ответу
+            player->redirects++;
+            QUrl url = player->url.resolved(QUrl::fromEncoded(player->location));
+            fetch(player, player->kind, url, player->offset, player->length);
+            return;
+        }
+        player->redirects = 0;
+
+        if( !ok )
+        {
+            /// плеер повторяет тот же запрос через секунду; 3xx без Location
+            /// или после MAX_REDIRECTS переходов - тоже ошибка
+            mStats.errors++;
+            Player::Kind kind = player->kind;
+            mWheel->start(RETRY_DELAY, [this, player, kind]()
+            {
+                retry(player, kind);
+            });
+            return;
+        }
+        onResponse(player);
+    }
+
+    void retry(Player *player, Player::Kind kind)
+    {
+        const LadderVariant &variant = mLadder->variants.at(player->variant);
+        switch( kind )
+        {
+        case Player::Master:
+            fetch(player, Player::Master, mLadder->master);
+            break;
+        case Player::Playlist:
+            fetch(player, Player::Playlist, variant.main.url);
+            break;
+        case Player::AudioPlaylist:
+            fetch(player, Player::AudioPlaylist, variant.audio.url);
+            break;
+        case Player::Init:
+            startMedia(player);
+            break;
+        case Player::Segment:
+            fetchSegment(player, variant.main, player->segment, Player::Segment);
+            break;
+        case Player::AudioSegment:
+            fetchSegment(player, variant.audio, audioSegment(player), Player::AudioSegment);
+            break;
+        }
+    }
+
+    void onResponse(Player *player)
+    {
+        const LadderVariant &variant = mLadder->variants.at(player->variant);
+        switch( player->kind )
+        {
+        case Player::Master:
+            fetch(player, Player::Playlist, variant.main.url);
+            break;
+        case Player::Playlist:
+            if( !variant.audio.segments.isNull() )
+                fetch(player, Player::AudioPlaylist, variant.audio.url);
+            else
+                startMedia(player);
+            break;
+        case Player::AudioPlaylist:
+            startMedia(player);
+            break;
+        case Player::Init:
+            fetchSegment(player, variant.main, player->segment, Player::Segment);
+            break;
+        case Player::Segment:
+        {
+            qint64 downloadUs = qMax<qint64>(1, nowUs() - player->startedUs);
+            qreal sample = player->bodyBytes * 8 * 1000000.0 / downloadUs;
+            player->estimate = player->estimate > 0 ? player->estimate * (1 - ESTIMATE_WEIGHT) + sample * ESTIMATE_WEIGHT : sample;
+            if( !variant.audio.segments.isNull() )
+            {
+                fetchSegment(player, variant.audio, audioSegment(player), Player::AudioSegment);
+                break;
+            }
+            onSegment(player);
+            break;
+        }
+        case Player::AudioSegment:
+            onSegment(player);
+            break;
+        }
+    }
+
+    /// после плейлиста: сначала EXT-X-MAP, если он есть, потом сегменты
+    void startMedia(Player *player)
+    {
+        const Rendition &main = mLadder->variants.at(player->variant).main;
+        QLatin1String map = main.segments.mapUri(player->segment);
+        if( map.size() == 0 )
+        {
+            fetchSegment(player, main, player->segment, Player::Segment);
+            return;
+        }
+        fetch(player, Player::Init, main.url.resolved(QUrl::fromEncoded(QByteArray(map.data(), map.size()))));
+    }
+
+    /// аудио-сегмент того же момента, что и текущий сегмент варианта
+    int audioSegment(const Player *player) const
+    {
+        const LadderVariant &variant = mLadder->variants.at(player->variant);
+        int mainCount = qMax(1, variant.main.segments.count());
+        int index = int(qint64(player->segment) * variant.audio.segments.count() / mainCount);
+        return qBound(0, index, variant.audio.segments.count() - 1);
+    }
+
+    void fetchSegment(Player *player, const Rendition &rendition, int index, Player::Kind kind)
+    {
+        const SegmentStore &segments = rendition.segments;
+        QUrl url = rendition.url.resolved(QUrl::fromEncoded(segments.uri(index)));
+        if( segments.flags(index) & SegmentStore::ByteRange )
+            fetch(player, kind, url, qint64(segments.offset(index)), segments.bytes(index));
+        else
+            fetch(player, kind, url);
+    }
+
+    /// сдвигает воспроизведение к текущему моменту; пустой буфер - остановка
+    void updatePlayback(Player *player)
+    {
+        qint64 now = nowMs();
+        if( player->playing )
+        {
+            qint64 playhead = player->playheadMs + now - player->lastUpdateMs;
+            if( playhead > player->mediaMs )
+            {
+                playhead = player->mediaMs;
+                if( !player->stalled )
+                {
+                    player->stalled = true;
+                    mStats.rebuffers++;
+                }
+            }
+            player->playheadMs = playhead;
+        }
+        player->lastUpdateMs = now;
+    }
+
+    void onSegment(Player *player)
+    {
+        const LadderVariant &current = mLadder->variants.at(player->variant);
+        updatePlayback(player);
+        player->mediaMs += current.main.segments.durationUs(player->segment) / 1000;
+        player->playing = true;
+        player->stalled = false;
+        player->segment++;
+
+        const qint64 bufferMs = player->mediaMs - player->playheadMs;
+        if( player->segment >= current.main.segments.count() )
+        {
+            /// поток досмотрен - новый сеанс, когда буфер доиграет
+            mWheel->start(int(bufferMs), [this, player]()
+            {
+                startSession(player);
+            });
+            return;
+        }
+
+        int next = chooseVariant(player, bufferMs);
+        if( next != player->variant )
+        {
+            mStats.switches++;
+            player->variant = next;
+            /// сегменты вариантов выровнены по времени, номер сохраняется
+            player->segment = qMin(player->segment, mLadder->variants.at(next).main.segments.count() - 1);
+            fetch(player, Player::Playlist, mLadder->variants.at(next).main.url);
+            return;
+        }
+
+        qint64 delay = bufferMs - mOptions.bufferMs;
+        if( delay <= 0 )
+        {
+            fetchSegment(player, current.main, player->segment, Player::Segment);
+            return;
+        }
+        mWheel->start(int(delay), [this, player]()
+        {
+            const LadderVariant &variant = mLadder->variants.at(player->variant);
+            fetchSegment(player, variant.main, player->segment, Player::Segment);
+        });
+    }
+
+    /// самый высокий вариант в пределах safety от оценки; вверх - только
+    /// при запасе буфера
+    int chooseVariant(const Player *player, qint64 bufferMs) const
+    {
+        int best = 0;
+        for( int i = 0; i < mLadder->variants.size(); ++i )
+        {
+            if( mLadder->variants.at(i).bandwidth <= player->estimate * mOptions.safety )
+                best = i;
+        }
+        if( best > player->variant && bufferMs < mOptions.bufferMs / 3 )
+            return player->variant;
+        return best;
+    }
+
+private:
+    QSharedPointer<const Ladder> mLadder;
+    LoadOptions mOptions;
+    TimerWheel *mWheel;
+    QElapsedTimer mClock;
+    QVector<Player *> mPlayers;
+    LoadStats mStats;
+};
+
+LoadTest::LoadTest(const AnalysisResult &result, const LoadOptions &options, QObject *parent)
+    : QObject(parent)
+    , mResult(result)
+    , mOptions(options)
+    , mReportTimer(new QTimer(this))
+    , mLastReportMs(0)
+{
+    mReportTimer->setInterval(qMax(100, options.reportIntervalMs));
+    connect(mReportTimer, &QTimer::timeout, this, &LoadTest::onReportTimer);
+}
+
+LoadTest::~LoadTest()
+{
+    stop();
+}
+
+bool LoadTest::start(const ReportCallback &onReport)
+{
+    QSharedPointer<Ladder> ladder(new Ladder);
+    ladder->master = QUrl(mResult.url);
+    foreach(const VariantStream &variantStream, mResult.variantStreams)
+    {
+        LadderVariant variant;
+        variant.bandwidth = variantStream.averageBandwidth ? variantStream.averageBandwidth : variantStream.peakBandwidth;
+        if( !variantStream.videoStream.url.isEmpty() )
+        {
+            variant.main.url = QUrl(variantStream.videoStream.url);
+            variant.main.segments = mResult.segments.value(variantStream.videoId);
+            if( !variantStream.audioStream.url.isEmpty() )
+            {
+                variant.audio.url = QUrl(variantStream.audioStream.url);
+                variant.audio.segments = mResult.segments.value(variantStream.audioId);
+            }
+        }
+        else
+        {
+            variant.main.url = QUrl(variantStream.audioStream.url);
+            variant.main.segments = mResult.segments.value(variantStream.audioId);
+        }
+        if( variant.main.segments.isNull() || variant.main.segments.count() == 0 )
+            continue;
+        if( !variant.audio.segments.isNull() && variant.audio.segments.count() == 0 )
+            variant.audio.segments = SegmentStore();
+        ladder->variants.append(variant);
+    }
+    if( ladder->variants.isEmpty() )
+    {
+        mErrorString = "Нет вариантов с сегментами: нужен анализ с keepSegments";
+        return false;
+    }
+    std::stable_sort(ladder->variants.begin(), ladder->variants.end(), [](const LadderVariant &left, const LadderVariant &right)
+    {
+        return left.bandwidth < right.bandwidth;
+    });
+
+    mOnReport = onReport;
+    mTotal = LoadReport();
+    mTotal.clientsPerVariant.fill(0, ladder->variants.size());
+    mTotalLatency.clear();
+
+    const int clients = qMax(1, mOptions.clients);
+    const int threads = qBound(1, mOptions.threads, clients);
+    QVector<QVector<int>> delays(threads);
+    for( int i = 0; i < clients; ++i )
+    {
+        delays[i % threads].append(int(qint64(mOptions.rampUpMs) * i / clients));
+    }
+
+    for( int i = 0; i < threads; ++i )
+    {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("load-%1").arg(i));
+        LoadWorker *worker = new LoadWorker(ladder, mOptions);
+        worker->moveToThread(thread);
+        thread->start();
+        QVector<int> workerDelays = delays.at(i);
+        QMetaObject::invokeMethod(worker, [worker, workerDelays]()
+        {
+            worker->addClients(workerDelays);
+        });
+        mThreads.append(thread);
+        mWorkers.append(worker);
+    }
+
+    mClock.start();
+    mLastReportMs = 0;
+    mReportTimer->start();
+    if( mOptions.durationMs > 0 )
+    {
+        QTimer::singleShot(mOptions.durationMs, this, [this]()
+        {
+            if( mWorkers.isEmpty() )
+                return;
+            stop();
+            emit finished();
+        });
+    }
+    return true;
+}
+
+void LoadTest::stop()
+{
+    if( mWorkers.isEmpty() )
+        return;
+
+    /// последний неполный интервал тоже в отчёт
+    onReportTimer();
+    mReportTimer->stop();
+    mTotal.elapsedMs = mClock.elapsed();
+
+    foreach(LoadWorker *worker, mWorkers)
+    {
+        QMetaObject::invokeMethod(worker, [worker]()
+        {
+            delete worker;
+        }, Qt::BlockingQueuedConnection);
+    }
+    mWorkers.clear();
+    foreach(QThread *thread, mThreads)
+    {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    mThreads.clear();
+}
+
+LoadReport LoadTest::total() const
+{
+    LoadReport total = mTotal;
+    if( !mWorkers.isEmpty() )
+        total.elapsedMs = mClock.elapsed();
+    if( total.elapsedMs > 0 )
+        total.throughput = total.bytes * 8 * 1000 / quint64(total.elapsedMs);
+    total.ttfbP50 = mTotalLatency.percentile(50);
+    total.ttfbP90 = mTotalLatency.percentile(90);
+    total.ttfbP99 = mTotalLatency.percentile(99);
+    return total;
+}
+
+QString LoadTest::errorString() const
+{
+    return mErrorString;
+}
+
+void LoadTest::onReportTimer()
+{
+    LoadReport report;
+    report.elapsedMs = mClock.elapsed();
+    report.clientsPerVariant.fill(0, mTotal.clientsPerVariant.size());
+
+    LatencyHistogram latency;
+    foreach(LoadWorker *worker, mWorkers)
+    {
+        LoadStats stats;
+        QMetaObject::invokeMethod(worker, [worker, &stats]()
+        {
+            stats = worker->takeStats();
+        }, Qt::BlockingQueuedConnection);
+
+        report.activeClients += stats.activeClients;
+        report.requests += stats.requests;
+        report.errors += stats.errors;
+        report.bytes += stats.bytes;
+        report.switches += stats.switches;
+        report.rebuffers += stats.rebuffers;
+        latency.merge(stats.latency);
+        for( int i = 0; i < stats.clientsPerVariant.size() && i < report.clientsPerVariant.size(); ++i )
+        {
+            report.clientsPerVariant[i] += stats.clientsPerVariant.at(i);
+        }
+    }
+
+    qint64 intervalMs = qMax<qint64>(1, report.elapsedMs - mLastReportMs);
+    mLastReportMs = report.elapsedMs;
+    report.throughput = report.bytes * 8 * 1000 / quint64(intervalMs);
+    report.ttfbP50 = latency.percentile(50);
+    report.ttfbP90 = latency.percentile(90);
+    report.ttfbP99 = latency.percentile(99);
+
+    mTotal.activeClients = report.activeClients;
+    mTotal.requests += report.requests;
+    mTotal.errors += report.errors;
+    mTotal.bytes += report.bytes;
+    mTotal.switches += report.switches;
+    mTotal.rebuffers += report.rebuffers;
+    mTotal.clientsPerVariant = report.clientsPerVariant;
+    mTotalLatency.merge(latency);
+
+    if( mOnReport )
+        mOnReport(report);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QObject>
+
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <functional>
+
+#include "hlsanalyzer.h"
+#include "latencyhistogram.h"
+
+class LoadWorker;
+class QThread;
+class QTimer;
+
+struct LoadOptions
+{
+    int clients = 100;
+    /// потоков с циклами событий, клиенты распределяются по ним поровну
+    int threads = 4;
+    int durationMs = 60000;         // 0 - пока не остановят
+    /// клиенты подключаются равномерно за это время
+    int rampUpMs = 10000;
+    int reportIntervalMs = 1000;
+    /// плеер качает следующий сегмент, пока буфер меньше этого
+    int bufferMs = 30000;
+    int requestTimeoutMs = 10000;
+    /// вариант выбирается по такой доле оценки пропускной способности
+    qreal safety = 0.8;
+};
+
+/// Итоги нагрузки за интервал или за весь прогон
+struct LoadReport
+{
+    qint64 elapsedMs = 0;
+    int activeClients = 0;
+    quint64 requests = 0;
+    quint64 errors = 0;             // ошибки соединения, таймауты, ответы 4xx/5xx и 3xx без перехода
+    quint64 bytes = 0;
+    quint64 throughput = 0;         //in bits per second
+    qreal ttfbP50 = 0;              //in milliseconds
+    qreal ttfbP90 = 0;
+    qreal ttfbP99 = 0;
+    quint64 switches = 0;           // смены варианта по ABR
+    quint64 rebuffers = 0;          // буфер плеера опустел
+    /// сколько клиентов сейчас смотрят каждый вариант, по возрастанию битрейта
+    QVector<int> clientsPerVariant;
+};
+
+/// Нагрузочный тест origin: clients имитированных плееров смотрят
+/// проанализированный поток. Лесенка вариантов и сегменты берутся из
+/// AnalysisResult (нужен AnalysisOptions::keepSegments). Каждый плеер
+/// держит одно соединение HTTP/1.1, запрашивает мастер- и медиа-плейлисты,
+/// затем сегменты видео и аудио, пока буфер не заполнится, и дальше в
+/// темпе воспроизведения; после сегмента выбирает вариант по оценке
+/// пропускной способности. Все плееры живут на нескольких потоках с
+/// циклами событий, их сроки - на колесе таймеров каждого потока.
+/// Каждые reportIntervalMs в onReport приходит LoadReport за интервал.
+class LoadTest : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(const LoadReport &)> ReportCallback;
+
+    LoadTest(const AnalysisResult &result, const LoadOptions &options, QObject *parent = nullptr);
+    ~LoadTest();
+
+    /// false - в результате нет ни одного варианта с сегментами
+    bool start(const ReportCallback &onReport);
+    void stop();
+
+    /// итог всего прогона
+    LoadReport total() const;
+    QString errorString() const;
+
+signals:
+    void finished();
+
+private:
+    void onReportTimer();
+
+private:
+    AnalysisResult mResult;
+    LoadOptions mOptions;
+    ReportCallback mOnReport;
+    QString mErrorString;
+
+    QVector<QThread *> mThreads;
+    QVector<LoadWorker *> mWorkers;
+    QTimer *mReportTimer;
+    QElapsedTimer mClock;
+    qint64 mLastReportMs;
+
+    LoadReport mTotal;
+    LatencyHistogram mTotalLatency;
+};
@@ -0,0 +1,91 @@
+#include "localfiles.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QUrl>
+
+#include <climits>
+
+MappedFile::MappedFile(const QString &path)
+    : mFile(path)
+    , mData(nullptr)
+    , mSize(0)
+{
+    if( !mFile.open(QIODevice::ReadOnly) )
+        return;
+
+    mSize = mFile.size();
+    if( mSize > 0 )
+    {
+        mData = mFile.map(0, mSize);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if( mData )
+    {
+        mFile.unmap(mData);
+    }
+}
+
+bool MappedFile::isOpen() const
+{
+    return mFile.isOpen() && (mData || mSize == 0);
+}
+
+QByteArray MappedFile::data() const
+{
+    if( !mData )
+        return QByteArray();
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(mData), int(qMin<qint64>(mSize, INT_MAX)));
+}
+
+QString MappedFile::errorString() const
+{
+    return mFile.errorString();
+}
+
+bool LocalFiles::isLocal(const QString &url)
+{
+    if( url.startsWith("file:", Qt::CaseInsensitive) )
+        return true;
+    if( url.contains("://") )
+        return false;
+    return QFileInfo::exists(url);
+}
+
+QString LocalFiles::toLocalPath(const QString &url)
+{
+    if( url.startsWith("file:", Qt::CaseInsensitive) )
+        return QUrl(url).toLocalFile();
+    return QFileInfo(url).absoluteFilePath();
+}
+
+QStringList LocalFiles::expand(const QString &url)
+{
+    if( !isLocal(url) )
+        return QStringList() << url;
+
+    QString path = toLocalPath(url);
+    if( QFileInfo(path).isDir() )
+        return findMasterPlaylists(path);
+    return QStringList() << path;
+}
+
+QStringList LocalFiles::findMasterPlaylists(const QString &directory)
+{
+    QStringList masters;
+    QDirIterator it(directory, QStringList() << "*.m3u8", QDir::Files, QDirIterator::Subdirectories);
+    while( it.hasNext() )
+    {
+        QString path = it.next();
+        MappedFile file(path);
+        if( file.isOpen() && file.data().contains("#EXT-X-STREAM-INF") )
+        {
+            masters.append(path);
+        }
+    }
+    masters.sort();
+    return masters;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QStringList>
+
+/// Файл, отображённый в память только для чтения
+class MappedFile
+{
+public:
+    explicit MappedFile(const QString &path);
+    ~MappedFile();
+
+    bool isOpen() const;
+    /// данные без копирования; действительны, пока жив объект
+    QByteArray data() const;
+    QString errorString() const;
+
+private:
+    Q_DISABLE_COPY(MappedFile)
+
+    QFile mFile;
+    uchar *mData;
+    qint64 mSize;
+};
+
+/// Работа с результатом упаковки на локальном диске: file:// URL и
+/// обычные пути к файлам и каталогам
+class LocalFiles
+{
+public:
+    static bool isLocal(const QString &url);
+    static QString toLocalPath(const QString &url);
+
+    /// мастер-плейлисты для анализа: сам url, либо все мастер-плейлисты
+    /// в дереве каталога, если url указывает на каталог
+    static QStringList expand(const QString &url);
+    static QStringList findMasterPlaylists(const QString &directory);
+};
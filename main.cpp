@@ -1,9 +1,413 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
 
+#include <csignal>
+#include <cstring>
+
+#include "batchrunner.h"
+#include "loadtest.h"
+#include "monitordaemon.h"
+#include "playlistcache.h"
 #include "mainwindow.h"
+#include "snapshotreport.h"
+
+const int SIGNAL_POLL_INTERVAL = 100; //in milliseconds
+
+/// обработчик сигнала только ставит флаг - звать Qt из него нельзя
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void onStopSignal(int signal)
+{
+    Q_UNUSED(signal)
+    stopRequested = 1;
+}
+
+static bool hasOption(int argc, char *argv[], const char *option)
+{
+    for( int i = 1; i < argc; ++i )
+    {
+        if( !std::strncmp(argv[i], option, std::strlen(option)) )
+            return true;
+    }
+    return false;
+}
+
+static int runBatch(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Пакетный анализ HLS-потоков");
+    parser.addHelpOption();
+    QCommandLineOption batchOption("batch", "Файл со списком мастер-URL, по одному на строку (\"-\" - stdin).", "file");
+    QCommandLineOption concurrencyOption("concurrency", "Количество одновременно анализируемых потоков.", "n", "16");
+    QCommandLineOption maxPerHostOption("max-per-host", "Максимум одновременных запросов к одному хосту (HTTP/1.1).", "n", "6");
+    QCommandLineOption cacheDirOption("cache-dir", "Каталог дискового кэша плейлистов.", "dir", PlaylistCache::defaultDirectory());
+    QCommandLineOption cacheSizeOption("cache-size", "Максимальный размер дискового кэша в мегабайтах.", "mb", "512");
+    QCommandLineOption noCacheOption("no-cache", "Не использовать дисковый кэш.");
+    QCommandLineOption metricsOption("metrics", "Файл для замеров сетевых запросов.", "file");
+    QCommandLineOption metricsFormatOption("metrics-format", "Формат замеров: json или prometheus.", "format", "json");
+    QCommandLineOption formatOption("format", "Формат вывода: json или csv.", "format", "json");
+    QCommandLineOption deviationOption("deviation", "Допустимое отклонение битрейта в процентах.", "percent", "10");
+    QCommandLineOption probeRateOption("probe-rate", "HEAD-запросов в секунду к одному хосту для размеров сегментов без EXT-X-BITRATE (0 - не запрашивать).", "n", "0");
+    QCommandLineOption deepProbeOption("deep-probe", "Разбирать каждый N-й сегмент MPEG-TS и сверять кодеки и частоту кадров (0 - не скачивать сегменты).", "n", "0");
+    QCommandLineOption retriesOption("retries", "Повторов запроса после сетевой ошибки, 5xx или 429.", "n", "2");
+    QCommandLineOption requestTimeoutOption("request-timeout", "Запрос обрывается, если столько секунд не пришло ни байта (0 - без ограничения).", "seconds", "15");
+    QCommandLineOption timeoutOption("timeout", "Срок анализа одного потока в секундах; по истечении выводится неполный результат (0 - без ограничения).", "seconds", "0");
+    QCommandLineOption liveOption("live", "Наблюдать за живыми потоками столько секунд и выводить каждую перезагрузку медиа-плейлистов (0 - пока не остановят).", "seconds");
+    QCommandLineOption peakWindowOption("peak-window", "Окно проверки пикового битрейта в секундах.", "seconds", "10");
+    QCommandLineOption snapshotDirOption("snapshot-dir", "Каталог для двоичных снимков результатов, см. --diff и --history.", "dir");
+    parser.addOption(batchOption);
+    parser.addOption(concurrencyOption);
+    parser.addOption(maxPerHostOption);
+    parser.addOption(cacheDirOption);
+    parser.addOption(cacheSizeOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(metricsOption);
+    parser.addOption(metricsFormatOption);
+    parser.addOption(formatOption);
+    parser.addOption(deviationOption);
+    parser.addOption(peakWindowOption);
+    parser.addOption(probeRateOption);
+    parser.addOption(deepProbeOption);
+    parser.addOption(retriesOption);
+    parser.addOption(requestTimeoutOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(liveOption);
+    parser.addOption(snapshotDirOption);
+    parser.process(app);
+
+    QFile input;
+    QString fileName = parser.value(batchOption);
+    bool opened;
+    if( fileName == "-" )
+    {
+        opened = input.open(stdin, QIODevice::ReadOnly);
+    }
+    else
+    {
+        input.setFileName(fileName);
+        opened = input.open(QIODevice::ReadOnly);
+    }
+    if( !opened )
+    {
+        qCritical() << "Не удалось открыть" << fileName;
+        return 1;
+    }
+
+    QStringList urls;
+    while( !input.atEnd() )
+    {
+        QString line = QString::fromUtf8(input.readLine()).trimmed();
+        if( !line.isEmpty() && !line.startsWith('#') )
+            urls.append(line);
+    }
+
+    BatchRunner runner;
+    runner.setConcurrency(parser.value(concurrencyOption).toInt());
+    runner.setMaxPerHost(parser.value(maxPerHostOption).toInt());
+    runner.setRetries(parser.value(retriesOption).toInt());
+    runner.setRequestTimeout(int(parser.value(requestTimeoutOption).toDouble() * 1000));
+    if( !parser.isSet(noCacheOption) )
+    {
+        runner.enableCache(parser.value(cacheDirOption), parser.value(cacheSizeOption).toLongLong() * 1024 * 1024);
+    }
+    runner.setFormat(parser.value(formatOption) == "csv" ? BatchRunner::Csv : BatchRunner::Json);
+    runner.setDeviation(parser.value(deviationOption).toDouble());
+    runner.setPeakWindow(quint32(parser.value(peakWindowOption).toDouble() * 1000));
+    runner.setProbeRate(parser.value(probeRateOption).toInt());
+    runner.setDeepProbe(parser.value(deepProbeOption).toInt());
+    runner.setDeadline(int(parser.value(timeoutOption).toDouble() * 1000));
+    if( parser.isSet(liveOption) )
+    {
+        runner.setLive(int(parser.value(liveOption).toDouble() * 1000));
+    }
+    if( parser.isSet(snapshotDirOption) )
+    {
+        runner.setSnapshotDirectory(parser.value(snapshotDirOption));
+    }
+    runner.addUrls(urls);
+    QObject::connect(&runner, &BatchRunner::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+    runner.start();
+
+    int code = app.exec();
+    qInfo() << "Проанализировано:" << runner.succeeded() << "ошибок:" << runner.failed();
+    qInfo().noquote() << "Запросы:" << runner.statisticsString();
+
+    if( parser.isSet(metricsOption) )
+    {
+        QFile metrics(parser.value(metricsOption));
+        if( !metrics.open(QIODevice::WriteOnly) )
+        {
+            qCritical() << "Не удалось открыть" << metrics.fileName();
+            return 1;
+        }
+        metrics.write(runner.metrics(parser.value(metricsFormatOption) == "prometheus"));
+    }
+    return code == 0 && runner.failed() == 0 ? 0 : 2;
+}
+
+static int runDaemon(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Наблюдение за каталогом HLS-потоков");
+    parser.addHelpOption();
+    QCommandLineOption daemonOption("daemon", "Файл заданий: строки \"<url> [период в секундах]\"; перечитывается при изменении.", "file");
+    QCommandLineOption stateOption("state", "Файл состояния: время и история проверок переживают перезапуск.", "file");
+    QCommandLineOption intervalOption("interval", "Период проверки по умолчанию в секундах.", "seconds", "3600");
+    QCommandLineOption historyOption("history", "Сколько последних проверок хранить для каждого потока.", "n", "64");
+    QCommandLineOption concurrencyOption("concurrency", "Количество одновременно анализируемых потоков.", "n", "16");
+    QCommandLineOption maxPerHostOption("max-per-host", "Максимум одновременных запросов к одному хосту (HTTP/1.1).", "n", "6");
+    QCommandLineOption cacheDirOption("cache-dir", "Каталог дискового кэша плейлистов.", "dir", PlaylistCache::defaultDirectory());
+    QCommandLineOption cacheSizeOption("cache-size", "Максимальный размер дискового кэша в мегабайтах.", "mb", "512");
+    QCommandLineOption noCacheOption("no-cache", "Не использовать дисковый кэш.");
+    QCommandLineOption metricsOption("metrics", "Файл для замеров сетевых запросов, обновляется при сохранении состояния.", "file");
+    QCommandLineOption metricsFormatOption("metrics-format", "Формат замеров: json или prometheus.", "format", "json");
+    QCommandLineOption deviationOption("deviation", "Допустимое отклонение битрейта в процентах.", "percent", "10");
+    QCommandLineOption peakWindowOption("peak-window", "Окно проверки пикового битрейта в секундах.", "seconds", "10");
+    QCommandLineOption probeRateOption("probe-rate", "HEAD-запросов в секунду к одному хосту для размеров сегментов без EXT-X-BITRATE (0 - не запрашивать).", "n", "0");
+    QCommandLineOption retriesOption("retries", "Повторов запроса после сетевой ошибки, 5xx или 429.", "n", "2");
+    QCommandLineOption requestTimeoutOption("request-timeout", "Запрос обрывается, если столько секунд не пришло ни байта (0 - без ограничения).", "seconds", "15");
+    QCommandLineOption timeoutOption("timeout", "Срок анализа одного потока в секундах (0 - без ограничения).", "seconds", "300");
+    parser.addOption(daemonOption);
+    parser.addOption(stateOption);
+    parser.addOption(intervalOption);
+    parser.addOption(historyOption);
+    parser.addOption(concurrencyOption);
+    parser.addOption(maxPerHostOption);
+    parser.addOption(cacheDirOption);
+    parser.addOption(cacheSizeOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(metricsOption);
+    parser.addOption(metricsFormatOption);
+    parser.addOption(deviationOption);
+    parser.addOption(peakWindowOption);
+    parser.addOption(probeRateOption);
+    parser.addOption(retriesOption);
+    parser.addOption(requestTimeoutOption);
+    parser.addOption(timeoutOption);
+    parser.process(app);
+
+    MonitorDaemon daemon;
+    daemon.setJobsFile(parser.value(daemonOption));
+    daemon.setStateFile(parser.value(stateOption));
+    daemon.setInterval(parser.value(intervalOption).toInt());
+    daemon.setHistory(parser.value(historyOption).toInt());
+    daemon.setConcurrency(parser.value(concurrencyOption).toInt());
+    daemon.setMaxPerHost(parser.value(maxPerHostOption).toInt());
+    daemon.setRetries(parser.value(retriesOption).toInt());
+    daemon.setRequestTimeout(int(parser.value(requestTimeoutOption).toDouble() * 1000));
+    if( !parser.isSet(noCacheOption) )
+    {
+        daemon.enableCache(parser.value(cacheDirOption), parser.value(cacheSizeOption).toLongLong() * 1024 * 1024);
+    }
+    if( parser.isSet(metricsOption) )
+    {
+        daemon.setMetricsFile(parser.value(metricsOption), parser.value(metricsFormatOption) == "prometheus");
+    }
+    daemon.setDeviation(parser.value(deviationOption).toDouble());
+    daemon.setPeakWindow(quint32(parser.value(peakWindowOption).toDouble() * 1000));
+    daemon.setProbeRate(parser.value(probeRateOption).toInt());
+    daemon.setDeadline(int(parser.value(timeoutOption).toDouble() * 1000));
+    if( !daemon.start() )
+    {
+        return 1;
+    }
+    return app.exec();
+}
+
+static int runSnapshots(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Сравнение снимков анализа HLS-потоков");
+    parser.addHelpOption();
+    QCommandLineOption diffOption("diff", "Сравнить два прогона: файлы снимков или мастер-URL, которые анализируются сейчас.");
+    QCommandLineOption historyOption("history", "Изменения по всем снимкам каталога, поток за потоком.", "dir");
+    QCommandLineOption thresholdOption("threshold", "Сдвиг битрейта рендишена в процентах, который считается изменением.", "percent", "5");
+    QCommandLineOption probeRateOption("probe-rate", "HEAD-запросов в секунду к одному хосту для размеров сегментов без EXT-X-BITRATE (0 - не запрашивать).", "n", "0");
+    QCommandLineOption timeoutOption("timeout", "Срок анализа потока в секундах (0 - без ограничения).", "seconds", "300");
+    parser.addOption(diffOption);
+    parser.addOption(historyOption);
+    parser.addOption(thresholdOption);
+    parser.addOption(probeRateOption);
+    parser.addOption(timeoutOption);
+    parser.addPositionalArgument("before", "Снимок или мастер-URL до изменений (для --diff).");
+    parser.addPositionalArgument("after", "Снимок или мастер-URL после изменений (для --diff).");
+    parser.process(app);
+
+    AnalysisOptions options;
+    options.probeRate = parser.value(probeRateOption).toInt();
+    options.deadlineMs = int(parser.value(timeoutOption).toDouble() * 1000);
+
+    SnapshotReport report;
+    report.setThreshold(parser.value(thresholdOption).toDouble());
+    report.setAnalysisOptions(options);
+
+    bool ok;
+    if( parser.isSet(historyOption) )
+    {
+        ok = report.history(parser.value(historyOption));
+    }
+    else
+    {
+        QStringList sources = parser.positionalArguments();
+        if( sources.size() != 2 )
+        {
+            parser.showHelp(1);
+        }
+        ok = report.diff(sources.at(0), sources.at(1));
+    }
+    if( !ok )
+    {
+        return 1;
+    }
+    qInfo() << "Изменений:" << report.changeCount();
+    return report.changeCount() == 0 ? 0 : 2;
+}
+
+static QByteArray loadReportJson(const LoadReport &report, bool total)
+{
+    QJsonObject object;
+    if( total )
+        object["total"] = true;
+    object["elapsed"] = report.elapsedMs / 1000.0;
+    object["clients"] = report.activeClients;
+    object["requests"] = double(report.requests);
+    object["errors"] = double(report.errors);
+    object["errorRate"] = report.requests ? double(report.errors) / report.requests : 0.0;
+    object["bytes"] = double(report.bytes);
+    object["throughput"] = double(report.throughput);
+    object["ttfbP50"] = report.ttfbP50;
+    object["ttfbP90"] = report.ttfbP90;
+    object["ttfbP99"] = report.ttfbP99;
+    object["switches"] = double(report.switches);
+    object["rebuffers"] = double(report.rebuffers);
+    QJsonArray variants;
+    foreach(int clients, report.clientsPerVariant)
+    {
+        variants.append(clients);
+    }
+    object["clientsPerVariant"] = variants;
+    return QJsonDocument(object).toJson(QJsonDocument::Compact) + "\n";
+}
+
+static int runLoadTest(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Нагрузочный тест origin имитированными плеерами");
+    parser.addHelpOption();
+    QCommandLineOption loadOption("load", "Мастер-URL: поток анализируется, затем его смотрят имитированные плееры.", "url");
+    QCommandLineOption clientsOption("clients", "Количество одновременных плееров.", "n", "100");
+    QCommandLineOption threadsOption("threads", "Потоков с циклами событий для плееров.", "n", "4");
+    QCommandLineOption durationOption("duration", "Длительность теста в секундах (0 - пока не остановят).", "seconds", "60");
+    QCommandLineOption rampUpOption("ramp-up", "За сколько секунд подключаются все плееры.", "seconds", "10");
+    QCommandLineOption reportIntervalOption("report-interval", "Период строк отчёта в секундах.", "seconds", "1");
+    QCommandLineOption bufferOption("buffer", "Буфер плеера в секундах.", "seconds", "30");
+    QCommandLineOption requestTimeoutOption("request-timeout", "Срок запроса плеера в секундах.", "seconds", "10");
+    QCommandLineOption probeRateOption("probe-rate", "HEAD-запросов в секунду к одному хосту для размеров сегментов без EXT-X-BITRATE (0 - не запрашивать).", "n", "0");
+    QCommandLineOption timeoutOption("timeout", "Срок анализа потока в секундах (0 - без ограничения).", "seconds", "300");
+    parser.addOption(loadOption);
+    parser.addOption(clientsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(durationOption);
+    parser.addOption(rampUpOption);
+    parser.addOption(reportIntervalOption);
+    parser.addOption(bufferOption);
+    parser.addOption(requestTimeoutOption);
+    parser.addOption(probeRateOption);
+    parser.addOption(timeoutOption);
+    parser.process(app);
+
+    AnalysisOptions analysisOptions;
+    analysisOptions.keepSegments = true;
+    analysisOptions.probeRate = parser.value(probeRateOption).toInt();
+    analysisOptions.deadlineMs = int(parser.value(timeoutOption).toDouble() * 1000);
+
+    AnalysisResult result;
+    {
+        HlsAnalyzer analyzer;
+        result = analyzer.analyze(parser.value(loadOption), analysisOptions).result();
+    }
+    if( !result.errorString.isEmpty() )
+    {
+        qCritical() << "Не удалось проанализировать поток:" << result.errorString;
+        return 1;
+    }
+
+    LoadOptions options;
+    options.clients = parser.value(clientsOption).toInt();
+    options.threads = parser.value(threadsOption).toInt();
+    options.durationMs = int(parser.value(durationOption).toDouble() * 1000);
+    options.rampUpMs = int(parser.value(rampUpOption).toDouble() * 1000);
+    options.reportIntervalMs = int(parser.value(reportIntervalOption).toDouble() * 1000);
+    options.bufferMs = int(parser.value(bufferOption).toDouble() * 1000);
+    options.requestTimeoutMs = int(parser.value(requestTimeoutOption).toDouble() * 1000);
+
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+
+    LoadTest test(result, options);
+    QObject::connect(&test, &LoadTest::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+    bool started = test.start([&out](const LoadReport &report)
+    {
+        out.write(loadReportJson(report, false));
+        out.flush();
+    });
+    if( !started )
+    {
+        qCritical() << test.errorString();
+        return 1;
+    }
+
+    /// Ctrl+C и SIGTERM останавливают тест штатно: с итоговой строкой и кодом возврата
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    QTimer stopTimer;
+    QObject::connect(&stopTimer, &QTimer::timeout, &app, [&app]()
+    {
+        if( stopRequested )
+            app.quit();
+    });
+    stopTimer.start(SIGNAL_POLL_INTERVAL);
+
+    app.exec();
+    test.stop();
+    LoadReport total = test.total();
+    out.write(loadReportJson(total, true));
+    return total.errors == 0 ? 0 : 2;
+}
 
 int main(int argc, char *argv[])
 {
+    if( hasOption(argc, argv, "--daemon") )
+    {
+        return runDaemon(argc, argv);
+    }
+    if( hasOption(argc, argv, "--batch") )
+    {
+        return runBatch(argc, argv);
+    }
+    if( hasOption(argc, argv, "--diff") || hasOption(argc, argv, "--history") )
+    {
+        return runSnapshots(argc, argv);
+    }
+    if( hasOption(argc, argv, "--load") )
+    {
+        return runLoadTest(argc, argv);
+    }
+
     Q_INIT_RESOURCE(HLS);
 
     QApplication app(argc, argv);
@@ -12,6 +416,10 @@ int main(int argc, char *argv[])
     MainWindow window;
     window.setMinimumSize(1400, 700);
     window.setWindowTitle("Утилита HLS");
+    if( app.arguments().size() > 1 )
+    {
+        window.setUrl(app.arguments().at(1));
+    }
     window.showMaximized();
     return app.exec();
 }
@@ -1,8 +1,13 @@
 #include "mainwindow.h"
 
+#include <QCheckBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QHBoxLayout>
 #include <QHeaderView>
 #include <QLineEdit>
 #include <QMessageBox>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QSplitter>
 #include <QStatusBar>
@@ -10,7 +15,9 @@
 #include <QVBoxLayout>
 
 #include "backend.h"
-#include "utils.h"
+#include "tablemodels.h"
+
+const int DEEP_PROBE_INTERVAL = 10;
 
 class MainWindow::Impl : public QObject
 {
@@ -21,7 +28,14 @@ public:
 
     QLineEdit *mUrlLineEdit;
     QLineEdit *mBitratePercentEdit;
+    QLineEdit *mLogFilterEdit;
+    QCheckBox *mDeepProbeCheckBox;
     QPushButton *mAnalyseButton;
+    QPushButton *mMetricsButton;
+    QProgressBar *mProgressBar;
+    ColumnarProxyModel *mAudioProxy;
+    ColumnarProxyModel *mVideoProxy;
+    ColumnarProxyModel *mLogProxy;
     QTableView *mAudioView;
     QTableView *mVideoView;
     QTableView *mLogView;
@@ -29,10 +43,14 @@ public:
     Impl(MainWindow *parent)
         : mParent(parent)
         , mBackend(new Backend(parent))
+        , mAudioProxy(new ColumnarProxyModel(mBackend->audioModel(), parent))
+        , mVideoProxy(new ColumnarProxyModel(mBackend->videoModel(), parent))
+        , mLogProxy(new ColumnarProxyModel(mBackend->logModel(), parent))
     {
         mParent->statusBar();
 
         connect(mBackend, &Backend::analysisFinished, this, &Impl::onAnalysisFinished);
+        connect(mBackend, &Backend::progressChanged, this, &Impl::onProgressChanged);
         connect(mBackend, &Backend::error, this, &Impl::onErrorOccured);
 
         createWidgets();
@@ -50,8 +68,23 @@ public:
         mAnalyseButton = new QPushButton("Анализировать", mParent);
         connect(mAnalyseButton, &QPushButton::clicked, this, &Impl::onAnalyseButtonClicked);
 
+        mDeepProbeCheckBox = new QCheckBox("Проверять сегменты", mParent);
+        mDeepProbeCheckBox->setToolTip(QString("Скачивать каждый %1-й сегмент и сверять кодеки и частоту кадров").arg(DEEP_PROBE_INTERVAL));
+
+        mMetricsButton = new QPushButton("Сохранить замеры...", mParent);
+        connect(mMetricsButton, &QPushButton::clicked, this, &Impl::onMetricsButtonClicked);
+
+        /// число медиа-плейлистов известно только после мастер-плейлиста - до того бар "бегущий"
+        mProgressBar = new QProgressBar(mParent);
+        mProgressBar->setRange(0, 0);
+        mProgressBar->setMaximumWidth(200);
+        mProgressBar->setFormat("%v из %m");
+        mProgressBar->hide();
+        mParent->statusBar()->addPermanentWidget(mProgressBar);
+
         mAudioView = new QTableView(mParent);
-        mAudioView->setModel(mBackend->audioModel());
+        mAudioView->setModel(mAudioProxy);
+        mAudioView->setSortingEnabled(true);
         mAudioView->resizeColumnsToContents();
         mAudioView->horizontalHeader()->setStretchLastSection(true);
         mAudioView->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -60,7 +93,8 @@ public:
         mAudioView->setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
 
         mVideoView = new QTableView(mParent);
-        mVideoView->setModel(mBackend->videoModel());
+        mVideoView->setModel(mVideoProxy);
+        mVideoView->setSortingEnabled(true);
         mVideoView->resizeColumnsToContents();
         mVideoView->horizontalHeader()->setStretchLastSection(true);
         mVideoView->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -69,7 +103,7 @@ public:
         mVideoView->setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
 
         mLogView = new QTableView(mParent);
-        mLogView->setModel(mBackend->logModel());
+        mLogView->setModel(mLogProxy);
         mLogView->horizontalHeader()->setStretchLastSection(true);
         mLogView->setEditTriggers(QAbstractItemView::NoEditTriggers);
         mLogView->setSelectionBehavior(QAbstractItemView::SelectRows);
@@ -77,6 +111,10 @@ public:
         mLogView->setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
         connect(mLogView->selectionModel(), &QItemSelectionModel::selectionChanged, this, &Impl::onLogSelectionChanged);
 
+        mLogFilterEdit = new QLineEdit(mParent);
+        mLogFilterEdit->setPlaceholderText("Фильтр сообщений");
+        connect(mLogFilterEdit, &QLineEdit::textChanged, mLogProxy, &ColumnarProxyModel::setPattern);
+
         QSplitter *splitter = new QSplitter(Qt::Vertical, mParent);
         splitter->addWidget(mVideoView);
         splitter->addWidget(mAudioView);       
@@ -88,11 +126,17 @@ public:
         layout->addWidget(splitter);
         layout->addWidget(mUrlLineEdit);
         layout->addWidget(mBitratePercentEdit);
-        layout->addWidget(mAnalyseButton, 0, Qt::AlignRight);
+        QHBoxLayout *buttonsLayout = new QHBoxLayout();
+        buttonsLayout->addWidget(mDeepProbeCheckBox);
+        buttonsLayout->addStretch();
+        buttonsLayout->addWidget(mMetricsButton);
+        buttonsLayout->addWidget(mAnalyseButton);
+        layout->addLayout(buttonsLayout);
 
         QVBoxLayout *logLayout = new QVBoxLayout();
         logLayout->setSpacing(10);
         logLayout->setMargin(10);
+        logLayout->addWidget(mLogFilterEdit);
         logLayout->addWidget(mLogView);
 
         QWidget *widget1 = new QWidget();
@@ -124,13 +168,34 @@ public:
         {
             mBackend->setDeviation(10);
         }
+        mBackend->setDeepProbe(mDeepProbeCheckBox->isChecked() ? DEEP_PROBE_INTERVAL : 0);
 
         mBackend->reset();
 
         mParent->statusBar()->showMessage("Ждите...");
+        mProgressBar->setRange(0, 0);
+        mProgressBar->show();
         mBackend->parseUrl(mUrlLineEdit->text());
     }
 
+    void onMetricsButtonClicked()
+    {
+        QString selectedFilter;
+        QString fileName = QFileDialog::getSaveFileName(mParent, "Сохранить замеры", QString(),
+                                                        "JSON (*.json);;Prometheus (*.prom)", &selectedFilter);
+        if( fileName.isEmpty() )
+            return;
+
+        QFile file(fileName);
+        if( !file.open(QIODevice::WriteOnly) )
+        {
+            QMessageBox::warning(mParent, "Ошибка!", "Не удалось открыть файл " + fileName);
+            return;
+        }
+        bool prometheus = selectedFilter.startsWith("Prometheus") || fileName.endsWith(".prom");
+        file.write(prometheus ? mBackend->timings().toPrometheus() : mBackend->timings().toJson());
+    }
+
     void onLogSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected)
     {
         Q_UNUSED(deselected)
@@ -140,18 +205,24 @@ public:
 
         if( !selected.isEmpty() )
         {
-            int row = selected.indexes().first().row();
-            QModelIndex index = mBackend->logModel()->index(row, 0);
-            QString error = index.data().toString();
+            QModelIndex index = selected.indexes().first();
+            int video = index.data(LogTableModel::VideoRowRole).toInt();
+            int audio = index.data(LogTableModel::AudioRowRole).toInt();
 
-            auto pair = Utils::getStreamNumbers(error);
-            mVideoView->selectRow(pair.first - 1);
-            mAudioView->selectRow(pair.second - 1);
+            mVideoView->selectRow(mVideoProxy->proxyRow(video - 1));
+            mAudioView->selectRow(mAudioProxy->proxyRow(audio - 1));
         }
     }
 
+    void onProgressChanged(int done, int total)
+    {
+        mProgressBar->setRange(0, total);
+        mProgressBar->setValue(done);
+    }
+
     void onAnalysisFinished()
     {
+        mProgressBar->hide();
         mParent->statusBar()->clearMessage();
         mAudioView->resizeColumnsToContents();
         mVideoView->resizeColumnsToContents();
@@ -159,6 +230,7 @@ public:
 
     void onErrorOccured(const QString &error)
     {
+        mProgressBar->hide();
         mParent->statusBar()->showMessage("Ошибка!");
         QMessageBox::warning(mParent, "Ошибка!", error);
         mParent->statusBar()->clearMessage();
@@ -171,3 +243,8 @@ MainWindow::MainWindow(QWidget *parent)
 {
 
 }
+
+void MainWindow::setUrl(const QString &url)
+{
+    _impl->mUrlLineEdit->setText(url);
+}
@@ -8,6 +8,9 @@ class MainWindow : public QMainWindow
 public:
     explicit MainWindow(QWidget *parent = nullptr);
 
+    /// URL в строке ввода, например адрес тестового origin
+    void setUrl(const QString &url);
+
 private:
     class Impl;
     Impl *_impl;
@@ -0,0 +1,161 @@
+#include "masterplaylistparser.h"
+
+#include "attributelist.h"
+#include "utils.h"
+
+MasterPlaylistParser::MasterPlaylistParser()
+    : mIsMaster(false)
+{
+}
+
+bool MasterPlaylistParser::parse(const QByteArray &data, const QUrl &base)
+{
+    clear();
+
+    int pos = 0;
+    if( !Utils::isHLS(Utils::nextLine(data, pos)) )
+    {
+        return false;
+    }
+
+    AttributeList attributes;
+    while( pos < data.size() )
+    {
+        QLatin1String line = Utils::nextLine(data, pos);
+        if( Utils::stripTag(line, QLatin1String("#EXT-X-STREAM-INF:")) )
+        {
+            mIsMaster = true;
+            attributes.parse(line);
+
+            QLatin1String uri = Utils::nextLine(data, pos);
+            if( Utils::isURI(uri) )
+            {
+                QUrl final = base.resolved(QUrl(QString::fromUtf8(uri.data(), uri.size())));
+                VariantStream variantStream;
+                variantStream.averageBandwidth = quint32(Utils::toUInt64(attributes.value(QLatin1String("AVERAGE-BANDWIDTH"))));
+                variantStream.peakBandwidth = quint32(Utils::toUInt64(attributes.value(QLatin1String("BANDWIDTH"))));
+                variantStream.audio = attributes.value(QLatin1String("AUDIO"));
+                variantStream.videoStream.url = final.toString();
+
+                QLatin1String codec = attributes.value(QLatin1String("CODECS"));
+                int comma = Utils::indexOf(codec, ',');
+                if( comma != -1 )
+                {
+                    variantStream.videoStream.codec = Utils::getReadableCodec(QString(codec.left(comma)));
+                    int next = Utils::indexOf(codec, ',', comma + 1);
+                    QLatin1String second = codec.mid(comma + 1, (next == -1 ? codec.size() : next) - comma - 1);
+                    variantStream.audioStream.codec = Utils::getReadableCodec(QString(second));
+                }
+                else
+                {
+                    variantStream.videoStream.codec = Utils::getReadableCodec(QString(codec));
+                }
+                variantStream.videoStream.resolution = attributes.value(QLatin1String("RESOLUTION"));
+                variantStream.videoStream.framerate = attributes.value(QLatin1String("FRAME-RATE"));
+
+                bool isNew;
+                int variant = mVariantStreams.size();
+                variantStream.videoId = mRegistry.intern(StreamRegistry::Video, variantStream.videoStream.url, &isNew);
+                if( isNew )
+                {
+                    mVideoIds.append(variantStream.videoId);
+                }
+                mRegistry.linkVariant(variantStream.videoId, variant);
+                mVariantStreams.append(variantStream);
+            }
+        }
+        else if( Utils::stripTag(line, QLatin1String("#EXT-X-MEDIA:")) )
+        {
+            attributes.parse(line);
+            QLatin1String uri = attributes.value(QLatin1String("URI"));
+            if( attributes.value(QLatin1String("TYPE")) != QLatin1String("AUDIO") || uri.isEmpty() )
+                continue;
+
+            QString groupId = attributes.value(QLatin1String("GROUP-ID"));
+            AudioStream audioStream;
+            audioStream.url = base.resolved(QUrl(QString::fromUtf8(uri.data(), uri.size()))).toString();
+            audioStream.language = attributes.value(QLatin1String("LANGUAGE"));
+            audioStream.numOfChannels = quint32(Utils::toUInt64(attributes.value(QLatin1String("CHANNELS"))));
+
+            bool isNew;
+            int audioId = mRegistry.intern(StreamRegistry::Audio, audioStream.url, &isNew);
+            if( isNew )
+            {
+                mAudioIds.append(audioId);
+            }
+
+            mRegistry.addGroupRendition(groupId, mAudioRenditions.size());
+            mAudioRenditions.append(audioStream);
+        }
+    }
+
+    /// группы назначаются после разбора, когда известны все рендишены:
+    /// как и раньше, Variant Stream получает последний рендишен своей группы
+    for(int variant = 0; variant < mVariantStreams.size(); ++variant)
+    {
+        const QString &groupId = mVariantStreams.at(variant).audio;
+        if( groupId.isEmpty() )
+            continue;
+
+        QVector<int> renditions = mRegistry.groupRenditions(groupId);
+        if( !renditions.isEmpty() )
+        {
+            assignAudio(variant, renditions.last());
+        }
+    }
+
+    return true;
+}
+
+void MasterPlaylistParser::clear()
+{
+    mIsMaster = false;
+    mRegistry.clear();
+    mVideoIds.clear();
+    mAudioIds.clear();
+    mAudioRenditions.clear();
+    mVariantStreams.clear();
+}
+
+bool MasterPlaylistParser::isMaster() const
+{
+    return mIsMaster;
+}
+
+QList<VariantStream> &MasterPlaylistParser::variantStreams()
+{
+    return mVariantStreams;
+}
+
+const QList<VariantStream> &MasterPlaylistParser::variantStreams() const
+{
+    return mVariantStreams;
+}
+
+const StreamRegistry &MasterPlaylistParser::registry() const
+{
+    return mRegistry;
+}
+
+const QVector<int> &MasterPlaylistParser::videoIds() const
+{
+    return mVideoIds;
+}
+
+const QVector<int> &MasterPlaylistParser::audioIds() const
+{
+    return mAudioIds;
+}
+
+void MasterPlaylistParser::assignAudio(int variant, int rendition)
+{
+    const AudioStream &audioStream = mAudioRenditions.at(rendition);
+    VariantStream &variantStream = mVariantStreams[variant];
+    int audioId = mRegistry.find(StreamRegistry::Audio, audioStream.url);
+
+    variantStream.audioId = audioId;
+    variantStream.audioStream.url = audioStream.url;
+    variantStream.audioStream.language = audioStream.language;
+    variantStream.audioStream.numOfChannels = audioStream.numOfChannels;
+    mRegistry.linkVariant(audioId, variant);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QUrl>
+#include <QVector>
+
+#include "streamregistry.h"
+#include "streams.h"
+
+/// Разбор мастер-плейлиста: список Variant Stream'ов и адреса
+/// медиа-плейлистов, которые нужно скачать для подсчёта реального битрейта.
+class MasterPlaylistParser
+{
+public:
+    MasterPlaylistParser();
+
+    /// false, если данные не являются плейлистом HLS
+    bool parse(const QByteArray &data, const QUrl &base);
+    void clear();
+
+    bool isMaster() const;
+    QList<VariantStream> &variantStreams();
+    const QList<VariantStream> &variantStreams() const;
+    const StreamRegistry &registry() const;
+    /// id уникальных медиа-плейлистов видео и аудио в порядке появления
+    const QVector<int> &videoIds() const;
+    const QVector<int> &audioIds() const;
+
+private:
+    void assignAudio(int variant, int rendition);
+
+private:
+    bool mIsMaster;
+    StreamRegistry mRegistry;
+    QVector<int> mVideoIds;
+    QVector<int> mAudioIds;
+    QList<AudioStream> mAudioRenditions;
+    QList<VariantStream> mVariantStreams;
+};
@@ -0,0 +1,181 @@
+#include "mediaplaylistparser.h"
+
+#include <cstring>
+
+#include "attributelist.h"
+#include "utils.h"
+
+MediaPlaylistReader::MediaPlaylistReader()
+    : mHeaderChecked(false)
+    , mValid(false)
+    , mBitrate(0)
+    , mNextByteRangeOffset(0)
+    , mMapByteRangeLength(0)
+    , mMapByteRangeOffset(0)
+    , mSegmentCount(0)
+{
+}
+
+void MediaPlaylistReader::feed(const QByteArray &chunk, QVector<SegmentRecord> &records)
+{
+    if( mHeaderChecked && !mValid )
+        return;
+
+    /// записи прошлой порции уже разобраны
+    while( mMapUris.size() > 1 )
+        mMapUris.removeFirst();
+
+    const char *begin = chunk.constData();
+    const char *end = begin + chunk.size();
+
+    if( !mPending.isEmpty() )
+    {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+        if( !newline )
+        {
+            mPending.append(begin, int(end - begin));
+            return;
+        }
+        mPending.append(begin, int(newline - begin));
+        mCompleted.swap(mPending);
+        mPending.clear();
+        int pos = 0;
+        processLine(Utils::nextLine(mCompleted, pos), records);
+        begin = newline + 1;
+    }
+
+    while( begin < end )
+    {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+        if( !newline )
+        {
+            /// незавершённая строка - дождёмся следующей порции
+            mPending.append(begin, int(end - begin));
+            return;
+        }
+        const char *lineEnd = newline;
+        if( lineEnd > begin && *(lineEnd - 1) == '\r' )
+            --lineEnd;
+        processLine(QLatin1String(begin, int(lineEnd - begin)), records);
+        begin = newline + 1;
+    }
+}
+
+void MediaPlaylistReader::finish(QVector<SegmentRecord> &records)
+{
+    if( !mPending.isEmpty() )
+    {
+        mCompleted.swap(mPending);
+        mPending.clear();
+        int pos = 0;
+        processLine(Utils::nextLine(mCompleted, pos), records);
+    }
+}
+
+bool MediaPlaylistReader::isValid() const
+{
+    return mValid;
+}
+
+quint32 MediaPlaylistReader::segmentCount() const
+{
+    return mSegmentCount;
+}
+
+const PlaylistInfo &MediaPlaylistReader::info() const
+{
+    return mInfo;
+}
+
+void MediaPlaylistReader::processLine(QLatin1String line, QVector<SegmentRecord> &records)
+{
+    if( !mHeaderChecked )
+    {
+        mHeaderChecked = true;
+        mValid = Utils::isHLS(line);
+        return;
+    }
+    if( !mValid || line.isEmpty() )
+        return;
+
+    if( Utils::isURI(line) )
+    {
+        /// EXT-X-BITRATE не относится к сегментам с EXT-X-BYTERANGE (RFC 8216bis, 4.4.4.8),
+        /// зато у них точный размер: битрейт считается из него
+        if( mNext.hasByteRange )
+            mNext.bitrate = mNext.durationUs ? quint32(mNext.byteRangeLength * 8000 / mNext.durationUs) : 0;
+        else
+            mNext.bitrate = mBitrate;
+        mNext.uri = line;
+        if( !mMapUris.isEmpty() )
+            mNext.mapUri = QLatin1String(mMapUris.last().constData(), mMapUris.last().size());
+        mNext.mapByteRangeLength = mMapByteRangeLength;
+        mNext.mapByteRangeOffset = mMapByteRangeOffset;
+        mNext.sequence = mInfo.mediaSequence + mInfo.skippedSegments + mSegmentCount;
+        records.append(mNext);
+        mNext = SegmentRecord();
+        mSegmentCount++;
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXTINF:")) )
+    {
+        mNext.durationUs = Utils::toMicroseconds(line);
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-BITRATE:")) )
+    {
+        mBitrate = quint32(Utils::toUInt64(line));
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-BYTERANGE:")) )
+    {
+        /// <n>[@<o>]; без смещения диапазон продолжает предыдущий
+        mNext.hasByteRange = true;
+        mNext.byteRangeLength = Utils::toUInt64(line);
+        int at = Utils::indexOf(line, '@');
+        mNext.byteRangeOffset = at == -1 ? mNextByteRangeOffset
+                                         : Utils::toUInt64(QLatin1String(line.data() + at + 1, line.size() - at - 1));
+        mNextByteRangeOffset = mNext.byteRangeOffset + mNext.byteRangeLength;
+    }
+    else if( line == QLatin1String("#EXT-X-DISCONTINUITY") )
+    {
+        mNext.discontinuity = true;
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-KEY:")) )
+    {
+        mNext.keyChanged = true;
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-MAP:")) )
+    {
+        mNext.mapChanged = true;
+
+        /// URI="init.mp4"[,BYTERANGE="<n>[@<o>]"]
+        AttributeList attributes(line);
+        QLatin1String uri = attributes.value(QLatin1String("URI"));
+        mMapUris.append(QByteArray(uri.data(), uri.size()));
+        QLatin1String byteRange = attributes.value(QLatin1String("BYTERANGE"));
+        mMapByteRangeLength = Utils::toUInt64(byteRange);
+        int at = Utils::indexOf(byteRange, '@');
+        mMapByteRangeOffset = at == -1 ? 0 : Utils::toUInt64(QLatin1String(byteRange.data() + at + 1, byteRange.size() - at - 1));
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-TARGETDURATION:")) )
+    {
+        mInfo.targetDurationUs = Utils::toUInt64(line) * 1000000;
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-MEDIA-SEQUENCE:")) )
+    {
+        mInfo.mediaSequence = Utils::toUInt64(line);
+    }
+    else if( line == QLatin1String("#EXT-X-ENDLIST") )
+    {
+        mInfo.endList = true;
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-SERVER-CONTROL:")) )
+    {
+        AttributeList attributes(line);
+        mInfo.canSkipUntilUs = Utils::toMicroseconds(attributes.value(QLatin1String("CAN-SKIP-UNTIL")));
+    }
+    else if( Utils::stripTag(line, QLatin1String("#EXT-X-SKIP:")) )
+    {
+        /// пропущенные сегменты идут сразу за EXT-X-MEDIA-SEQUENCE
+        AttributeList attributes(line);
+        mInfo.skippedSegments = Utils::toUInt64(attributes.value(QLatin1String("SKIPPED-SEGMENTS")));
+    }
+}
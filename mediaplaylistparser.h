@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QByteArray>
+#include <QLatin1String>
+#include <QList>
+#include <QVector>
+
+#include "playlistmetrics.h"
+#include "segmentrecord.h"
+
+/// Потоковое чтение медиа-плейлиста: данные подаются порциями по мере
+/// поступления из сети, незавершённая строка переносится в следующую порцию.
+/// Теги собираются в SegmentRecord, который выдаётся на строке URI.
+/// В памяти хранится только хвост последней порции и теги текущего сегмента.
+class MediaPlaylistReader
+{
+public:
+    MediaPlaylistReader();
+
+    /// завершённые в порции сегменты дописываются в records
+    void feed(const QByteArray &chunk, QVector<SegmentRecord> &records);
+    void finish(QVector<SegmentRecord> &records);
+
+    bool isValid() const;
+    quint32 segmentCount() const;
+    const PlaylistInfo &info() const;
+
+private:
+    void processLine(QLatin1String line, QVector<SegmentRecord> &records);
+
+private:
+    QByteArray mPending;
+    /// последняя собранная из порций строка: на неё ссылается SegmentRecord::uri
+    QByteArray mCompleted;
+    bool mHeaderChecked;
+    bool mValid;
+
+    PlaylistInfo mInfo;
+    SegmentRecord mNext;
+    quint32 mBitrate; //действует до следующего EXT-X-BITRATE, kbps
+    quint64 mNextByteRangeOffset;
+    /// URI из EXT-X-MAP: строка тега не переживает порцию, поэтому копия.
+    /// Действует последний; прежние держатся до следующей порции - на них
+    /// ссылаются записи, которые ещё не отданы метрикам
+    QList<QByteArray> mMapUris;
+    quint64 mMapByteRangeLength;
+    quint64 mMapByteRangeOffset;
+    quint32 mSegmentCount;
+};
+
+/// Однопроходный анализ медиа-плейлиста. Каждый сегмент один раз передаётся
+/// всем метрикам из Metrics (см. playlistmetrics.h); набор собирается на этапе
+/// компиляции, так что новая метрика не добавляет прохода по данным.
+/// Метрики доступны напрямую через наследование или через metric<T>().
+template<typename... Metrics>
+class MediaPlaylistAnalyzer : public Metrics...
+{
+public:
+    void feed(const QByteArray &chunk)
+    {
+        mRecords.clear();
+        mReader.feed(chunk, mRecords);
+        addRecords();
+    }
+
+    void finish()
+    {
+        mRecords.clear();
+        mReader.finish(mRecords);
+        addRecords();
+
+        using expand = int[];
+        (void)expand{0, (static_cast<Metrics &>(*this).finish(mReader.info()), 0)...};
+    }
+
+    bool isValid() const
+    {
+        return mReader.isValid();
+    }
+
+    quint32 segmentCount() const
+    {
+        return mReader.segmentCount();
+    }
+
+    const PlaylistInfo &info() const
+    {
+        return mReader.info();
+    }
+
+    template<typename Metric>
+    const Metric &metric() const
+    {
+        return static_cast<const Metric &>(*this);
+    }
+
+private:
+    void addRecords()
+    {
+        using expand = int[];
+        for( int i = 0; i < mRecords.size(); ++i )
+        {
+            const SegmentRecord &record = mRecords.at(i);
+            (void)expand{0, (static_cast<Metrics &>(*this).add(record, mReader.info()), 0)...};
+        }
+    }
+
+private:
+    MediaPlaylistReader mReader;
+    QVector<SegmentRecord> mRecords;
+};
+
+/// Потоковые метрики каждого медиа-плейлиста потока. Посегментные данные
+/// есть только в SegmentStore (нужна арена, см. setArena()), всё остальное
+/// считается проходами по нему, см. scanSegments()
+class MediaPlaylistParser : public MediaPlaylistAnalyzer<BitrateMean, SampledSegments, StoredSegments>
+{
+};
@@ -0,0 +1,460 @@
+#include "monitordaemon.h"
+
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QTimer>
+
+#include "timerwheel.h"
+
+const int SAVE_INTERVAL = 5 * 60 * 1000; //in milliseconds
+/// просроченные за время остановки проверки размазываются по этому отрезку
+const int OVERDUE_SPREAD = 10 * 60 * 1000; //in milliseconds
+const int STATE_VERSION = 1;
+
+/// случайное число от 0 до range включительно
+static qint64 randomDelay(qint64 range)
+{
+    return range > 0 ? qint64(QRandomGenerator::global()->bounded(quint64(range) + 1)) : 0;
+}
+
+MonitorDaemon::MonitorDaemon(QObject *parent)
+    : QObject(parent)
+    , mAnalyzer(new HlsAnalyzer(this))
+    , mWheel(new TimerWheel(1000, 3600, this))
+    , mWatcher(new QFileSystemWatcher(this))
+    , mSaveTimer(new QTimer(this))
+    , mPrometheus(false)
+    , mIntervalMs(60 * 60 * 1000)
+    , mHistory(64)
+    , mConcurrency(16)
+    , mDeviation(10)
+    , mRunning(0)
+    , mDirty(false)
+{
+    mOut.open(stdout, QIODevice::WriteOnly);
+
+    connect(mWatcher, &QFileSystemWatcher::fileChanged, this, [this]()
+    {
+        /// редакторы часто заменяют файл целиком - слежение нужно восстановить
+        if( !mWatcher->files().contains(mJobsFile) )
+            mWatcher->addPath(mJobsFile);
+        loadJobs();
+    });
+
+    mSaveTimer->setInterval(SAVE_INTERVAL);
+    connect(mSaveTimer, &QTimer::timeout, this, &MonitorDaemon::saveState);
+}
+
+void MonitorDaemon::setJobsFile(const QString &fileName)
+{
+    mJobsFile = fileName;
+}
+
+void MonitorDaemon::setStateFile(const QString &fileName)
+{
+    mStateFile = fileName;
+}
+
+void MonitorDaemon::setInterval(int seconds)
+{
+    mIntervalMs = qMax(1, seconds) * 1000;
+}
+
+void MonitorDaemon::setHistory(int checks)
+{
+    mHistory = qMax(1, checks);
+}
+
+void MonitorDaemon::setConcurrency(int concurrency)
+{
+    mConcurrency = qMax(1, concurrency);
+}
+
+void MonitorDaemon::setMaxPerHost(int maxPerHost)
+{
+    mAnalyzer->setMaxPerHost(maxPerHost);
+}
+
+void MonitorDaemon::setRetries(int retries)
+{
+    mAnalyzer->setMaxAttempts(retries + 1);
+}
+
+void MonitorDaemon::setRequestTimeout(int ms)
+{
+    mAnalyzer->setRequestTimeout(ms);
+}
+
+void MonitorDaemon::enableCache(const QString &directory, qint64 maximumSize)
+{
+    mAnalyzer->enableCache(directory, maximumSize);
+}
+
+void MonitorDaemon::setDeviation(qreal deviation)
+{
+    mDeviation = deviation;
+}
+
+void MonitorDaemon::setPeakWindow(quint32 windowMs)
+{
+    mOptions.peakWindowMs = windowMs;
+}
+
+void MonitorDaemon::setProbeRate(int requestsPerSecond)
+{
+    mOptions.probeRate = requestsPerSecond;
+}
+
+void MonitorDaemon::setDeadline(int ms)
+{
+    mOptions.deadlineMs = ms;
+}
+
+void MonitorDaemon::setMetricsFile(const QString &fileName, bool prometheus)
+{
+    mMetricsFile = fileName;
+    mPrometheus = prometheus;
+}
+
+bool MonitorDaemon::start()
+{
+    loadState();
+    if( !loadJobs() )
+        return false;
+
+    mWatcher->addPath(mJobsFile);
+    mSaveTimer->start();
+    qInfo() << "Заданий:" << mJobs.size();
+    return true;
+}
+
+bool MonitorDaemon::loadJobs()
+{
+    QFile file(mJobsFile);
+    if( !file.open(QIODevice::ReadOnly) )
+    {
+        qCritical() << "Не удалось открыть" << mJobsFile;
+        return false;
+    }
+
+    QHash<QString, int> intervals;
+    while( !file.atEnd() )
+    {
+        QString line = QString::fromUtf8(file.readLine()).simplified();
+        if( line.isEmpty() || line.startsWith('#') )
+            continue;
+        QStringList fields = line.split(' ');
+        int intervalMs = fields.size() > 1 ? qMax(1, fields.at(1).toInt()) * 1000 : mIntervalMs;
+        intervals.insert(fields.at(0), intervalMs);
+    }
+
+    /// снятые задания: идущий анализ доработает, но его результат не нужен
+    QHash<QString, Job>::iterator it = mJobs.begin();
+    while( it != mJobs.end() )
+    {
+        if( intervals.contains(it.key()) )
+        {
+            ++it;
+            continue;
+        }
+        mWheel->stop(it->timer);
+        if( it->running )
+            mDetached.insert(it.key());
+        it = mJobs.erase(it);
+        mDirty = true;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for( QHash<QString, int>::const_iterator interval = intervals.constBegin(); interval != intervals.constEnd(); ++interval )
+    {
+        Job &job = mJobs[interval.key()];
+        job.url = interval.key();
+        if( mDetached.remove(job.url) )
+            job.running = true;
+        /// изменённый период действует сразу, а не после следующей проверки
+        const bool changed = job.intervalMs != interval.value();
+        job.intervalMs = interval.value();
+        if( job.queued || job.running || (job.timer && !changed) )
+            continue;
+
+        /// первая проверка: новое задание - в любой момент периода, по сохранённому
+        /// состоянию - в свой срок, просроченные - вразброс в ближайшие минуты
+        const Check *last = lastCheck(job);
+        if( !last )
+        {
+            schedule(job, randomDelay(job.intervalMs));
+            continue;
+        }
+        qint64 delay = last->time * 1000 + job.intervalMs - now;
+        schedule(job, delay > 0 ? delay : randomDelay(qMin(job.intervalMs, OVERDUE_SPREAD)));
+    }
+    return true;
+}
+
+void MonitorDaemon::loadState()
+{
+    if( mStateFile.isEmpty() )
+        return;
+
+    QFile file(mStateFile);
+    if( !file.open(QIODevice::ReadOnly) )
+        return;
+
+    QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+    if( state.value("version").toInt() != STATE_VERSION )
+    {
+        qDebug() << "Error: " << "неизвестная версия состояния" << mStateFile;
+        return;
+    }
+
+    foreach(const QJsonValue &value, state.value("jobs").toArray())
+    {
+        QJsonObject object = value.toObject();
+        Job &job = mJobs[object.value("url").toString()];
+        job.url = object.value("url").toString();
+        job.drifting = object.value("drifting").toBool();
+        job.failing = object.value("failing").toBool();
+
+        /// старые записи идут первыми, лишние отбрасываются
+        QJsonArray history = object.value("history").toArray();
+        for( int i = qMax(0, history.size() - mHistory); i < history.size(); ++i )
+        {
+            QJsonArray entry = history.at(i).toArray();
+            Check check;
+            check.time = qint64(entry.at(0).toDouble());
+            check.worstDeviation = quint32(entry.at(1).toDouble());
+            check.variants = quint16(entry.at(2).toInt());
+            check.outOfRange = quint8(entry.at(3).toInt());
+            check.flags = quint8(entry.at(4).toInt());
+            record(job, check);
+        }
+    }
+}
+
+void MonitorDaemon::saveState()
+{
+    if( !mMetricsFile.isEmpty() )
+    {
+        QSaveFile metrics(mMetricsFile);
+        if( metrics.open(QIODevice::WriteOnly) )
+        {
+            NetworkTimings timings = mAnalyzer->timings();
+            metrics.write(mPrometheus ? timings.toPrometheus() : timings.toJson());
+            metrics.commit();
+        }
+    }
+    /// замеры копятся по каждому запросу - без сброса память росла бы всё время работы
+    mAnalyzer->clearTimings();
+
+    if( mStateFile.isEmpty() || !mDirty )
+        return;
+
+    QJsonArray jobs;
+    foreach(const Job &job, mJobs)
+    {
+        QJsonArray history;
+        const int size = job.history.size();
+        const int first = size < mHistory ? 0 : job.nextCheck;
+        for( int i = 0; i < size; ++i )
+        {
+            const Check &check = job.history.at((first + i) % size);
+            QJsonArray entry;
+            entry.append(double(check.time));
+            entry.append(double(check.worstDeviation));
+            entry.append(int(check.variants));
+            entry.append(int(check.outOfRange));
+            entry.append(int(check.flags));
+            history.append(entry);
+        }
+
+        QJsonObject object;
+        object.insert("url", job.url);
+        object.insert("drifting", job.drifting);
+        object.insert("failing", job.failing);
+        object.insert("history", history);
+        jobs.append(object);
+    }
+
+    QJsonObject state;
+    state.insert("version", STATE_VERSION);
+    state.insert("jobs", jobs);
+
+    /// QSaveFile: при сбое посреди записи старое состояние остаётся целым
+    QSaveFile file(mStateFile);
+    if( !file.open(QIODevice::WriteOnly) )
+    {
+        qDebug() << "Error: " << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(state).toJson(QJsonDocument::Compact));
+    if( file.commit() )
+        mDirty = false;
+}
+
+void MonitorDaemon::schedule(Job &job, qint64 delayMs)
+{
+    QString url = job.url;
+    mWheel->stop(job.timer);
+    job.timer = mWheel->start(int(qMax<qint64>(0, delayMs)), [this, url]()
+    {
+        onDue(url);
+    });
+}
+
+void MonitorDaemon::onDue(const QString &url)
+{
+    if( !mJobs.contains(url) )
+        return;
+
+    Job &job = mJobs[url];
+    job.timer = 0;
+    if( job.queued || job.running )
+        return;
+    job.queued = true;
+    mQueue.enqueue(url);
+    startNext();
+}
+
+void MonitorDaemon::startNext()
+{
+    while( mRunning < mConcurrency && !mQueue.isEmpty() )
+    {
+        QString url = mQueue.dequeue();
+        if( !mJobs.contains(url) )
+            continue;
+
+        Job &job = mJobs[url];
+        job.queued = false;
+        job.running = true;
+        mRunning++;
+
+        QFutureWatcher<AnalysisResult> *watcher = new QFutureWatcher<AnalysisResult>(this);
+        connect(watcher, &QFutureWatcher<AnalysisResult>::finished, this, [this, watcher, url]()
+        {
+            watcher->deleteLater();
+            onAnalysisFinished(url, watcher->result());
+        });
+        watcher->setFuture(mAnalyzer->analyze(url, mOptions));
+    }
+}
+
+void MonitorDaemon::onAnalysisFinished(const QString &url, const AnalysisResult &result)
+{
+    mRunning--;
+    mDetached.remove(url);
+    if( mJobs.contains(url) )
+    {
+        Job &job = mJobs[url];
+        job.running = false;
+
+        Check check = summarize(result);
+        record(job, check);
+        mDirty = true;
+
+        /// сообщаем только о переходах между состояниями
+        if( check.flags & Failed )
+        {
+            if( !job.failing )
+                alert(job, "error", check, result.errorString);
+            job.failing = true;
+        }
+        else
+        {
+            if( job.failing )
+                alert(job, "available", check, QString());
+            job.failing = false;
+
+            if( check.outOfRange > 0 && !job.drifting )
+                alert(job, "drift", check, QString());
+            else if( check.outOfRange == 0 && job.drifting )
+                alert(job, "normal", check, QString());
+            job.drifting = check.outOfRange > 0;
+        }
+
+        /// следующий срок - через период +-10%
+        qint64 jitter = job.intervalMs / 10;
+        schedule(job, job.intervalMs - jitter + randomDelay(2 * jitter));
+    }
+    startNext();
+}
+
+MonitorDaemon::Check MonitorDaemon::summarize(const AnalysisResult &result) const
+{
+    Check check;
+    check.time = QDateTime::currentSecsSinceEpoch();
+    if( !result.errorString.isEmpty() )
+        check.flags |= Failed;
+    if( result.partial )
+        check.flags |= Partial;
+    check.variants = quint16(qMin(result.variantStreams.size(), 0xffff));
+
+    int outOfRange = 0;
+    foreach(const VariantStream &variantStream, result.variantStreams)
+    {
+        quint32 real = variantStream.videoStream.realVideoBitrate + variantStream.audioStream.realAudioBitrate;
+        /// без заявленного или без измеренного битрейта сравнивать нечего
+        if( variantStream.averageBandwidth == 0 || real == 0 )
+            continue;
+
+        quint64 difference = real > variantStream.averageBandwidth ? real - variantStream.averageBandwidth
+                                                                   : variantStream.averageBandwidth - real;
+        check.worstDeviation = qMax(check.worstDeviation,
+                                    quint32(qMin<quint64>(difference * 10000 / variantStream.averageBandwidth, 0xffffffffu)));
+        if( !variantStream.isInRange(mDeviation) )
+            outOfRange++;
+    }
+    check.outOfRange = quint8(qMin(outOfRange, 0xff));
+    return check;
+}
+
+void MonitorDaemon::record(Job &job, const Check &check)
+{
+    if( job.history.size() < mHistory )
+    {
+        job.history.append(check);
+        return;
+    }
+    job.history[job.nextCheck] = check;
+    job.nextCheck = (job.nextCheck + 1) % mHistory;
+}
+
+const MonitorDaemon::Check *MonitorDaemon::lastCheck(const Job &job) const
+{
+    if( job.history.isEmpty() )
+        return nullptr;
+    if( job.history.size() < mHistory )
+        return &job.history.last();
+    return &job.history.at((job.nextCheck + mHistory - 1) % mHistory);
+}
+
+void MonitorDaemon::alert(const Job &job, const QString &kind, const Check &check, const QString &errorString)
+{
+    QJsonObject object;
+    object.insert("time", QDateTime::fromSecsSinceEpoch(check.time, Qt::UTC).toString(Qt::ISODate));
+    object.insert("master", job.url);
+    object.insert("event", kind);
+    if( !errorString.isEmpty() )
+    {
+        object.insert("error", errorString);
+    }
+    else
+    {
+        object.insert("variants", int(check.variants));
+        object.insert("outOfRange", int(check.outOfRange));
+        object.insert("worstDeviation", check.worstDeviation / 100.0);
+    }
+    if( check.flags & Partial )
+    {
+        object.insert("partial", true);
+    }
+
+    mOut.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    mOut.write("\n");
+    mOut.flush();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QObject>
+
+#include <QFile>
+#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QVector>
+
+#include "hlsanalyzer.h"
+
+class QFileSystemWatcher;
+class QTimer;
+class TimerWheel;
+
+/// Служба наблюдения за каталогом потоков: каждый поток из списка заданий
+/// перепроверяется со своим периодом, а об уходе битрейта за допустимое
+/// отклонение и о возврате в норму в stdout пишется по одной строке JSON.
+/// Все анализы идут через один HlsAnalyzer (общий сетевой поток, пределы
+/// на хост, кэш) и не больше concurrency сразу. Сроки ведёт колесо таймеров,
+/// каждый срок сдвигается на случайные +-10% периода, чтобы тысячи заданий
+/// не приходили к серверам разом. История проверок каждого потока - кольцо
+/// фиксированной длины, замеры сети сбрасываются при каждом сохранении
+/// состояния, поэтому память не растёт со временем работы.
+class MonitorDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    enum CheckFlag
+    {
+        Failed = 0x01,
+        Partial = 0x02
+    };
+
+    /// Итог одной проверки потока
+    struct Check
+    {
+        qint64 time = 0;            //in seconds since epoch
+        quint32 worstDeviation = 0; // наибольшее отклонение битрейта варианта, в сотых долях процента
+        quint16 variants = 0;
+        quint8 outOfRange = 0;      // вариантов вне допустимого отклонения
+        quint8 flags = 0;
+    };
+
+    explicit MonitorDaemon(QObject *parent = nullptr);
+
+    /// строки "<url> [период в секундах]"; файл перечитывается при изменении
+    void setJobsFile(const QString &fileName);
+    /// время проверок и история сохраняются сюда раз в пять минут и читаются при запуске
+    void setStateFile(const QString &fileName);
+    /// период по умолчанию
+    void setInterval(int seconds);
+    /// длина истории на поток
+    void setHistory(int checks);
+    void setConcurrency(int concurrency);
+    void setMaxPerHost(int maxPerHost);
+    /// повторов после неудачной попытки, 0 - без повторов
+    void setRetries(int retries);
+    void setRequestTimeout(int ms);
+    void enableCache(const QString &directory, qint64 maximumSize);
+    void setDeviation(qreal deviation);
+    void setPeakWindow(quint32 windowMs);
+    void setProbeRate(int requestsPerSecond);
+    /// срок анализа одного потока, 0 - без ограничения
+    void setDeadline(int ms);
+    /// замеры сети выгружаются сюда при каждом сохранении состояния
+    void setMetricsFile(const QString &fileName, bool prometheus);
+
+    /// false - список заданий не прочитан
+    bool start();
+
+private:
+    struct Job
+    {
+        QString url;
+        int intervalMs = 0;
+        quint64 timer = 0;
+        bool queued = false;
+        bool running = false;
+        /// последнее, о чём сообщено: битрейт вне нормы, поток недоступен
+        bool drifting = false;
+        bool failing = false;
+        QVector<Check> history;
+        int nextCheck = 0;
+    };
+
+    bool loadJobs();
+    void loadState();
+    void saveState();
+    void schedule(Job &job, qint64 delayMs);
+    void onDue(const QString &url);
+    void startNext();
+    void onAnalysisFinished(const QString &url, const AnalysisResult &result);
+    Check summarize(const AnalysisResult &result) const;
+    void record(Job &job, const Check &check);
+    const Check *lastCheck(const Job &job) const;
+    void alert(const Job &job, const QString &kind, const Check &check, const QString &errorString);
+
+private:
+    HlsAnalyzer *mAnalyzer;
+    AnalysisOptions mOptions;
+    TimerWheel *mWheel;
+    QFileSystemWatcher *mWatcher;
+    QTimer *mSaveTimer;
+    QFile mOut;
+
+    QString mJobsFile;
+    QString mStateFile;
+    QString mMetricsFile;
+    bool mPrometheus;
+    int mIntervalMs;
+    int mHistory;
+    int mConcurrency;
+    // in percent
+    qreal mDeviation;
+
+    QHash<QString, Job> mJobs;
+    /// снятые задания, чей анализ ещё идёт: вернувшееся в список задание
+    /// не должно запускать второй анализ поверх первого
+    QSet<QString> mDetached;
+    QQueue<QString> mQueue;
+    int mRunning;
+    bool mDirty;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <QtEndian>
+#include <QtGlobal>
+
+/// Последовательное чтение боксов ISO BMFF (ISO/IEC 14496-12, 4.2) поверх
+/// чужого буфера. Бокс - это тип и указатель на содержимое внутри того же
+/// буфера, ничего не копируется и не выделяется; буфер должен жить дольше
+/// читателя и полученных боксов. Вложенные боксы читаются новым
+/// Mp4BoxReader поверх содержимого родителя.
+class Mp4BoxReader
+{
+public:
+    struct Box
+    {
+        quint32 type = 0;
+        const uchar *data = nullptr; // содержимое без заголовка
+        quint64 size = 0;
+    };
+
+    static constexpr quint32 fourcc(const char (&name)[5])
+    {
+        return quint32(uchar(name[0])) << 24 | quint32(uchar(name[1])) << 16 |
+                quint32(uchar(name[2])) << 8 | quint32(uchar(name[3]));
+    }
+
+    /// Длина заголовка бокса в начале data: 8, 16 (64-битный размер) или
+    /// +16 для uuid; 0 - данных на заголовок не хватает, -1 - заголовок неверен.
+    /// size - полный размер бокса вместе с заголовком, 0 - до конца файла
+    static int header(const uchar *data, quint64 available, quint32 *type, quint64 *size)
+    {
+        if( available < 8 )
+            return 0;
+
+        int length = 8;
+        *size = qFromBigEndian<quint32>(data);
+        *type = qFromBigEndian<quint32>(data + 4);
+        if( *size == 1 )
+        {
+            if( available < 16 )
+                return 0;
+            *size = qFromBigEndian<quint64>(data + 8);
+            length = 16;
+        }
+        if( *type == fourcc("uuid") )
+        {
+            length += 16;
+            if( available < quint64(length) )
+                return 0;
+        }
+        if( *size != 0 && *size < quint64(length) )
+            return -1;
+        return length;
+    }
+
+    Mp4BoxReader(const uchar *data, quint64 size)
+        : mData(data)
+        , mSize(size)
+        , mPos(0)
+        , mMalformed(false)
+    {
+    }
+
+    /// следующий бокс; false - боксы кончились или бокс выходит за буфер
+    bool next(Box *box)
+    {
+        if( mMalformed || mPos >= mSize )
+            return false;
+
+        quint64 size = 0;
+        int length = header(mData + mPos, mSize - mPos, &box->type, &size);
+        if( size == 0 && length > 0 )
+            size = mSize - mPos;
+        if( length <= 0 || size > mSize - mPos )
+        {
+            mMalformed = true;
+            return false;
+        }
+        box->data = mData + mPos + length;
+        box->size = size - quint64(length);
+        mPos += size;
+        return true;
+    }
+
+    /// первый бокс нужного типа начиная с текущей позиции
+    bool find(quint32 type, Box *box)
+    {
+        while( next(box) )
+        {
+            if( box->type == type )
+                return true;
+        }
+        return false;
+    }
+
+    bool isMalformed() const
+    {
+        return mMalformed;
+    }
+
+private:
+    const uchar *mData;
+    quint64 mSize;
+    quint64 mPos;
+    bool mMalformed;
+};
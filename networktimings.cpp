@@ -0,0 +1,207 @@
+#include "networktimings.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+const int DEFAULT_MAXIMUM_RECORDS = 10000;
+const double QUANTILES[] = { 0.5, 0.95, 0.99 };
+
+qint64 NetworkTimings::Request::queueTime() const
+{
+    return startedAt >= 0 && queuedAt >= 0 ? startedAt - queuedAt : -1;
+}
+
+qint64 NetworkTimings::Request::timeToFirstByte() const
+{
+    return firstByteAt >= 0 && startedAt >= 0 ? firstByteAt - startedAt : -1;
+}
+
+qint64 NetworkTimings::Request::transferTime() const
+{
+    return finishedAt >= 0 && firstByteAt >= 0 ? finishedAt - firstByteAt : -1;
+}
+
+qint64 NetworkTimings::Request::totalTime() const
+{
+    return finishedAt >= 0 && startedAt >= 0 ? finishedAt - startedAt : -1;
+}
+
+int NetworkTimings::Request::connectionReused() const
+{
+    if( !encrypted || fromCache )
+        return -1;
+    return encryptedAt < 0 ? 1 : 0;
+}
+
+void NetworkTimings::Timing::add(qint64 ms)
+{
+    histogram.add(ms * 1000);
+    sum += ms;
+}
+
+NetworkTimings::NetworkTimings()
+    : mMaximumRecords(DEFAULT_MAXIMUM_RECORDS)
+    , mNextRecord(0)
+{
+}
+
+void NetworkTimings::record(const Request &request)
+{
+    if( mRecords.size() < mMaximumRecords )
+    {
+        mRecords.append(request);
+    }
+    else if( mMaximumRecords > 0 )
+    {
+        mRecords[mNextRecord] = request;
+        mNextRecord = (mNextRecord + 1) % mMaximumRecords;
+    }
+
+    HostSamples &samples = mHosts[request.host];
+    samples.requests++;
+    samples.bytes += request.bytes;
+    if( request.error )
+        samples.errors++;
+    if( request.fromCache )
+        samples.cached++;
+    if( request.connectionReused() == 1 )
+        samples.reused++;
+    if( request.encryptedAt >= 0 )
+        samples.handshakes++;
+    if( request.queueTime() >= 0 )
+        samples.queueTimes.add(request.queueTime());
+    if( request.timeToFirstByte() >= 0 )
+        samples.firstByteTimes.add(request.timeToFirstByte());
+    if( request.totalTime() >= 0 )
+        samples.totalTimes.add(request.totalTime());
+}
+
+void NetworkTimings::clear()
+{
+    mRecords.clear();
+    mNextRecord = 0;
+    mHosts.clear();
+}
+
+void NetworkTimings::setMaximumRecords(int count)
+{
+    mMaximumRecords = qMax(0, count);
+    clear();
+}
+
+QByteArray NetworkTimings::toJson() const
+{
+    QJsonObject hosts;
+    for( auto it = mHosts.constBegin(); it != mHosts.constEnd(); ++it )
+    {
+        const HostSamples &samples = it.value();
+        QJsonObject host;
+        host.insert("requests", qint64(samples.requests));
+        host.insert("errors", qint64(samples.errors));
+        host.insert("fromCache", qint64(samples.cached));
+        host.insert("reusedConnections", qint64(samples.reused));
+        host.insert("tlsHandshakes", qint64(samples.handshakes));
+        host.insert("bytes", qint64(samples.bytes));
+
+        QJsonObject queue, firstByte, total;
+        for( double quantile : QUANTILES )
+        {
+            QString key = QString("p%1").arg(int(quantile * 100));
+            queue.insert(key, samples.queueTimes.histogram.percentile(quantile * 100));
+            firstByte.insert(key, samples.firstByteTimes.histogram.percentile(quantile * 100));
+            total.insert(key, samples.totalTimes.histogram.percentile(quantile * 100));
+        }
+        host.insert("queueMs", queue);
+        host.insert("timeToFirstByteMs", firstByte);
+        host.insert("totalMs", total);
+        hosts.insert(it.key(), host);
+    }
+
+    QJsonArray requests;
+    for( int i = 0; i < mRecords.size(); ++i )
+    {
+        const Request &record = mRecords.at((mNextRecord + i) % mRecords.size());
+        QJsonObject request;
+        request.insert("url", record.url);
+        request.insert("host", record.host);
+        request.insert("priority", record.priority);
+        request.insert("queuedMs", record.queuedAt);
+        request.insert("startedMs", record.startedAt);
+        request.insert("firstByteMs", record.firstByteAt);
+        request.insert("finishedMs", record.finishedAt);
+        if( record.encryptedAt >= 0 )
+            request.insert("tlsHandshakeMs", record.encryptedAt - record.startedAt);
+        request.insert("bytes", record.bytes);
+        request.insert("status", record.httpStatus);
+        request.insert("httpVersion", record.httpVersion);
+        if( record.connectionReused() != -1 )
+            request.insert("connectionReused", record.connectionReused() == 1);
+        request.insert("fromCache", record.fromCache);
+        request.insert("error", record.error);
+        requests.append(request);
+    }
+
+    QJsonObject root;
+    root.insert("hosts", hosts);
+    root.insert("requests", requests);
+    return QJsonDocument(root).toJson();
+}
+
+QByteArray NetworkTimings::toPrometheus() const
+{
+    QByteArray counters;
+    QByteArray summaries;
+
+    struct Counter
+    {
+        const char *name;
+        quint64 HostSamples::*value;
+    };
+    const Counter totals[] = {
+        { "hls_requests_total", &HostSamples::requests },
+        { "hls_request_errors_total", &HostSamples::errors },
+        { "hls_requests_from_cache_total", &HostSamples::cached },
+        { "hls_connections_reused_total", &HostSamples::reused },
+        { "hls_tls_handshakes_total", &HostSamples::handshakes },
+        { "hls_response_bytes_total", &HostSamples::bytes }
+    };
+    for( const Counter &counter : totals )
+    {
+        counters += QByteArray("# TYPE ") + counter.name + " counter\n";
+        for( auto it = mHosts.constBegin(); it != mHosts.constEnd(); ++it )
+        {
+            counters += QByteArray(counter.name) + "{host=\"" + it.key().toUtf8() + "\"} "
+                    + QByteArray::number(it.value().*counter.value) + "\n";
+        }
+    }
+
+    struct Summary
+    {
+        const char *name;
+        Timing HostSamples::*timing;
+    };
+    const Summary metrics[] = {
+        { "hls_request_queue_seconds", &HostSamples::queueTimes },
+        { "hls_request_ttfb_seconds", &HostSamples::firstByteTimes },
+        { "hls_request_duration_seconds", &HostSamples::totalTimes }
+    };
+    for( const Summary &metric : metrics )
+    {
+        summaries += QByteArray("# TYPE ") + metric.name + " summary\n";
+        for( auto it = mHosts.constBegin(); it != mHosts.constEnd(); ++it )
+        {
+            const Timing &timing = it.value().*metric.timing;
+            QByteArray host = it.key().toUtf8();
+            for( double quantile : QUANTILES )
+            {
+                summaries += QByteArray(metric.name) + "{host=\"" + host + "\",quantile=\"" + QByteArray::number(quantile)
+                        + "\"} " + QByteArray::number(timing.histogram.percentile(quantile * 100) / 1000.0) + "\n";
+            }
+            summaries += QByteArray(metric.name) + "_sum{host=\"" + host + "\"} " + QByteArray::number(timing.sum / 1000.0) + "\n";
+            summaries += QByteArray(metric.name) + "_count{host=\"" + host + "\"} " + QByteArray::number(timing.histogram.count()) + "\n";
+        }
+    }
+
+    return counters + summaries;
+}
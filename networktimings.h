@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "latencyhistogram.h"
+
+/// Замеры сетевых запросов одного анализа (или пакетного прогона).
+/// Qt не сообщает время DNS и TCP по отдельности, поэтому для HTTPS
+/// фиксируется момент окончания TLS-рукопожатия: его отсутствие означает,
+/// что соединение было переиспользовано. Времена по хостам копятся в
+/// гистограммах с постоянной памятью, целиком хранятся только последние
+/// setMaximumRecords() запросов.
+class NetworkTimings
+{
+public:
+    struct Request
+    {
+        QString url;
+        QString host;
+        int priority = 0;
+        qint64 queuedAt = -1; //in milliseconds from scheduler start
+        qint64 startedAt = -1;
+        qint64 encryptedAt = -1; //-1 - no TLS handshake on this reply
+        qint64 firstByteAt = -1;
+        qint64 finishedAt = -1;
+        qint64 bytes = 0;
+        int httpStatus = 0;
+        QString httpVersion;
+        bool encrypted = false;
+        bool fromCache = false;
+        bool error = false;
+
+        qint64 queueTime() const;
+        qint64 timeToFirstByte() const;
+        qint64 transferTime() const;
+        qint64 totalTime() const;
+        /// -1 - неизвестно (для незашифрованных соединений Qt этого не сообщает)
+        int connectionReused() const;
+    };
+
+    NetworkTimings();
+
+    void record(const Request &request);
+    void clear();
+
+    /// сколько последних запросов хранить целиком для выгрузки
+    void setMaximumRecords(int count);
+
+    QByteArray toJson() const;
+    QByteArray toPrometheus() const;
+
+private:
+    struct Timing
+    {
+        void add(qint64 ms);
+
+        LatencyHistogram histogram;
+        qint64 sum = 0; //in milliseconds
+    };
+
+    struct HostSamples
+    {
+        quint64 requests = 0;
+        quint64 errors = 0;
+        quint64 cached = 0;
+        quint64 reused = 0;
+        quint64 handshakes = 0;
+        quint64 bytes = 0;
+        Timing queueTimes;
+        Timing firstByteTimes;
+        Timing totalTimes;
+    };
+
+private:
+    int mMaximumRecords;
+    QVector<Request> mRecords;
+    int mNextRecord;
+    QHash<QString, HostSamples> mHosts;
+};
@@ -0,0 +1,76 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include "originserver.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Тестовый HLS-origin с синтетическими потоками и сбоями");
+    parser.addHelpOption();
+    QCommandLineOption addressOption("address", "Адрес, на котором слушать.", "address", "127.0.0.1");
+    QCommandLineOption portOption("port", "Порт (0 - любой свободный).", "port", "8080");
+    QCommandLineOption variantsOption("variants", "Количество вариантов в мастер-плейлисте.", "n", "4");
+    QCommandLineOption audioGroupsOption("audio-groups", "Количество групп аудио.", "n", "1");
+    QCommandLineOption languagesOption("languages", "Языков в каждой группе аудио.", "n", "2");
+    QCommandLineOption segmentsOption("segments", "Сегментов в медиа-плейлисте VOD.", "n", "100");
+    QCommandLineOption bitrateOption("bitrate-tags", "Добавлять EXT-X-BITRATE к сегментам.");
+    QCommandLineOption fmp4Option("fmp4", "Сегменты fMP4 с EXT-X-MAP вместо MPEG-TS.");
+    QCommandLineOption byteRangeOption("byte-range", "Сегменты - диапазоны EXT-X-BYTERANGE одного файла.");
+    QCommandLineOption liveWindowOption("live-window", "Живой поток с окном из стольких сегментов (0 - VOD).", "n", "0");
+    QCommandLineOption latencyOption("latency", "Задержка перед каждым ответом в миллисекундах.", "ms", "0");
+    QCommandLineOption jitterOption("jitter", "Случайная добавка к задержке до стольких миллисекунд.", "ms", "0");
+    QCommandLineOption throttleOption("throttle", "Скорость каждого соединения в килобайтах в секунду (0 - без ограничения).", "kb", "0");
+    QCommandLineOption errorRateOption("error-rate", "Процент запросов, на которые возвращается ошибка.", "percent", "0");
+    QCommandLineOption errorStatusOption("error-status", "HTTP-код ошибки.", "status", "503");
+    QCommandLineOption stallRateOption("stall-rate", "Процент ответов, которые зависают посреди тела.", "percent", "0");
+    parser.addOption(addressOption);
+    parser.addOption(portOption);
+    parser.addOption(variantsOption);
+    parser.addOption(audioGroupsOption);
+    parser.addOption(languagesOption);
+    parser.addOption(segmentsOption);
+    parser.addOption(bitrateOption);
+    parser.addOption(fmp4Option);
+    parser.addOption(byteRangeOption);
+    parser.addOption(liveWindowOption);
+    parser.addOption(latencyOption);
+    parser.addOption(jitterOption);
+    parser.addOption(throttleOption);
+    parser.addOption(errorRateOption);
+    parser.addOption(errorStatusOption);
+    parser.addOption(stallRateOption);
+    parser.process(app);
+
+    OriginServer::Options options;
+    options.variants = qMax(1, parser.value(variantsOption).toInt());
+    options.audioGroups = qMax(0, parser.value(audioGroupsOption).toInt());
+    options.languages = qMax(1, parser.value(languagesOption).toInt());
+    options.segments = qMax(1, parser.value(segmentsOption).toInt());
+    options.withBitrate = parser.isSet(bitrateOption);
+    options.fmp4 = parser.isSet(fmp4Option);
+    options.byteRange = parser.isSet(byteRangeOption);
+    options.liveWindow = qMax(0, parser.value(liveWindowOption).toInt());
+
+    OriginServer::Faults faults;
+    faults.latencyMs = parser.value(latencyOption).toInt();
+    faults.jitterMs = parser.value(jitterOption).toInt();
+    faults.bytesPerSecond = qint64(parser.value(throttleOption).toDouble() * 1024);
+    faults.errorRate = parser.value(errorRateOption).toDouble() / 100;
+    faults.errorStatus = parser.value(errorStatusOption).toInt();
+    faults.stallRate = parser.value(stallRateOption).toDouble() / 100;
+
+    OriginServer server;
+    server.setOptions(options);
+    server.setFaults(faults);
+    if( !server.listen(QHostAddress(parser.value(addressOption)), quint16(parser.value(portOption).toUInt())) )
+    {
+        qCritical() << "Не удалось открыть порт:" << server.errorString();
+        return 1;
+    }
+    qInfo().noquote() << server.masterUrl();
+    return app.exec();
+}
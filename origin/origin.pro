@@ -0,0 +1,19 @@
+# тестовый HLS-origin: синтетические потоки, задержки, ограничение скорости,
+# ошибки и зависания для проверки сети без CDN
+QT -= gui
+QT += network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = hls-origin
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        origin.cpp \
+        originserver.cpp
+
+HEADERS += \
+    originserver.h \
+    playlistgenerator.h
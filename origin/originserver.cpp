@@ -0,0 +1,522 @@
+#include "originserver.h"
+
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "playlistgenerator.h"
+
+const int TICK_INTERVAL = 10; //in milliseconds
+const int TICKS_PER_SECOND = 1000 / TICK_INTERVAL;
+const int MAX_REQUEST_SIZE = 64 * 1024;
+const int WRITE_BUFFER_SIZE = 256 * 1024;
+
+static QByteArray statusText(int status)
+{
+    switch( status )
+    {
+    case 200:
+        return "OK";
+    case 206:
+        return "Partial Content";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 416:
+        return "Range Not Satisfiable";
+    case 429:
+        return "Too Many Requests";
+    case 500:
+        return "Internal Server Error";
+    case 503:
+        return "Service Unavailable";
+    }
+    return "Error";
+}
+
+static bool chance(qreal rate)
+{
+    return rate > 0 && QRandomGenerator::global()->generateDouble() < rate;
+}
+
+/// "bytes=100-199", "bytes=100-" или "bytes=-100" (последние 100 байт);
+/// false - заголовок не разобран и, как велит RFC 7233, не учитывается.
+/// Разобранный диапазон может быть невыполним: from >= total
+static bool parseRange(const QByteArray &range, qint64 total, qint64 *from, qint64 *to)
+{
+    if( !range.startsWith("bytes=") || range.contains(',') )
+        return false;
+    int dash = range.indexOf('-');
+    if( dash == -1 )
+        return false;
+
+    bool ok = false;
+    QByteArray start = range.mid(6, dash - 6).trimmed();
+    QByteArray end = range.mid(dash + 1).trimmed();
+    if( start.isEmpty() )
+    {
+        qint64 suffix = end.toLongLong(&ok);
+        if( !ok || suffix < 0 )
+            return false;
+        *from = qMax<qint64>(0, total - suffix);
+        *to = total - 1;
+        return true;
+    }
+
+    qint64 first = start.toLongLong(&ok);
+    if( !ok || first < 0 )
+        return false;
+    qint64 last = total - 1;
+    if( !end.isEmpty() )
+    {
+        last = end.toLongLong(&ok);
+        if( !ok || last < first )
+            return false;
+        last = qMin(last, total - 1);
+    }
+    *from = first;
+    *to = last;
+    return true;
+}
+
+OriginServer::OriginServer(QObject *parent)
+    : QObject(parent)
+    , mServer(new QTcpServer(this))
+    , mTimer(new QTimer(this))
+    , mStartTime(0)
+    , mRequestCount(0)
+    , mBytesSent(0)
+    , mFaultCount(0)
+{
+    mTimer->setInterval(TICK_INTERVAL);
+    connect(mTimer, &QTimer::timeout, this, &OriginServer::onTick);
+    connect(mServer, &QTcpServer::newConnection, this, &OriginServer::onNewConnection);
+    setOptions(Options());
+}
+
+void OriginServer::setOptions(const Options &options)
+{
+    mOptions = options;
+    mMaster = PlaylistGenerator::master(options.variants, options.audioGroups, options.languages);
+    mSegments.clear();
+}
+
+void OriginServer::setFaults(const Faults &faults)
+{
+    mFaults = faults;
+}
+
+bool OriginServer::listen(const QHostAddress &address, quint16 port)
+{
+    mStartTime = QDateTime::currentMSecsSinceEpoch();
+    return mServer->listen(address, port);
+}
+
+quint16 OriginServer::port() const
+{
+    return mServer->serverPort();
+}
+
+QString OriginServer::masterUrl() const
+{
+    QHostAddress address = mServer->serverAddress();
+    QString host = address == QHostAddress::Any || address == QHostAddress::AnyIPv4 ? "127.0.0.1" : address.toString();
+    return QString("http://%1:%2/master.m3u8").arg(host).arg(port());
+}
+
+QString OriginServer::errorString() const
+{
+    return mServer->errorString();
+}
+
+quint64 OriginServer::requestCount() const
+{
+    return mRequestCount;
+}
+
+quint64 OriginServer::bytesSent() const
+{
+    return mBytesSent;
+}
+
+quint64 OriginServer::faultCount() const
+{
+    return mFaultCount;
+}
+
+void OriginServer::onNewConnection()
+{
+    while( QTcpSocket *socket = mServer->nextPendingConnection() )
+    {
+        mConnections.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]()
+        {
+            onReadyRead(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]()
+        {
+            if( mConnections.contains(socket) )
+                send(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            mConnections.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void OriginServer::onReadyRead(QTcpSocket *socket)
+{
+    if( !mConnections.contains(socket) )
+        return;
+    mConnections[socket].input.append(socket->readAll());
+    processNext(socket);
+}
+
+void OriginServer::processNext(QTcpSocket *socket)
+{
+    Connection &connection = mConnections[socket];
+    if( connection.busy )
+        return;
+
+    int end = connection.input.indexOf("\r\n\r\n");
+    if( end == -1 )
+    {
+        if( connection.input.size() > MAX_REQUEST_SIZE )
+            socket->abort();
+        return;
+    }
+
+    QList<QByteArray> lines = connection.input.left(end).split('\n');
+    connection.input.remove(0, end + 4);
+
+    QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    QByteArray method = requestLine.value(0);
+    QByteArray path = requestLine.value(1);
+    QByteArray range;
+    for( int i = 1; i < lines.size(); ++i )
+    {
+        QByteArray line = lines.at(i).trimmed();
+        if( line.toLower().startsWith("range:") )
+            range = line.mid(6).trimmed();
+    }
+
+    connection.busy = true;
+    mRequestCount++;
+
+    int delay = mFaults.latencyMs;
+    if( mFaults.jitterMs > 0 )
+    {
+        delay += int(QRandomGenerator::global()->bounded(mFaults.jitterMs + 1));
+    }
+    if( delay <= 0 )
+    {
+        respond(socket, method, path, range);
+        return;
+    }
+    QTimer::singleShot(delay, socket, [this, socket, method, path, range]()
+    {
+        respond(socket, method, path, range);
+    });
+}
+
+void OriginServer::respond(QTcpSocket *socket, const QByteArray &method, const QByteArray &path, const QByteArray &range)
+{
+    if( !mConnections.contains(socket) )
+        return;
+
+    Response response;
+    if( method != "GET" && method != "HEAD" )
+    {
+        response.status = 400;
+    }
+    else if( chance(mFaults.errorRate) )
+    {
+        response.status = mFaults.errorStatus;
+        mFaultCount++;
+    }
+    else
+    {
+        response = resolve(path);
+    }
+
+    qint64 from = 0;
+    qint64 length = response.total;
+    QByteArray extra;
+    qint64 first = 0;
+    qint64 to = 0;
+    /// непонятный Range не учитывается - отдаётся весь ответ
+    if( response.status == 200 && !range.isEmpty() && parseRange(range, response.total, &first, &to) )
+    {
+        if( first < response.total )
+        {
+            from = first;
+            response.status = 206;
+            length = to - from + 1;
+            extra = "Content-Range: bytes " + QByteArray::number(from) + "-" + QByteArray::number(to)
+                    + "/" + QByteArray::number(response.total) + "\r\n";
+        }
+        else
+        {
+            response.status = 416;
+            length = 0;
+            extra = "Content-Range: bytes */" + QByteArray::number(response.total) + "\r\n";
+        }
+    }
+    if( response.status != 200 && response.status != 206 )
+    {
+        response.unit = statusText(response.status) + "\n";
+        response.contentType = "text/plain";
+        from = 0;
+        length = response.unit.size();
+    }
+
+    QByteArray header = "HTTP/1.1 " + QByteArray::number(response.status) + " " + statusText(response.status) + "\r\n";
+    if( !response.contentType.isEmpty() )
+    {
+        header += "Content-Type: " + response.contentType + "\r\n";
+    }
+    header += "Content-Length: " + QByteArray::number(length) + "\r\n";
+    header += "Accept-Ranges: bytes\r\n";
+    header += extra;
+    header += "Connection: keep-alive\r\n\r\n";
+
+    Connection &connection = mConnections[socket];
+    connection.header = header;
+    connection.unit.clear();
+    connection.from = 0;
+    connection.size = header.size();
+    connection.position = 0;
+    connection.stallAt = -1;
+    if( method != "HEAD" && length > 0 )
+    {
+        connection.unit = response.unit;
+        connection.from = from;
+        connection.size += length;
+        if( chance(mFaults.stallRate) )
+        {
+            /// заголовки и половина тела, дальше тишина до закрытия клиентом
+            connection.stallAt = header.size() + length / 2;
+            mFaultCount++;
+        }
+    }
+    send(socket);
+}
+
+void OriginServer::send(QTcpSocket *socket)
+{
+    Connection &connection = mConnections[socket];
+    if( connection.size == 0 )
+        return;
+    if( mFaults.bytesPerSecond > 0 )
+    {
+        /// ограниченные соединения пишет onTick
+        if( !mTimer->isActive() )
+            mTimer->start();
+        return;
+    }
+
+    /// в буфере сокета не больше WRITE_BUFFER_SIZE, остальное - по bytesWritten
+    qint64 limit = connection.stallAt >= 0 ? connection.stallAt : connection.size;
+    qint64 count = qMin(limit - connection.position, WRITE_BUFFER_SIZE - socket->bytesToWrite());
+    if( count > 0 )
+    {
+        write(socket, count);
+    }
+    if( connection.position == connection.size )
+    {
+        finishResponse(socket);
+    }
+}
+
+/// count байт ответа с текущей позиции: заголовки, затем тело из unit
+void OriginServer::write(QTcpSocket *socket, qint64 count)
+{
+    Connection &connection = mConnections[socket];
+    while( count > 0 )
+    {
+        const char *data;
+        qint64 available;
+        if( connection.position < connection.header.size() )
+        {
+            data = connection.header.constData() + connection.position;
+            available = connection.header.size() - connection.position;
+        }
+        else
+        {
+            qint64 offset = (connection.from + connection.position - connection.header.size()) % connection.unit.size();
+            data = connection.unit.constData() + offset;
+            available = connection.unit.size() - offset;
+        }
+        qint64 written = qMin(count, available);
+        socket->write(data, written);
+        mBytesSent += quint64(written);
+        connection.position += written;
+        count -= written;
+    }
+}
+
+void OriginServer::onTick()
+{
+    const int budget = int(qMax<qint64>(1, mFaults.bytesPerSecond / TICKS_PER_SECOND));
+    bool pending = false;
+    foreach(QTcpSocket *socket, mConnections.keys())
+    {
+        Connection &connection = mConnections[socket];
+        if( !connection.busy || connection.size == 0 )
+            continue;
+
+        qint64 limit = connection.stallAt >= 0 ? connection.stallAt : connection.size;
+        qint64 count = qMin<qint64>(budget, limit - connection.position);
+        if( count > 0 )
+        {
+            write(socket, count);
+        }
+        if( connection.position == connection.size )
+        {
+            finishResponse(socket);
+        }
+        else if( connection.position < limit )
+        {
+            pending = true;
+        }
+    }
+    if( !pending )
+    {
+        mTimer->stop();
+    }
+}
+
+void OriginServer::finishResponse(QTcpSocket *socket)
+{
+    Connection &connection = mConnections[socket];
+    connection.header.clear();
+    connection.unit.clear();
+    connection.size = 0;
+    connection.position = 0;
+    connection.busy = false;
+    /// следующий конвейерный запрос - после возврата из текущей записи
+    QTimer::singleShot(0, socket, [this, socket]()
+    {
+        if( mConnections.contains(socket) )
+            processNext(socket);
+    });
+}
+
+OriginServer::Response OriginServer::resolve(const QByteArray &path) const
+{
+    Response response;
+    response.status = 404;
+
+    QByteArray file = path;
+    int query = file.indexOf('?');
+    if( query != -1 )
+        file.truncate(query);
+
+    if( file == "/master.m3u8" )
+    {
+        response.status = 200;
+        response.contentType = "application/vnd.apple.mpegurl";
+        response.unit = mMaster;
+        response.total = mMaster.size();
+        return response;
+    }
+
+    /// /video/<n>/<имя> или /audio/<группа>/<имя>
+    QList<QByteArray> parts = file.split('/');
+    if( parts.size() != 4 || !parts.at(0).isEmpty() )
+        return response;
+    bool ok = false;
+    int index = parts.at(2).toInt(&ok);
+    if( !ok || index < 0 )
+        return response;
+
+    quint32 bandwidth;
+    if( parts.at(1) == "video" && index < mOptions.variants )
+        bandwidth = PlaylistGenerator::averageBandwidth(index);
+    else if( parts.at(1) == "audio" && index < mOptions.audioGroups )
+        bandwidth = PlaylistGenerator::AUDIO_BANDWIDTH;
+    else
+        return response;
+    const int bytes = int(quint64(bandwidth) * PlaylistGenerator::SEGMENT_DURATION_MS / 8000);
+
+    const QByteArray name = parts.at(3);
+    const QByteArray extension = mOptions.fmp4 ? ".m4s" : ".ts";
+    response.contentType = mOptions.fmp4 ? "video/mp4" : "video/mp2t";
+    if( name.endsWith(".m3u8") )
+    {
+        response.contentType = "application/vnd.apple.mpegurl";
+        response.unit = mediaPlaylist(bytes);
+    }
+    else if( mOptions.fmp4 && name == "init.mp4" )
+    {
+        response.unit = PlaylistGenerator::initSegment();
+    }
+    else if( mOptions.byteRange && name == (mOptions.fmp4 ? "main.mp4" : "main.ts") )
+    {
+        response.unit = segment(bytes);
+        int count = mOptions.liveWindow > 0 ? liveSequence() + 1 : mOptions.segments;
+        response.status = 200;
+        response.total = qint64(response.unit.size()) * count;
+        return response;
+    }
+    else if( !mOptions.byteRange && name.startsWith("segment") && name.endsWith(extension) )
+    {
+        int sequence = name.mid(7, name.size() - 7 - extension.size()).toInt(&ok);
+        int last = mOptions.liveWindow > 0 ? liveSequence() : mOptions.segments - 1;
+        if( !ok || sequence < 0 || sequence > last )
+            return response;
+        response.unit = segment(bytes);
+    }
+    else
+    {
+        return response;
+    }
+    response.status = 200;
+    response.total = response.unit.size();
+    return response;
+}
+
+QByteArray OriginServer::mediaPlaylist(int bytes) const
+{
+    PlaylistGenerator::MediaOptions options;
+    options.withBitrate = mOptions.withBitrate;
+    options.fmp4 = mOptions.fmp4;
+    options.byteRange = mOptions.byteRange ? segment(bytes).size() : 0;
+    if( mOptions.liveWindow > 0 )
+    {
+        int last = liveSequence();
+        options.firstSequence = qMax(0, last - mOptions.liveWindow + 1);
+        options.segments = last - options.firstSequence + 1;
+        options.ended = false;
+    }
+    else
+    {
+        options.segments = mOptions.segments;
+    }
+    return PlaylistGenerator::media(options);
+}
+
+/// сегменты одного размера одинаковы, поэтому генерируются один раз
+QByteArray OriginServer::segment(int bytes) const
+{
+    auto it = mSegments.constFind(bytes);
+    if( it != mSegments.constEnd() )
+        return it.value();
+
+    QByteArray data = mOptions.fmp4 ? PlaylistGenerator::fragment(1, bytes)
+                                    : PlaylistGenerator::transportStream(150, bytes);
+    mSegments.insert(bytes, data);
+    return data;
+}
+
+/// последний сегмент живого окна; поток будто начался за окно до запуска
+int OriginServer::liveSequence() const
+{
+    qint64 elapsed = QDateTime::currentMSecsSinceEpoch() - mStartTime;
+    return mOptions.liveWindow - 1 + int(elapsed / PlaylistGenerator::SEGMENT_DURATION_MS);
+}
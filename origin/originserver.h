@@ -0,0 +1,120 @@
+#pragma once
+
+#include <QObject>
+
+#include <QHash>
+#include <QHostAddress>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+/// Тестовый HLS-origin: мастер- и медиа-плейлисты и пустые сегменты TS или
+/// fMP4 генерируются на лету через PlaylistGenerator, размеры сегментов -
+/// по AVERAGE-BANDWIDTH вариантов. Минимальный HTTP/1.1: GET и HEAD,
+/// keep-alive, конвейерные запросы и Range. На каждый запрос можно добавить
+/// задержку, ограничить скорость соединения, вернуть ошибку или зависнуть
+/// посреди тела - так сеть, планировщик и таймауты проверяются без CDN.
+///
+/// Пути: /master.m3u8, /video/<n>/prog_index.m3u8, /audio/<группа>/<имя>.m3u8,
+/// сегменты - рядом с плейлистом (segment<n>.ts, segment<n>.m4s, init.mp4,
+/// main.ts/main.mp4 для EXT-X-BYTERANGE).
+class OriginServer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options
+    {
+        int variants = 4;
+        int audioGroups = 1;
+        int languages = 2;
+        int segments = 100;
+        bool withBitrate = false;
+        bool fmp4 = false;
+        /// сегменты - диапазоны одного файла
+        bool byteRange = false;
+        /// >0 - живой поток: окно из стольких сегментов сдвигается в реальном времени
+        int liveWindow = 0;
+    };
+
+    struct Faults
+    {
+        int latencyMs = 0;          // перед заголовками ответа
+        int jitterMs = 0;           // к задержке добавляется случайное 0..jitterMs
+        qint64 bytesPerSecond = 0;  // на соединение, 0 - без ограничения
+        qreal errorRate = 0;        // доля запросов, на которые отвечает errorStatus
+        int errorStatus = 503;
+        qreal stallRate = 0;        // доля ответов, которые замолкают на середине тела
+    };
+
+    explicit OriginServer(QObject *parent = nullptr);
+
+    void setOptions(const Options &options);
+    void setFaults(const Faults &faults);
+
+    bool listen(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 0);
+    quint16 port() const;
+    QString masterUrl() const;
+    QString errorString() const;
+
+    quint64 requestCount() const;
+    quint64 bytesSent() const;
+    /// ответов с ошибкой или зависших по Faults
+    quint64 faultCount() const;
+
+private:
+    struct Connection
+    {
+        QByteArray input;
+        /// ответ: header, затем unit по кругу с байта from, всего size байт;
+        /// тело порождается по мере записи
+        QByteArray header;
+        QByteArray unit;
+        qint64 from = 0;
+        qint64 size = 0; //0 - ответ ещё не готов
+        qint64 position = 0;
+        /// ответ готовится или ещё пишется - следующий запрос ждёт
+        bool busy = false;
+        /// после stallAt байт ответа он замолкает, -1 - не замолкает
+        qint64 stallAt = -1;
+    };
+
+    struct Response
+    {
+        int status = 200;
+        QByteArray contentType;
+        /// тело - unit, повторённый до total байт: так файл EXT-X-BYTERANGE
+        /// не собирается целиком
+        QByteArray unit;
+        qint64 total = 0;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    void processNext(QTcpSocket *socket);
+    void respond(QTcpSocket *socket, const QByteArray &method, const QByteArray &path, const QByteArray &range);
+    void send(QTcpSocket *socket);
+    void write(QTcpSocket *socket, qint64 count);
+    void onTick();
+    void finishResponse(QTcpSocket *socket);
+
+    Response resolve(const QByteArray &path) const;
+    QByteArray mediaPlaylist(int bytes) const;
+    QByteArray segment(int bytes) const;
+    int liveSequence() const;
+
+private:
+    QTcpServer *mServer;
+    QTimer *mTimer;
+    Options mOptions;
+    Faults mFaults;
+    qint64 mStartTime;
+
+    QHash<QTcpSocket *, Connection> mConnections;
+    mutable QHash<int, QByteArray> mSegments;
+    QByteArray mMaster;
+
+    quint64 mRequestCount;
+    quint64 mBytesSent;
+    quint64 mFaultCount;
+};
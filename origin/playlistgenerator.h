@@ -0,0 +1,222 @@
+#pragma once
+
+#include <QByteArray>
+
+/// Синтетические плейлисты и сегменты для бенчмарков и тестового origin
+class PlaylistGenerator
+{
+public:
+    static const int SEGMENT_DURATION_MS = 6006;
+    static const quint32 AUDIO_BANDWIDTH = 128000; //in bits per second
+
+    struct MediaOptions
+    {
+        int firstSequence = 0;
+        int segments = 0;
+        /// VOD: EXT-X-PLAYLIST-TYPE и EXT-X-ENDLIST; иначе - окно живого потока
+        bool ended = true;
+        bool withBitrate = false;
+        /// EXT-X-MAP:URI="init.mp4" и сегменты .m4s вместо .ts
+        bool fmp4 = false;
+        /// >0 - сегменты идут диапазонами такой длины в одном файле main.ts/main.mp4
+        int byteRange = 0;
+    };
+
+    /// AVERAGE-BANDWIDTH варианта index в master()
+    static quint32 averageBandwidth(int index)
+    {
+        return quint32(300000 + index * 25000);
+    }
+
+    /// мастер-плейлист: variants Variant Stream'ов и audioGroups групп аудио
+    /// по languages языков в каждой
+    static QByteArray master(int variants, int audioGroups = 2, int languages = 4)
+    {
+        QByteArray data;
+        data.reserve(variants * 256 + audioGroups * languages * 160);
+        data += "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-INDEPENDENT-SEGMENTS\n";
+
+        static const char *codes[] = { "en", "ru", "de", "fr", "es", "it", "ja", "zh" };
+        for( int group = 0; group < audioGroups; ++group )
+        {
+            for( int language = 0; language < languages; ++language )
+            {
+                const char *code = codes[language % 8];
+                data += "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"aud" + QByteArray::number(group)
+                        + "\",LANGUAGE=\"" + code + "\",NAME=\"" + code + QByteArray::number(language)
+                        + "\",AUTOSELECT=YES,DEFAULT=" + (language == 0 ? "YES" : "NO")
+                        + ",CHANNELS=\"2\",URI=\"audio/" + QByteArray::number(group) + "/" + code
+                        + QByteArray::number(language) + ".m3u8\"\n";
+            }
+        }
+
+        for( int i = 0; i < variants; ++i )
+        {
+            QByteArray average = QByteArray::number(averageBandwidth(i));
+            QByteArray peak = QByteArray::number(400000 + i * 30000);
+            data += "#EXT-X-STREAM-INF:AVERAGE-BANDWIDTH=" + average + ",BANDWIDTH=" + peak
+                    + ",CODECS=\"avc1.640028,mp4a.40.2\",RESOLUTION=" + QByteArray::number(320 + (i % 50) * 32)
+                    + "x" + QByteArray::number(180 + (i % 50) * 18)
+                    + ",FRAME-RATE=29.970,CLOSED-CAPTIONS=NONE";
+            /// без групп аудио ссылаться не на что
+            if( audioGroups > 0 )
+                data += ",AUDIO=\"aud" + QByteArray::number(i % audioGroups) + "\"";
+            data += "\n";
+            data += "video/" + QByteArray::number(i) + "/prog_index.m3u8\n";
+        }
+        return data;
+    }
+
+    /// медиа-плейлист VOD из segments сегментов по 6 секунд
+    static QByteArray media(int segments, bool withBitrate)
+    {
+        MediaOptions options;
+        options.segments = segments;
+        options.withBitrate = withBitrate;
+        return media(options);
+    }
+
+    static QByteArray media(const MediaOptions &options)
+    {
+        QByteArray data;
+        data.reserve(options.segments * 64 + 160);
+        data += "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:6\n";
+        if( options.ended )
+        {
+            data += "#EXT-X-PLAYLIST-TYPE:VOD\n";
+        }
+        data += "#EXT-X-MEDIA-SEQUENCE:" + QByteArray::number(options.firstSequence) + "\n";
+        if( options.fmp4 )
+        {
+            data += "#EXT-X-MAP:URI=\"init.mp4\"\n";
+        }
+
+        const QByteArray extension = options.fmp4 ? ".m4s" : ".ts";
+        const QByteArray file = options.fmp4 ? "main.mp4\n" : "main.ts\n";
+        for( int i = options.firstSequence; i < options.firstSequence + options.segments; ++i )
+        {
+            if( options.withBitrate )
+            {
+                data += "#EXT-X-BITRATE:" + QByteArray::number(2000 + (i * 7919) % 1500) + "\n";
+            }
+            data += "#EXTINF:6.006,\n";
+            if( options.byteRange > 0 )
+            {
+                data += "#EXT-X-BYTERANGE:" + QByteArray::number(options.byteRange) + "@"
+                        + QByteArray::number(qint64(i) * options.byteRange) + "\n" + file;
+            }
+            else
+            {
+                data += "segment" + QByteArray::number(i) + extension + "\n";
+            }
+        }
+        if( options.ended )
+        {
+            data += "#EXT-X-ENDLIST\n";
+        }
+        return data;
+    }
+
+    /// сегмент MPEG-TS: PAT, PMT (AVC на 0x100, AAC на 0x101), frames кадров
+    /// по 25 в секунду, на каждый кадр 11 пакетов видео и пакет аудио
+    static QByteArray transportStream(int frames)
+    {
+        QByteArray data;
+        data.reserve((frames * 12 + 2) * 188);
+        packet(data, 0x0000, QByteArray("\x00\x00\xb0\x0d\x00\x01\xc1\x00\x00\x00\x01\xf0\x00" "CRC!", 17));
+        packet(data, 0x1000, QByteArray("\x00\x02\xb0\x17\x00\x01\xc1\x00\x00\xe1\x00\xf0\x00"
+                                        "\x1b\xe1\x00\xf0\x00\x0f\xe1\x01\xf0\x00" "CRC!", 27));
+        for( int i = 0; i < frames; ++i )
+        {
+            qint64 pts = 900000 + qint64(i) * 3600;
+            QByteArray header("\x00\x00\x01\xe0\x00\x00\x80\x80\x05", 9);
+            header += char(0x21 | ((pts >> 29) & 0x0e));
+            header += char((pts >> 22) & 0xff);
+            header += char(0x01 | ((pts >> 14) & 0xfe));
+            header += char((pts >> 7) & 0xff);
+            header += char(0x01 | ((pts << 1) & 0xfe));
+
+            packet(data, 0x100, header + QByteArray(170, 'v'), true);
+            for( int k = 0; k < 10; ++k )
+            {
+                packet(data, 0x100, QByteArray(184, 'v'), false);
+            }
+            header[3] = char(0xc0);
+            packet(data, 0x101, header + QByteArray(100, 'a'), true);
+        }
+        return data;
+    }
+
+    /// то же размером около bytes: кадров столько, сколько помещается, а
+    /// хвост добивается пустыми пакетами (PID 0x1fff)
+    static QByteArray transportStream(int frames, int bytes)
+    {
+        frames = qMax(1, qMin(frames, (bytes / 188 - 2) / 12));
+        QByteArray data = transportStream(frames);
+        while( data.size() + 188 <= bytes )
+        {
+            packet(data, 0x1fff, QByteArray(184, char(0xff)), false);
+        }
+        return data;
+    }
+
+    /// init-сегмент fMP4: ftyp и moov с одним mvhd, без дорожек
+    static QByteArray initSegment()
+    {
+        QByteArray mvhd(100, '\0');
+        mvhd[14] = char(0x03);              // timescale 1000
+        mvhd[15] = char(0xe8);
+        mvhd[21] = char(0x01);              // rate 1.0
+        mvhd[24] = char(0x01);              // volume 1.0
+        return box("ftyp", QByteArray("iso6\0\0\0\0iso6cmfc", 16)) + box("moov", box("mvhd", mvhd));
+    }
+
+    /// фрагмент fMP4 размером bytes: moof с mfhd и mdat-заполнитель
+    static QByteArray fragment(int sequence, int bytes)
+    {
+        QByteArray mfhd(8, '\0');
+        mfhd[4] = char(sequence >> 24);
+        mfhd[5] = char(sequence >> 16);
+        mfhd[6] = char(sequence >> 8);
+        mfhd[7] = char(sequence);
+        QByteArray moof = box("moof", box("mfhd", mfhd));
+        return moof + box("mdat", QByteArray(qMax(0, bytes - moof.size() - 8), 'm'));
+    }
+
+private:
+    static QByteArray box(const char *type, const QByteArray &payload)
+    {
+        const int size = payload.size() + 8;
+        QByteArray data;
+        data.reserve(size);
+        data += char(size >> 24);
+        data += char(size >> 16);
+        data += char(size >> 8);
+        data += char(size);
+        data += QByteArray(type, 4);
+        data += payload;
+        return data;
+    }
+
+    /// пакет 188 байт; короткая нагрузка выравнивается полем адаптации
+    static void packet(QByteArray &data, int pid, const QByteArray &payload, bool unitStart = true)
+    {
+        char header[5] = { 0x47, char((unitStart ? 0x40 : 0) | (pid >> 8)), char(pid & 0xff), 0x10, 0 };
+        if( payload.size() >= 184 )
+        {
+            data.append(header, 4);
+            data.append(payload.constData(), 184);
+            return;
+        }
+        int stuffing = 183 - payload.size();
+        header[3] = 0x30;
+        header[4] = char(stuffing);
+        data.append(header, 5);
+        if( stuffing > 0 )
+        {
+            data += char(0x00);
+            data += QByteArray(stuffing - 1, char(0xff));
+        }
+        data += payload;
+    }
+};
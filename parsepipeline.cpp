@@ -0,0 +1,238 @@
+#include "parsepipeline.h"
+
+#include <QCryptographicHash>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "arena.h"
+#include "mediaplaylistparser.h"
+
+const qint64 DEFAULT_MAXIMUM_QUEUED_BYTES = 4 * 1024 * 1024;
+
+/// Состояние одной задачи. Парсер и хеш трогает только рабочий поток,
+/// запущенный для задачи (running), очередь порций - под мьютексом.
+struct ParsePipeline::Task
+{
+    explicit Task(bool hashContent)
+        : hash(QCryptographicHash::Sha1)
+        , hashContent(hashContent)
+        , closed(false)
+        , cancelled(false)
+        , running(false)
+    {
+    }
+
+    MediaPlaylistParser parser;
+    QCryptographicHash hash;
+    bool hashContent;
+    QQueue<QByteArray> chunks;
+    bool closed;
+    bool cancelled;
+    bool running;
+};
+
+/// Общее состояние живёт дольше конвейера, пока его держат рабочие потоки
+struct ParsePipeline::State
+{
+    QMutex mutex;
+    ParsePipeline *pipeline = nullptr;
+    QHash<quint64, QSharedPointer<Task>> tasks;
+    QList<Result> results;
+    quint64 nextTask = 1;
+    qint64 queuedBytes = 0;
+    qint64 maximumQueuedBytes = DEFAULT_MAXIMUM_QUEUED_BYTES;
+    bool resultsNotified = false;
+    bool capacityWanted = false;
+};
+
+class ParsePipeline::Runnable : public QRunnable
+{
+public:
+    Runnable(const QSharedPointer<State> &state, quint64 id, const QSharedPointer<Task> &task)
+        : mState(state)
+        , mId(id)
+        , mTask(task)
+    {
+    }
+
+    void run() override
+    {
+        forever
+        {
+            QByteArray chunk;
+            {
+                QMutexLocker locker(&mState->mutex);
+                if( mTask->cancelled || (mTask->chunks.isEmpty() && !mTask->closed) )
+                {
+                    mTask->running = false;
+                    return;
+                }
+                if( mTask->chunks.isEmpty() )
+                    break;
+                chunk = mTask->chunks.dequeue();
+            }
+
+            mTask->parser.feed(chunk);
+            if( mTask->hashContent )
+            {
+                mTask->hash.addData(chunk);
+            }
+
+            QMutexLocker locker(&mState->mutex);
+            mState->queuedBytes -= chunk.size();
+            if( mState->capacityWanted && mState->queuedBytes < mState->maximumQueuedBytes )
+            {
+                mState->capacityWanted = false;
+                notify(&ParsePipeline::capacityAvailable);
+            }
+        }
+
+        mTask->parser.finish();
+        Result result;
+        result.task = mId;
+        result.valid = mTask->parser.isValid();
+        result.averageBitrate = mTask->parser.averageBitrate();
+        result.segmentCount = mTask->parser.segmentCount();
+        result.sampledSegments = mTask->parser.sampledSegments();
+        result.segments = mTask->parser.segmentStore();
+        if( mTask->hashContent )
+        {
+            result.contentHash = mTask->hash.result();
+        }
+
+        QMutexLocker locker(&mState->mutex);
+        mTask->running = false;
+        if( mTask->cancelled )
+            return;
+        mState->tasks.remove(mId);
+        mState->results.append(result);
+        if( !mState->resultsNotified )
+        {
+            mState->resultsNotified = true;
+            notify(&ParsePipeline::resultsReady);
+        }
+    }
+
+private:
+    /// вызывается под мьютексом: конвейер не может исчезнуть посередине
+    void notify(void (ParsePipeline::*signal)())
+    {
+        ParsePipeline *pipeline = mState->pipeline;
+        if( !pipeline )
+            return;
+        QMetaObject::invokeMethod(pipeline, [pipeline, signal]()
+        {
+            emit (pipeline->*signal)();
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    QSharedPointer<State> mState;
+    quint64 mId;
+    QSharedPointer<Task> mTask;
+};
+
+ParsePipeline::ParsePipeline(QObject *parent)
+    : QObject(parent)
+    , mState(new State)
+{
+    mState->pipeline = this;
+}
+
+ParsePipeline::~ParsePipeline()
+{
+    QMutexLocker locker(&mState->mutex);
+    mState->pipeline = nullptr;
+    foreach(const QSharedPointer<Task> &task, mState->tasks)
+    {
+        task->cancelled = true;
+        task->chunks.clear();
+    }
+    mState->tasks.clear();
+}
+
+void ParsePipeline::setMaximumQueuedBytes(qint64 bytes)
+{
+    QMutexLocker locker(&mState->mutex);
+    mState->maximumQueuedBytes = bytes;
+}
+
+quint64 ParsePipeline::open(bool hashContent, int sampleInterval, const QSharedPointer<Arena> &arena)
+{
+    QSharedPointer<Task> task(new Task(hashContent));
+    task->parser.setSampleInterval(sampleInterval);
+    task->parser.setArena(arena ? arena : QSharedPointer<Arena>(new Arena));
+
+    QMutexLocker locker(&mState->mutex);
+    quint64 id = mState->nextTask++;
+    mState->tasks.insert(id, task);
+    return id;
+}
+
+void ParsePipeline::push(quint64 task, const QByteArray &chunk)
+{
+    if( chunk.isEmpty() )
+        return;
+
+    QMutexLocker locker(&mState->mutex);
+    QSharedPointer<Task> t = mState->tasks.value(task);
+    if( !t || t->closed )
+        return;
+    t->chunks.enqueue(chunk);
+    mState->queuedBytes += chunk.size();
+    schedule(mState, task, t);
+}
+
+void ParsePipeline::close(quint64 task)
+{
+    QMutexLocker locker(&mState->mutex);
+    QSharedPointer<Task> t = mState->tasks.value(task);
+    if( !t )
+        return;
+    t->closed = true;
+    schedule(mState, task, t);
+}
+
+void ParsePipeline::cancel(quint64 task)
+{
+    QMutexLocker locker(&mState->mutex);
+    QSharedPointer<Task> t = mState->tasks.take(task);
+    if( !t )
+        return;
+    t->cancelled = true;
+    foreach(const QByteArray &chunk, t->chunks)
+    {
+        mState->queuedBytes -= chunk.size();
+    }
+    t->chunks.clear();
+}
+
+bool ParsePipeline::hasCapacity() const
+{
+    QMutexLocker locker(&mState->mutex);
+    if( mState->queuedBytes < mState->maximumQueuedBytes )
+        return true;
+    mState->capacityWanted = true;
+    return false;
+}
+
+QList<ParsePipeline::Result> ParsePipeline::takeResults()
+{
+    QMutexLocker locker(&mState->mutex);
+    mState->resultsNotified = false;
+    QList<Result> results;
+    results.swap(mState->results);
+    return results;
+}
+
+/// вызывается под мьютексом
+void ParsePipeline::schedule(const QSharedPointer<State> &state, quint64 id, const QSharedPointer<Task> &task)
+{
+    if( task->running )
+        return;
+    task->running = true;
+    QThreadPool::globalInstance()->start(new Runnable(state, id, task));
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QObject>
+
+#include <QList>
+#include <QSharedPointer>
+
+#include "segmentrecord.h"
+#include "segmentstore.h"
+
+/// Конвейер разбора медиа-плейлистов. Сетевая сторона отдаёт неизменяемые
+/// порции QByteArray, разбор идёт в глобальном QThreadPool (по числу ядер),
+/// порции одной задачи обрабатываются строго по очереди. Объём ожидающих
+/// данных ограничен: пока очередь полна, hasCapacity() возвращает false,
+/// и читающая сторона должна притормозить. Готовые результаты копятся в
+/// одной очереди и забираются владельцем в его потоке через takeResults().
+class ParsePipeline : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        quint64 task = 0;
+        bool valid = false;
+        quint32 averageBitrate = 0;
+        quint32 segmentCount = 0;
+        QByteArray contentHash;
+        /// каждый N-й сегмент для глубокой проверки
+        QVector<SampledSegment> sampledSegments;
+        /// все сегменты; по ним считаются шкалы и размеры, см. scanSegments()
+        SegmentStore segments;
+    };
+
+    explicit ParsePipeline(QObject *parent = nullptr);
+    ~ParsePipeline();
+
+    void setMaximumQueuedBytes(qint64 bytes);
+
+    /// новая задача; при hashContent считается SHA-1 всего тела,
+    /// sampleInterval - см. SampledSegments; сегменты сохраняются в
+    /// Result::segments в arena, без неё - в собственной арене задачи
+    quint64 open(bool hashContent, int sampleInterval = 0, const QSharedPointer<Arena> &arena = QSharedPointer<Arena>());
+    void push(quint64 task, const QByteArray &chunk);
+    /// данных больше не будет - после разбора хвоста появится результат
+    void close(quint64 task);
+    /// задача отменена - результата не будет
+    void cancel(quint64 task);
+
+    bool hasCapacity() const;
+    QList<Result> takeResults();
+
+signals:
+    /// в очереди появились результаты; несколько готовых задач дают один сигнал
+    void resultsReady();
+    /// очередь порций опустела ниже предела
+    void capacityAvailable();
+
+private:
+    struct Task;
+    struct State;
+    class Runnable;
+
+    static void schedule(const QSharedPointer<State> &state, quint64 id, const QSharedPointer<Task> &task);
+
+private:
+    QSharedPointer<State> mState;
+};
@@ -0,0 +1,179 @@
+#include "peakbitrate.h"
+
+#include <algorithm>
+
+static quint32 toBitsPerSecond(quint32 kbps)
+{
+    return quint32(qMin<quint64>(quint64(kbps) * 1000, 0xffffffffu));
+}
+
+/// Сегменты SegmentStore по порядку с концом каждого на шкале плейлиста
+struct StoreCursor
+{
+    explicit StoreCursor(const SegmentStore &store)
+        : store(store)
+        , index(0)
+        , endUs(store.count() ? store.durationUs(0) : 0)
+    {
+    }
+
+    bool atEnd() const
+    {
+        return index >= store.count();
+    }
+
+    quint32 endMs() const
+    {
+        return quint32(endUs / 1000);
+    }
+
+    void next()
+    {
+        if( ++index < store.count() )
+            endUs += store.durationUs(index);
+    }
+
+    const SegmentStore &store;
+    int index;
+    quint64 endUs;
+};
+
+PeakBitrateCheck::PeakBitrateCheck(quint32 windowMs, int maximumRanges)
+    : mWindowMs(windowMs)
+    , mMaximumRanges(maximumRanges)
+{
+}
+
+quint32 PeakBitrateCheck::run(const SegmentStore &video, const SegmentStore &audio, quint32 declared,
+                              QVector<PeakRange> *ranges) const
+{
+    if( ranges )
+        ranges->clear();
+
+    BitrateTimeline timeline = merge(video, audio);
+    const int n = timeline.size();
+
+    quint32 peak = 0;
+    for( int i = 0; i < n; ++i )
+    {
+        peak = qMax(peak, timeline.at(i).bitrate);
+    }
+    if( declared == 0 || !ranges || toBitsPerSecond(peak) <= declared )
+        return toBitsPerSecond(peak);
+
+    /// индексы отрезков окна по убыванию битрейта: в голове - максимум окна
+    QVector<int> window(n);
+    int head = 0;
+    int tail = 0;
+    int next = 0;
+
+    QVector<PeakRange> found;
+    PeakRange current;
+    bool open = false;
+    for( int i = 0; i < n; ++i )
+    {
+        const TimelineSegment &segment = timeline.at(i);
+        quint64 windowEnd = quint64(segment.startMs) + mWindowMs;
+        while( next < n && (next <= i || timeline.at(next).startMs < windowEnd) )
+        {
+            while( tail > head && timeline.at(window.at(tail - 1)).bitrate <= timeline.at(next).bitrate )
+                --tail;
+            window[tail++] = next++;
+        }
+        while( window.at(head) < i )
+            ++head;
+
+        if( toBitsPerSecond(timeline.at(window.at(head)).bitrate) <= declared )
+        {
+            /// до конца окна превышений нет - эпизод закончился
+            if( open )
+            {
+                found.append(current);
+                open = false;
+            }
+            continue;
+        }
+
+        quint32 bitrate = toBitsPerSecond(segment.bitrate);
+        if( bitrate <= declared )
+            continue;
+        if( !open )
+        {
+            current = PeakRange();
+            current.startMs = segment.startMs;
+            open = true;
+        }
+        current.endMs = segment.startMs + segment.durationMs;
+        current.peakBitrate = qMax(current.peakBitrate, bitrate);
+    }
+    if( open )
+    {
+        found.append(current);
+    }
+
+    std::sort(found.begin(), found.end(), [](const PeakRange &left, const PeakRange &right)
+    {
+        return left.peakBitrate > right.peakBitrate;
+    });
+    if( found.size() > mMaximumRanges )
+    {
+        found.resize(mMaximumRanges);
+    }
+    std::sort(found.begin(), found.end(), [](const PeakRange &left, const PeakRange &right)
+    {
+        return left.startMs < right.startMs;
+    });
+    *ranges = found;
+    return toBitsPerSecond(peak);
+}
+
+/// Общая шкала варианта: на каждом отрезке битрейты видео и аудио
+/// складываются; если один из них не задан, сумма тоже считается неизвестной.
+/// Где один плейлист кончился (или его нет вовсе), хвост другого идёт сам
+/// по себе - иначе превышения в конце более длинного не видны
+BitrateTimeline PeakBitrateCheck::merge(const SegmentStore &video, const SegmentStore &audio)
+{
+    BitrateTimeline merged;
+    merged.reserve(video.count() + audio.count());
+
+    StoreCursor v(video);
+    StoreCursor a(audio);
+    quint32 position = 0;
+    while( !v.atEnd() || !a.atEnd() )
+    {
+        quint32 end;
+        quint32 bitrate;
+        if( a.atEnd() )
+        {
+            end = v.endMs();
+            bitrate = video.bitrate(v.index);
+        }
+        else if( v.atEnd() )
+        {
+            end = a.endMs();
+            bitrate = audio.bitrate(a.index);
+        }
+        else
+        {
+            end = qMin(v.endMs(), a.endMs());
+            quint32 videoBitrate = video.bitrate(v.index);
+            quint32 audioBitrate = audio.bitrate(a.index);
+            bitrate = videoBitrate && audioBitrate ? videoBitrate + audioBitrate : 0;
+        }
+
+        if( end > position )
+        {
+            TimelineSegment segment;
+            segment.startMs = position;
+            segment.durationMs = end - position;
+            segment.bitrate = bitrate;
+            merged.append(segment);
+            position = end;
+        }
+        if( !v.atEnd() && v.endMs() == end )
+            v.next();
+        if( !a.atEnd() && a.endMs() == end )
+            a.next();
+    }
+    return merged;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QVector>
+
+#include "segmentrecord.h"
+#include "segmentstore.h"
+#include "streams.h"
+
+/// Проверка пикового битрейта Variant Stream'а: BANDWIDTH по RFC 8216
+/// (4.3.4.2) - это пиковый битрейт сегментов, а не среднее.
+/// Сегменты видео и аудио (битрейт - по размерам в SegmentStore) сливаются
+/// в общую шкалу за O(n + m), она живёт только на время run(); монотонная
+/// очередь даёт максимум битрейта в каждом окне длиной window за O(n).
+/// Окна с превышением, идущие подряд, склеиваются в один диапазон, так что
+/// превышения, разделённые промежутком короче окна, считаются одним эпизодом.
+class PeakBitrateCheck
+{
+public:
+    explicit PeakBitrateCheck(quint32 windowMs, int maximumRanges = 5);
+
+    /// Возвращает измеренный пик в bps; худшие по пику диапазоны, где он
+    /// больше declared, попадают в ranges в порядке времени
+    quint32 run(const SegmentStore &video, const SegmentStore &audio, quint32 declared,
+                QVector<PeakRange> *ranges) const;
+
+private:
+    static BitrateTimeline merge(const SegmentStore &video, const SegmentStore &audio);
+
+private:
+    quint32 mWindowMs;
+    int mMaximumRanges;
+};
@@ -0,0 +1,143 @@
+#include "playlistcache.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QStandardPaths>
+
+const quint32 RESULTS_MAGIC = 0x484c5352; // "HLSR"
+const quint32 RESULTS_VERSION = 3;
+const int DEFAULT_MAXIMUM_RESULTS = 100000;
+const qint64 DEFAULT_MAXIMUM_SIZE = 512 * 1024 * 1024;
+
+PlaylistCache::PlaylistCache(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , mDirectory(directory)
+    , mDiskCache(new QNetworkDiskCache(this))
+    , mResults(DEFAULT_MAXIMUM_RESULTS)
+{
+    QDir().mkpath(mDirectory);
+    mDiskCache->setCacheDirectory(QDir(mDirectory).filePath("http"));
+    mDiskCache->setMaximumCacheSize(DEFAULT_MAXIMUM_SIZE);
+
+    load();
+}
+
+PlaylistCache::~PlaylistCache()
+{
+    save();
+}
+
+QString PlaylistCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+}
+
+void PlaylistCache::install(QNetworkAccessManager *accessManager)
+{
+    /// QNetworkAccessManager становится владельцем кэша
+    accessManager->setCache(mDiskCache);
+}
+
+void PlaylistCache::setMaximumSize(qint64 bytes)
+{
+    mDiskCache->setMaximumCacheSize(bytes);
+}
+
+void PlaylistCache::setMaximumResults(int count)
+{
+    mResults.setMaxCost(count);
+}
+
+bool PlaylistCache::lookup(const QString &url, const QByteArray &contentHash, Result *result)
+{
+    Entry *entry = mResults.object(url);
+    if( !entry || entry->contentHash != contentHash )
+    {
+        mStatistics.resultMisses++;
+        return false;
+    }
+
+    mStatistics.resultHits++;
+    *result = entry->result;
+    return true;
+}
+
+void PlaylistCache::store(const QString &url, const QByteArray &contentHash, const Result &result)
+{
+    Entry *entry = new Entry;
+    entry->contentHash = contentHash;
+    entry->result = result;
+    mResults.insert(url, entry);
+}
+
+void PlaylistCache::recordReply(bool fromCache)
+{
+    if( fromCache )
+        mStatistics.networkHits++;
+    else
+        mStatistics.networkMisses++;
+}
+
+const PlaylistCache::Statistics &PlaylistCache::statistics() const
+{
+    return mStatistics;
+}
+
+QString PlaylistCache::statisticsString() const
+{
+    return QString("из кэша %1, из сети %2, результатов разбора найдено %3, не найдено %4, на диске %5 КБ")
+            .arg(mStatistics.networkHits).arg(mStatistics.networkMisses)
+            .arg(mStatistics.resultHits).arg(mStatistics.resultMisses)
+            .arg(mDiskCache ? mDiskCache->cacheSize() / 1024 : 0);
+}
+
+void PlaylistCache::save() const
+{
+    QFile file(QDir(mDirectory).filePath("results.dat"));
+    if( !file.open(QIODevice::WriteOnly) )
+        return;
+
+    QDataStream stream(&file);
+    stream << RESULTS_MAGIC << RESULTS_VERSION;
+
+    QList<QString> urls = mResults.keys();
+    stream << quint32(urls.size());
+    foreach(auto &url, urls)
+    {
+        const Entry *entry = mResults.object(url);
+        const Result &result = entry->result;
+        stream << url << entry->contentHash << result.averageBitrate << result.segmentCount << result.durationsUs << result.sizes;
+    }
+}
+
+void PlaylistCache::load()
+{
+    QFile file(QDir(mDirectory).filePath("results.dat"));
+    if( !file.open(QIODevice::ReadOnly) )
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic, version;
+    stream >> magic >> version;
+    if( magic != RESULTS_MAGIC || version != RESULTS_VERSION )
+        return;
+
+    quint32 count;
+    stream >> count;
+    for( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+    {
+        QString url;
+        Entry *entry = new Entry;
+        Result &result = entry->result;
+        stream >> url >> entry->contentHash >> result.averageBitrate >> result.segmentCount >> result.durationsUs >> result.sizes;
+        if( stream.status() != QDataStream::Ok )
+        {
+            delete entry;
+            break;
+        }
+        mResults.insert(url, entry);
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QObject>
+
+#include <QByteArray>
+#include <QCache>
+#include <QPointer>
+#include <QNetworkDiskCache>
+#include <QString>
+#include <QVector>
+
+class QNetworkAccessManager;
+
+/// Кэш плейлистов на диске. Тела ответов хранит QNetworkDiskCache:
+/// устаревшие записи перепроверяются через If-None-Match/If-Modified-Since,
+/// и ответ 304 отдаётся с диска. Вдобавок по url хранятся результаты разбора
+/// медиа-плейлистов вместе с хэшем разобранного тела: результат отдаётся,
+/// только если хэш полученного тела совпал, так что неизменившийся плейлист
+/// не разбирается повторно, а изменившийся - не подменяется старым.
+class PlaylistCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        quint32 averageBitrate = 0; //in bits per second
+        quint32 segmentCount = 0;
+        /// столбцы SegmentStore для проверки пиков: длительности и размеры (0 - неизвестен)
+        QVector<quint32> durationsUs;
+        QVector<quint32> sizes;
+    };
+
+    struct Statistics
+    {
+        quint64 networkHits = 0;
+        quint64 networkMisses = 0;
+        quint64 resultHits = 0;
+        quint64 resultMisses = 0;
+    };
+
+    explicit PlaylistCache(const QString &directory, QObject *parent = nullptr);
+    ~PlaylistCache();
+
+    static QString defaultDirectory();
+
+    void install(QNetworkAccessManager *accessManager);
+
+    void setMaximumSize(qint64 bytes);
+    void setMaximumResults(int count);
+
+    /// результат для url, если он был получен разбором тела с хэшем contentHash
+    bool lookup(const QString &url, const QByteArray &contentHash, Result *result);
+    void store(const QString &url, const QByteArray &contentHash, const Result &result);
+
+    void recordReply(bool fromCache);
+
+    const Statistics &statistics() const;
+    QString statisticsString() const;
+
+    void save() const;
+
+private:
+    /// хэш и результат вытесняются вместе
+    struct Entry
+    {
+        QByteArray contentHash;
+        Result result;
+    };
+
+    void load();
+
+private:
+    QString mDirectory;
+    QPointer<QNetworkDiskCache> mDiskCache;
+
+    QCache<QString, Entry> mResults;
+
+    Statistics mStatistics;
+};
@@ -0,0 +1,186 @@
+#include "playlistmetrics.h"
+
+#include <cmath>
+
+/// kbps по размеру сегмента блока; 0 - размер или длительность неизвестны
+static quint32 segmentBitrate(const SegmentStore::Columns &columns, int i)
+{
+    if( columns.durationsUs[i] == 0 )
+        return 0;
+    /// байты * 8000 / мкс = кбит/с
+    return quint32(qMin<quint64>(quint64(columns.sizes[i]) * 8000 / columns.durationsUs[i], 0xffffffffu));
+}
+
+void BitrateMean::add(const SegmentRecord &record, const PlaylistInfo &)
+{
+    if( record.bitrate == 0 )
+        return;
+
+    quint64 durationMs = record.durationUs / 1000;
+    mWeightedSum += quint64(record.bitrate) * durationMs;
+    mWeight += durationMs;
+    mSum += record.bitrate;
+    mCount++;
+}
+
+void BitrateMean::add(const SegmentStore::Columns &columns, const PlaylistInfo &)
+{
+    for( int i = 0; i < columns.count; ++i )
+    {
+        if( columns.sizes[i] == 0 )
+            continue;
+
+        /// байты * 8 = кбит/с * мс
+        mWeightedSum += quint64(columns.sizes[i]) * 8;
+        mWeight += columns.durationsUs[i] / 1000;
+        mSum += segmentBitrate(columns, i);
+        mCount++;
+    }
+}
+
+void BitrateMean::finish(const PlaylistInfo &)
+{
+}
+
+quint32 BitrateMean::bitrateCount() const
+{
+    return mCount;
+}
+
+quint32 BitrateMean::averageBitrate() const
+{
+    if( mCount == 0 )
+        return 0;
+    if( mWeight == 0 )
+        return quint32((mSum * 1000) / mCount);
+    /// делим до умножения на 1000, чтобы сумма не переполнилась
+    return quint32((mWeightedSum / mWeight) * 1000 + ((mWeightedSum % mWeight) * 1000) / mWeight);
+}
+
+void UnsizedSegments::add(const SegmentStore::Columns &columns, const PlaylistInfo &)
+{
+    for( int i = 0; i < columns.count; ++i )
+    {
+        if( columns.sizes[i] == 0 && !(columns.flags[i] & SegmentStore::ByteRange) && columns.durationsUs[i] > 0 )
+            mSegments.append(columns.first + i);
+    }
+}
+
+void UnsizedSegments::finish(const PlaylistInfo &)
+{
+}
+
+const QVector<int> &UnsizedSegments::unsizedSegments() const
+{
+    return mSegments;
+}
+
+void SampledSegments::setSampleInterval(int interval)
+{
+    mInterval = interval;
+}
+
+void SampledSegments::add(const SegmentRecord &record, const PlaylistInfo &)
+{
+    if( mInterval <= 0 || mIndex++ % mInterval != 0 )
+        return;
+
+    if( record.mapUri != QLatin1String(mMapUri.constData(), mMapUri.size()) )
+    {
+        mMapUri = QByteArray(record.mapUri.data(), record.mapUri.size());
+    }
+
+    SampledSegment segment;
+    segment.uri = QByteArray(record.uri.data(), record.uri.size());
+    if( record.hasByteRange )
+    {
+        segment.byteRangeLength = record.byteRangeLength;
+        segment.byteRangeOffset = record.byteRangeOffset;
+    }
+    segment.durationMs = quint32(record.durationUs / 1000);
+    segment.mapUri = mMapUri;
+    segment.mapByteRangeLength = record.mapByteRangeLength;
+    segment.mapByteRangeOffset = record.mapByteRangeOffset;
+    mSegments.append(segment);
+}
+
+void SampledSegments::finish(const PlaylistInfo &)
+{
+}
+
+const QVector<SampledSegment> &SampledSegments::sampledSegments() const
+{
+    return mSegments;
+}
+
+void StoredSegments::setArena(const QSharedPointer<Arena> &arena)
+{
+    mStore = arena ? SegmentStore(arena) : SegmentStore();
+}
+
+void StoredSegments::add(const SegmentRecord &record, const PlaylistInfo &)
+{
+    mStore.append(record);
+}
+
+void StoredSegments::finish(const PlaylistInfo &)
+{
+    mStore.squeeze();
+}
+
+const SegmentStore &StoredSegments::segmentStore() const
+{
+    return mStore;
+}
+
+void SegmentDurations::add(const SegmentStore::Columns &columns, const PlaylistInfo &info)
+{
+    for( int i = 0; i < columns.count; ++i )
+    {
+        quint64 durationUs = columns.durationsUs[i];
+        quint64 durationMs = durationUs / 1000;
+        mSum += durationUs;
+        mSumOfSquares += durationMs * durationMs;
+        mCount++;
+        if( durationUs > mMaximum )
+            mMaximum = durationUs;
+
+        if( info.targetDurationUs && (durationUs + 500000) / 1000000 > info.targetDurationUs / 1000000 )
+            mOverTarget++;
+    }
+}
+
+void SegmentDurations::finish(const PlaylistInfo &info)
+{
+    mTargetDuration = info.targetDurationUs;
+}
+
+quint64 SegmentDurations::averageDuration() const
+{
+    return mCount ? mSum / mCount : 0;
+}
+
+quint64 SegmentDurations::maximumDuration() const
+{
+    return mMaximum;
+}
+
+qreal SegmentDurations::durationDeviation() const
+{
+    if( mCount == 0 )
+        return 0;
+
+    double mean = double(mSum) / 1000 / mCount;
+    double variance = double(mSumOfSquares) / mCount - mean * mean;
+    return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+quint32 SegmentDurations::overTargetCount() const
+{
+    return mOverTarget;
+}
+
+quint64 SegmentDurations::targetDuration() const
+{
+    return mTargetDuration;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <QByteArray>
+
+#include "segmentrecord.h"
+#include "segmentstore.h"
+
+/// Метрики медиа-плейлиста; вся арифметика 64-битная.
+/// Потоковые (для MediaPlaylistAnalyzer) получают сегменты по одному через
+/// add(record, info) и нужны, пока сегменты ещё не сохранены. Остальные -
+/// проходы по столбцам SegmentStore через scanSegments(): своих посегментных
+/// данных они не держат, а размеры сегментов видят уже с учётом setBytes().
+/// Битрейт сегмента в проходах - размер / длительность, 0 - размер неизвестен.
+
+/// Один проход по блокам store для всех metrics: каждая получает блок через
+/// add(columns, info), после последнего - finish(info)
+template<typename... Metrics>
+void scanSegments(const SegmentStore &store, const PlaylistInfo &info, Metrics &... metrics)
+{
+    using expand = int[];
+    for( int chunk = 0; chunk < store.chunkCount(); ++chunk )
+    {
+        SegmentStore::Columns columns = store.columns(chunk);
+        (void)expand{0, (metrics.add(columns, info), 0)...};
+    }
+    (void)expand{0, (metrics.finish(info), 0)...};
+}
+
+/// Средний битрейт EXT-X-BITRATE, взвешенный по длительности сегментов.
+/// Если длительности не заданы, считается обычное среднее.
+/// Потоковая метрика и проход: по сохранённым сегментам - битрейт по размерам
+/// (включая узнанные через setBytes()); одному объекту - что-то одно.
+class BitrateMean
+{
+public:
+    void add(const SegmentRecord &record, const PlaylistInfo &info);
+    void add(const SegmentStore::Columns &columns, const PlaylistInfo &info);
+    void finish(const PlaylistInfo &info);
+
+    quint32 bitrateCount() const;
+    quint32 averageBitrate() const; //in bits per second
+
+private:
+    quint64 mWeightedSum = 0;   //kbps * ms
+    quint64 mWeight = 0;        //ms
+    quint64 mSum = 0;           //kbps
+    quint32 mCount = 0;
+};
+
+/// Проход: сегменты без размера (нет ни EXT-X-BITRATE, ни EXT-X-BYTERANGE):
+/// их размеры можно узнать отдельно (см. SegmentSizeProber) и записать
+/// через SegmentStore::setBytes(); URI - SegmentStore::uri()
+class UnsizedSegments
+{
+public:
+    void add(const SegmentStore::Columns &columns, const PlaylistInfo &info);
+    void finish(const PlaylistInfo &info);
+
+    /// номера сегментов в SegmentStore
+    const QVector<int> &unsizedSegments() const;
+
+private:
+    QVector<int> mSegments;
+};
+
+/// Каждый N-й сегмент для глубокой проверки (см. TsProbe, Fmp4Probe); N = 0 - ничего
+class SampledSegments
+{
+public:
+    void setSampleInterval(int interval);
+
+    void add(const SegmentRecord &record, const PlaylistInfo &info);
+    void finish(const PlaylistInfo &info);
+
+    const QVector<SampledSegment> &sampledSegments() const;
+
+private:
+    int mInterval = 0;
+    int mIndex = 0;
+    /// общий для всех сегментов одного EXT-X-MAP
+    QByteArray mMapUri;
+    QVector<SampledSegment> mSegments;
+};
+
+/// Все сегменты столбцами в арене анализа, см. SegmentStore; без арены ничего не хранится
+class StoredSegments
+{
+public:
+    void setArena(const QSharedPointer<Arena> &arena);
+
+    void add(const SegmentRecord &record, const PlaylistInfo &info);
+    void finish(const PlaylistInfo &info);
+
+    const SegmentStore &segmentStore() const;
+
+private:
+    SegmentStore mStore;
+};
+
+/// Проход: длительности сегментов относительно EXT-X-TARGETDURATION
+class SegmentDurations
+{
+public:
+    void add(const SegmentStore::Columns &columns, const PlaylistInfo &info);
+    void finish(const PlaylistInfo &info);
+
+    quint64 averageDuration() const; //in microseconds
+    quint64 maximumDuration() const; //in microseconds
+    qreal durationDeviation() const; //in milliseconds
+    /// сегменты, длительность которых после округления больше TARGETDURATION (RFC 8216, 4.3.3.1)
+    quint32 overTargetCount() const;
+    quint64 targetDuration() const; //in microseconds
+
+private:
+    quint64 mSum = 0;           //us
+    quint64 mSumOfSquares = 0;  //ms^2
+    quint64 mMaximum = 0;       //us
+    quint32 mCount = 0;
+    quint32 mOverTarget = 0;
+    quint64 mTargetDuration = 0;
+};
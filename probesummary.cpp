@@ -0,0 +1,119 @@
+#include "probesummary.h"
+
+#include "fmp4probe.h"
+#include "tsprobe.h"
+
+const qint64 PTS_WRAP = qint64(1) << 33;
+const qreal PTS_CLOCK = 90000;
+
+static quint32 bitrate(quint64 bytes, qreal seconds)
+{
+    return seconds > 0 ? quint32(qMin(qreal(bytes) * 8 / seconds, qreal(0xffffffffu))) : 0;
+}
+
+void ProbeSummary::add(const TsProbe &probe, quint32 durationMs)
+{
+    if( !probe.isValid() )
+        return;
+
+    mSegments++;
+    if( const TsProbe::Stream *video = probe.videoStream() )
+    {
+        if( mVideoCodec.isEmpty() )
+            mVideoCodec = video->codec;
+        mVideoBytes += video->bytes;
+        mVideoSeconds += qreal(durationMs) / 1000;
+
+        /// PTS внутри сегмента; переход через 2^33 просто пропускаем
+        qint64 span = video->maxPts - video->minPts;
+        if( video->pesCount > 1 && span > 0 && span < PTS_WRAP / 2 )
+        {
+            mFrames += video->pesCount - 1;
+            mFrameSeconds += qreal(span) / PTS_CLOCK;
+        }
+    }
+    if( const TsProbe::Stream *audio = probe.audioStream() )
+    {
+        if( mAudioCodec.isEmpty() )
+            mAudioCodec = audio->codec;
+        mAudioBytes += audio->bytes;
+        mAudioSeconds += qreal(durationMs) / 1000;
+    }
+}
+
+void ProbeSummary::add(const Fmp4Probe &probe)
+{
+    if( !probe.isValid() || !probe.hasFragments() )
+        return;
+
+    mSegments++;
+    if( const Fmp4Probe::Track *video = probe.videoTrack() )
+    {
+        if( mVideoCodec.isEmpty() )
+        {
+            mVideoCodec = video->codec;
+            mResolution = QString("%1x%2").arg(video->width).arg(video->height);
+        }
+        if( video->timescale > 0 )
+        {
+            qreal seconds = qreal(video->duration) / video->timescale;
+            mVideoBytes += video->bytes;
+            mVideoSeconds += seconds;
+            mFrames += video->sampleCount;
+            mFrameSeconds += seconds;
+        }
+    }
+    if( const Fmp4Probe::Track *audio = probe.audioTrack() )
+    {
+        if( mAudioCodec.isEmpty() )
+        {
+            mAudioCodec = audio->codec;
+            mChannels = audio->channels;
+        }
+        if( audio->timescale > 0 )
+        {
+            mAudioBytes += audio->bytes;
+            mAudioSeconds += qreal(audio->duration) / audio->timescale;
+        }
+    }
+}
+
+int ProbeSummary::segmentCount() const
+{
+    return mSegments;
+}
+
+QString ProbeSummary::videoCodec() const
+{
+    return mVideoCodec;
+}
+
+QString ProbeSummary::audioCodec() const
+{
+    return mAudioCodec;
+}
+
+QString ProbeSummary::resolution() const
+{
+    return mResolution;
+}
+
+quint32 ProbeSummary::channels() const
+{
+    return mChannels;
+}
+
+qreal ProbeSummary::frameRate() const
+{
+    return mFrameSeconds > 0 ? qreal(mFrames) / mFrameSeconds : 0;
+}
+
+quint32 ProbeSummary::videoBitrate() const
+{
+    return bitrate(mVideoBytes, mVideoSeconds);
+}
+
+quint32 ProbeSummary::audioBitrate() const
+{
+    return bitrate(mAudioBytes, mAudioSeconds);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QString>
+
+class Fmp4Probe;
+class TsProbe;
+
+/// Сводка глубокой проверки по нескольким сегментам одного медиа-плейлиста.
+/// Для MPEG-TS длительность берётся из EXTINF, частота кадров - по PTS;
+/// во fMP4 длительности и размеры сэмплов точные, из trun.
+class ProbeSummary
+{
+public:
+    void add(const TsProbe &probe, quint32 durationMs);
+    void add(const Fmp4Probe &probe);
+
+    int segmentCount() const;
+    QString videoCodec() const;
+    QString audioCodec() const;
+    /// "ширинаxвысота" из init-сегмента fMP4, для MPEG-TS пусто
+    QString resolution() const;
+    /// из init-сегмента fMP4, для MPEG-TS 0
+    quint32 channels() const;
+    qreal frameRate() const;
+    quint32 videoBitrate() const; //in bits per second
+    quint32 audioBitrate() const; //in bits per second
+
+private:
+    int mSegments = 0;
+    QString mVideoCodec;
+    QString mAudioCodec;
+    QString mResolution;
+    quint32 mChannels = 0;
+    quint64 mVideoBytes = 0;
+    qreal mVideoSeconds = 0;
+    quint64 mAudioBytes = 0;
+    qreal mAudioSeconds = 0;
+    quint64 mFrames = 0;
+    qreal mFrameSeconds = 0;
+};
@@ -0,0 +1,629 @@
+#include "requestscheduler.h"
+
+#include <QNetworkReply>
+#include <QRandomGenerator>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "playlistcache.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+const QNetworkRequest::Attribute HTTP2_ALLOWED = QNetworkRequest::Http2AllowedAttribute;
+const QNetworkRequest::Attribute HTTP2_WAS_USED = QNetworkRequest::Http2WasUsedAttribute;
+void (QNetworkReply::*const REPLY_ERROR)(QNetworkReply::NetworkError) = &QNetworkReply::errorOccurred;
+#else
+const QNetworkRequest::Attribute HTTP2_ALLOWED = QNetworkRequest::HTTP2AllowedAttribute;
+const QNetworkRequest::Attribute HTTP2_WAS_USED = QNetworkRequest::HTTP2WasUsedAttribute;
+void (QNetworkReply::*const REPLY_ERROR)(QNetworkReply::NetworkError) = &QNetworkReply::error;
+#endif
+
+const int DEFAULT_MAX_ATTEMPTS = 3;
+const int DEFAULT_TIMEOUT = 15000; //in milliseconds
+const int BACKOFF_BASE = 250; //in milliseconds
+const int BACKOFF_CAP = 8000; //in milliseconds
+const int DEFAULT_HEDGE_DELAY = 1000; //in milliseconds
+const int MINIMUM_HEDGE_DELAY = 150; //in milliseconds
+const int HEDGE_SAMPLES = 64;
+const int MINIMUM_HEDGE_SAMPLES = 8;
+const int RATE_TICK = 10; //in milliseconds
+
+static QString hostKeyFor(const QUrl &url)
+{
+    return url.scheme() + "://" + url.host() + ":" + QString::number(url.port(url.scheme() == "https" ? 443 : 80));
+}
+
+static QNetworkRequest::Priority networkPriority(RequestScheduler::Priority priority)
+{
+    switch( priority )
+    {
+    case RequestScheduler::MasterPriority:
+        return QNetworkRequest::HighPriority;
+    case RequestScheduler::SegmentPriority:
+        return QNetworkRequest::LowPriority;
+    default:
+        return QNetworkRequest::NormalPriority;
+    }
+}
+
+static bool isRetryableStatus(int status)
+{
+    return status == 429 || status >= 500;
+}
+
+/// ошибки, которые может исправить повтор; OperationCanceled - таймаут попытки
+static bool isRetryableError(QNetworkReply::NetworkError error)
+{
+    switch( error )
+    {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::OperationCanceledError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Экспоненциальная задержка перед попыткой attempt + 1: половина
+/// фиксирована, половина случайна, чтобы повторы не шли волной
+static int backoff(int attempt, const QNetworkReply *reply)
+{
+    int delay = qMin(BACKOFF_CAP, BACKOFF_BASE << qBound(0, attempt - 1, 10));
+    delay = delay / 2 + int(QRandomGenerator::global()->bounded(delay / 2 + 1));
+
+    /// Retry-After в секундах - сервер сам сказал, когда приходить
+    bool ok = false;
+    int retryAfter = reply->rawHeader("Retry-After").trimmed().toInt(&ok);
+    if( ok && retryAfter > 0 )
+    {
+        delay = qMax(delay, qMin(BACKOFF_CAP, retryAfter * 1000));
+    }
+    return delay;
+}
+
+RequestScheduler::RequestScheduler(QObject *parent)
+    : QObject(parent)
+    , mAccessManager(new QNetworkAccessManager(this))
+    , mMaxPerHost(6)
+    , mMaxPerHttp2Host(32)
+    , mMaxAttempts(DEFAULT_MAX_ATTEMPTS)
+    , mTimeout(DEFAULT_TIMEOUT)
+    , mCache(nullptr)
+    , mRateTimer(new QTimer(this))
+{
+    mClock.start();
+    mRateTimer->setInterval(RATE_TICK);
+    connect(mRateTimer, &QTimer::timeout, this, &RequestScheduler::onRateTick);
+}
+
+QNetworkAccessManager *RequestScheduler::accessManager() const
+{
+    return mAccessManager;
+}
+
+void RequestScheduler::setMaxPerHost(int maxPerHost)
+{
+    mMaxPerHost = qMax(1, maxPerHost);
+}
+
+void RequestScheduler::setMaxPerHttp2Host(int maxPerHost)
+{
+    mMaxPerHttp2Host = qMax(1, maxPerHost);
+}
+
+void RequestScheduler::setMaxAttempts(int attempts)
+{
+    mMaxAttempts = qMax(1, attempts);
+}
+
+void RequestScheduler::setTimeout(int ms)
+{
+    mTimeout = qMax(0, ms);
+}
+
+void RequestScheduler::setCache(PlaylistCache *cache)
+{
+    mCache = cache;
+    if( mCache )
+    {
+        mCache->install(mAccessManager);
+    }
+}
+
+PlaylistCache *RequestScheduler::cache() const
+{
+    return mCache;
+}
+
+void RequestScheduler::get(const QNetworkRequest &request, Priority priority, QObject *context, const StartedCallback &started,
+                           int rate)
+{
+    enqueue(request, false, priority, context, started, rate);
+}
+
+void RequestScheduler::head(const QNetworkRequest &request, Priority priority, QObject *context, const StartedCallback &started,
+                            int rate)
+{
+    enqueue(request, true, priority, context, started, rate);
+}
+
+void RequestScheduler::cancel(QObject *context)
+{
+    for( auto it = mHosts.begin(); it != mHosts.end(); )
+    {
+        bool empty = true;
+        for( int priority = 0; priority < PriorityCount; ++priority )
+        {
+            QQueue<PendingRequest> kept;
+            foreach(const PendingRequest &pending, it.value().queues[priority])
+            {
+                if( pending.call->owner == context )
+                {
+                    pending.call->cancelled = true;
+                    mStatistics.queueDepth--;
+                    mStatistics.cancelled++;
+                }
+                else
+                {
+                    kept.enqueue(pending);
+                }
+            }
+            it.value().queues[priority] = kept;
+            empty = empty && kept.isEmpty();
+        }
+        if( empty && it.value().inFlight == 0 )
+            it = mHosts.erase(it);
+        else
+            ++it;
+    }
+
+    for( auto it = mRateLimits.begin(); it != mRateLimits.end(); ++it )
+    {
+        QQueue<CallPointer> kept;
+        foreach(const CallPointer &call, it.value().calls)
+        {
+            if( call->owner == context )
+            {
+                call->cancelled = true;
+                mStatistics.cancelled++;
+            }
+            else
+            {
+                kept.enqueue(call);
+            }
+        }
+        it.value().calls = kept;
+    }
+
+    for( int i = mBackoff.size() - 1; i >= 0; --i )
+    {
+        if( mBackoff.at(i)->owner == context )
+        {
+            mBackoff.at(i)->cancelled = true;
+            mBackoff.removeAt(i);
+            mStatistics.cancelled++;
+        }
+    }
+
+    QList<QNetworkReply *> replies;
+    for( auto it = mReplies.cbegin(); it != mReplies.cend(); ++it )
+    {
+        if( it.value()->owner == context )
+        {
+            it.value()->cancelled = true;
+            replies.append(it.key());
+        }
+    }
+    foreach(QNetworkReply *reply, replies)
+    {
+        /// сначала отцепляем вызывающего: его finished не должен прийти,
+        /// context может быть уже наполовину разрушен
+        disconnect(reply, nullptr, context, nullptr);
+        reply->abort();
+        mStatistics.cancelled++;
+    }
+}
+
+void RequestScheduler::enqueue(const QNetworkRequest &request, bool head, Priority priority, QObject *context, const StartedCallback &started,
+                               int rate)
+{
+    CallPointer call(new Call);
+    call->request = request;
+    call->request.setAttribute(HTTP2_ALLOWED, true);
+    call->request.setPriority(networkPriority(priority));
+    call->head = head;
+    call->priority = priority;
+    call->owner = context;
+    call->context = context;
+    call->started = started;
+    call->rate = qMax(0, rate);
+
+    if( context && !mContexts.contains(context) )
+    {
+        connect(context, &QObject::destroyed, this, [this, context]()
+        {
+            foreach(const QString &key, mContexts.take(context))
+            {
+                if( --mHostContexts[key] > 0 )
+                    continue;
+                mHostContexts.remove(key);
+                mPlaylistFirstByte.remove(key);
+            }
+            cancel(context);
+        });
+    }
+    if( context )
+    {
+        QSet<QString> &hosts = mContexts[context];
+        QString key = hostKeyFor(request.url());
+        if( !hosts.contains(key) )
+        {
+            hosts.insert(key);
+            mHostContexts[key]++;
+        }
+    }
+
+    mStatistics.requests[priority]++;
+    admit(call);
+}
+
+void RequestScheduler::admit(const CallPointer &call)
+{
+    if( call->rate == 0 )
+    {
+        schedule(call);
+        return;
+    }
+
+    QString key = hostKeyFor(call->request.url());
+    auto it = mRateLimits.find(key);
+    if( it == mRateLimits.end() )
+    {
+        /// новый хост начинает с полным запасом
+        it = mRateLimits.insert(key, RateLimit());
+        it.value().tokens = qMax<qreal>(1, call->rate * RATE_TICK / 1000.0);
+        it.value().refilledAt = mClock.elapsed();
+    }
+    it.value().rate = call->rate;
+    it.value().calls.enqueue(call);
+    onRateTick();
+    if( !mRateLimits.isEmpty() && !mRateTimer->isActive() )
+        mRateTimer->start();
+}
+
+void RequestScheduler::onRateTick()
+{
+    const qint64 now = mClock.elapsed();
+    QList<CallPointer> ready;
+    for( auto it = mRateLimits.begin(); it != mRateLimits.end(); )
+    {
+        RateLimit &limit = it.value();
+        /// запас не больше одного такта: после простоя нет залпа
+        const qreal burst = qMax<qreal>(1, limit.rate * RATE_TICK / 1000.0);
+        limit.tokens = qMin(burst, limit.tokens + (now - limit.refilledAt) * limit.rate / 1000.0);
+        limit.refilledAt = now;
+        while( limit.tokens >= 1 && !limit.calls.isEmpty() )
+        {
+            CallPointer call = limit.calls.dequeue();
+            if( call->cancelled || call->context.isNull() )
+                continue;
+            limit.tokens -= 1;
+            ready.append(call);
+        }
+
+        if( limit.calls.isEmpty() && limit.tokens >= burst )
+            it = mRateLimits.erase(it);
+        else
+            ++it;
+    }
+    if( mRateLimits.isEmpty() )
+        mRateTimer->stop();
+
+    /// после обхода: started может добавить новые запросы
+    foreach(const CallPointer &call, ready)
+    {
+        schedule(call);
+    }
+}
+
+void RequestScheduler::schedule(const CallPointer &call)
+{
+    PendingRequest pending;
+    pending.call = call;
+    pending.hedge = false;
+    pending.enqueuedAt = mClock.elapsed();
+
+    QString key = hostKeyFor(call->request.url());
+    if( mHosts[key].inFlight < limitFor(key) )
+    {
+        startRequest(key, pending);
+        return;
+    }
+
+    mHosts[key].queues[call->priority].enqueue(pending);
+    mStatistics.queued[call->priority]++;
+    mStatistics.queueDepth++;
+    mStatistics.maxQueueDepth = qMax(mStatistics.maxQueueDepth, mStatistics.queueDepth);
+}
+
+const RequestScheduler::Statistics &RequestScheduler::statistics() const
+{
+    return mStatistics;
+}
+
+QString RequestScheduler::statisticsString() const
+{
+    static const char *names[PriorityCount] = { "master", "media", "segment" };
+
+    QStringList parts;
+    for( int i = 0; i < PriorityCount; ++i )
+    {
+        if( mStatistics.requests[i] == 0 )
+            continue;
+        qint64 average = mStatistics.queued[i] > 0 ? mStatistics.totalWait[i] / qint64(mStatistics.queued[i]) : 0;
+        parts.append(QString("%1: %2 запросов, в очереди %3, ожидание ср. %4 мс, макс. %5 мс")
+                     .arg(names[i]).arg(mStatistics.requests[i]).arg(mStatistics.queued[i])
+                     .arg(average).arg(mStatistics.maxWait[i]));
+    }
+    parts.append(QString("макс. глубина очереди %1").arg(mStatistics.maxQueueDepth));
+    parts.append(QString("повторов %1, дублей %2, таймаутов %3, отменено %4")
+                 .arg(mStatistics.retries).arg(mStatistics.hedges).arg(mStatistics.timeouts).arg(mStatistics.cancelled));
+    return parts.join("; ");
+}
+
+NetworkTimings &RequestScheduler::timings()
+{
+    return mTimings;
+}
+
+const NetworkTimings &RequestScheduler::timings() const
+{
+    return mTimings;
+}
+
+void RequestScheduler::startRequest(const QString &hostKey, PendingRequest &pending)
+{
+    CallPointer call = pending.call;
+    if( call->context.isNull() || call->cancelled )
+        return;
+
+    mHosts[hostKey].inFlight++;
+    mStatistics.inFlight++;
+
+    QSharedPointer<NetworkTimings::Request> timing(new NetworkTimings::Request);
+    timing->url = call->request.url().toString();
+    timing->host = hostKey;
+    timing->priority = call->priority;
+    timing->queuedAt = pending.enqueuedAt;
+    timing->startedAt = mClock.elapsed();
+    timing->encrypted = call->request.url().scheme() == "https";
+
+    /// последняя попытка отдаётся сразу: её ошибку вызывающий должен увидеть сам
+    bool last = !pending.hedge && ++call->attempts >= mMaxAttempts;
+
+    QNetworkReply *reply = call->head ? mAccessManager->head(call->request) : mAccessManager->get(call->request);
+    mReplies.insert(reply, call);
+    call->replies.append(reply);
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, call, reply, timing]()
+    {
+        if( timing->firstByteAt < 0 )
+        {
+            timing->firstByteAt = mClock.elapsed();
+            if( call->priority != SegmentPriority )
+            {
+                QVector<qint64> &samples = mPlaylistFirstByte[timing->host];
+                if( samples.size() == HEDGE_SAMPLES )
+                    samples.removeFirst();
+                samples.append(timing->timeToFirstByte());
+            }
+        }
+        onHeaders(call, reply);
+    });
+    connect(reply, REPLY_ERROR, this, [this, call, reply](QNetworkReply::NetworkError error)
+    {
+        /// повтор не поможет - ошибку сразу видит вызывающий, finished придёт следом
+        if( !call->reply && !call->cancelled && !isRetryableError(error)
+                && !isRetryableStatus(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()) )
+            handOver(call, reply);
+    });
+    connect(reply, &QNetworkReply::downloadProgress, this, [timing](qint64 bytesReceived, qint64 bytesTotal)
+    {
+        Q_UNUSED(bytesTotal)
+        timing->bytes = bytesReceived;
+    });
+#ifndef QT_NO_SSL
+    /// encrypted приходит только если для этого ответа было TLS-рукопожатие
+    connect(reply, &QNetworkReply::encrypted, this, [this, timing]()
+    {
+        timing->encryptedAt = mClock.elapsed();
+    });
+#endif
+    connect(reply, &QNetworkReply::finished, this, [this, hostKey, reply, timing]()
+    {
+        onReplyFinished(hostKey, reply, timing);
+    });
+
+    if( mTimeout > 0 )
+    {
+        /// таймер перезапускается каждой порцией: обрывается только зависшая попытка
+        QTimer *timer = new QTimer(reply);
+        timer->setSingleShot(true);
+        timer->setInterval(mTimeout);
+        connect(timer, &QTimer::timeout, reply, [this, reply]()
+        {
+            mStatistics.timeouts++;
+            qDebug() << "Error: " << "таймаут запроса" << reply->url().toString();
+            reply->abort();
+        });
+        connect(reply, &QNetworkReply::metaDataChanged, timer, [timer]()
+        {
+            timer->start();
+        });
+        connect(reply, &QNetworkReply::downloadProgress, timer, [timer]()
+        {
+            timer->start();
+        });
+        timer->start();
+    }
+
+    if( last )
+    {
+        handOver(call, reply);
+    }
+    else if( !pending.hedge && call->priority != SegmentPriority )
+    {
+        /// плейлисты маленькие - дубль дешевле, чем ждать хвост распределения
+        QTimer::singleShot(hedgeDelay(hostKey), reply, [this, hostKey, call, reply]()
+        {
+            hedge(hostKey, call, reply);
+        });
+    }
+}
+
+void RequestScheduler::onHeaders(const CallPointer &call, QNetworkReply *reply)
+{
+    if( call->reply )
+        return;
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if( isRetryableStatus(status) )
+    {
+        /// тело ошибки никому не нужно; повтор решится, когда попытка закончится
+        QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+        return;
+    }
+    handOver(call, reply);
+}
+
+void RequestScheduler::handOver(const CallPointer &call, QNetworkReply *reply)
+{
+    call->reply = reply;
+    foreach(QNetworkReply *other, call->replies)
+    {
+        /// проигравший дубль
+        if( other != reply )
+            QMetaObject::invokeMethod(other, "abort", Qt::QueuedConnection);
+    }
+    if( !call->context.isNull() )
+    {
+        call->started(reply);
+    }
+}
+
+void RequestScheduler::hedge(const QString &hostKey, const CallPointer &call, QNetworkReply *primary)
+{
+    if( call->reply || call->cancelled || call->replies.size() != 1 || call->replies.first() != primary )
+        return;
+    /// дубль не должен стоять в очереди и вытеснять чужие запросы
+    auto host = mHosts.constFind(hostKey);
+    if( host != mHosts.constEnd() && host.value().inFlight >= limitFor(hostKey) )
+        return;
+
+    PendingRequest pending;
+    pending.call = call;
+    pending.hedge = true;
+    pending.enqueuedAt = mClock.elapsed();
+    mStatistics.hedges++;
+    startRequest(hostKey, pending);
+}
+
+void RequestScheduler::retry(const CallPointer &call, QNetworkReply *reply)
+{
+    /// неповторяемые ошибки отданы вызывающему ещё в сигнале ошибки
+    int delay = backoff(call->attempts, reply);
+    mStatistics.retries++;
+
+    mBackoff.append(call);
+    QTimer::singleShot(delay, this, [this, call]()
+    {
+        if( !mBackoff.removeOne(call) || call->context.isNull() )
+            return;
+        admit(call);
+    });
+}
+
+void RequestScheduler::onReplyFinished(const QString &hostKey, QNetworkReply *reply, const QSharedPointer<NetworkTimings::Request> &timing)
+{
+    bool http2 = reply->attribute(HTTP2_WAS_USED).toBool();
+    bool fromCache = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+    if( http2 )
+    {
+        mHttp2Hosts.insert(hostKey);
+    }
+    if( mCache )
+    {
+        mCache->recordReply(fromCache);
+    }
+
+    timing->finishedAt = mClock.elapsed();
+    timing->httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    timing->httpVersion = fromCache ? "cache" : (http2 ? "2" : "1.1");
+    timing->fromCache = fromCache;
+    timing->error = reply->error() != QNetworkReply::NoError;
+    mTimings.record(*timing);
+
+    mStatistics.inFlight--;
+    mHosts[hostKey].inFlight--;
+
+    CallPointer call = mReplies.take(reply);
+    call->replies.removeOne(reply);
+    if( call->reply != reply || call->cancelled )
+    {
+        /// ответ не дошёл до вызывающего - удаляем сами
+        reply->deleteLater();
+        if( !call->reply && !call->cancelled && !call->context.isNull() && call->replies.isEmpty() )
+            retry(call, reply);
+    }
+
+    /// обращаемся к mHosts заново на каждом шаге: startRequest может
+    /// добавить новый хост и перестроить хэш
+    int limit = limitFor(hostKey);
+    for( int priority = 0; priority < PriorityCount; ++priority )
+    {
+        while( mHosts[hostKey].inFlight < limit && !mHosts[hostKey].queues[priority].isEmpty() )
+        {
+            PendingRequest pending = mHosts[hostKey].queues[priority].dequeue();
+            mStatistics.queueDepth--;
+
+            qint64 wait = mClock.elapsed() - pending.enqueuedAt;
+            mStatistics.totalWait[priority] += wait;
+            mStatistics.maxWait[priority] = qMax(mStatistics.maxWait[priority], wait);
+
+            startRequest(hostKey, pending);
+        }
+    }
+
+    const Host &host = mHosts[hostKey];
+    if( host.inFlight == 0 )
+    {
+        bool empty = true;
+        for( int priority = 0; priority < PriorityCount; ++priority )
+            empty = empty && host.queues[priority].isEmpty();
+        if( empty )
+            mHosts.remove(hostKey);
+    }
+}
+
+int RequestScheduler::limitFor(const QString &hostKey) const
+{
+    return mHttp2Hosts.contains(hostKey) ? mMaxPerHttp2Host : mMaxPerHost;
+}
+
+/// p95 времени до первого байта плейлистов этого хоста
+int RequestScheduler::hedgeDelay(const QString &hostKey) const
+{
+    QVector<qint64> samples = mPlaylistFirstByte.value(hostKey);
+    if( samples.size() < MINIMUM_HEDGE_SAMPLES )
+        return DEFAULT_HEDGE_DELAY;
+
+    auto nth = samples.begin() + (samples.size() * 95) / 100;
+    std::nth_element(samples.begin(), nth, samples.end());
+    return int(qMax<qint64>(MINIMUM_HEDGE_DELAY, *nth));
+}
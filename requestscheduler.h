@@ -0,0 +1,184 @@
+#pragma once
+
+#include <QObject>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QQueue>
+#include <QSet>
+#include <QSharedPointer>
+
+#include <functional>
+
+#include "networktimings.h"
+
+class PlaylistCache;
+class QTimer;
+
+/// Планировщик запросов между анализом и QNetworkAccessManager.
+/// Ограничивает число одновременных запросов к одному хосту, отдаёт
+/// освободившееся место запросам с более высоким приоритетом и
+/// разрешает HTTP/2 там, где его поддерживает сервер.
+/// Попытка, на которой за timeout не пришло ни байта, обрывается. Сетевые
+/// ошибки, 5xx и 429 до выдачи ответа вызывающему повторяются с растущей
+/// задержкой и джиттером; пока повтор возможен, вызывающий получает ответ
+/// только после заголовков. Плейлист, на который сервер долго не отвечает,
+/// запрашивается второй раз параллельно, побеждает первый ответ.
+/// Запросы уничтоженного (или снятого через cancel) context обрываются.
+/// Запросы с ограничением rate (HEAD-пробы размеров) к одному хосту идут
+/// не чаще rate в секунду от всех анализов вместе.
+class RequestScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority
+    {
+        MasterPriority = 0,
+        MediaPlaylistPriority,
+        SegmentPriority,
+        PriorityCount
+    };
+
+    struct Statistics
+    {
+        quint64 requests[PriorityCount] = {};
+        quint64 queued[PriorityCount] = {};
+        qint64 totalWait[PriorityCount] = {}; //in milliseconds
+        qint64 maxWait[PriorityCount] = {}; //in milliseconds
+        int queueDepth = 0;
+        int maxQueueDepth = 0;
+        int inFlight = 0;
+        quint64 retries = 0;
+        quint64 hedges = 0;
+        quint64 timeouts = 0;
+        quint64 cancelled = 0;
+    };
+
+    typedef std::function<void(QNetworkReply *)> StartedCallback;
+
+    explicit RequestScheduler(QObject *parent = nullptr);
+
+    QNetworkAccessManager *accessManager() const;
+
+    void setMaxPerHost(int maxPerHost);
+    void setMaxPerHttp2Host(int maxPerHost);
+    /// всего попыток на запрос, 1 - без повторов
+    void setMaxAttempts(int attempts);
+    /// попытка обрывается, если за ms не пришло ни байта; 0 - без ограничения
+    void setTimeout(int ms);
+
+    /// кэш устанавливается в QNetworkAccessManager и доступен анализам
+    void setCache(PlaylistCache *cache);
+    PlaylistCache *cache() const;
+
+    /// Запрос будет отправлен, когда у хоста освободится место.
+    /// started вызывается с созданным QNetworkReply, если context ещё жив.
+    /// rate > 0 - запрос ждёт очереди в общем для хоста token bucket на rate
+    /// запросов в секунду; повторы тоже
+    void get(const QNetworkRequest &request, Priority priority, QObject *context, const StartedCallback &started,
+             int rate = 0);
+    /// то же для HEAD: размер без тела ответа
+    void head(const QNetworkRequest &request, Priority priority, QObject *context, const StartedCallback &started,
+              int rate = 0);
+    /// Снять все запросы context: ждущие в очереди выбрасываются, отправленные
+    /// обрываются, и их сигналы до context уже не доходят. Вызывается само,
+    /// когда context уничтожается.
+    void cancel(QObject *context);
+
+    const Statistics &statistics() const;
+    QString statisticsString() const;
+
+    /// замеры каждого отправленного запроса
+    NetworkTimings &timings();
+    const NetworkTimings &timings() const;
+
+private:
+    /// запрос вызывающего; переживает повторы и дублирующие попытки
+    struct Call
+    {
+        QNetworkRequest request;
+        bool head = false;
+        Priority priority = MasterPriority;
+        QObject *owner = nullptr;   // только для сравнения: context мог уже умереть
+        QPointer<QObject> context;
+        StartedCallback started;
+        int attempts = 0;
+        int rate = 0;   // запросов в секунду на хост, 0 - без ограничения
+        bool cancelled = false;
+        /// ответ, отданный вызывающему
+        QNetworkReply *reply = nullptr;
+        /// попытки в полёте
+        QList<QNetworkReply *> replies;
+    };
+    typedef QSharedPointer<Call> CallPointer;
+
+    struct PendingRequest
+    {
+        CallPointer call;
+        bool hedge;
+        qint64 enqueuedAt;
+    };
+
+    struct Host
+    {
+        int inFlight = 0;
+        QQueue<PendingRequest> queues[PriorityCount];
+    };
+
+    /// token bucket хоста для запросов с rate; живёт, пока есть очередь
+    /// или запас не восстановился полностью
+    struct RateLimit
+    {
+        int rate = 0;
+        qreal tokens = 0;
+        qint64 refilledAt = 0;
+        QQueue<CallPointer> calls;
+    };
+
+    void enqueue(const QNetworkRequest &request, bool head, Priority priority, QObject *context, const StartedCallback &started,
+                 int rate);
+    void admit(const CallPointer &call);
+    void onRateTick();
+    void schedule(const CallPointer &call);
+    void startRequest(const QString &hostKey, PendingRequest &pending);
+    void onHeaders(const CallPointer &call, QNetworkReply *reply);
+    void handOver(const CallPointer &call, QNetworkReply *reply);
+    void hedge(const QString &hostKey, const CallPointer &call, QNetworkReply *primary);
+    void retry(const CallPointer &call, QNetworkReply *reply);
+    void onReplyFinished(const QString &hostKey, QNetworkReply *reply, const QSharedPointer<NetworkTimings::Request> &timing);
+    int limitFor(const QString &hostKey) const;
+    int hedgeDelay(const QString &hostKey) const;
+
+private:
+    QNetworkAccessManager *mAccessManager;
+    QElapsedTimer mClock;
+
+    int mMaxPerHost;
+    int mMaxPerHttp2Host;
+    int mMaxAttempts;
+    int mTimeout; //in milliseconds
+
+    PlaylistCache *mCache;
+
+    QHash<QString, Host> mHosts;
+    QSet<QString> mHttp2Hosts;
+    QHash<QString, RateLimit> mRateLimits;
+    QTimer *mRateTimer;
+
+    QHash<QNetworkReply *, CallPointer> mReplies;
+    /// запросы, ждущие повтора
+    QList<CallPointer> mBackoff;
+    /// хосты, к которым обращался каждый живой context
+    QHash<QObject *, QSet<QString>> mContexts;
+    /// число живых context на хост
+    QHash<QString, int> mHostContexts;
+    /// время до первого байта последних запросов плейлистов по хостам;
+    /// хост забывается вместе с последним обращавшимся к нему context
+    QHash<QString, QVector<qint64>> mPlaylistFirstByte;
+
+    Statistics mStatistics;
+    NetworkTimings mTimings;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QByteArray>
+#include <QLatin1String>
+#include <QVector>
+
+/// Сегмент медиа-плейлиста вместе со всеми тегами, которые к нему относятся
+struct SegmentRecord
+{
+    QLatin1String uri;              // действительна только внутри add()
+    quint64 sequence = 0;
+    quint64 durationUs = 0;         // EXTINF
+    quint64 byteRangeLength = 0;    // EXT-X-BYTERANGE
+    quint64 byteRangeOffset = 0;
+    bool hasByteRange = false;
+    quint32 bitrate = 0;            // EXT-X-BITRATE или размер из EXT-X-BYTERANGE, kbps; 0 - не задан
+    bool discontinuity = false;     // EXT-X-DISCONTINUITY перед сегментом
+    bool keyChanged = false;        // EXT-X-KEY перед сегментом
+    bool mapChanged = false;        // EXT-X-MAP перед сегментом
+    QLatin1String mapUri;           // действующий EXT-X-MAP, пусто - нет; действительна только внутри add()
+    quint64 mapByteRangeLength = 0; // BYTERANGE из EXT-X-MAP; 0 - весь файл
+    quint64 mapByteRangeOffset = 0;
+};
+
+/// Сегмент, выбранный для глубокой проверки: всё, что нужно для его загрузки
+struct SampledSegment
+{
+    QByteArray uri;
+    quint64 byteRangeLength = 0;    // 0 - весь файл
+    quint64 byteRangeOffset = 0;
+    quint32 durationMs = 0;
+    QByteArray mapUri;              // init-сегмент fMP4; пусто - MPEG-TS
+    quint64 mapByteRangeLength = 0;
+    quint64 mapByteRangeOffset = 0;
+};
+
+/// Отрезок шкалы битрейта - один сегмент с отсчётом от начала плейлиста
+struct TimelineSegment
+{
+    quint32 startMs = 0;
+    quint32 durationMs = 0;
+    quint32 bitrate = 0;            // kbps; 0 - не задан
+};
+
+typedef QVector<TimelineSegment> BitrateTimeline;
+
+/// Теги уровня плейлиста
+struct PlaylistInfo
+{
+    quint64 targetDurationUs = 0;   // EXT-X-TARGETDURATION
+    quint64 mediaSequence = 0;      // EXT-X-MEDIA-SEQUENCE
+    bool endList = false;           // EXT-X-ENDLIST
+    quint64 canSkipUntilUs = 0;     // CAN-SKIP-UNTIL из EXT-X-SERVER-CONTROL; 0 - разностных обновлений нет
+    quint64 skippedSegments = 0;    // EXT-X-SKIP разностного обновления (_HLS_skip)
+};
@@ -0,0 +1,163 @@
+#include "segmentsizeprober.h"
+
+#include <QNetworkReply>
+#include <QTimer>
+
+#include "requestscheduler.h"
+
+/// 405 Method Not Allowed, 501 Not Implemented: сервер не принимает HEAD
+static bool isHeadRejected(int status)
+{
+    return status == 405 || status == 501;
+}
+
+/// "bytes 0-0/12345" -> 12345; -1, если полный размер неизвестен ("*")
+static qint64 totalFromContentRange(const QByteArray &contentRange)
+{
+    int slash = contentRange.lastIndexOf('/');
+    if( slash == -1 )
+        return -1;
+    bool ok = false;
+    qint64 total = contentRange.mid(slash + 1).trimmed().toLongLong(&ok);
+    return ok ? total : -1;
+}
+
+SegmentSizeProber::SegmentSizeProber(RequestScheduler *scheduler, QObject *parent)
+    : QObject(parent)
+    , mScheduler(scheduler)
+    , mRate(0)
+    , mMaxInFlight(16)
+    , mNext(0)
+    , mInFlight(0)
+    , mRemaining(0)
+{
+}
+
+void SegmentSizeProber::setRate(int requestsPerSecond)
+{
+    mRate = qMax(0, requestsPerSecond);
+}
+
+void SegmentSizeProber::setMaxInFlight(int maxInFlight)
+{
+    mMaxInFlight = qMax(1, maxInFlight);
+}
+
+void SegmentSizeProber::probe(const QVector<QUrl> &urls)
+{
+    mUrls = urls;
+    mSizes.fill(-1, urls.size());
+    mNext = 0;
+    mInFlight = 0;
+    mRemaining = urls.size();
+    if( mRemaining == 0 )
+    {
+        QTimer::singleShot(0, this, &SegmentSizeProber::done);
+        return;
+    }
+    requestNext();
+}
+
+const QVector<qint64> &SegmentSizeProber::sizes() const
+{
+    return mSizes;
+}
+
+void SegmentSizeProber::requestNext()
+{
+    while( mInFlight < mMaxInFlight && mNext < mUrls.size() )
+    {
+        request(mNext++, false);
+    }
+}
+
+void SegmentSizeProber::request(int index, bool range)
+{
+    QNetworkRequest request(mUrls.at(index));
+    request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    /// размер нужен без сжатия - иначе Content-Length будет не тот
+    request.setRawHeader("Accept-Encoding", "identity");
+    if( range )
+    {
+        request.setRawHeader("Range", "bytes=0-0");
+    }
+
+    mInFlight++;
+    RequestScheduler::StartedCallback started = [this, index, range](QNetworkReply *reply)
+    {
+        connect(reply, &QNetworkReply::finished, this, [this, index, range, reply]()
+        {
+            onReplyFinished(index, range, reply);
+        });
+        if( !range )
+            return;
+
+        /// сервер не понял Range и отдаёт весь сегмент - обрываем на заголовках
+        auto check = [reply]()
+        {
+            int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if( status != 206 )
+                QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+        };
+        /// заголовки могли прийти раньше, чем ответ отдан сюда
+        if( reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid() )
+            check();
+        else
+            connect(reply, &QNetworkReply::metaDataChanged, this, check);
+    };
+    if( range )
+        mScheduler->get(request, RequestScheduler::SegmentPriority, this, started, mRate);
+    else
+        mScheduler->head(request, RequestScheduler::SegmentPriority, this, started, mRate);
+}
+
+void SegmentSizeProber::onReplyFinished(int index, bool range, QNetworkReply *reply)
+{
+    reply->deleteLater();
+    mInFlight--;
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    qint64 size = -1;
+    bool fallback = false;
+    if( range )
+    {
+        /// только из Content-Range: Content-Length ответа 200 - не тот запрос
+        if( reply->error() == QNetworkReply::NoError && status == 206 )
+            size = totalFromContentRange(reply->rawHeader("Content-Range"));
+    }
+    else if( reply->error() == QNetworkReply::NoError )
+    {
+        if( reply->hasRawHeader("Content-Length") )
+            size = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        else
+            fallback = true;
+    }
+    else if( isHeadRejected(status) )
+    {
+        fallback = true;
+    }
+    else
+    {
+        qDebug() << "Error: " << reply->errorString();
+    }
+
+    if( fallback )
+    {
+        /// HEAD не дал размера - пробуем Range
+        request(index, true);
+        return;
+    }
+
+    mSizes[index] = size;
+    if( --mRemaining == 0 )
+    {
+        done();
+        return;
+    }
+    requestNext();
+}
+
+void SegmentSizeProber::done()
+{
+    emit finished();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QObject>
+
+#include <QUrl>
+#include <QVector>
+
+class QNetworkReply;
+class RequestScheduler;
+
+/// Точные размеры сегментов без загрузки их содержимого: HEAD, а если
+/// сервер не вернул Content-Length или не принимает HEAD (405, 501) -
+/// GET с Range: bytes=0-0 и размер из Content-Range. Ответ на Range без
+/// 206 обрывается на заголовках: тело сегмента не скачивается. Запросы
+/// идут через RequestScheduler с приоритетом сегментов; ограничение rate
+/// в секунду планировщик держит на хост для всех проверок вместе, а здесь
+/// в планировщике одновременно не больше maxInFlight запросов. HTTP/1.1
+/// pipelining разрешён, так что заголовки идут пачкой.
+class SegmentSizeProber : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SegmentSizeProber(RequestScheduler *scheduler, QObject *parent = nullptr);
+
+    /// на хост для всех проверок вместе, см. RequestScheduler; 0 - без ограничения
+    void setRate(int requestsPerSecond);
+    void setMaxInFlight(int maxInFlight);
+
+    void probe(const QVector<QUrl> &urls);
+
+    /// размер каждого сегмента в байтах, -1 - узнать не удалось
+    const QVector<qint64> &sizes() const;
+
+signals:
+    void finished();
+
+private:
+    void requestNext();
+    void request(int index, bool range);
+    void onReplyFinished(int index, bool range, QNetworkReply *reply);
+    void done();
+
+private:
+    RequestScheduler *mScheduler;
+
+    int mRate;
+    int mMaxInFlight;
+
+    QVector<QUrl> mUrls;
+    QVector<qint64> mSizes;
+    int mNext;
+    int mInFlight;
+    int mRemaining;
+};
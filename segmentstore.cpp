@@ -0,0 +1,433 @@
+#include "segmentstore.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "arena.h"
+
+const int URI_PAGE_SIZE = 4096;
+/// каждый URI_RESTART-й URI хранится целиком: столько записей максимум
+/// раскодирует uri()
+const int URI_RESTART = 64;
+
+struct SegmentStore::Chunk
+{
+    /// для каждого ANCHOR_INTERVAL-го сегмента блока
+    quint64 anchorOffsets[CHUNK_SIZE / ANCHOR_INTERVAL];  // его смещение
+    int anchorEntries[CHUNK_SIZE / ANCHOR_INTERVAL];      // записей URI до него
+    quint32 durationsUs[CHUNK_SIZE];
+    quint32 sizes[CHUNK_SIZE];
+    quint8 flags[CHUNK_SIZE];
+};
+
+/// начало записи URI с номером, кратным URI_RESTART
+struct UriRestart
+{
+    int page;
+    int offset;
+};
+
+struct OffsetEntry
+{
+    int index;
+    quint64 offset;
+};
+
+struct MapChange
+{
+    int index;
+    quint32 uri;    // номер в StringPool
+};
+
+struct SegmentStore::Data
+{
+    QSharedPointer<Arena> arena;
+    int count = 0;
+    QVector<Chunk *> chunks;
+
+    /// URI: varint длины общего с предыдущим префикса, varint длины
+    /// остатка, остаток; пара нулей - продолжение на следующей странице
+    QVector<char *> uriPages;
+    qint64 uriBytes = 0;
+    char *uriPos = nullptr;
+    char *uriEnd = nullptr;
+    QVector<UriRestart> uriRestarts;
+    int uriEntries = 0;
+    QByteArray lastUri;
+
+    bool previousByteRange = false;
+    quint64 nextOffset = 0;
+    QVector<OffsetEntry> offsets;
+
+    QByteArray lastMapUri;
+    QVector<MapChange> maps;
+
+    quint32 codec = StringPool::NONE;
+    quint32 language = StringPool::NONE;
+    quint32 groupId = StringPool::NONE;
+};
+
+static char *writeVarint(char *p, quint32 value)
+{
+    while( value >= 0x80 )
+    {
+        *p++ = char(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = char(value);
+    return p;
+}
+
+static const char *readVarint(const char *p, quint32 *value)
+{
+    quint32 result = 0;
+    int shift = 0;
+    while( uchar(*p) & 0x80 )
+    {
+        result |= quint32(uchar(*p++) & 0x7f) << shift;
+        shift += 7;
+    }
+    *value = result | quint32(uchar(*p++)) << shift;
+    return p;
+}
+
+static quint32 clamp32(quint64 value)
+{
+    return quint32(qMin<quint64>(value, 0xffffffffu));
+}
+
+SegmentStore::SegmentStore()
+{
+}
+
+SegmentStore::SegmentStore(const QSharedPointer<Arena> &arena)
+    : mData(new Data)
+{
+    mData->arena = arena;
+}
+
+bool SegmentStore::isNull() const
+{
+    return !mData;
+}
+
+void SegmentStore::append(const SegmentRecord &record)
+{
+    if( !mData )
+        return;
+
+    Data &data = *mData;
+    const int position = data.count % CHUNK_SIZE;
+    if( position == 0 )
+    {
+        /// блоки не переезжают: арена не умеет освобождать по одному
+        Chunk *chunk = static_cast<Chunk *>(data.arena->allocate(int(sizeof(Chunk)), alignof(Chunk)));
+        data.chunks.append(chunk);
+    }
+    Chunk *chunk = data.chunks.last();
+    if( position % ANCHOR_INTERVAL == 0 )
+    {
+        chunk->anchorOffsets[position / ANCHOR_INTERVAL] = record.hasByteRange ? record.byteRangeOffset : 0;
+        chunk->anchorEntries[position / ANCHOR_INTERVAL] = data.uriEntries;
+    }
+
+    quint8 flags = 0;
+    if( record.discontinuity )
+        flags |= Discontinuity;
+    if( record.keyChanged )
+        flags |= KeyChanged;
+    if( record.mapChanged )
+        flags |= MapChanged;
+
+    const bool sameUri = data.count > 0 && record.uri == QLatin1String(data.lastUri.constData(), data.lastUri.size());
+    if( sameUri )
+        flags |= SameUri;
+    else
+        appendUri(record.uri);
+
+    quint64 bytes = 0;
+    if( record.hasByteRange )
+    {
+        flags |= ByteRange;
+        bytes = record.byteRangeLength;
+        quint64 expected = sameUri && data.previousByteRange ? data.nextOffset : 0;
+        if( record.byteRangeOffset != expected )
+        {
+            flags |= ExplicitOffset;
+            OffsetEntry entry;
+            entry.index = data.count;
+            entry.offset = record.byteRangeOffset;
+            data.offsets.append(entry);
+        }
+        data.nextOffset = record.byteRangeOffset + record.byteRangeLength;
+    }
+    else if( record.bitrate )
+    {
+        /// kbps * us / 8000 = байт
+        flags |= SizeEstimated;
+        bytes = quint64(record.bitrate) * record.durationUs / 8000;
+    }
+    data.previousByteRange = record.hasByteRange;
+
+    if( record.mapUri != QLatin1String(data.lastMapUri.constData(), data.lastMapUri.size()) )
+    {
+        data.lastMapUri = QByteArray(record.mapUri.data(), record.mapUri.size());
+        MapChange change;
+        change.index = data.count;
+        change.uri = data.arena->strings().intern(record.mapUri);
+        data.maps.append(change);
+    }
+
+    chunk->durationsUs[position] = clamp32(record.durationUs);
+    chunk->sizes[position] = clamp32(bytes);
+    chunk->flags[position] = flags;
+    data.count++;
+}
+
+void SegmentStore::squeeze()
+{
+    if( !mData )
+        return;
+
+    mData->chunks.squeeze();
+    mData->uriPages.squeeze();
+    mData->uriRestarts.squeeze();
+    mData->offsets.squeeze();
+    mData->maps.squeeze();
+}
+
+void SegmentStore::setTags(const QString &codec, const QString &language, const QString &groupId)
+{
+    if( !mData )
+        return;
+
+    StringPool &strings = mData->arena->strings();
+    mData->codec = strings.intern(codec);
+    mData->language = strings.intern(language);
+    mData->groupId = strings.intern(groupId);
+}
+
+QLatin1String SegmentStore::codec() const
+{
+    return mData ? mData->arena->strings().string(mData->codec) : QLatin1String();
+}
+
+QLatin1String SegmentStore::language() const
+{
+    return mData ? mData->arena->strings().string(mData->language) : QLatin1String();
+}
+
+QLatin1String SegmentStore::groupId() const
+{
+    return mData ? mData->arena->strings().string(mData->groupId) : QLatin1String();
+}
+
+int SegmentStore::count() const
+{
+    return mData ? mData->count : 0;
+}
+
+quint32 SegmentStore::durationUs(int index) const
+{
+    return mData->chunks.at(index / CHUNK_SIZE)->durationsUs[index % CHUNK_SIZE];
+}
+
+quint32 SegmentStore::bytes(int index) const
+{
+    return mData->chunks.at(index / CHUNK_SIZE)->sizes[index % CHUNK_SIZE];
+}
+
+quint32 SegmentStore::bitrate(int index) const
+{
+    const Chunk *chunk = mData->chunks.at(index / CHUNK_SIZE);
+    quint32 durationUs = chunk->durationsUs[index % CHUNK_SIZE];
+    if( durationUs == 0 )
+        return 0;
+    return clamp32(quint64(chunk->sizes[index % CHUNK_SIZE]) * 8000 / durationUs);
+}
+
+quint8 SegmentStore::flags(int index) const
+{
+    return mData->chunks.at(index / CHUNK_SIZE)->flags[index % CHUNK_SIZE];
+}
+
+quint64 SegmentStore::offset(int index) const
+{
+    const Chunk *chunk = mData->chunks.at(index / CHUNK_SIZE);
+    const int first = index - index % CHUNK_SIZE;
+    const int anchor = index - index % ANCHOR_INTERVAL;
+
+    /// назад до явного смещения, смены URI или якоря
+    quint64 offset = 0;
+    for( int i = index; ; --i )
+    {
+        quint8 flags = chunk->flags[i - first];
+        if( !(flags & ByteRange) )
+            return offset;
+        if( flags & ExplicitOffset )
+        {
+            const QVector<OffsetEntry> &offsets = mData->offsets;
+            QVector<OffsetEntry>::const_iterator it = std::lower_bound(offsets.constBegin(), offsets.constEnd(), i,
+                                                                          [](const OffsetEntry &entry, int i)
+            {
+                return entry.index < i;
+            });
+            return offset + it->offset;
+        }
+        if( !(flags & SameUri) )
+            return offset;
+        if( i == anchor )
+            return offset + chunk->anchorOffsets[(anchor - first) / ANCHOR_INTERVAL];
+        if( !(chunk->flags[i - 1 - first] & ByteRange) )
+            return offset;
+        offset += chunk->sizes[i - 1 - first];
+    }
+}
+
+QByteArray SegmentStore::uri(int index) const
+{
+    const int entry = uriEntry(index);
+    const UriRestart &restart = mData->uriRestarts.at(entry / URI_RESTART);
+    int page = restart.page;
+    const char *p = mData->uriPages.at(page) + restart.offset;
+
+    QByteArray uri;
+    for( int i = entry - entry % URI_RESTART; i <= entry; )
+    {
+        quint32 shared = 0;
+        quint32 length = 0;
+        p = readVarint(p, &shared);
+        p = readVarint(p, &length);
+        if( shared == 0 && length == 0 )
+        {
+            p = mData->uriPages.at(++page);
+            continue;
+        }
+        uri.truncate(int(shared));
+        uri.append(p, int(length));
+        p += length;
+        ++i;
+    }
+    return uri;
+}
+
+QLatin1String SegmentStore::mapUri(int index) const
+{
+    if( !mData )
+        return QLatin1String();
+
+    const QVector<MapChange> &maps = mData->maps;
+    QVector<MapChange>::const_iterator it = std::upper_bound(maps.constBegin(), maps.constEnd(), index,
+                                                             [](int index, const MapChange &change)
+    {
+        return index < change.index;
+    });
+    if( it == maps.constBegin() )
+        return QLatin1String();
+    return mData->arena->strings().string((it - 1)->uri);
+}
+
+void SegmentStore::setBytes(int index, quint32 bytes)
+{
+    Chunk *chunk = mData->chunks.at(index / CHUNK_SIZE);
+    quint8 &flags = chunk->flags[index % CHUNK_SIZE];
+    /// по размерам диапазонов считаются смещения - их не трогаем
+    if( flags & ByteRange )
+        return;
+    chunk->sizes[index % CHUNK_SIZE] = bytes;
+    flags = quint8((flags & ~SizeEstimated) | SizeProbed);
+}
+
+int SegmentStore::chunkCount() const
+{
+    return mData ? mData->chunks.size() : 0;
+}
+
+SegmentStore::Columns SegmentStore::columns(int chunk) const
+{
+    const Chunk *data = mData->chunks.at(chunk);
+    Columns columns;
+    columns.durationsUs = data->durationsUs;
+    columns.sizes = data->sizes;
+    columns.flags = data->flags;
+    columns.first = chunk * CHUNK_SIZE;
+    columns.count = qMin(CHUNK_SIZE, mData->count - chunk * CHUNK_SIZE);
+    return columns;
+}
+
+qint64 SegmentStore::memoryUsage() const
+{
+    if( !mData )
+        return 0;
+
+    const Data &data = *mData;
+    return qint64(sizeof(Data)) +
+            qint64(data.chunks.capacity()) * qint64(sizeof(Chunk *) + sizeof(Chunk)) +
+            qint64(data.uriPages.capacity()) * qint64(sizeof(char *)) + data.uriBytes +
+            qint64(data.uriRestarts.capacity()) * qint64(sizeof(UriRestart)) +
+            qint64(data.offsets.capacity()) * qint64(sizeof(OffsetEntry)) +
+            qint64(data.maps.capacity()) * qint64(sizeof(MapChange));
+}
+
+void SegmentStore::appendUri(QLatin1String uri)
+{
+    Data &data = *mData;
+
+    quint32 shared = 0;
+    if( data.uriEntries % URI_RESTART != 0 )
+    {
+        const int limit = qMin(uri.size(), data.lastUri.size());
+        while( int(shared) < limit && uri.data()[shared] == data.lastUri.at(int(shared)) )
+            ++shared;
+    }
+    const quint32 length = quint32(uri.size()) - shared;
+
+    /// два varint'а не длиннее 10 байт; ещё 2 - на переход к следующей странице
+    const int need = 10 + int(length) + 2;
+    if( data.uriPos == nullptr || data.uriEnd - data.uriPos < need )
+    {
+        if( data.uriPos )
+        {
+            *data.uriPos++ = 0;
+            *data.uriPos++ = 0;
+        }
+        int pageSize = qMax(URI_PAGE_SIZE, need);
+        char *page = static_cast<char *>(data.arena->allocate(pageSize, 1));
+        data.uriPages.append(page);
+        data.uriBytes += pageSize;
+        data.uriPos = page;
+        data.uriEnd = page + pageSize;
+    }
+
+    if( data.uriEntries % URI_RESTART == 0 )
+    {
+        UriRestart restart;
+        restart.page = data.uriPages.size() - 1;
+        restart.offset = int(data.uriPos - data.uriPages.last());
+        data.uriRestarts.append(restart);
+    }
+
+    data.uriPos = writeVarint(data.uriPos, shared);
+    data.uriPos = writeVarint(data.uriPos, length);
+    std::memcpy(data.uriPos, uri.data() + shared, length);
+    data.uriPos += length;
+
+    data.lastUri.truncate(int(shared));
+    data.lastUri.append(uri.data() + shared, int(length));
+    data.uriEntries++;
+}
+
+int SegmentStore::uriEntry(int index) const
+{
+    const Chunk *chunk = mData->chunks.at(index / CHUNK_SIZE);
+    const int first = index - index % CHUNK_SIZE;
+    const int anchor = index - index % ANCHOR_INTERVAL;
+    int entries = 0;
+    for( int i = anchor; i <= index; ++i )
+    {
+        if( !(chunk->flags[i - first] & SameUri) )
+            entries++;
+    }
+    /// сегмент с тем же URI ссылается на запись предыдущего
+    return chunk->anchorEntries[(anchor - first) / ANCHOR_INTERVAL] + entries - 1;
+}
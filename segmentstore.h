@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QByteArray>
+#include <QLatin1String>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include "segmentrecord.h"
+
+class Arena;
+
+/// Посегментные данные медиа-плейлиста для шкал, перцентилей и сравнений.
+/// Хранятся столбцами (struct of arrays) в блоках по CHUNK_SIZE сегментов,
+/// выделенных из арены анализа: длительность, размер и флаги - 9 байт на
+/// сегмент, плюс URI с общим префиксом (front coding), в сумме меньше
+/// 16 байт на сегмент для типичных имён. Смещения EXT-X-BYTERANGE не
+/// хранятся, а досчитываются по размерам; явные смещения и смены EXT-X-MAP
+/// лежат в разреженных таблицах; каждые ANCHOR_INTERVAL сегментов блок
+/// помнит смещение и номер записи URI, так что offset() и uri() смотрят
+/// назад не дальше якоря. Строки рендишена интернированы в арене.
+/// Копии разделяют одни данные (и арену): setBytes() видят все копии.
+/// Заполняется в одном потоке, читается после заполнения из любого.
+class SegmentStore
+{
+public:
+    static const int CHUNK_SIZE = 1024;
+    static const int ANCHOR_INTERVAL = 64;
+
+    enum Flag
+    {
+        Discontinuity = 0x01,   // EXT-X-DISCONTINUITY перед сегментом
+        KeyChanged = 0x02,      // EXT-X-KEY перед сегментом
+        MapChanged = 0x04,      // EXT-X-MAP перед сегментом
+        ByteRange = 0x08,       // EXT-X-BYTERANGE: размер точный
+        ExplicitOffset = 0x10,  // смещение не продолжает предыдущий диапазон
+        SameUri = 0x20,         // URI тот же, что у предыдущего сегмента
+        SizeEstimated = 0x40,   // размер посчитан из EXT-X-BITRATE
+        SizeProbed = 0x80       // размер узнан запросом, см. setBytes()
+    };
+
+    /// столбцы одного блока для последовательных проходов
+    struct Columns
+    {
+        const quint32 *durationsUs = nullptr;
+        const quint32 *sizes = nullptr;     // байт; 0 - неизвестен
+        const quint8 *flags = nullptr;
+        int first = 0;      // номер первого сегмента блока
+        int count = 0;
+    };
+
+    SegmentStore();
+    explicit SegmentStore(const QSharedPointer<Arena> &arena);
+
+    bool isNull() const;
+    void append(const SegmentRecord &record);
+    void squeeze();
+
+    /// CODEC, LANGUAGE и GROUP-ID рендишена, интернируются в арене
+    void setTags(const QString &codec, const QString &language, const QString &groupId);
+    QLatin1String codec() const;
+    QLatin1String language() const;
+    QLatin1String groupId() const;
+
+    int count() const;
+    quint32 durationUs(int index) const;
+    /// 0 - размер неизвестен
+    quint32 bytes(int index) const;
+    /// kbps; 0 - размер неизвестен
+    quint32 bitrate(int index) const;
+    quint8 flags(int index) const;
+    /// начало диапазона EXT-X-BYTERANGE; 0 - сегмент целиком
+    quint64 offset(int index) const;
+    QByteArray uri(int index) const;
+    /// действующий EXT-X-MAP; пусто - нет
+    QLatin1String mapUri(int index) const;
+
+    /// размер сегмента без EXT-X-BYTERANGE, узнанный отдельно
+    void setBytes(int index, quint32 bytes);
+
+    int chunkCount() const;
+    Columns columns(int chunk) const;
+
+    /// байт под сегменты, включая разреженные таблицы
+    qint64 memoryUsage() const;
+
+private:
+    struct Chunk;
+    struct Data;
+
+    void appendUri(QLatin1String uri);
+    int uriEntry(int index) const;
+
+private:
+    QSharedPointer<Data> mData;
+};
@@ -0,0 +1,330 @@
+#include "snapshot.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
+#include <QSaveFile>
+
+#include <cstring>
+
+#include "hlsanalyzer.h"
+#include "localfiles.h"
+
+const quint32 SNAPSHOT_MAGIC = 0x53534c48; // "HLSS"
+const int RECORD_ALIGNMENT = 8;
+
+struct Snapshot::Header
+{
+    quint32 magic;
+    quint32 version;
+    quint32 flags;
+    quint32 reserved;
+    qint64 time;            //in milliseconds since epoch
+    StringRef url;
+    StringRef error;
+    quint32 renditionCount;
+    quint32 renditionOffset;
+    quint32 variantCount;
+    quint32 variantOffset;
+    quint32 stringsOffset;
+    quint32 stringsSize;
+};
+
+/// размеры записей - часть формата
+Q_STATIC_ASSERT(sizeof(Snapshot::StringRef) == 8);
+Q_STATIC_ASSERT(sizeof(Snapshot::Rendition) == 40);
+Q_STATIC_ASSERT(sizeof(Snapshot::Variant) == 24);
+
+static int align(int size)
+{
+    return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+/// Таблица строк снимка: одинаковые строки (кодеки, языки) хранятся раз
+class StringTable
+{
+public:
+    Snapshot::StringRef add(const QString &value)
+    {
+        QByteArray utf8 = value.toUtf8();
+        auto it = mRefs.constFind(utf8);
+        if( it != mRefs.constEnd() )
+            return it.value();
+
+        Snapshot::StringRef ref;
+        ref.offset = quint32(mData.size());
+        ref.size = quint32(utf8.size());
+        mData.append(utf8);
+        mRefs.insert(utf8, ref);
+        return ref;
+    }
+
+    const QByteArray &data() const
+    {
+        return mData;
+    }
+
+private:
+    QByteArray mData;
+    QHash<QByteArray, Snapshot::StringRef> mRefs;
+};
+
+Snapshot::Snapshot()
+    : mRenditions(nullptr)
+    , mVariants(nullptr)
+    , mStrings(nullptr)
+    , mStringsSize(0)
+{
+    mErrorString = "Пустой снимок";
+}
+
+Snapshot::Snapshot(const QByteArray &data)
+    : mData(data)
+    , mRenditions(nullptr)
+    , mVariants(nullptr)
+    , mStrings(nullptr)
+    , mStringsSize(0)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    fail("Снимки читаются только на little-endian");
+    return;
+#endif
+    const quint64 size = quint64(mData.size());
+    if( size < sizeof(Header) )
+    {
+        fail("Файл короче заголовка");
+        return;
+    }
+    if( quintptr(mData.constData()) % RECORD_ALIGNMENT != 0 )
+    {
+        /// записи читаются на месте, поэтому данные должны быть выровнены
+        mData = QByteArray(data.constData(), data.size());
+    }
+
+    const Header *h = header();
+    if( h->magic != SNAPSHOT_MAGIC )
+    {
+        fail("Не снимок анализа");
+        return;
+    }
+    if( h->version != FORMAT_VERSION )
+    {
+        fail(QString("Неподдерживаемая версия снимка %1").arg(h->version));
+        return;
+    }
+    if( h->renditionOffset % RECORD_ALIGNMENT != 0 || h->variantOffset % RECORD_ALIGNMENT != 0 ||
+        quint64(h->renditionOffset) + quint64(h->renditionCount) * sizeof(Rendition) > size ||
+        quint64(h->variantOffset) + quint64(h->variantCount) * sizeof(Variant) > size ||
+        quint64(h->stringsOffset) + h->stringsSize > size )
+    {
+        fail("Снимок повреждён");
+        return;
+    }
+
+    mRenditions = reinterpret_cast<const Rendition *>(mData.constData() + h->renditionOffset);
+    mVariants = reinterpret_cast<const Variant *>(mData.constData() + h->variantOffset);
+    mStrings = mData.constData() + h->stringsOffset;
+    mStringsSize = h->stringsSize;
+}
+
+Snapshot Snapshot::open(const QString &path)
+{
+    QSharedPointer<MappedFile> file(new MappedFile(path));
+    if( !file->isOpen() )
+    {
+        Snapshot snapshot;
+        snapshot.fail(file->errorString());
+        return snapshot;
+    }
+
+    Snapshot snapshot(file->data());
+    snapshot.mFile = file;
+    return snapshot;
+}
+
+QByteArray Snapshot::serialize(const AnalysisResult &result, qint64 time)
+{
+    StringTable strings;
+    QVector<Rendition> renditions;
+    QVector<Variant> variants;
+    /// рендишен входит в несколько вариантов, в снимке он один
+    QHash<QString, int> videoIndexes;
+    QHash<QString, int> audioIndexes;
+
+    foreach(auto &variantStream, result.variantStreams)
+    {
+        Variant variant;
+        variant.averageBandwidth = variantStream.averageBandwidth;
+        variant.peakBandwidth = variantStream.peakBandwidth;
+        variant.realPeakBandwidth = variantStream.realPeakBandwidth;
+        variant.peakRangeCount = quint32(variantStream.peakRanges.size());
+
+        const VideoStream &video = variantStream.videoStream;
+        if( !video.url.isEmpty() )
+        {
+            auto it = videoIndexes.constFind(video.url);
+            if( it == videoIndexes.constEnd() )
+            {
+                Rendition rendition;
+                rendition.url = strings.add(video.url);
+                rendition.codec = strings.add(video.codec);
+                rendition.detail = strings.add(video.resolution);
+                rendition.bitrate = video.realVideoBitrate;
+                rendition.probedBitrate = video.probedBitrate;
+                rendition.segmentCount = video.segmentCount;
+                it = videoIndexes.insert(video.url, renditions.size());
+                renditions.append(rendition);
+            }
+            variant.video = it.value();
+        }
+
+        const AudioStream &audio = variantStream.audioStream;
+        if( !audio.url.isEmpty() )
+        {
+            auto it = audioIndexes.constFind(audio.url);
+            if( it == audioIndexes.constEnd() )
+            {
+                Rendition rendition;
+                rendition.url = strings.add(audio.url);
+                rendition.codec = strings.add(audio.codec);
+                rendition.detail = strings.add(audio.language);
+                rendition.bitrate = audio.realAudioBitrate;
+                rendition.probedBitrate = audio.probedBitrate;
+                rendition.segmentCount = audio.segmentCount;
+                rendition.isAudio = 1;
+                rendition.channels = quint16(qMin<quint32>(audio.numOfChannels, 0xffff));
+                it = audioIndexes.insert(audio.url, renditions.size());
+                renditions.append(rendition);
+            }
+            variant.audio = it.value();
+        }
+        variants.append(variant);
+    }
+
+    Q_STATIC_ASSERT(sizeof(Header) == 64);
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = FORMAT_VERSION;
+    h.flags = (result.partial ? Partial : 0) | (result.errorString.isEmpty() ? 0 : Failed);
+    h.time = time;
+    h.url = strings.add(result.url);
+    h.error = strings.add(result.errorString);
+    h.renditionCount = quint32(renditions.size());
+    h.renditionOffset = quint32(align(int(sizeof(Header))));
+    h.variantCount = quint32(variants.size());
+    h.variantOffset = quint32(align(int(h.renditionOffset + renditions.size() * sizeof(Rendition))));
+    h.stringsOffset = quint32(align(int(h.variantOffset + variants.size() * sizeof(Variant))));
+    h.stringsSize = quint32(strings.data().size());
+
+    QByteArray data(int(h.stringsOffset + h.stringsSize), '\0');
+    char *out = data.data();
+    std::memcpy(out, &h, sizeof(h));
+    if( !renditions.isEmpty() )
+        std::memcpy(out + h.renditionOffset, renditions.constData(), renditions.size() * sizeof(Rendition));
+    if( !variants.isEmpty() )
+        std::memcpy(out + h.variantOffset, variants.constData(), variants.size() * sizeof(Variant));
+    std::memcpy(out + h.stringsOffset, strings.data().constData(), h.stringsSize);
+    return data;
+}
+
+bool Snapshot::save(const QString &path, const AnalysisResult &result, qint64 time)
+{
+    QSaveFile file(path);
+    if( !file.open(QIODevice::WriteOnly) )
+    {
+        qDebug() << "Error: " << path << file.errorString();
+        return false;
+    }
+    file.write(serialize(result, time));
+    if( !file.commit() )
+    {
+        qDebug() << "Error: " << path << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString Snapshot::fileName(const QString &url, qint64 time)
+{
+    QByteArray hash = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    QString stamp = QDateTime::fromMSecsSinceEpoch(time, Qt::UTC).toString("yyyyMMdd'T'HHmmsszzz");
+    return QString("%1-%2.hlss").arg(QString::fromLatin1(hash), stamp);
+}
+
+bool Snapshot::isValid() const
+{
+    return mStrings != nullptr;
+}
+
+QString Snapshot::errorString() const
+{
+    return mErrorString;
+}
+
+qint64 Snapshot::time() const
+{
+    return isValid() ? header()->time : 0;
+}
+
+quint32 Snapshot::flags() const
+{
+    return isValid() ? header()->flags : 0;
+}
+
+QString Snapshot::url() const
+{
+    return isValid() ? QString::fromUtf8(string(header()->url)) : QString();
+}
+
+QString Snapshot::analysisError() const
+{
+    return isValid() ? QString::fromUtf8(string(header()->error)) : QString();
+}
+
+int Snapshot::renditionCount() const
+{
+    return isValid() ? int(header()->renditionCount) : 0;
+}
+
+const Snapshot::Rendition &Snapshot::rendition(int index) const
+{
+    return mRenditions[index];
+}
+
+int Snapshot::variantCount() const
+{
+    return isValid() ? int(header()->variantCount) : 0;
+}
+
+const Snapshot::Variant &Snapshot::variant(int index) const
+{
+    return mVariants[index];
+}
+
+QByteArray Snapshot::string(const StringRef &ref) const
+{
+    if( quint64(ref.offset) + ref.size > mStringsSize )
+        return QByteArray();
+    return QByteArray::fromRawData(mStrings + ref.offset, int(ref.size));
+}
+
+QByteArray Snapshot::data() const
+{
+    return mData;
+}
+
+void Snapshot::fail(const QString &errorString)
+{
+    mErrorString = errorString;
+    mRenditions = nullptr;
+    mVariants = nullptr;
+    mStrings = nullptr;
+    mStringsSize = 0;
+}
+
+const Snapshot::Header *Snapshot::header() const
+{
+    return reinterpret_cast<const Header *>(mData.constData());
+}
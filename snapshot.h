@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+
+struct AnalysisResult;
+class MappedFile;
+
+/// Снимок результата анализа в компактном двоичном виде для хранения и
+/// сравнения прогонов. Файл - заголовок, массивы записей фиксированного
+/// размера (рендишены и варианты) и таблица строк; ссылки на строки -
+/// смещение и длина. Все поля выровнены, порядок байт - little-endian,
+/// поэтому файл читается прямо из отображения в память: открытие
+/// проверяет только заголовок и границы массивов, без разбора.
+/// Копии разделяют данные. Формат версионируется, при его изменении
+/// FORMAT_VERSION увеличивается и старые снимки не открываются.
+class Snapshot
+{
+public:
+    static const quint32 FORMAT_VERSION = 1;
+
+    enum Flag
+    {
+        Partial = 0x01, // часть медиа-плейлистов не получена
+        Failed = 0x02   // анализ не удался, см. analysisError()
+    };
+
+    struct StringRef
+    {
+        quint32 offset = 0; // от начала таблицы строк
+        quint32 size = 0;
+    };
+
+    /// уникальный медиа-плейлист снимка
+    struct Rendition
+    {
+        StringRef url;
+        StringRef codec;
+        StringRef detail;           // видео - разрешение, аудио - язык
+        quint32 bitrate = 0;        //in bits per second
+        quint32 probedBitrate = 0;  //in bits per second
+        quint32 segmentCount = 0;
+        quint16 isAudio = 0;
+        quint16 channels = 0;
+    };
+
+    struct Variant
+    {
+        quint32 averageBandwidth = 0;   //in bits per second
+        quint32 peakBandwidth = 0;      //in bits per second
+        quint32 realPeakBandwidth = 0;  //in bits per second
+        qint32 video = -1;              // номер рендишена, -1 - нет
+        qint32 audio = -1;
+        quint32 peakRangeCount = 0;
+    };
+
+    /// пустой, недействительный снимок
+    Snapshot();
+    /// data не копируются; для данных fromRawData они должны жить дольше снимка
+    explicit Snapshot(const QByteArray &data);
+
+    /// отображает файл в память, данные живут с последней копией снимка
+    static Snapshot open(const QString &path);
+    /// time - время анализа в миллисекундах от эпохи
+    static QByteArray serialize(const AnalysisResult &result, qint64 time);
+    static bool save(const QString &path, const AnalysisResult &result, qint64 time);
+    /// имя файла снимка: хэш мастер-URL и время, так что снимки одного
+    /// потока в каталоге идут по порядку
+    static QString fileName(const QString &url, qint64 time);
+
+    bool isValid() const;
+    /// почему снимок не открылся
+    QString errorString() const;
+
+    qint64 time() const;
+    quint32 flags() const;
+    QString url() const;
+    QString analysisError() const;
+
+    int renditionCount() const;
+    const Rendition &rendition(int index) const;
+    int variantCount() const;
+    const Variant &variant(int index) const;
+
+    /// без копирования, пока жив снимок; пусто для ссылки за границей таблицы
+    QByteArray string(const StringRef &ref) const;
+    QByteArray data() const;
+
+private:
+    struct Header;
+
+    void fail(const QString &errorString);
+    const Header *header() const;
+
+private:
+    QSharedPointer<MappedFile> mFile;
+    QByteArray mData;
+    QString mErrorString;
+    const Rendition *mRenditions;
+    const Variant *mVariants;
+    const char *mStrings;
+    quint32 mStringsSize;
+};
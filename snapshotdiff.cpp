@@ -0,0 +1,192 @@
+#include "snapshotdiff.h"
+
+#include <QHash>
+
+/// URL рендишена без query, без копирования
+static QByteArray renditionKey(const Snapshot &snapshot, int index)
+{
+    QByteArray url = snapshot.string(snapshot.rendition(index).url);
+    int query = url.indexOf('?');
+    if( query != -1 )
+        url.truncate(query);
+    return url;
+}
+
+static QByteArray variantKey(const Snapshot &snapshot, int index)
+{
+    const Snapshot::Variant &variant = snapshot.variant(index);
+    QByteArray key;
+    if( variant.video >= 0 && variant.video < snapshot.renditionCount() )
+        key = renditionKey(snapshot, variant.video);
+    key.append('\n');
+    if( variant.audio >= 0 && variant.audio < snapshot.renditionCount() )
+        key.append(renditionKey(snapshot, variant.audio));
+    return key;
+}
+
+static QString variantName(const QByteArray &key)
+{
+    QString name = QString::fromUtf8(key);
+    if( name.endsWith('\n') )
+        name.chop(1);
+    else
+        name.replace('\n', " + ");
+    return name;
+}
+
+QString SnapshotChange::kindName(Kind kind)
+{
+    switch( kind )
+    {
+    case RenditionAdded:
+        return "renditionAdded";
+    case RenditionRemoved:
+        return "renditionRemoved";
+    case BitrateChanged:
+        return "bitrateChanged";
+    case SegmentCountChanged:
+        return "segmentCountChanged";
+    case CodecChanged:
+        return "codecChanged";
+    case VariantAdded:
+        return "variantAdded";
+    case VariantRemoved:
+        return "variantRemoved";
+    case BandwidthChanged:
+        return "bandwidthChanged";
+    }
+    return QString();
+}
+
+SnapshotDiff::SnapshotDiff()
+    : mThreshold(5)
+{
+}
+
+void SnapshotDiff::setThreshold(qreal percent)
+{
+    mThreshold = qMax<qreal>(0, percent);
+}
+
+QVector<SnapshotChange> SnapshotDiff::compare(const Snapshot &before, const Snapshot &after) const
+{
+    QVector<SnapshotChange> changes;
+
+    /// видео и аудио сопоставляются отдельно: URL у них могут совпадать
+    QHash<QByteArray, int> renditions[2];
+    renditions[0].reserve(before.renditionCount());
+    for( int i = 0; i < before.renditionCount(); ++i )
+    {
+        renditions[before.rendition(i).isAudio ? 1 : 0].insert(renditionKey(before, i), i);
+    }
+
+    QVector<bool> matched(before.renditionCount(), false);
+    for( int i = 0; i < after.renditionCount(); ++i )
+    {
+        const Snapshot::Rendition &current = after.rendition(i);
+        QByteArray key = renditionKey(after, i);
+
+        SnapshotChange change;
+        change.isAudio = current.isAudio;
+        change.url = QString::fromUtf8(key);
+
+        int index = renditions[current.isAudio ? 1 : 0].value(key, -1);
+        if( index == -1 )
+        {
+            change.kind = SnapshotChange::RenditionAdded;
+            change.after = current.bitrate;
+            changes.append(change);
+            continue;
+        }
+        matched[index] = true;
+
+        const Snapshot::Rendition &previous = before.rendition(index);
+        QByteArray previousCodec = before.string(previous.codec);
+        QByteArray currentCodec = after.string(current.codec);
+        if( previousCodec != currentCodec )
+        {
+            change.kind = SnapshotChange::CodecChanged;
+            change.text = QString("%1 -> %2").arg(QString::fromUtf8(previousCodec), QString::fromUtf8(currentCodec));
+            changes.append(change);
+        }
+        if( shifted(previous.bitrate, current.bitrate) )
+        {
+            change.kind = SnapshotChange::BitrateChanged;
+            change.before = previous.bitrate;
+            change.after = current.bitrate;
+            change.text.clear();
+            changes.append(change);
+        }
+        if( previous.segmentCount != current.segmentCount )
+        {
+            change.kind = SnapshotChange::SegmentCountChanged;
+            change.before = previous.segmentCount;
+            change.after = current.segmentCount;
+            change.text.clear();
+            changes.append(change);
+        }
+    }
+    for( int i = 0; i < before.renditionCount(); ++i )
+    {
+        if( matched.at(i) )
+            continue;
+        SnapshotChange change;
+        change.kind = SnapshotChange::RenditionRemoved;
+        change.isAudio = before.rendition(i).isAudio;
+        change.url = QString::fromUtf8(renditionKey(before, i));
+        change.before = before.rendition(i).bitrate;
+        changes.append(change);
+    }
+
+    QHash<QByteArray, int> variants;
+    variants.reserve(before.variantCount());
+    for( int i = 0; i < before.variantCount(); ++i )
+    {
+        variants.insert(variantKey(before, i), i);
+    }
+
+    matched.fill(false, before.variantCount());
+    for( int i = 0; i < after.variantCount(); ++i )
+    {
+        QByteArray key = variantKey(after, i);
+        SnapshotChange change;
+        change.url = variantName(key);
+
+        int index = variants.value(key, -1);
+        if( index == -1 )
+        {
+            change.kind = SnapshotChange::VariantAdded;
+            change.after = after.variant(i).averageBandwidth;
+            changes.append(change);
+            continue;
+        }
+        matched[index] = true;
+
+        if( before.variant(index).averageBandwidth != after.variant(i).averageBandwidth )
+        {
+            change.kind = SnapshotChange::BandwidthChanged;
+            change.before = before.variant(index).averageBandwidth;
+            change.after = after.variant(i).averageBandwidth;
+            changes.append(change);
+        }
+    }
+    for( int i = 0; i < before.variantCount(); ++i )
+    {
+        if( matched.at(i) )
+            continue;
+        SnapshotChange change;
+        change.kind = SnapshotChange::VariantRemoved;
+        change.url = variantName(variantKey(before, i));
+        change.before = before.variant(i).averageBandwidth;
+        changes.append(change);
+    }
+    return changes;
+}
+
+bool SnapshotDiff::shifted(quint32 before, quint32 after) const
+{
+    if( before == 0 || after == 0 )
+        return before != after;
+    quint32 delta = before > after ? before - after : after - before;
+    return delta / static_cast<qreal>(before) * 100 > mThreshold;
+}
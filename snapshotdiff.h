@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "snapshot.h"
+
+/// Изменение между двумя снимками одного потока
+struct SnapshotChange
+{
+    enum Kind
+    {
+        RenditionAdded,
+        RenditionRemoved,
+        BitrateChanged,         // измеренный битрейт сдвинулся больше порога
+        SegmentCountChanged,
+        CodecChanged,
+        VariantAdded,
+        VariantRemoved,
+        BandwidthChanged        // заявленный AVERAGE-BANDWIDTH
+    };
+
+    Kind kind = RenditionAdded;
+    bool isAudio = false;
+    /// рендишен; для вариантов - видео и аудио через " + "
+    QString url;
+    qint64 before = 0;
+    qint64 after = 0;
+    /// для CodecChanged - кодеки "до -> после"
+    QString text;
+
+    static QString kindName(Kind kind);
+};
+
+/// Сравнение снимков рендишен за рендишеном. Рендишены сопоставляются по
+/// URL без query (токены доступа меняются между прогонами), варианты -
+/// по паре своих рендишенов. Строки читаются прямо из снимков, так что
+/// сравнение не копирует данные и годится для прохода по тысячам снимков.
+class SnapshotDiff
+{
+public:
+    SnapshotDiff();
+
+    /// битрейт считается изменившимся, если сдвинулся больше чем на percent
+    void setThreshold(qreal percent);
+
+    QVector<SnapshotChange> compare(const Snapshot &before, const Snapshot &after) const;
+
+private:
+    bool shifted(quint32 before, quint32 after) const;
+
+private:
+    // in percent
+    qreal mThreshold;
+};
@@ -0,0 +1,158 @@
+#include "snapshotreport.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+static QString timeString(qint64 time)
+{
+    return QDateTime::fromMSecsSinceEpoch(time, Qt::UTC).toString(Qt::ISODateWithMs);
+}
+
+/// снимки одного потока - с общим хэшем мастер-URL в начале имени
+static QString streamKey(const QString &fileName)
+{
+    return fileName.section('-', 0, 0);
+}
+
+SnapshotReport::SnapshotReport()
+    : mAnalyzer(nullptr)
+    , mChangeCount(0)
+{
+    mOut.open(stdout, QIODevice::WriteOnly);
+}
+
+SnapshotReport::~SnapshotReport()
+{
+    delete mAnalyzer;
+}
+
+void SnapshotReport::setThreshold(qreal percent)
+{
+    mDiff.setThreshold(percent);
+}
+
+void SnapshotReport::setAnalysisOptions(const AnalysisOptions &options)
+{
+    mOptions = options;
+}
+
+bool SnapshotReport::diff(const QString &before, const QString &after)
+{
+    Snapshot first = load(before);
+    if( !first.isValid() )
+        return false;
+    Snapshot second = load(after);
+    if( !second.isValid() )
+        return false;
+
+    write(first, second, mDiff.compare(first, second));
+    return true;
+}
+
+bool SnapshotReport::history(const QString &directory)
+{
+    QDir dir(directory);
+    if( !dir.exists() )
+    {
+        qCritical() << "Нет каталога" << directory;
+        return false;
+    }
+
+    /// имена упорядочены по потоку, затем по времени; отображены в память
+    /// одновременно только два снимка
+    QStringList names = dir.entryList(QStringList() << "*.hlss", QDir::Files, QDir::Name);
+    Snapshot previous;
+    QString previousKey;
+    foreach(auto &name, names)
+    {
+        Snapshot current = Snapshot::open(dir.filePath(name));
+        if( !current.isValid() )
+        {
+            qDebug() << "Error: " << name << current.errorString();
+            continue;
+        }
+
+        QString key = streamKey(name);
+        if( previous.isValid() && key == previousKey )
+        {
+            QVector<SnapshotChange> changes = mDiff.compare(previous, current);
+            if( !changes.isEmpty() )
+            {
+                write(previous, current, changes);
+            }
+        }
+        previous = current;
+        previousKey = key;
+    }
+    return true;
+}
+
+int SnapshotReport::changeCount() const
+{
+    return mChangeCount;
+}
+
+Snapshot SnapshotReport::load(const QString &source)
+{
+    if( QFileInfo(source).isFile() && source.endsWith(".hlss") )
+    {
+        Snapshot snapshot = Snapshot::open(source);
+        if( !snapshot.isValid() )
+        {
+            qCritical() << "Не удалось открыть" << source << snapshot.errorString();
+        }
+        return snapshot;
+    }
+
+    if( !mAnalyzer )
+    {
+        mAnalyzer = new HlsAnalyzer;
+    }
+    /// анализ идёт в потоках анализатора, здесь его можно просто дождаться
+    AnalysisResult result = mAnalyzer->analyze(source, mOptions).result();
+    if( !result.errorString.isEmpty() )
+    {
+        qCritical() << "Не удалось проанализировать" << source << result.errorString;
+        return Snapshot();
+    }
+    return Snapshot(Snapshot::serialize(result, QDateTime::currentMSecsSinceEpoch()));
+}
+
+void SnapshotReport::write(const Snapshot &before, const Snapshot &after, const QVector<SnapshotChange> &changes)
+{
+    QJsonObject object;
+    object.insert("master", after.url());
+    object.insert("before", timeString(before.time()));
+    object.insert("after", timeString(after.time()));
+
+    QJsonArray items;
+    foreach(auto &change, changes)
+    {
+        QJsonObject item;
+        item.insert("kind", SnapshotChange::kindName(change.kind));
+        item.insert("url", change.url);
+        if( change.isAudio )
+            item.insert("audio", true);
+        if( !change.text.isEmpty() )
+        {
+            item.insert("text", change.text);
+        }
+        else
+        {
+            item.insert("before", change.before);
+            item.insert("after", change.after);
+        }
+        items.append(item);
+    }
+    object.insert("changes", items);
+    mChangeCount += changes.size();
+
+    mOut.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    mOut.write("\n");
+    mOut.flush();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QFile>
+
+#include "hlsanalyzer.h"
+#include "snapshotdiff.h"
+
+/// Отчёты по снимкам анализа для командной строки: сравнение двух
+/// прогонов и история изменений по каталогу снимков. Изменения пишутся
+/// в stdout строками JSON.
+class SnapshotReport
+{
+public:
+    SnapshotReport();
+    ~SnapshotReport();
+
+    void setThreshold(qreal percent);
+    void setAnalysisOptions(const AnalysisOptions &options);
+
+    /// before и after - файлы снимков или мастер-URL: URL анализируется
+    /// сейчас же и сравнивается как снимок
+    bool diff(const QString &before, const QString &after);
+    /// все снимки каталога: каждый сравнивается с предыдущим снимком того
+    /// же потока, выводятся только снимки с изменениями
+    bool history(const QString &directory);
+
+    int changeCount() const;
+
+private:
+    Q_DISABLE_COPY(SnapshotReport)
+
+    Snapshot load(const QString &source);
+    void write(const Snapshot &before, const Snapshot &after, const QVector<SnapshotChange> &changes);
+
+private:
+    QFile mOut;
+    SnapshotDiff mDiff;
+    AnalysisOptions mOptions;
+    HlsAnalyzer *mAnalyzer;
+    int mChangeCount;
+};
@@ -0,0 +1,778 @@
+#include "streamanalysis.h"
+
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include "arena.h"
+#include "deepprobe.h"
+#include "fmp4probe.h"
+#include "localfiles.h"
+#include "mediaplaylistparser.h"
+#include "peakbitrate.h"
+#include "playlistcache.h"
+#include "playlistmetrics.h"
+#include "requestscheduler.h"
+#include "segmentsizeprober.h"
+#include "tsprobe.h"
+
+const qint64 READ_BUFFER_SIZE = 256 * 1024;
+const quint32 DEFAULT_PEAK_WINDOW_MS = 10000;
+const int DEFAULT_PROBE_RATE = 0;
+
+/// Номера сегментов без размера, см. UnsizedSegments
+static QVector<int> unsizedSegments(const SegmentStore &segments)
+{
+    UnsizedSegments unsized;
+    scanSegments(segments, PlaylistInfo(), unsized);
+    return unsized.unsizedSegments();
+}
+
+/// Размеры сегментов indexes (-1 - неизвестен) - в сохранённые сегменты;
+/// копия SegmentStore разделяет данные. Возвращает средний битрейт,
+/// пересчитанный по всем размерам с весом по длительности
+static quint32 storeSegmentSizes(SegmentStore segments, const QVector<int> &indexes, const QVector<qint64> &sizes)
+{
+    for( int i = 0; i < indexes.size() && i < sizes.size(); ++i )
+    {
+        if( sizes.at(i) >= 0 )
+            segments.setBytes(indexes.at(i), quint32(qMin<qint64>(sizes.at(i), 0xffffffffu)));
+    }
+
+    BitrateMean mean;
+    scanSegments(segments, PlaylistInfo(), mean);
+    return mean.averageBitrate();
+}
+
+/// Столбцы для кэша результатов: длительности и размеры без URI
+static void cacheSegments(const SegmentStore &segments, PlaylistCache::Result *result)
+{
+    result->durationsUs.reserve(segments.count());
+    result->sizes.reserve(segments.count());
+    for( int chunk = 0; chunk < segments.chunkCount(); ++chunk )
+    {
+        SegmentStore::Columns columns = segments.columns(chunk);
+        for( int i = 0; i < columns.count; ++i )
+        {
+            result->durationsUs.append(columns.durationsUs[i]);
+            result->sizes.append(columns.sizes[i]);
+        }
+    }
+}
+
+/// Сегменты из кэша результатов - только для проверки пиков
+static SegmentStore restoreSegments(const PlaylistCache::Result &result)
+{
+    SegmentStore segments(QSharedPointer<Arena>(new Arena));
+    const int count = qMin(result.durationsUs.size(), result.sizes.size());
+    for( int i = 0; i < count; ++i )
+    {
+        SegmentRecord record;
+        record.durationUs = result.durationsUs.at(i);
+        segments.append(record);
+        if( result.sizes.at(i) )
+            segments.setBytes(i, result.sizes.at(i));
+    }
+    segments.squeeze();
+    return segments;
+}
+
+/// Диапазон EXT-X-BYTERANGE внутри отображённого файла; length = 0 - весь файл
+static QByteArray byteRange(const QByteArray &data, quint64 offset, quint64 length)
+{
+    if( length == 0 )
+        return data;
+    if( offset >= quint64(data.size()) )
+        return QByteArray();
+    length = qMin(length, quint64(data.size()) - offset);
+    return QByteArray::fromRawData(data.constData() + offset, int(length));
+}
+
+/// Глубокая проверка локальных сегментов: файлы отображаются в память
+/// целиком, TsProbe и Fmp4Probe читают их на месте
+static ProbeSummary probeLocalSegments(const QString &playlistPath, const QVector<SampledSegment> &segments)
+{
+    ProbeSummary summary;
+    QUrl base = QUrl::fromLocalFile(playlistPath);
+    QHash<QByteArray, Fmp4Probe> inits;
+    foreach(const SampledSegment &segment, segments)
+    {
+        MappedFile file(base.resolved(QUrl(QString::fromUtf8(segment.uri))).toLocalFile());
+        if( !file.isOpen() )
+            continue;
+        QByteArray data = byteRange(file.data(), segment.byteRangeOffset, segment.byteRangeLength);
+
+        if( segment.mapUri.isEmpty() )
+        {
+            TsProbe probe;
+            probe.feed(data);
+            probe.finish();
+            summary.add(probe, segment.durationMs);
+            continue;
+        }
+
+        QByteArray key = DeepProbe::initKey(segment);
+        if( !inits.contains(key) )
+        {
+            Fmp4Probe init;
+            MappedFile initFile(base.resolved(QUrl(QString::fromUtf8(segment.mapUri))).toLocalFile());
+            if( initFile.isOpen() )
+            {
+                init.feed(byteRange(initFile.data(), segment.mapByteRangeOffset, segment.mapByteRangeLength));
+                init.finish();
+            }
+            inits.insert(key, init);
+        }
+
+        Fmp4Probe probe = inits.value(key);
+        if( !probe.isValid() )
+            continue;
+        probe.feed(data);
+        probe.finish();
+        summary.add(probe);
+    }
+    return summary;
+}
+
+StreamAnalysis::StreamAnalysis(RequestScheduler *scheduler, const QString &url, QObject *parent)
+    : QObject(parent)
+    , mScheduler(scheduler)
+    , mUrl(url)
+    , mPartial(false)
+    , mPendingReplies(0)
+    , mTotalReplies(0)
+    , mPeakWindowMs(DEFAULT_PEAK_WINDOW_MS)
+    , mProbeRate(DEFAULT_PROBE_RATE)
+    , mSampleInterval(0)
+    , mDeadlineMs(0)
+    , mDeadline(nullptr)
+    , mPipeline(new ParsePipeline(this))
+    , mLocalWatcher(nullptr)
+{
+    connect(mPipeline, &ParsePipeline::resultsReady, this, &StreamAnalysis::onParseResults);
+    connect(mPipeline, &ParsePipeline::capacityAvailable, this, &StreamAnalysis::onCapacityAvailable);
+}
+
+void StreamAnalysis::setPeakWindow(quint32 windowMs)
+{
+    mPeakWindowMs = windowMs;
+}
+
+void StreamAnalysis::setProbeRate(int requestsPerSecond)
+{
+    mProbeRate = requestsPerSecond;
+}
+
+void StreamAnalysis::setDeepProbe(int sampleInterval)
+{
+    mSampleInterval = sampleInterval;
+}
+
+void StreamAnalysis::setDeadline(int ms)
+{
+    mDeadlineMs = ms;
+}
+
+void StreamAnalysis::setKeepSegments(bool keep)
+{
+    mArena = keep ? QSharedPointer<Arena>(new Arena) : QSharedPointer<Arena>();
+}
+
+void StreamAnalysis::start()
+{
+    if( mDeadlineMs > 0 )
+    {
+        mDeadline = new QTimer(this);
+        mDeadline->setSingleShot(true);
+        connect(mDeadline, &QTimer::timeout, this, &StreamAnalysis::onDeadline);
+        mDeadline->start(mDeadlineMs);
+    }
+
+    if( LocalFiles::isLocal(mUrl) )
+    {
+        /// ошибка открытия или пустой плейлист завершают анализ сразу:
+        /// finished не должен приходить раньше, чем start() вернёт управление
+        QMetaObject::invokeMethod(this, [this]()
+        {
+            startLocal();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    QNetworkRequest request(mUrl);
+    mScheduler->get(request, RequestScheduler::MasterPriority, this, [this](QNetworkReply *reply)
+    {
+        connect(reply, &QNetworkReply::finished, this, [this, reply]()
+        {
+            onMasterReplyFinished(reply);
+        });
+    });
+}
+
+QString StreamAnalysis::url() const
+{
+    return mUrl;
+}
+
+QString StreamAnalysis::errorString() const
+{
+    return mErrorString;
+}
+
+bool StreamAnalysis::isPartial() const
+{
+    return mPartial;
+}
+
+const QList<VariantStream> &StreamAnalysis::variantStreams() const
+{
+    return mMaster.variantStreams();
+}
+
+const StreamRegistry &StreamAnalysis::registry() const
+{
+    return mMaster.registry();
+}
+
+const QHash<int, SegmentStore> &StreamAnalysis::segments() const
+{
+    return mSegments;
+}
+
+void StreamAnalysis::startLocal()
+{
+    QString path = LocalFiles::toLocalPath(mUrl);
+    MappedFile file(path);
+    if( !file.isOpen() )
+    {
+        fail(file.errorString());
+        return;
+    }
+
+    QUrl base = QUrl::fromLocalFile(QFileInfo(path).absolutePath() + "/");
+    if( !mMaster.parse(file.data(), base) )
+    {
+        fail("Неверный формат!");
+        return;
+    }
+
+    /// пути считаем здесь: реестр не должен читаться из рабочих потоков
+    QVector<LocalJob> jobs;
+    foreach(int videoId, mMaster.videoIds())
+    {
+        LocalJob job;
+        job.id = videoId;
+        job.path = QUrl(mMaster.registry().url(videoId)).toLocalFile();
+        job.sampleInterval = mSampleInterval;
+        job.arena = mArena;
+        jobs.append(job);
+    }
+    foreach(int audioId, mMaster.audioIds())
+    {
+        LocalJob job;
+        job.id = audioId;
+        job.isAudio = true;
+        job.path = QUrl(mMaster.registry().url(audioId)).toLocalFile();
+        job.sampleInterval = mSampleInterval;
+        job.arena = mArena;
+        jobs.append(job);
+    }
+    if( jobs.isEmpty() )
+    {
+        complete();
+        return;
+    }
+
+    mLocalWatcher = new QFutureWatcher<LocalResult>(this);
+    connect(mLocalWatcher, &QFutureWatcher<LocalResult>::resultReadyAt, this, &StreamAnalysis::onLocalResultReady);
+    connect(mLocalWatcher, &QFutureWatcher<LocalResult>::finished, this, &StreamAnalysis::onLocalResultsReady);
+    connect(mLocalWatcher, &QFutureWatcher<LocalResult>::progressValueChanged, this, [this](int value)
+    {
+        emit progressChanged(value, mLocalWatcher->progressMaximum());
+    });
+    mLocalWatcher->setFuture(QtConcurrent::mapped(jobs, &StreamAnalysis::parseLocalMediaPlaylist));
+}
+
+StreamAnalysis::LocalResult StreamAnalysis::parseLocalMediaPlaylist(const LocalJob &job)
+{
+    LocalResult result;
+    result.id = job.id;
+    result.isAudio = job.isAudio;
+
+    MappedFile file(job.path);
+    if( !file.isOpen() )
+    {
+        qDebug() << "Error: " << job.path << file.errorString();
+        return result;
+    }
+
+    MediaPlaylistParser parser;
+    parser.setSampleInterval(job.sampleInterval);
+    /// без сохранения сегментов арена своя: сегменты нужны до проверки пиков
+    parser.setArena(job.arena ? job.arena : QSharedPointer<Arena>(new Arena));
+    parser.feed(file.data());
+    parser.finish();
+    result.valid = parser.isValid();
+    result.averageBitrate = parser.averageBitrate();
+    result.segmentCount = parser.segmentCount();
+    result.segments = parser.segmentStore();
+
+    /// локальные сегменты - просто размеры файлов
+    QVector<int> unsized = unsizedSegments(result.segments);
+    if( !unsized.isEmpty() )
+    {
+        QUrl base = QUrl::fromLocalFile(job.path);
+        QVector<qint64> sizes;
+        sizes.reserve(unsized.size());
+        foreach(int index, unsized)
+        {
+            QUrl segment = base.resolved(QUrl(QString::fromUtf8(result.segments.uri(index))));
+            sizes.append(segment.isLocalFile() ? QFileInfo(segment.toLocalFile()).size() : -1);
+        }
+        result.averageBitrate = storeSegmentSizes(result.segments, unsized, sizes);
+    }
+
+    result.probe = probeLocalSegments(job.path, parser.sampledSegments());
+    return result;
+}
+
+void StreamAnalysis::onLocalResultReady(int index)
+{
+    LocalResult result = mLocalWatcher->resultAt(index);
+    if( !result.valid )
+    {
+        qDebug() << "Неверный формат!" << mMaster.registry().url(result.id);
+        return;
+    }
+
+    setBitrate(result.id, result.isAudio, result.averageBitrate, result.segmentCount);
+    keepSegments(result.id, result.isAudio, result.segments);
+    setProbeResult(result.id, result.isAudio, result.probe);
+    emit renditionReady(result.id, result.isAudio);
+}
+
+void StreamAnalysis::onLocalResultsReady()
+{
+    /// результаты уже применены по одному в onLocalResultReady
+    complete();
+}
+
+void StreamAnalysis::onMasterReplyFinished(QNetworkReply *reply)
+{
+    reply->deleteLater();
+    if( reply->error() != QNetworkReply::NoError )
+    {
+        qDebug() << "Error: " << reply->errorString();
+        fail(reply->errorString());
+        return;
+    }
+
+    QUrl base = reply->url().adjusted(QUrl::RemoveFilename);
+    if( !mMaster.parse(reply->readAll(), base) )
+    {
+        fail("Неверный формат!");
+        return;
+    }
+
+    requestMediaPlaylists();
+}
+
+void StreamAnalysis::requestMediaPlaylists()
+{
+    mPendingReplies = mMaster.videoIds().size() + mMaster.audioIds().size();
+    mTotalReplies = mPendingReplies;
+    if( mPendingReplies == 0 )
+    {
+        complete();
+        return;
+    }
+    emit progressChanged(0, mTotalReplies);
+
+    foreach(int videoId, mMaster.videoIds())
+    {
+        requestMediaPlaylist(videoId, false);
+    }
+
+    foreach(int audioId, mMaster.audioIds())
+    {
+        requestMediaPlaylist(audioId, true);
+    }
+}
+
+void StreamAnalysis::requestMediaPlaylist(int id, bool isAudio)
+{
+    QString url = mMaster.registry().url(id);
+    QNetworkRequest request(url);
+    mScheduler->get(request, RequestScheduler::MediaPlaylistPriority, this, [this, id, isAudio](QNetworkReply *reply)
+    {
+        quint64 task = mPipeline->open(mScheduler->cache() != nullptr, mSampleInterval, mArena);
+        MediaReply &mediaReply = mMediaReplies[task];
+        mediaReply.reply = reply;
+        mediaReply.id = id;
+        mediaReply.isAudio = isAudio;
+
+        /// пока конвейер полон, данные остаются в сокете, а не в памяти
+        reply->setReadBufferSize(READ_BUFFER_SIZE);
+        connect(reply, &QNetworkReply::readyRead, this, [this, task]()
+        {
+            readMediaData(task);
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, task]()
+        {
+            onMediaReplyFinished(task);
+        });
+    });
+}
+
+bool StreamAnalysis::checkDiskCache(MediaReply &mediaReply)
+{
+    if( !mediaReply.cacheChecked )
+    {
+        mediaReply.cacheChecked = true;
+        /// тело пришло с диска - плейлист мог уже быть разобран; при глубокой
+        /// проверке и сохранении сегментов нужны сами сегменты, а их в кэше результатов нет
+        mediaReply.fromDiskCache = mScheduler->cache() && mSampleInterval == 0 && !mArena &&
+                mediaReply.reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+    }
+    return mediaReply.fromDiskCache;
+}
+
+void StreamAnalysis::readMediaData(quint64 task)
+{
+    MediaReply &mediaReply = mMediaReplies[task];
+    if( checkDiskCache(mediaReply) )
+    {
+        /// с диска, а не из сети: держать тело до конца дёшево
+        mediaReply.body += mediaReply.reply->readAll();
+        return;
+    }
+
+    if( !mPipeline->hasCapacity() )
+    {
+        mediaReply.throttled = true;
+        return;
+    }
+    mediaReply.throttled = false;
+    mPipeline->push(task, mediaReply.reply->readAll());
+}
+
+void StreamAnalysis::onMediaReplyFinished(quint64 task)
+{
+    MediaReply &mediaReply = mMediaReplies[task];
+    QNetworkReply *reply = mediaReply.reply;
+    reply->deleteLater();
+
+    if( reply->error() != QNetworkReply::NoError )
+    {
+        qDebug() << "Error: " << reply->errorString();
+        mPartial = true;
+        mPipeline->cancel(task);
+        mMediaReplies.remove(task);
+        finishMediaPlaylist();
+        return;
+    }
+
+    if( checkDiskCache(mediaReply) )
+    {
+        /// результат годится, только если разобрано было ровно это тело
+        mediaReply.body += reply->readAll();
+        QByteArray hash = QCryptographicHash::hash(mediaReply.body, QCryptographicHash::Sha1);
+        if( mScheduler->cache()->lookup(mMaster.registry().url(mediaReply.id), hash, &mediaReply.result) )
+        {
+            mPipeline->cancel(task);
+            setBitrate(mediaReply.id, mediaReply.isAudio, mediaReply.result.averageBitrate, mediaReply.result.segmentCount);
+            keepSegments(mediaReply.id, mediaReply.isAudio, restoreSegments(mediaReply.result));
+            emit renditionReady(mediaReply.id, mediaReply.isAudio);
+            mMediaReplies.remove(task);
+            finishMediaPlaylist();
+            return;
+        }
+
+        /// промах: тело уже прочитано, разбираем его целиком
+        mPipeline->push(task, mediaReply.body);
+        mediaReply.body.clear();
+    }
+
+    /// хвост не больше буфера чтения, поэтому отдаём его без оглядки на предел
+    mPipeline->push(task, reply->readAll());
+    mPipeline->close(task);
+    mediaReply.reply = nullptr;
+    mediaReply.throttled = false;
+}
+
+void StreamAnalysis::onParseResults()
+{
+    foreach(const ParsePipeline::Result &result, mPipeline->takeResults())
+    {
+        MediaReply mediaReply = mMediaReplies.take(result.task);
+        QVector<int> unsized = result.valid && mProbeRate > 0 ? unsizedSegments(result.segments) : QVector<int>();
+        if( !result.valid )
+        {
+            qDebug() << "Неверный формат!" << mMaster.registry().url(mediaReply.id);
+            finishMediaPlaylist();
+        }
+        else if( !unsized.isEmpty() )
+        {
+            probeSegmentSizes(mediaReply.id, mediaReply.isAudio, result, unsized);
+        }
+        else
+        {
+            applyParseResult(mediaReply.id, mediaReply.isAudio, result);
+        }
+    }
+}
+
+void StreamAnalysis::probeSegmentSizes(int id, bool isAudio, const ParsePipeline::Result &result, const QVector<int> &unsized)
+{
+    QUrl base(mMaster.registry().url(id));
+    QVector<QUrl> urls;
+    urls.reserve(unsized.size());
+    foreach(int index, unsized)
+    {
+        urls.append(base.resolved(QUrl(QString::fromUtf8(result.segments.uri(index)))));
+    }
+
+    SegmentSizeProber *prober = new SegmentSizeProber(mScheduler, this);
+    prober->setRate(mProbeRate);
+    connect(prober, &SegmentSizeProber::finished, this, [this, prober, id, isAudio, result, unsized]()
+    {
+        ParsePipeline::Result sized = result;
+        sized.averageBitrate = storeSegmentSizes(sized.segments, unsized, prober->sizes());
+        prober->deleteLater();
+        applyParseResult(id, isAudio, sized);
+    });
+    prober->probe(urls);
+}
+
+void StreamAnalysis::applyParseResult(int id, bool isAudio, const ParsePipeline::Result &result)
+{
+    if( PlaylistCache *cache = mScheduler->cache() )
+    {
+        PlaylistCache::Result cached;
+        cached.averageBitrate = result.averageBitrate;
+        cached.segmentCount = result.segmentCount;
+        cacheSegments(result.segments, &cached);
+        cache->store(mMaster.registry().url(id), result.contentHash, cached);
+    }
+    setBitrate(id, isAudio, result.averageBitrate, result.segmentCount);
+    keepSegments(id, isAudio, result.segments);
+    if( !result.sampledSegments.isEmpty() )
+    {
+        probeSegments(id, isAudio, result);
+    }
+    else
+    {
+        emit renditionReady(id, isAudio);
+    }
+    finishMediaPlaylist();
+}
+
+void StreamAnalysis::probeSegments(int id, bool isAudio, const ParsePipeline::Result &result)
+{
+    /// плейлист закончен, но анализ ждёт ещё и сегменты
+    mPendingReplies++;
+    mTotalReplies++;
+    DeepProbe *probe = new DeepProbe(mScheduler, this);
+    connect(probe, &DeepProbe::finished, this, [this, probe, id, isAudio]()
+    {
+        setProbeResult(id, isAudio, probe->summary());
+        emit renditionReady(id, isAudio);
+        probe->deleteLater();
+        finishMediaPlaylist();
+    });
+    probe->probe(QUrl(mMaster.registry().url(id)), result.sampledSegments);
+}
+
+void StreamAnalysis::onCapacityAvailable()
+{
+    QList<quint64> throttled;
+    for( auto it = mMediaReplies.cbegin(); it != mMediaReplies.cend(); ++it )
+    {
+        if( it.value().throttled )
+            throttled.append(it.key());
+    }
+
+    foreach(quint64 task, throttled)
+    {
+        readMediaData(task);
+    }
+}
+
+void StreamAnalysis::onDeadline()
+{
+    qDebug() << "Error: " << "превышено время анализа" << mUrl;
+    mPartial = true;
+    if( mLocalWatcher )
+    {
+        /// начатые разборы доработают, остальные не начнутся; результат - в onLocalResultsReady
+        mLocalWatcher->cancel();
+        return;
+    }
+
+    /// недополученные плейлисты, размеры и сегменты больше не ждём
+    mScheduler->cancel(this);
+    qDeleteAll(findChildren<SegmentSizeProber *>(QString(), Qt::FindDirectChildrenOnly));
+    qDeleteAll(findChildren<DeepProbe *>(QString(), Qt::FindDirectChildrenOnly));
+    disconnect(mPipeline, nullptr, this, nullptr);
+    foreach(quint64 task, mMediaReplies.keys())
+    {
+        mPipeline->cancel(task);
+    }
+    mMediaReplies.clear();
+
+    if( mTotalReplies == 0 )
+    {
+        fail("Превышено время анализа");
+        return;
+    }
+    complete();
+}
+
+void StreamAnalysis::finishMediaPlaylist()
+{
+    --mPendingReplies;
+    emit progressChanged(mTotalReplies - mPendingReplies, mTotalReplies);
+    if( mPendingReplies == 0 )
+    {
+        complete();
+    }
+}
+
+void StreamAnalysis::complete()
+{
+    if( mDeadline )
+        mDeadline->stop();
+    checkPeaks();
+    emit finished();
+}
+
+void StreamAnalysis::checkPeaks()
+{
+    PeakBitrateCheck check(mPeakWindowMs);
+    QList<VariantStream> &variantStreams = mMaster.variantStreams();
+    for( int i = 0; i < variantStreams.size(); ++i )
+    {
+        VariantStream &variantStream = variantStreams[i];
+        variantStream.realPeakBandwidth = check.run(mSegments.value(variantStream.videoId),
+                                                    mSegments.value(variantStream.audioId),
+                                                    variantStream.peakBandwidth, &variantStream.peakRanges);
+    }
+    /// без setKeepSegments() сегменты нужны только для проверки - не держим
+    /// их (и их арены) до удаления анализа
+    if( !mArena )
+    {
+        mSegments.clear();
+    }
+}
+
+void StreamAnalysis::fail(const QString &errorString)
+{
+    if( mDeadline )
+        mDeadline->stop();
+    mErrorString = errorString;
+    emit finished();
+}
+
+void StreamAnalysis::setBitrate(int id, bool isAudio, quint32 bitrate, quint32 segmentCount)
+{
+    if( isAudio )
+    {
+        setAudioBitrate(id, bitrate, segmentCount);
+    }
+    else
+    {
+        setVideoBitrate(id, bitrate, segmentCount);
+    }
+}
+
+void StreamAnalysis::setVideoBitrate(int videoId, quint32 videoBitrate, quint32 segmentCount)
+{
+    QList<VariantStream> &variantStreams = mMaster.variantStreams();
+    foreach(int variant, mMaster.registry().variants(videoId))
+    {
+        if( variantStreams.at(variant).videoId == videoId )
+        {
+            variantStreams[variant].videoStream.realVideoBitrate = videoBitrate;
+            variantStreams[variant].videoStream.segmentCount = segmentCount;
+        }
+    }
+}
+
+void StreamAnalysis::setAudioBitrate(int audioId, quint32 audioBitrate, quint32 segmentCount)
+{
+    QList<VariantStream> &variantStreams = mMaster.variantStreams();
+    foreach(int variant, mMaster.registry().variants(audioId))
+    {
+        if( variantStreams.at(variant).audioId == audioId )
+        {
+            variantStreams[variant].audioStream.realAudioBitrate = audioBitrate;
+            variantStreams[variant].audioStream.segmentCount = segmentCount;
+        }
+    }
+}
+
+void StreamAnalysis::setProbeResult(int id, bool isAudio, const ProbeSummary &summary)
+{
+    if( summary.segmentCount() == 0 )
+        return;
+
+    QList<VariantStream> &variantStreams = mMaster.variantStreams();
+    foreach(int variant, mMaster.registry().variants(id))
+    {
+        VariantStream &variantStream = variantStreams[variant];
+        if( isAudio && variantStream.audioId == id )
+        {
+            variantStream.audioStream.probedCodec = summary.audioCodec();
+            variantStream.audioStream.probedBitrate = summary.audioBitrate();
+            variantStream.audioStream.probedChannels = summary.channels();
+        }
+        else if( !isAudio && variantStream.videoId == id )
+        {
+            variantStream.videoStream.probedCodec = summary.videoCodec();
+            variantStream.videoStream.probedFramerate = summary.frameRate();
+            variantStream.videoStream.probedBitrate = summary.videoBitrate();
+            variantStream.videoStream.probedResolution = summary.resolution();
+            /// аудио в том же TS, отдельной группы нет
+            if( variantStream.audioId == -1 )
+            {
+                variantStream.audioStream.probedCodec = summary.audioCodec();
+                variantStream.audioStream.probedBitrate = summary.audioBitrate();
+                variantStream.audioStream.probedChannels = summary.channels();
+            }
+        }
+    }
+}
+
+void StreamAnalysis::keepSegments(int id, bool isAudio, const SegmentStore &segments)
+{
+    if( segments.isNull() )
+        return;
+
+    /// без setKeepSegments() сегменты нужны только проверке пиков, теги - нет
+    if( !mArena )
+    {
+        mSegments.insert(id, segments);
+        return;
+    }
+
+    /// теги - по первому варианту, который ссылается на плейлист
+    SegmentStore store = segments;
+    const QList<VariantStream> &variantStreams = mMaster.variantStreams();
+    foreach(int variant, mMaster.registry().variants(id))
+    {
+        const VariantStream &variantStream = variantStreams.at(variant);
+        if( isAudio && variantStream.audioId == id )
+        {
+            store.setTags(variantStream.audioStream.codec, variantStream.audioStream.language, variantStream.audio);
+            break;
+        }
+        if( !isAudio && variantStream.videoId == id )
+        {
+            store.setTags(variantStream.videoStream.codec, QString(), QString());
+            break;
+        }
+    }
+    mSegments.insert(id, store);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <QObject>
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QNetworkReply>
+
+#include "masterplaylistparser.h"
+#include "parsepipeline.h"
+#include "playlistcache.h"
+#include "probesummary.h"
+
+class QTimer;
+class RequestScheduler;
+
+/// Анализ одного HLS-потока: скачивает мастер-плейлист и все медиа-плейлисты
+/// через общий RequestScheduler и считает реальные битрейты.
+/// Ничего не знает о моделях, поэтому дёшево создаётся на каждый поток.
+/// Скачанные порции медиа-плейлистов уходят в ParsePipeline и разбираются
+/// в пуле потоков; сам объект только читает ответы и применяет результаты,
+/// поэтому может жить в отдельном сетевом потоке.
+/// Локальные плейлисты (file:// или путь) читаются через отображение в
+/// память, медиа-плейлисты разбираются параллельно в пуле потоков.
+class StreamAnalysis : public QObject
+{
+    Q_OBJECT
+public:
+    StreamAnalysis(RequestScheduler *scheduler, const QString &url, QObject *parent = nullptr);
+
+    /// окно проверки пикового битрейта, см. PeakBitrateCheck
+    void setPeakWindow(quint32 windowMs);
+    /// сколько HEAD-запросов в секунду к одному хосту тратить на размеры
+    /// сегментов без EXT-X-BITRATE; 0 - не узнавать размеры (по умолчанию)
+    void setProbeRate(int requestsPerSecond);
+    /// разбирать каждый N-й сегмент (MPEG-TS или fMP4) и сверять кодеки,
+    /// частоту кадров, разрешение и битрейты с заявленными; 0 - не скачивать сегменты
+    void setDeepProbe(int sampleInterval);
+    /// весь анализ не дольше ms: недополученное бросается, результат
+    /// помечается неполным; 0 - без ограничения
+    void setDeadline(int ms);
+    /// сохранять все сегменты каждого медиа-плейлиста в арене анализа,
+    /// см. SegmentStore; кэш результатов при этом не используется
+    void setKeepSegments(bool keep);
+
+    void start();
+
+    QString url() const;
+    QString errorString() const;
+    /// часть медиа-плейлистов не получена (ошибки, срок анализа)
+    bool isPartial() const;
+    const QList<VariantStream> &variantStreams() const;
+    const StreamRegistry &registry() const;
+    /// сегменты по id в StreamRegistry, если включён setKeepSegments();
+    /// иначе они живут только до проверки пиков
+    const QHash<int, SegmentStore> &segments() const;
+
+signals:
+    /// медиа-плейлист id разобран и проверен: его битрейты и результаты
+    /// проверки сегментов в variantStreams() больше не изменятся
+    void renditionReady(int id, bool isAudio);
+    /// готово done медиа-плейлистов и проверок сегментов из total известных
+    void progressChanged(int done, int total);
+    void finished();
+
+private:
+    struct MediaReply
+    {
+        QNetworkReply *reply = nullptr;
+        int id = -1;
+        bool isAudio = false;
+        bool cacheChecked = false;
+        /// тело с диска копится в body: результат из кэша ищется по его хэшу
+        bool fromDiskCache = false;
+        QByteArray body;
+        /// данные ждут в сокете, пока конвейер не освободится
+        bool throttled = false;
+        PlaylistCache::Result result;
+    };
+
+    struct LocalJob
+    {
+        int id = -1;
+        bool isAudio = false;
+        QString path;
+        int sampleInterval = 0;
+        QSharedPointer<Arena> arena;
+    };
+
+    struct LocalResult
+    {
+        int id = -1;
+        bool isAudio = false;
+        bool valid = false;
+        quint32 averageBitrate = 0;
+        quint32 segmentCount = 0;
+        SegmentStore segments;
+        ProbeSummary probe;
+    };
+
+    void startLocal();
+    static LocalResult parseLocalMediaPlaylist(const LocalJob &job);
+    void onLocalResultReady(int index);
+    void onLocalResultsReady();
+    void onMasterReplyFinished(QNetworkReply *reply);
+    void requestMediaPlaylists();
+    void requestMediaPlaylist(int id, bool isAudio);
+    bool checkDiskCache(MediaReply &mediaReply);
+    void readMediaData(quint64 task);
+    void onMediaReplyFinished(quint64 task);
+    void onParseResults();
+    void probeSegmentSizes(int id, bool isAudio, const ParsePipeline::Result &result, const QVector<int> &unsized);
+    void applyParseResult(int id, bool isAudio, const ParsePipeline::Result &result);
+    void probeSegments(int id, bool isAudio, const ParsePipeline::Result &result);
+    void onCapacityAvailable();
+    void onDeadline();
+    void finishMediaPlaylist();
+    void complete();
+    void checkPeaks();
+    void fail(const QString &errorString);
+    void setBitrate(int id, bool isAudio, quint32 bitrate, quint32 segmentCount);
+    void setVideoBitrate(int videoId, quint32 videoBitrate, quint32 segmentCount);
+    void setAudioBitrate(int audioId, quint32 audioBitrate, quint32 segmentCount);
+    void setProbeResult(int id, bool isAudio, const ProbeSummary &summary);
+    void keepSegments(int id, bool isAudio, const SegmentStore &segments);
+
+private:
+    RequestScheduler *mScheduler;
+    QString mUrl;
+    QString mErrorString;
+    bool mPartial;
+
+    MasterPlaylistParser mMaster;
+    int mPendingReplies;
+    int mTotalReplies;
+
+    quint32 mPeakWindowMs;
+    int mProbeRate;
+    int mSampleInterval;
+    int mDeadlineMs;
+    QTimer *mDeadline;
+    QSharedPointer<Arena> mArena;
+    QHash<int, SegmentStore> mSegments;
+
+    ParsePipeline *mPipeline;
+    QHash<quint64, MediaReply> mMediaReplies;
+
+    QFutureWatcher<LocalResult> *mLocalWatcher;
+};
@@ -0,0 +1,64 @@
+#include "streamregistry.h"
+
+int StreamRegistry::intern(Type type, const QString &url, bool *isNew)
+{
+    Key key(type, url);
+    QHash<Key, int>::const_iterator it = mIds.constFind(key);
+    if( it != mIds.constEnd() )
+    {
+        if( isNew )
+            *isNew = false;
+        return it.value();
+    }
+
+    int id = mUrls.size();
+    mIds.insert(key, id);
+    mUrls.append(url);
+    mVariants.append(QVector<int>());
+    if( isNew )
+        *isNew = true;
+    return id;
+}
+
+int StreamRegistry::find(Type type, const QString &url) const
+{
+    return mIds.value(Key(type, url), -1);
+}
+
+QString StreamRegistry::url(int id) const
+{
+    return mUrls.value(id);
+}
+
+int StreamRegistry::size() const
+{
+    return mUrls.size();
+}
+
+void StreamRegistry::linkVariant(int id, int variant)
+{
+    mVariants[id].append(variant);
+}
+
+const QVector<int> &StreamRegistry::variants(int id) const
+{
+    return mVariants.at(id);
+}
+
+void StreamRegistry::addGroupRendition(const QString &groupId, int rendition)
+{
+    mGroupRenditions[groupId].append(rendition);
+}
+
+QVector<int> StreamRegistry::groupRenditions(const QString &groupId) const
+{
+    return mGroupRenditions.value(groupId);
+}
+
+void StreamRegistry::clear()
+{
+    mIds.clear();
+    mUrls.clear();
+    mVariants.clear();
+    mGroupRenditions.clear();
+}
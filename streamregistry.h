@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/// Реестр потоков одного анализа. Каждый рендишен (тип + URL) получает
+/// целочисленный id, по которому за O(1) находятся использующие его
+/// Variant Stream'ы; группы аудио (GROUP-ID) индексируются отдельно.
+class StreamRegistry
+{
+public:
+    /// видео- и аудиоплейлист с одинаковым URL - разные потоки
+    enum Type
+    {
+        Video,
+        Audio
+    };
+
+    /// id для url; isNew - был ли url добавлен только что
+    int intern(Type type, const QString &url, bool *isNew = nullptr);
+    int find(Type type, const QString &url) const;
+    QString url(int id) const;
+    int size() const;
+
+    /// каждая пара (id, variant) добавляется один раз
+    void linkVariant(int id, int variant);
+    const QVector<int> &variants(int id) const;
+
+    /// рендишены группы (индексы в списке аудио мастер-плейлиста) в порядке появления
+    void addGroupRendition(const QString &groupId, int rendition);
+    QVector<int> groupRenditions(const QString &groupId) const;
+
+    void clear();
+
+private:
+    typedef QPair<int, QString> Key;
+
+    QHash<Key, int> mIds;
+    QVector<QString> mUrls;
+    QVector<QVector<int> > mVariants;
+
+    QHash<QString, QVector<int> > mGroupRenditions;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+struct VideoStream
+{
+    QString url;
+    QString codec;
+    QString resolution;
+    quint32 realVideoBitrate = 0; //in bits per second
+    QString framerate;
+    quint32 segmentCount = 0;
+
+    /// по содержимому сегментов, см. TsProbe
+    QString probedCodec;
+    qreal probedFramerate = 0;
+    QString probedResolution; // только fMP4
+    quint32 probedBitrate = 0; //in bits per second
+};
+
+struct AudioStream
+{
+    QString url;
+    QString codec;
+    quint32 numOfChannels = 0;
+    QString language;
+    quint32 realAudioBitrate = 0; //in bits per second
+    quint32 segmentCount = 0;
+
+    /// по содержимому сегментов, см. TsProbe
+    QString probedCodec;
+    quint32 probedChannels = 0; // только fMP4
+    quint32 probedBitrate = 0; //in bits per second
+};
+
+/// Отрезок, на котором пиковый битрейт превышает BANDWIDTH
+struct PeakRange
+{
+    quint32 startMs = 0;
+    quint32 endMs = 0;
+    quint32 peakBitrate = 0; //in bits per second
+};
+
+struct VariantStream
+{
+    quint32 averageBandwidth = 0; //in bits per second
+    quint32 peakBandwidth = 0; //in bits per second
+    QString audio;
+
+    quint32 realPeakBandwidth = 0; //in bits per second
+    QVector<PeakRange> peakRanges;
+
+    int videoId = -1; //id in StreamRegistry
+    int audioId = -1; //id in StreamRegistry
+
+    VideoStream videoStream;
+    AudioStream audioStream;
+
+    bool isInRange(qreal deviation) const
+    {
+        quint32 x;
+        if( videoStream.realVideoBitrate + audioStream.realAudioBitrate > averageBandwidth )
+            x = videoStream.realVideoBitrate + audioStream.realAudioBitrate - averageBandwidth;
+        else
+            x = averageBandwidth - videoStream.realVideoBitrate - audioStream.realAudioBitrate;
+        qreal y = x / static_cast<qreal>(averageBandwidth);
+        qreal z = deviation / static_cast<qreal>(100);
+
+        return z > y;
+    }
+};
@@ -0,0 +1,50 @@
+#include "stringpool.h"
+
+#include <cstring>
+
+#include "arena.h"
+
+StringPool::StringPool(Arena *arena)
+    : mArena(arena)
+{
+    mStrings.append(QLatin1String());
+}
+
+quint32 StringPool::intern(QLatin1String string)
+{
+    if( string.size() == 0 )
+        return NONE;
+
+    QMutexLocker locker(&mMutex);
+    QHash<QLatin1String, quint32>::const_iterator it = mIds.constFind(string);
+    if( it != mIds.constEnd() )
+        return it.value();
+
+    /// ключ хэша указывает на копию в арене, а не на строку вызывающего
+    char *data = static_cast<char *>(mArena->allocate(string.size(), 1));
+    std::memcpy(data, string.data(), size_t(string.size()));
+    QLatin1String stored(data, string.size());
+
+    quint32 id = quint32(mStrings.size());
+    mStrings.append(stored);
+    mIds.insert(stored, id);
+    return id;
+}
+
+quint32 StringPool::intern(const QString &string)
+{
+    QByteArray latin1 = string.toLatin1();
+    return intern(QLatin1String(latin1.constData(), latin1.size()));
+}
+
+QLatin1String StringPool::string(quint32 id) const
+{
+    QMutexLocker locker(&mMutex);
+    return id < quint32(mStrings.size()) ? mStrings.at(int(id)) : QLatin1String();
+}
+
+int StringPool::count() const
+{
+    QMutexLocker locker(&mMutex);
+    return mStrings.size() - 1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QHash>
+#include <QLatin1String>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+class Arena;
+
+/// Интернирование строк анализа: одинаковые кодеки, языки, GROUP-ID и URI
+/// init-сегментов хранятся один раз в памяти арены, а в данных остаётся
+/// 32-битный номер. Номер 0 (NONE) - пустая строка. Строки живут, пока
+/// жива арена. Потокобезопасен: пишут рабочие потоки конвейера разбора.
+class StringPool
+{
+public:
+    static const quint32 NONE = 0;
+
+    explicit StringPool(Arena *arena);
+
+    quint32 intern(QLatin1String string);
+    quint32 intern(const QString &string);
+
+    /// указатель действителен, пока жива арена
+    QLatin1String string(quint32 id) const;
+    int count() const;
+
+private:
+    Q_DISABLE_COPY(StringPool)
+
+    Arena *mArena;
+    mutable QMutex mMutex;
+    QHash<QLatin1String, quint32> mIds;
+    QVector<QLatin1String> mStrings;
+};
@@ -0,0 +1,363 @@
+#include "tablemodels.h"
+
+/// Время от начала плейлиста: ч:мм:сс.ззз
+static QString formatTime(quint32 ms)
+{
+    return QString("%1:%2:%3.%4")
+            .arg(ms / 3600000)
+            .arg(ms / 60000 % 60, 2, 10, QChar('0'))
+            .arg(ms / 1000 % 60, 2, 10, QChar('0'))
+            .arg(ms % 1000, 3, 10, QChar('0'));
+}
+
+ColumnarTableModel::ColumnarTableModel(const QStringList &headers, QObject *parent)
+    : QAbstractTableModel(parent)
+    , mHeaders(headers)
+    , mRows(0)
+{
+}
+
+int ColumnarTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : mRows;
+}
+
+int ColumnarTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : mHeaders.size();
+}
+
+QVariant ColumnarTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if( role != Qt::DisplayRole )
+        return QVariant();
+    if( orientation == Qt::Horizontal )
+        return mHeaders.value(section);
+    return section + 1;
+}
+
+void ColumnarTableModel::clear()
+{
+    beginResetModel();
+    clearColumns();
+    mRows = 0;
+    endResetModel();
+}
+
+void ColumnarTableModel::beginAppend(int count)
+{
+    beginInsertRows(QModelIndex(), mRows, mRows + count - 1);
+}
+
+void ColumnarTableModel::endAppend(int count)
+{
+    mRows += count;
+    endInsertRows();
+}
+
+VideoTableModel::VideoTableModel(QObject *parent)
+    : ColumnarTableModel(QStringList() << tr("Поток") << tr("Кодек") << tr("Разрешение") << tr("Битрейт") << tr("Фреймрейт"), parent)
+{
+}
+
+void VideoTableModel::append(const QVector<VideoStream> &videoStreams)
+{
+    if( videoStreams.isEmpty() )
+        return;
+
+    beginAppend(videoStreams.size());
+    for( int i = 0; i < videoStreams.size(); ++i )
+    {
+        const VideoStream &videoStream = videoStreams.at(i);
+        mUrls.append(videoStream.url);
+        mCodecs.append(videoStream.codec);
+        mResolutions.append(videoStream.resolution);
+        mBitrates.append(videoStream.realVideoBitrate);
+        mFramerates.append(videoStream.framerate);
+    }
+    endAppend(videoStreams.size());
+}
+
+QString VideoTableModel::url(int row) const
+{
+    return mUrls.value(row);
+}
+
+QVariant VideoTableModel::data(const QModelIndex &index, int role) const
+{
+    if( !index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole) )
+        return QVariant();
+
+    int row = index.row();
+    switch( index.column() )
+    {
+    case 0: return mUrls.at(row);
+    case 1: return mCodecs.at(row);
+    case 2: return mResolutions.at(row);
+    case 3: return mBitrates.at(row);
+    case 4: return mFramerates.at(row);
+    }
+    return QVariant();
+}
+
+bool VideoTableModel::lessThan(int column, int left, int right) const
+{
+    switch( column )
+    {
+    case 0: return mUrls.at(left) < mUrls.at(right);
+    case 1: return mCodecs.at(left) < mCodecs.at(right);
+    case 2: return mResolutions.at(left) < mResolutions.at(right);
+    case 3: return mBitrates.at(left) < mBitrates.at(right);
+    case 4: return mFramerates.at(left).toDouble() < mFramerates.at(right).toDouble();
+    }
+    return left < right;
+}
+
+bool VideoTableModel::matches(int row, const QString &pattern) const
+{
+    return mUrls.at(row).contains(pattern, Qt::CaseInsensitive)
+            || mCodecs.at(row).contains(pattern, Qt::CaseInsensitive)
+            || mResolutions.at(row).contains(pattern, Qt::CaseInsensitive);
+}
+
+void VideoTableModel::clearColumns()
+{
+    mUrls.clear();
+    mCodecs.clear();
+    mResolutions.clear();
+    mBitrates.clear();
+    mFramerates.clear();
+}
+
+AudioTableModel::AudioTableModel(QObject *parent)
+    : ColumnarTableModel(QStringList() << tr("Поток") << tr("Кодек") << tr("Количество каналов") << tr("Язык") << tr("Битрейт"), parent)
+{
+}
+
+void AudioTableModel::append(const QVector<AudioStream> &audioStreams)
+{
+    if( audioStreams.isEmpty() )
+        return;
+
+    beginAppend(audioStreams.size());
+    for( int i = 0; i < audioStreams.size(); ++i )
+    {
+        const AudioStream &audioStream = audioStreams.at(i);
+        mUrls.append(audioStream.url);
+        mCodecs.append(audioStream.codec);
+        mChannels.append(audioStream.numOfChannels);
+        mLanguages.append(audioStream.language);
+        mBitrates.append(audioStream.realAudioBitrate);
+    }
+    endAppend(audioStreams.size());
+}
+
+QString AudioTableModel::url(int row) const
+{
+    return mUrls.value(row);
+}
+
+QVariant AudioTableModel::data(const QModelIndex &index, int role) const
+{
+    if( !index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole) )
+        return QVariant();
+
+    int row = index.row();
+    switch( index.column() )
+    {
+    case 0: return mUrls.at(row);
+    case 1: return mCodecs.at(row);
+    case 2: return mChannels.at(row);
+    case 3: return mLanguages.at(row);
+    case 4: return mBitrates.at(row);
+    }
+    return QVariant();
+}
+
+bool AudioTableModel::lessThan(int column, int left, int right) const
+{
+    switch( column )
+    {
+    case 0: return mUrls.at(left) < mUrls.at(right);
+    case 1: return mCodecs.at(left) < mCodecs.at(right);
+    case 2: return mChannels.at(left) < mChannels.at(right);
+    case 3: return mLanguages.at(left) < mLanguages.at(right);
+    case 4: return mBitrates.at(left) < mBitrates.at(right);
+    }
+    return left < right;
+}
+
+bool AudioTableModel::matches(int row, const QString &pattern) const
+{
+    return mUrls.at(row).contains(pattern, Qt::CaseInsensitive)
+            || mCodecs.at(row).contains(pattern, Qt::CaseInsensitive)
+            || mLanguages.at(row).contains(pattern, Qt::CaseInsensitive);
+}
+
+void AudioTableModel::clearColumns()
+{
+    mUrls.clear();
+    mCodecs.clear();
+    mChannels.clear();
+    mLanguages.clear();
+    mBitrates.clear();
+}
+
+LogTableModel::LogTableModel(QObject *parent)
+    : ColumnarTableModel(QStringList() << tr("Сообщение"), parent)
+{
+}
+
+LogTableModel::Entry LogTableModel::entry(Type type, int video, int audio)
+{
+    Entry entry;
+    entry.type = type;
+    entry.video = video;
+    entry.audio = audio;
+    return entry;
+}
+
+LogTableModel::Entry LogTableModel::message(const QString &text, int video, int audio)
+{
+    Entry entry = LogTableModel::entry(Message, video, audio);
+    entry.text = text;
+    return entry;
+}
+
+/// Отрезок пишется сразу в текст: число диапазонов на вариант ограничено
+LogTableModel::Entry LogTableModel::peakEntry(const PeakRange &range, quint32 declared, int video, int audio)
+{
+    Entry entry = LogTableModel::entry(PeakOutOfRange, video, audio);
+    entry.text = QString("%1 - %2: пиковый битрейт %3 больше BANDWIDTH %4")
+            .arg(formatTime(range.startMs)).arg(formatTime(range.endMs))
+            .arg(range.peakBitrate).arg(declared);
+    return entry;
+}
+
+void LogTableModel::append(const QVector<Entry> &entries)
+{
+    if( entries.isEmpty() )
+        return;
+
+    beginAppend(entries.size());
+    for( int i = 0; i < entries.size(); ++i )
+    {
+        const Entry &entry = entries.at(i);
+        mTypes.append(quint8(entry.type));
+        mVideos.append(entry.video);
+        mAudios.append(entry.audio);
+        mTexts.append(entry.text);
+    }
+    endAppend(entries.size());
+}
+
+QVariant LogTableModel::data(const QModelIndex &index, int role) const
+{
+    if( !index.isValid() )
+        return QVariant();
+
+    switch( role )
+    {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return text(index.row());
+    case VideoRowRole:
+        return mVideos.at(index.row());
+    case AudioRowRole:
+        return mAudios.at(index.row());
+    }
+    return QVariant();
+}
+
+bool LogTableModel::lessThan(int column, int left, int right) const
+{
+    Q_UNUSED(column)
+
+    if( mTypes.at(left) != mTypes.at(right) )
+        return mTypes.at(left) < mTypes.at(right);
+    if( mVideos.at(left) != mVideos.at(right) )
+        return mVideos.at(left) < mVideos.at(right);
+    if( mAudios.at(left) != mAudios.at(right) )
+        return mAudios.at(left) < mAudios.at(right);
+    return mTexts.at(left) < mTexts.at(right);
+}
+
+bool LogTableModel::matches(int row, const QString &pattern) const
+{
+    if( mFilterTexts.size() < mTypes.size() )
+        mFilterTexts.resize(mTypes.size());
+    QString &filterText = mFilterTexts[row];
+    if( filterText.isNull() )
+        filterText = text(row);
+    return filterText.contains(pattern, Qt::CaseInsensitive);
+}
+
+void LogTableModel::clearColumns()
+{
+    mTypes.clear();
+    mVideos.clear();
+    mAudios.clear();
+    mTexts.clear();
+    mFilterTexts.clear();
+}
+
+QString LogTableModel::text(int row) const
+{
+    int video = mVideos.at(row);
+    int audio = mAudios.at(row);
+    switch( Type(mTypes.at(row)) )
+    {
+    case ZeroVideoBitrate:
+        return QString("Реальный битрейт равен нулю для видео-потока #%1").arg(video);
+    case ZeroAudioBitrate:
+        return QString("Реальный битрейт равен нулю для аудио-потока #%1").arg(audio);
+    case OutOfRange:
+        if( video != 0 && audio != 0 )
+            return QString("Реальный битрейт вне допустимого диапазона для Variant Stream'а с видео-потоком #%1 и аудио-потоком #%2")
+                    .arg(video).arg(audio);
+        if( video != 0 )
+            return QString("Реальный битрейт вне допустимого диапазона для Variant Stream'а с видео-потоком #%1").arg(video);
+        return QString("Реальный битрейт вне допустимого диапазона для Variant Stream'а с аудио-потоком #%1").arg(audio);
+    case PeakOutOfRange:
+        if( video != 0 && audio != 0 )
+            return QString("Видео-поток #%1, аудио-поток #%2, %3").arg(video).arg(audio).arg(mTexts.at(row));
+        if( video != 0 )
+            return QString("Видео-поток #%1, %2").arg(video).arg(mTexts.at(row));
+        return QString("Аудио-поток #%1, %2").arg(audio).arg(mTexts.at(row));
+    case Message:
+        break;
+    }
+    return mTexts.at(row);
+}
+
+ColumnarProxyModel::ColumnarProxyModel(ColumnarTableModel *source, QObject *parent)
+    : QSortFilterProxyModel(parent)
+    , mSource(source)
+{
+    setSourceModel(source);
+}
+
+void ColumnarProxyModel::setPattern(const QString &pattern)
+{
+    mPattern = pattern;
+    invalidateFilter();
+}
+
+int ColumnarProxyModel::proxyRow(int sourceRow) const
+{
+    if( sourceRow < 0 || sourceRow >= mSource->rowCount() )
+        return -1;
+    return mapFromSource(mSource->index(sourceRow, 0)).row();
+}
+
+bool ColumnarProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+{
+    return mSource->lessThan(left.column(), left.row(), right.row());
+}
+
+bool ColumnarProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent)
+
+    return mPattern.isEmpty() || mSource->matches(sourceRow, mPattern);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QStringList>
+#include <QVector>
+
+#include "streams.h"
+
+/// Основа табличных моделей результатов: данные хранятся по столбцам
+/// в непрерывных массивах, строки добавляются пачкой с одним
+/// beginInsertRows/endInsertRows, текст формируется только в data().
+class ColumnarTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    ColumnarTableModel(const QStringList &headers, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void clear();
+
+    /// сравнение и фильтрация без QVariant - для ColumnarProxyModel
+    virtual bool lessThan(int column, int left, int right) const = 0;
+    virtual bool matches(int row, const QString &pattern) const = 0;
+
+protected:
+    void beginAppend(int count);
+    void endAppend(int count);
+    virtual void clearColumns() = 0;
+
+private:
+    QStringList mHeaders;
+    int mRows;
+};
+
+class VideoTableModel : public ColumnarTableModel
+{
+    Q_OBJECT
+public:
+    explicit VideoTableModel(QObject *parent = nullptr);
+
+    void append(const QVector<VideoStream> &videoStreams);
+    QString url(int row) const;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool lessThan(int column, int left, int right) const override;
+    bool matches(int row, const QString &pattern) const override;
+
+protected:
+    void clearColumns() override;
+
+private:
+    QVector<QString> mUrls;
+    QVector<QString> mCodecs;
+    QVector<QString> mResolutions;
+    QVector<quint32> mBitrates;
+    QVector<QString> mFramerates;
+};
+
+class AudioTableModel : public ColumnarTableModel
+{
+    Q_OBJECT
+public:
+    explicit AudioTableModel(QObject *parent = nullptr);
+
+    void append(const QVector<AudioStream> &audioStreams);
+    QString url(int row) const;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool lessThan(int column, int left, int right) const override;
+    bool matches(int row, const QString &pattern) const override;
+
+protected:
+    void clearColumns() override;
+
+private:
+    QVector<QString> mUrls;
+    QVector<QString> mCodecs;
+    QVector<quint32> mChannels;
+    QVector<QString> mLanguages;
+    QVector<quint32> mBitrates;
+};
+
+class LogTableModel : public ColumnarTableModel
+{
+    Q_OBJECT
+public:
+    enum Type
+    {
+        ZeroVideoBitrate,
+        ZeroAudioBitrate,
+        OutOfRange,
+        PeakOutOfRange,
+        Message
+    };
+
+    enum Roles
+    {
+        VideoRowRole = Qt::UserRole + 1, //with 1, 0 - none
+        AudioRowRole
+    };
+
+    struct Entry
+    {
+        Type type;
+        int video;
+        int audio;
+        QString text;
+    };
+
+    explicit LogTableModel(QObject *parent = nullptr);
+
+    static Entry entry(Type type, int video, int audio = 0);
+    static Entry message(const QString &text, int video = 0, int audio = 0);
+    static Entry peakEntry(const PeakRange &range, quint32 declared, int video, int audio = 0);
+
+    void append(const QVector<Entry> &entries);
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool lessThan(int column, int left, int right) const override;
+    bool matches(int row, const QString &pattern) const override;
+
+protected:
+    void clearColumns() override;
+
+private:
+    QString text(int row) const;
+
+private:
+    QVector<quint8> mTypes;
+    QVector<int> mVideos;
+    QVector<int> mAudios;
+    QVector<QString> mTexts;
+    /// текст строк, уже проверенных фильтром: при наборе шаблона строка
+    /// формируется один раз, а не на каждое нажатие
+    mutable QVector<QString> mFilterTexts;
+};
+
+/// Сортировка и фильтрация поверх ColumnarTableModel: сравнения идут
+/// напрямую по столбцам исходной модели, а не через data().
+class ColumnarProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit ColumnarProxyModel(ColumnarTableModel *source, QObject *parent = nullptr);
+
+    void setPattern(const QString &pattern);
+    /// строка прокси для строки исходной модели, -1 если отфильтрована
+    int proxyRow(int sourceRow) const;
+
+protected:
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    ColumnarTableModel *mSource;
+    QString mPattern;
+};
@@ -0,0 +1,90 @@
+#include "timerwheel.h"
+
+#include <QTimer>
+
+TimerWheel::TimerWheel(int tickMs, int slotCount, QObject *parent)
+    : QObject(parent)
+    , mTimer(new QTimer(this))
+    , mTickMs(qMax(1, tickMs))
+    , mTick(0)
+    , mSlots(qMax(1, slotCount))
+    , mNextId(1)
+{
+    mClock.start();
+    mTimer->setInterval(mTickMs);
+    connect(mTimer, &QTimer::timeout, this, &TimerWheel::onTick);
+}
+
+quint64 TimerWheel::start(int delayMs, const Callback &callback)
+{
+    if( !mTimer->isActive() )
+    {
+        /// колесо стояло, ячейки пусты - продолжаем с текущего такта
+        mTick = mClock.elapsed() / mTickMs;
+        mTimer->start();
+    }
+
+    qint64 ticks = qMax<qint64>(1, (qint64(qMax(0, delayMs)) + mTickMs - 1) / mTickMs);
+    Entry entry;
+    entry.id = mNextId++;
+    entry.rounds = int((ticks - 1) / mSlots.size());
+    mSlots[int((mTick + ticks) % mSlots.size())].append(entry);
+    mCallbacks.insert(entry.id, callback);
+    return entry.id;
+}
+
+void TimerWheel::stop(quint64 id)
+{
+    mCallbacks.remove(id);
+}
+
+int TimerWheel::count() const
+{
+    return mCallbacks.size();
+}
+
+void TimerWheel::onTick()
+{
+    const qint64 now = mClock.elapsed() / mTickMs;
+    while( mTick < now && !mCallbacks.isEmpty() )
+    {
+        ++mTick;
+        QVector<Entry> &slot = mSlots[int(mTick % mSlots.size())];
+        QVector<quint64> due;
+        int kept = 0;
+        for( int i = 0; i < slot.size(); ++i )
+        {
+            Entry entry = slot.at(i);
+            if( !mCallbacks.contains(entry.id) )
+                continue;
+            if( entry.rounds > 0 )
+            {
+                entry.rounds--;
+                slot[kept++] = entry;
+            }
+            else
+            {
+                due.append(entry.id);
+            }
+        }
+        slot.resize(kept);
+
+        /// обработчики могут запускать и останавливать таймеры - ячейка уже обработана
+        foreach(quint64 id, due)
+        {
+            Callback callback = mCallbacks.take(id);
+            if( callback )
+                callback();
+        }
+    }
+
+    if( mCallbacks.isEmpty() )
+    {
+        mTimer->stop();
+        /// остановленные, но не дождавшиеся своего такта записи
+        for( int i = 0; i < mSlots.size(); ++i )
+        {
+            mSlots[i].clear();
+        }
+    }
+}
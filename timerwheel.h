@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QObject>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+
+#include <functional>
+
+class QTimer;
+
+/// Хэшированное колесо таймеров: тысячи однократных таймеров на одном
+/// QTimer. Время разбито на такты по tickMs, такт попадает в ячейку
+/// колеса по модулю числа ячеек; таймер дальше одного оборота ждёт
+/// нужное число оборотов. Запуск и остановка - O(1), такт обходит только
+/// свою ячейку. Точность - один такт; пропущенные такты (занятый поток)
+/// догоняются. QTimer работает, только пока есть таймеры.
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void()> Callback;
+
+    explicit TimerWheel(int tickMs = 50, int slotCount = 512, QObject *parent = nullptr);
+
+    /// номер таймера, никогда не 0
+    quint64 start(int delayMs, const Callback &callback);
+    void stop(quint64 id);
+    int count() const;
+
+private:
+    struct Entry
+    {
+        quint64 id;
+        int rounds;
+    };
+
+    void onTick();
+
+private:
+    QTimer *mTimer;
+    QElapsedTimer mClock;
+    int mTickMs;
+    /// последний обработанный такт от запуска mClock
+    qint64 mTick;
+    QVector<QVector<Entry>> mSlots;
+    /// остановленный таймер просто удаляется отсюда, ячейка чистится на своём такте
+    QHash<quint64, Callback> mCallbacks;
+    quint64 mNextId;
+};
@@ -0,0 +1,324 @@
+#include "tsprobe.h"
+
+#include "tsscanner.h"
+
+const int PAT_PID = 0x0000;
+const int NULL_PID = 0x1fff;
+
+static QString codecFor(quint8 streamType, bool *video, bool *audio)
+{
+    *video = false;
+    *audio = false;
+    switch( streamType )
+    {
+    case 0x01:
+    case 0x02:
+        *video = true;
+        return "MPEG-2";
+    case 0x1b:
+    case 0xdb: // SAMPLE-AES
+        *video = true;
+        return "AVC";
+    case 0x24:
+        *video = true;
+        return "HEVC";
+    case 0x03:
+    case 0x04:
+        *audio = true;
+        return "MP3";
+    case 0x0f:
+    case 0x11:
+    case 0xcf: // SAMPLE-AES
+        *audio = true;
+        return "AAC";
+    case 0x81:
+    case 0xc1: // SAMPLE-AES
+        *audio = true;
+        return "AC-3";
+    case 0x87:
+    case 0xc2: // SAMPLE-AES
+        *audio = true;
+        return "EC-3";
+    }
+    return QString();
+}
+
+/// stream_type 0x06 (private data): кодек определяется дескрипторами ES
+static QString codecForDescriptors(const uchar *descriptors, int size, bool *audio)
+{
+    int pos = 0;
+    while( pos + 2 <= size )
+    {
+        quint8 tag = descriptors[pos];
+        int length = descriptors[pos + 1];
+        if( tag == 0x6a )
+        {
+            *audio = true;
+            return "AC-3";
+        }
+        if( tag == 0x7a )
+        {
+            *audio = true;
+            return "EC-3";
+        }
+        pos += 2 + length;
+    }
+    return QString();
+}
+
+static qint64 readPts(const uchar *p)
+{
+    return (qint64(p[0] >> 1) & 0x07) << 30 |
+            qint64(p[1]) << 22 |
+            qint64(p[2] >> 1) << 15 |
+            qint64(p[3]) << 7 |
+            qint64(p[4] >> 1);
+}
+
+TsProbe::TsProbe()
+    : mSynced(false)
+    , mPacketCount(0)
+    , mResyncCount(0)
+    , mPmtPid(-1)
+    , mPmtParsed(false)
+    , mStreamByPid(PID_COUNT, -1)
+{
+}
+
+void TsProbe::feed(const QByteArray &chunk)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(chunk.constData());
+    int size = chunk.size();
+    int offset = 0;
+
+    if( !mPending.isEmpty() )
+    {
+        if( !mSynced )
+        {
+            /// без синхронизации хвост короткий - проще склеить
+            mPending.append(chunk);
+            int consumed = 0;
+            scan(reinterpret_cast<const uchar *>(mPending.constData()), mPending.size(), &consumed);
+            mPending.remove(0, consumed);
+            return;
+        }
+
+        /// дополняем пакет, начатый в прошлой порции
+        int need = qMin(TsScanner::PACKET_SIZE - mPending.size(), size);
+        mPending.append(chunk.constData(), need);
+        offset = need;
+        if( mPending.size() < TsScanner::PACKET_SIZE )
+            return;
+
+        const uchar *packet = reinterpret_cast<const uchar *>(mPending.constData());
+        if( packet[0] == TsScanner::SYNC_BYTE )
+        {
+            processPacket(packet);
+        }
+        else
+        {
+            mSynced = false;
+            mResyncCount++;
+        }
+        mPending.clear();
+    }
+
+    int consumed = 0;
+    scan(data + offset, size - offset, &consumed);
+    mPending.append(chunk.constData() + offset + consumed, size - offset - consumed);
+}
+
+void TsProbe::finish()
+{
+    mPending.clear();
+}
+
+bool TsProbe::isValid() const
+{
+    return mPmtParsed;
+}
+
+quint64 TsProbe::packetCount() const
+{
+    return mPacketCount;
+}
+
+quint32 TsProbe::resyncCount() const
+{
+    return mResyncCount;
+}
+
+const QVector<TsProbe::Stream> &TsProbe::streams() const
+{
+    return mStreams;
+}
+
+const TsProbe::Stream *TsProbe::videoStream() const
+{
+    for( int i = 0; i < mStreams.size(); ++i )
+    {
+        if( mStreams.at(i).video )
+            return &mStreams.at(i);
+    }
+    return nullptr;
+}
+
+const TsProbe::Stream *TsProbe::audioStream() const
+{
+    for( int i = 0; i < mStreams.size(); ++i )
+    {
+        if( mStreams.at(i).audio )
+            return &mStreams.at(i);
+    }
+    return nullptr;
+}
+
+void TsProbe::scan(const uchar *data, int size, int *consumed)
+{
+    int pos = 0;
+    while( pos < size )
+    {
+        if( !mSynced )
+        {
+            int found = TsScanner::findSync(data + pos, size - pos);
+            if( found == -1 )
+            {
+                /// findSync принимает и кандидатов у самого конца - значит, 0x47 здесь нет вовсе
+                pos = size;
+                break;
+            }
+            pos += found;
+            mSynced = true;
+        }
+
+        if( pos + TsScanner::PACKET_SIZE > size )
+            break;
+        if( data[pos] != TsScanner::SYNC_BYTE )
+        {
+            mSynced = false;
+            mResyncCount++;
+            ++pos;
+            continue;
+        }
+        processPacket(data + pos);
+        pos += TsScanner::PACKET_SIZE;
+    }
+    *consumed = pos;
+}
+
+void TsProbe::processPacket(const uchar *packet)
+{
+    mPacketCount++;
+
+    const bool unitStart = packet[1] & 0x40;
+    const int pid = (packet[1] & 0x1f) << 8 | packet[2];
+    const int adaptation = (packet[3] >> 4) & 0x03;
+    if( pid == NULL_PID || !(adaptation & 0x01) )
+        return;
+
+    int offset = 4;
+    if( adaptation & 0x02 )
+        offset += 1 + packet[4];
+    if( offset >= TsScanner::PACKET_SIZE )
+        return;
+
+    const uchar *payload = packet + offset;
+    const int size = TsScanner::PACKET_SIZE - offset;
+
+    if( pid == PAT_PID || pid == mPmtPid )
+    {
+        /// таблицы помещаются в один пакет; pointer_field - до начала секции
+        if( !unitStart || payload[0] + 1 >= size )
+            return;
+        const uchar *section = payload + 1 + payload[0];
+        int sectionSize = size - 1 - payload[0];
+        if( pid == PAT_PID )
+            parsePat(section, sectionSize);
+        else
+            parsePmt(section, sectionSize);
+        return;
+    }
+
+    int index = mStreamByPid.at(pid);
+    if( index == -1 )
+        return;
+
+    Stream &stream = mStreams[index];
+    stream.bytes += quint64(size);
+    if( unitStart )
+    {
+        parsePes(stream, payload, size);
+    }
+}
+
+void TsProbe::parsePat(const uchar *section, int size)
+{
+    if( size < 8 || section[0] != 0x00 )
+        return;
+
+    int sectionLength = (section[1] & 0x0f) << 8 | section[2];
+    int end = qMin(3 + sectionLength - 4, size);
+    for( int pos = 8; pos + 4 <= end; pos += 4 )
+    {
+        int program = section[pos] << 8 | section[pos + 1];
+        if( program != 0 )
+        {
+            /// анализируем первую программу: в сегментах HLS она одна
+            mPmtPid = (section[pos + 2] & 0x1f) << 8 | section[pos + 3];
+            return;
+        }
+    }
+}
+
+void TsProbe::parsePmt(const uchar *section, int size)
+{
+    if( mPmtParsed || size < 12 || section[0] != 0x02 )
+        return;
+
+    int sectionLength = (section[1] & 0x0f) << 8 | section[2];
+    int end = qMin(3 + sectionLength - 4, size);
+    int programInfoLength = (section[10] & 0x0f) << 8 | section[11];
+    for( int pos = 12 + programInfoLength; pos + 5 <= end; )
+    {
+        Stream stream;
+        stream.streamType = section[pos];
+        stream.pid = quint16((section[pos + 1] & 0x1f) << 8 | section[pos + 2]);
+        int infoLength = (section[pos + 3] & 0x0f) << 8 | section[pos + 4];
+
+        stream.codec = codecFor(stream.streamType, &stream.video, &stream.audio);
+        if( stream.streamType == 0x06 )
+        {
+            stream.codec = codecForDescriptors(section + pos + 5, qMin(infoLength, end - pos - 5), &stream.audio);
+        }
+
+        if( mStreamByPid.at(stream.pid) == -1 )
+        {
+            mStreamByPid[stream.pid] = qint16(mStreams.size());
+            mStreams.append(stream);
+        }
+        pos += 5 + infoLength;
+    }
+    mPmtParsed = true;
+}
+
+void TsProbe::parsePes(Stream &stream, const uchar *payload, int size)
+{
+    /// 00 00 01 stream_id, длина, флаги; PTS - если PTS_DTS_flags & 2
+    if( size < 14 || payload[0] != 0x00 || payload[1] != 0x00 || payload[2] != 0x01 )
+        return;
+    if( !(payload[7] & 0x80) )
+        return;
+
+    qint64 pts = readPts(payload + 9);
+    if( stream.pesCount == 0 )
+    {
+        stream.minPts = pts;
+        stream.maxPts = pts;
+    }
+    else
+    {
+        stream.minPts = qMin(stream.minPts, pts);
+        stream.maxPts = qMax(stream.maxPts, pts);
+    }
+    stream.pesCount++;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/// Разбор сегмента MPEG-TS, чтобы проверить то, что заявлено в плейлистах.
+/// PAT и PMT дают PID'ы и типы потоков, заголовки PES дают PTS; по ним
+/// считаются байты каждого PID'а, число кадров и настоящий кодек.
+/// Данные подаются порциями, неполный пакет переносится в следующую.
+/// Синхронизация ищется через TsScanner; пакеты читаются только по
+/// заголовкам, поэтому разбор упирается в пропускную способность памяти.
+class TsProbe
+{
+public:
+    struct Stream
+    {
+        quint16 pid = 0;
+        quint8 streamType = 0;
+        QString codec;
+        bool video = false;
+        bool audio = false;
+        quint64 bytes = 0;      // полезная нагрузка пакетов PID'а
+        quint32 pesCount = 0;   // PES с PTS
+        qint64 minPts = -1;     // 90 кГц
+        qint64 maxPts = -1;
+    };
+
+    TsProbe();
+
+    void feed(const QByteArray &chunk);
+    void finish();
+
+    /// синхронизация найдена и PMT разобрана
+    bool isValid() const;
+    quint64 packetCount() const;
+    /// сколько раз синхронизация терялась и находилась заново
+    quint32 resyncCount() const;
+
+    const QVector<Stream> &streams() const;
+    /// первый видео/аудио-поток или nullptr
+    const Stream *videoStream() const;
+    const Stream *audioStream() const;
+
+private:
+    void scan(const uchar *data, int size, int *consumed);
+    void processPacket(const uchar *packet);
+    void parsePat(const uchar *section, int size);
+    void parsePmt(const uchar *section, int size);
+    void parsePes(Stream &stream, const uchar *payload, int size);
+
+private:
+    static const int PID_COUNT = 8192;
+
+    QByteArray mPending;
+    bool mSynced;
+    quint64 mPacketCount;
+    quint32 mResyncCount;
+
+    int mPmtPid;
+    bool mPmtParsed;
+    QVector<qint16> mStreamByPid;
+    QVector<Stream> mStreams;
+};
@@ -0,0 +1,89 @@
+#include "tsscanner.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(QT_COMPILER_SUPPORTS_AVX2) && defined(Q_CC_MSVC)
+#include <intrin.h>
+#endif
+
+#include <QtAlgorithms>
+
+typedef int (*FindSync)(const uchar *data, int size);
+
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+static bool hasAvx2()
+{
+#if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+    return __builtin_cpu_supports("avx2");
+#elif defined(Q_CC_MSVC)
+    /// AVX2 в процессоре и сохранение YMM-регистров операционной системой
+    int info[4];
+    __cpuid(info, 1);
+    if( !(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6 )
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return false;
+#endif
+}
+#endif
+
+#ifndef __SSE2__
+static int findSyncFallback(const uchar *data, int size)
+{
+    return TsScanner::findSyncScalar(data, 0, size);
+}
+#endif
+
+static FindSync selectFindSync()
+{
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    if( hasAvx2() )
+        return &TsScanner::findSyncAvx2;
+#endif
+#ifdef __SSE2__
+    return &TsScanner::findSyncSse2;
+#else
+    return &findSyncFallback;
+#endif
+}
+
+int TsScanner::findSync(const uchar *data, int size)
+{
+    static const FindSync findSync = selectFindSync();
+    return findSync(data, size);
+}
+
+int TsScanner::findSyncScalar(const uchar *data, int from, int size)
+{
+    for( int i = from; i < size; ++i )
+    {
+        if( data[i] == SYNC_BYTE &&
+                (i + PACKET_SIZE >= size || data[i + PACKET_SIZE] == SYNC_BYTE) &&
+                (i + 2 * PACKET_SIZE >= size || data[i + 2 * PACKET_SIZE] == SYNC_BYTE) )
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef __SSE2__
+int TsScanner::findSyncSse2(const uchar *data, int size)
+{
+    const __m128i sync = _mm_set1_epi8(char(SYNC_BYTE));
+    int i = 0;
+    for( ; i + 16 + 2 * PACKET_SIZE <= size; i += 16 )
+    {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), sync);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + PACKET_SIZE)), sync);
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 2 * PACKET_SIZE)), sync);
+        uint mask = uint(_mm_movemask_epi8(_mm_and_si128(a, _mm_and_si128(b, c))));
+        if( mask )
+            return i + int(qCountTrailingZeroBits(mask));
+    }
+    return findSyncScalar(data, i, size);
+}
+#endif
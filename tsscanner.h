@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QtGlobal>
+
+/// Поиск синхронизации в потоке MPEG-TS: байт 0x47 в начале каждого
+/// 188-байтного пакета. Кандидат засчитывается, если 0x47 стоит и через
+/// один, и через два пакета (или там кончаются данные). Сравнение идёт
+/// по 32 (AVX2) или 16 (SSE2) байт за шаг; реализация выбирается один раз
+/// по возможностям процессора, без SIMD работает обычный цикл.
+class TsScanner
+{
+public:
+    static const int PACKET_SIZE = 188;
+    static const quint8 SYNC_BYTE = 0x47;
+
+    /// смещение первого синхронизированного пакета или -1
+    static int findSync(const uchar *data, int size);
+
+    static int findSyncScalar(const uchar *data, int from, int size);
+#ifdef __SSE2__
+    static int findSyncSse2(const uchar *data, int size);
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    static int findSyncAvx2(const uchar *data, int size);
+#endif
+};
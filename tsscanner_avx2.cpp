@@ -0,0 +1,26 @@
+#include "tsscanner.h"
+
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+
+#include <immintrin.h>
+
+#include <QtAlgorithms>
+
+/// Собирается с -mavx2 (AVX2_SOURCES) и вызывается только после проверки процессора
+int TsScanner::findSyncAvx2(const uchar *data, int size)
+{
+    const __m256i sync = _mm256_set1_epi8(char(SYNC_BYTE));
+    int i = 0;
+    for( ; i + 32 + 2 * PACKET_SIZE <= size; i += 32 )
+    {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), sync);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + PACKET_SIZE)), sync);
+        __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 2 * PACKET_SIZE)), sync);
+        uint mask = uint(_mm256_movemask_epi8(_mm256_and_si256(a, _mm256_and_si256(b, c))));
+        if( mask )
+            return i + int(qCountTrailingZeroBits(mask));
+    }
+    return findSyncScalar(data, i, size);
+}
+
+#endif
@@ -1,37 +1,89 @@
 #pragma once
 
-#include <QPair>
+#include <QByteArray>
+#include <QLatin1String>
 #include <QString>
 
+#include <cstring>
+
 class Utils
 {
 public:
-    static QString parseLine(const QString &line, const QString &key)
+    /// Следующая строка буфера без завершающих \r\n, без копирования.
+    /// pos сдвигается на начало следующей строки.
+    static QLatin1String nextLine(const QByteArray &data, int &pos)
+    {
+        const char *begin = data.constData() + pos;
+        const char *end = data.constData() + data.size();
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+        const char *lineEnd = newline ? newline : end;
+        pos = int((newline ? newline + 1 : end) - data.constData());
+        if( lineEnd > begin && *(lineEnd - 1) == '\r' )
+            --lineEnd;
+        return QLatin1String(begin, int(lineEnd - begin));
+    }
+
+    /// Если строка начинается с tag, отрезает его и возвращает true
+    static bool stripTag(QLatin1String &line, QLatin1String tag)
+    {
+        if( line.size() < tag.size() || std::memcmp(line.data(), tag.data(), size_t(tag.size())) )
+            return false;
+        line = QLatin1String(line.data() + tag.size(), line.size() - tag.size());
+        return true;
+    }
+
+    static int indexOf(QLatin1String str, char c, int from = 0)
+    {
+        if( from >= str.size() )
+            return -1;
+        const char *found = static_cast<const char *>(std::memchr(str.data() + from, c, size_t(str.size() - from)));
+        return found ? int(found - str.data()) : -1;
+    }
+
+    /// Десятичное число из начала строки; разбор останавливается на первом не-цифровом символе
+    static quint64 toUInt64(QLatin1String str)
     {
-        int keyStart = line.indexOf(key);
-        /// для различения BANDWIDTH и AVERAGE-BANDWIDTH
-        if( line.at(keyStart - 1) == "-" )
+        quint64 value = 0;
+        for( int i = 0; i < str.size(); ++i )
         {
-            keyStart = line.indexOf(key, keyStart + 1);
+            const char c = str.data()[i];
+            if( c < '0' || c > '9' )
+                break;
+            value = value * 10 + quint64(c - '0');
         }
-        if( keyStart > 0 )
+        return value;
+    }
+
+    /// Десятичное число секунд (например, "10.010") в микросекундах;
+    /// знаки после шестого отбрасываются
+    static quint64 toMicroseconds(QLatin1String str)
+    {
+        quint64 value = toUInt64(str) * 1000000;
+        int dot = 0;
+        while( dot < str.size() && str.data()[dot] >= '0' && str.data()[dot] <= '9' )
+            ++dot;
+        if( dot == str.size() || str.data()[dot] != '.' )
+            return value;
+
+        quint64 scale = 100000;
+        for( int i = dot + 1; i < str.size() && scale > 0; ++i, scale /= 10 )
         {
-            int keyEnd = line.indexOf(",", keyStart);
-            if( !QString::compare(key, QString("CODECS")) )
-            {
-                keyEnd = line.indexOf("\",", keyStart);
-            }
-            int val = keyStart + key.length() + 1;
-            if( keyEnd != -1 )
-            {
-                return line.mid(val, keyEnd - val).remove("\"");
-            }
-            else
-            {
-                return line.mid(val).remove("\"");
-            }
+            const char c = str.data()[i];
+            if( c < '0' || c > '9' )
+                break;
+            value += quint64(c - '0') * scale;
         }
-        return QString();
+        return value;
+    }
+
+    static bool isURI(QLatin1String line)
+    {
+        return line.size() > 0 && line.data()[0] != '#';
+    }
+
+    static bool isHLS(QLatin1String line)
+    {
+        return line == QLatin1String("#EXTM3U");
     }
 
     static bool isHLS(const QString &line)
@@ -39,25 +91,20 @@ public:
         return !QString::compare(line, QString("#EXTM3U"));
     }
 
+    /// имена совпадают с теми, что выдают TsProbe и Fmp4Probe: по ним
+    /// заявленный кодек сверяется с найденным в сегментах
     static QString getReadableCodec(const QString &codec)
     {
         if( codec.startsWith("avc", Qt::CaseInsensitive) ) return "AVC";
+        if( codec.startsWith("hvc1", Qt::CaseInsensitive) || codec.startsWith("hev1", Qt::CaseInsensitive) ) return "HEVC";
+        if( codec.startsWith("av01", Qt::CaseInsensitive) ) return "AV1";
+        if( codec.startsWith("vp09", Qt::CaseInsensitive) ) return "VP9";
         if( codec.startsWith("mp4a", Qt::CaseInsensitive) ) return "AAC";
         if( codec.startsWith("ac-3", Qt::CaseInsensitive) ) return "AC-3";
         if( codec.startsWith("ec-3", Qt::CaseInsensitive) ) return "EC-3";
+        if( codec.startsWith("opus", Qt::CaseInsensitive) ) return "Opus";
+        if( codec.startsWith("flac", Qt::CaseInsensitive) ) return "FLAC";
 
         return codec;
     }
-
-    static QPair<int, int> getStreamNumbers(const QString &str)
-    {
-        int first = str.indexOf('#');
-        int firstEnd = str.indexOf(' ', first);
-        int x = str.mid(first + 1, firstEnd - first - 1).toInt();
-        int second = str.indexOf('#', first + 1);
-        int secondEnd = str.indexOf(' ', second);
-        int y = str.mid(second + 1, secondEnd - second - 1).toInt();
-
-        return qMakePair(x, y);
-    }
 };